@@ -23,6 +23,20 @@
 #define PIN_ROT_POT  A1  ///< Analog pin 1 for Rotary Potentiometer
 #define PIN_FRET_1070_INT  14  ///< GPIO interrupt pin for changes on FretBoard AT42QT1070
 #define PIN_FRET_2120_INT  15  ///< GPIO interrupt pin for changes on FretBoard AT42QT2120
+#define PIN_IMU_INT  -1  ///< MMA8452Q INT1 data-ready line, -1 as it is not routed on the v2 board
+#define PIN_IMU_PL_INT  -1  ///< MMA8452Q INT2 orientation-change line, -1 as it is not routed on the v2 board
+#define PIN_WIRE_SDA  18  ///< Wire SDA, FretBoard
+#define PIN_WIRE_SCL  19  ///< Wire SCL, FretBoard
+
+///< \def PIN_WIRE1_SDA
+///< Wire1 pins differ per Teensy, the SDA1_SEL and SCL1_SEL jumpers pick which ones reach the StrumBoard and IMU
+#if defined(__MKL26Z64__)
+  #define PIN_WIRE1_SDA  23  ///< Wire1 SDA on the Teensy LC
+  #define PIN_WIRE1_SCL  22  ///< Wire1 SCL on the Teensy LC
+#else
+  #define PIN_WIRE1_SDA  17  ///< Wire1 SDA on the Teensy 4.0
+  #define PIN_WIRE1_SCL  16  ///< Wire1 SCL on the Teensy 4.0
+#endif
 
 #define LED_OFF    0x7  ///< 0b111 is Off, 1 corresponds to turning R/G/B channel off
 #define LED_RED    0x6  ///< 0b110 is Red, only red channel on
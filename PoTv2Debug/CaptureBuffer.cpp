@@ -0,0 +1,276 @@
+/*!
+ * @file CaptureBuffer.cpp
+ *
+ * \brief Triggered high-rate sensor capture buffer
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#include <string.h>
+
+#include "CaptureBuffer.hpp"
+
+static_assert(CAPTURE_RAM_BYTES / CAPTURE_RECORD_MAX_LEN >= 2, "Capture storage must hold a pre- and a post-trigger record");
+
+CAPTURE_STORAGE_ATTR uint8_t CaptureBuffer::_storage[CAPTURE_RAM_BYTES];
+
+/**************************************************************************/
+/*!
+    @brief    Constructor for CaptureBuffer, starts idle
+*/
+/**************************************************************************/
+CaptureBuffer::CaptureBuffer(void)
+{
+  _state = CAPTURE_STATE_IDLE;
+  _channels = 0;
+  _trigger = CAPTURE_TRIGGER_NOW;
+  _threshold = 0;
+  _periodMicros = 0;
+  _recordLen = 0;
+  _capacity = 0;
+  _preTarget = 0;
+  _writeSlot = 0;
+  _count = 0;
+  _postRemaining = 0;
+  _triggerIndex = 0;
+  _triggerTimestamp = 0;
+  memset(&_prev, 0, sizeof(_prev));
+  _hasPrev = false;
+  _isHeaderSent = false;
+  _dumpNext = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Discard any capture and start recording, waiting for the trigger
+    @param    channels
+              CAPTURE_CHANNEL_* bits to store, fewer channels fit more records
+    @param    trigger
+              CAPTURE_TRIGGER_* that ends the pre-trigger window
+    @param    threshold
+              Echo width in us that CAPTURE_TRIGGER_ULTRA fires below
+    @param    prePercent
+              Share of the capacity kept from before the trigger, 0 to 100
+    @param    periodMicros
+              Rate Record() is called at, reported to the host
+*/
+/**************************************************************************/
+void CaptureBuffer::Arm(uint8_t channels, uint8_t trigger, uint32_t threshold, uint8_t prePercent, uint32_t periodMicros)
+{
+  _channels = channels & CAPTURE_CHANNEL_ALL;
+  _trigger = (trigger < CAPTURE_NUM_TRIGGERS) ? trigger : CAPTURE_TRIGGER_NOW;
+  _threshold = threshold;
+  _periodMicros = periodMicros;
+  _recordLen = (uint8_t) TelemetryCaptureRecordLen(_channels);
+  _capacity = CAPTURE_RAM_BYTES / _recordLen;
+
+  // At least the trigger record itself lands in the post-trigger window
+  _preTarget = (_trigger == CAPTURE_TRIGGER_NOW || prePercent == 0) ? 0 : (uint32_t) ((uint64_t) _capacity * prePercent / 100);
+  if (_preTarget >= _capacity)
+  {
+    _preTarget = _capacity - 1;
+  }
+
+  _writeSlot = 0;
+  _count = 0;
+  _postRemaining = 0;
+  _triggerIndex = 0;
+  _triggerTimestamp = 0;
+  _hasPrev = false;
+  _isHeaderSent = false;
+  _dumpNext = 0;
+  _state = CAPTURE_STATE_ARMED;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Stop recording or dumping and discard the capture
+*/
+/**************************************************************************/
+void CaptureBuffer::Cancel(void)
+{
+  _state = CAPTURE_STATE_IDLE;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Store one sample while armed or triggered, call at the sample period
+    @param    sample
+              Latest value of every channel, only the enabled ones are kept
+*/
+/**************************************************************************/
+void CaptureBuffer::Record(const CaptureSample &sample)
+{
+  if (!IsSampling())
+  {
+    return;
+  }
+
+  if (_state == CAPTURE_STATE_ARMED && _IsTriggered(sample))
+  {
+    _state = CAPTURE_STATE_TRIGGERED;
+    _triggerIndex = (_count < _preTarget) ? _count : _preTarget;
+    _postRemaining = _capacity - _triggerIndex;
+    _triggerTimestamp = sample.timestamp;
+  }
+
+  TelemetryPackCaptureRecord(sample, _channels, &_storage[_writeSlot * _recordLen]);
+  _writeSlot = (_writeSlot + 1 == _capacity) ? 0 : _writeSlot + 1;
+  if (_count < _capacity)
+  {
+    _count++;
+  }
+  _prev = sample;
+  _hasPrev = true;
+
+  // Pre- and post-trigger records always add up to a full ring, oldest at _writeSlot
+  if (_state == CAPTURE_STATE_TRIGGERED && --_postRemaining == 0)
+  {
+    _state = CAPTURE_STATE_DUMPING;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Queue as much of a finished capture as SerialTx has room for, call every loop pass
+    @param    tx
+              Output the packets go to, one non-replaceable frame each
+*/
+/**************************************************************************/
+void CaptureBuffer::Service(SerialTx &tx)
+{
+  uint8_t payload[TELEMETRY_MAX_PAYLOAD];
+
+  while (_state == CAPTURE_STATE_DUMPING && tx.GetFree() >= TELEMETRY_MAX_FRAME_LEN)
+  {
+    if (!_isHeaderSent)
+    {
+      TelemetryCaptureHeader header;
+      header.channels = _channels;
+      header.trigger = _trigger;
+      header.periodMicros = _periodMicros;
+      header.recordCount = _capacity;
+      header.triggerIndex = _triggerIndex;
+      header.triggerTimestamp = _triggerTimestamp;
+      _isHeaderSent = _SendPacket(tx, payload, TelemetryPackCaptureHeader(header, payload), true);
+      continue;
+    }
+
+    // A block never wraps the ring, so its records go out with one copy
+    uint32_t maxPerBlock = (TELEMETRY_MAX_PAYLOAD - TELEMETRY_CAPTURE_BLOCK_OVERHEAD) / _recordLen;
+    uint32_t slot = _writeSlot + _dumpNext;
+    slot = (slot >= _capacity) ? slot - _capacity : slot;
+    uint32_t count = _capacity - _dumpNext;
+    if (count > _capacity - slot)
+    {
+      count = _capacity - slot;
+    }
+    if (count > maxPerBlock)
+    {
+      count = maxPerBlock;
+    }
+    size_t len = TelemetryPackCaptureBlock(_dumpNext, &_storage[slot * _recordLen], (uint8_t) count, _recordLen, payload);
+    if (!_SendPacket(tx, payload, len, false))
+    {
+      break;
+    }
+    _dumpNext += count;
+    if (_dumpNext == _capacity)
+    {
+      _state = CAPTURE_STATE_IDLE;
+    }
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Current CAPTURE_STATE_*
+*/
+/**************************************************************************/
+uint8_t CaptureBuffer::GetState(void) const
+{
+  return _state;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Whether Record() is storing samples, so the caller only gathers them when needed
+*/
+/**************************************************************************/
+bool CaptureBuffer::IsSampling(void) const
+{
+  return _state == CAPTURE_STATE_ARMED || _state == CAPTURE_STATE_TRIGGERED;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Records held in the ring
+*/
+/**************************************************************************/
+uint32_t CaptureBuffer::GetCount(void) const
+{
+  return _count;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Records a complete capture holds with the armed channels
+*/
+/**************************************************************************/
+uint32_t CaptureBuffer::GetCapacity(void) const
+{
+  return _capacity;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Whether a sample meets the armed trigger
+    @param    sample
+              Newest sample, compared against _prev for edge triggers
+    @return   True if the post-trigger window starts with this sample
+*/
+/**************************************************************************/
+bool CaptureBuffer::_IsTriggered(const CaptureSample &sample) const
+{
+  switch (_trigger)
+  {
+    case CAPTURE_TRIGGER_FRET:
+      return _hasPrev && (sample.fretKeys & ~_prev.fretKeys) != 0;
+    case CAPTURE_TRIGGER_STRUM:
+      return _hasPrev && (sample.strumKeys & ~_prev.strumKeys) != 0;
+    case CAPTURE_TRIGGER_ULTRA:
+      // Crossing into range rather than being in range, like an analyzer edge trigger
+      return _hasPrev && sample.echoMicros != 0 && sample.echoMicros < _threshold &&
+             (_prev.echoMicros == 0 || _prev.echoMicros >= _threshold);
+    default:
+      return true;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Frame a payload and queue it as its own non-replaceable frame
+    @param    tx
+              Output to queue the frame on
+    @param    payload
+              Serialized packet
+    @param    len
+              Number of bytes in payload
+    @param    isResync
+              True to lead with a 0x00 so TUI text sent before it cannot corrupt the frame
+    @return   True if it was queued
+*/
+/**************************************************************************/
+bool CaptureBuffer::_SendPacket(SerialTx &tx, const uint8_t *payload, size_t len, bool isResync)
+{
+  uint8_t frame[TELEMETRY_MAX_FRAME_LEN];
+  size_t frameLen = TelemetryEncodeFrame(payload, len, frame);
+
+  tx.BeginFrame();
+  if (isResync)
+  {
+    tx.write((uint8_t) 0x00);
+  }
+  tx.write(frame, frameLen);
+  return tx.EndFrame(false);
+}
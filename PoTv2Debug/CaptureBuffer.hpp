@@ -0,0 +1,89 @@
+/*!
+ * @file CaptureBuffer.hpp
+ *
+ * \brief Header for the triggered high-rate sensor capture buffer
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#ifndef __CAPTURE_BUFFER_HPP__
+#define __CAPTURE_BUFFER_HPP__
+
+#include <Arduino.h>
+#include "TelemetryCodec.hpp"
+#include "SerialTx.hpp"
+
+///< \def CAPTURE_RAM_BYTES
+///< Record storage, sized for the board's RAM. CAPTURE_PERIOD_US is the
+///< default sample period, CAPTURE_STORAGE_ATTR places the storage.
+#if defined(__IMXRT1062__)
+  #define CAPTURE_RAM_BYTES  (256 * 1024)  ///< A quarter of the 1MB, ~3.6s of every channel at CAPTURE_PERIOD_US
+  #define CAPTURE_STORAGE_ATTR  DMAMEM  ///< RAM2, keeps the tightly coupled RAM for code and stack
+  #define CAPTURE_PERIOD_US  250  ///< 4kHz
+#elif defined(__MKL26Z64__)
+  #define CAPTURE_RAM_BYTES  1024  ///< An eighth of the 8KB, 56 records of every channel or 256 of one
+  #define CAPTURE_STORAGE_ATTR
+  #define CAPTURE_PERIOD_US  1000  ///< 1kHz
+#else
+  #define CAPTURE_RAM_BYTES  (32 * 1024)
+  #define CAPTURE_STORAGE_ATTR
+  #define CAPTURE_PERIOD_US  250
+#endif
+
+#define CAPTURE_STATE_IDLE       0  ///< Nothing recorded, Arm() to start
+#define CAPTURE_STATE_ARMED      1  ///< Recording the pre-trigger window, waiting for the trigger
+#define CAPTURE_STATE_TRIGGERED  2  ///< Recording the post-trigger window
+#define CAPTURE_STATE_DUMPING    3  ///< Complete, Service() is sending it to the host
+
+/**************************************************************************/
+/*!
+    @brief  Logic-analyzer-style capture of chosen sensor channels
+    Once armed, Record() packs each sample's enabled CAPTURE_CHANNEL_* fields
+    into a fixed RAM ring, so only the newest records survive while waiting
+    for the trigger. When a sample meets the trigger, the ring keeps up to
+    the requested pre-trigger window and fills the rest of its capacity with
+    post-trigger records. Service() then sends a TELEMETRY_TYPE_CAPTURE_HEADER
+    packet and the records in TELEMETRY_TYPE_CAPTURE_BLOCK packets, only as
+    fast as SerialTx has room, and returns to idle. potv2-telemetry -c
+    turns the dump into CSV. All calls must come from the main loop.
+*/
+/**************************************************************************/
+class CaptureBuffer
+{
+  private:
+    uint8_t _state;  ///< CAPTURE_STATE_*
+    uint8_t _channels;  ///< CAPTURE_CHANNEL_* bits stored per record
+    uint8_t _trigger;  ///< CAPTURE_TRIGGER_* armed
+    uint32_t _threshold;  ///< Echo width in us for CAPTURE_TRIGGER_ULTRA
+    uint32_t _periodMicros;  ///< Sample period reported in the header
+    uint8_t _recordLen;  ///< Bytes per record for _channels
+    uint32_t _capacity;  ///< Records that fit CAPTURE_RAM_BYTES
+    uint32_t _preTarget;  ///< Records to keep from before the trigger
+    uint32_t _writeSlot;  ///< Ring slot the next record goes to
+    uint32_t _count;  ///< Valid records in the ring
+    uint32_t _postRemaining;  ///< Records still to take after the trigger
+    uint32_t _triggerIndex;  ///< Pre-trigger records kept, the index of the trigger record
+    uint32_t _triggerTimestamp;  ///< micros() of the trigger record
+    CaptureSample _prev;  ///< Previous sample, for edge triggers
+    bool _hasPrev;  ///< True once _prev is valid
+    bool _isHeaderSent;  ///< True once the dump's header packet is queued
+    uint32_t _dumpNext;  ///< Index of the next record to dump
+
+    static uint8_t _storage[CAPTURE_RAM_BYTES];  ///< Record ring, _capacity slots of _recordLen bytes
+
+    bool _IsTriggered(const CaptureSample &sample) const;
+    bool _SendPacket(SerialTx &tx, const uint8_t *payload, size_t len, bool isResync);
+
+  public:
+    CaptureBuffer(void);
+    void Arm(uint8_t channels, uint8_t trigger, uint32_t threshold, uint8_t prePercent, uint32_t periodMicros);
+    void Cancel(void);
+    void Record(const CaptureSample &sample);
+    void Service(SerialTx &tx);
+    uint8_t GetState(void) const;
+    bool IsSampling(void) const;
+    uint32_t GetCount(void) const;
+    uint32_t GetCapacity(void) const;
+};
+
+#endif  // __CAPTURE_BUFFER_HPP__
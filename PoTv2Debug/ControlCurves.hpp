@@ -0,0 +1,43 @@
+/*!
+ * @file ControlCurves.hpp
+ *
+ * \brief Paddle sensor-to-control curves and their compile-time lookup tables
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#ifndef __CONTROL_CURVES_HPP__
+#define __CONTROL_CURVES_HPP__
+
+#include "ControlMap.hpp"
+#include "Ultrasonic.hpp"
+#include "PotAdc.hpp"
+#include "SensorState.hpp"
+
+#define CONTROL_CC_MAX  127  ///< Largest MIDI data byte
+#define CONTROL_PITCH_BEND_DETUNE  -4096  ///< Pitch bend at the full whammy, half of the 14-bit negative range
+
+#ifndef ULTRA_CC_SHAPE_MILLI
+#define ULTRA_CC_SHAPE_MILLI  0  ///< ExpCurve steepness of the whammy CC, 0 is linear
+#endif
+
+#define IMU_TILT_SHIFT  4  ///< Milli-g are shifted right by this to index IMU_TILT_TO_CC, 16mg per entry
+#define IMU_TILT_MAX_MG  1024  ///< Tilt reaches the ends of IMU_TILT_TO_CC at +/-1g
+#define IMU_TILT_STEPS  (IMU_TILT_MAX_MG >> IMU_TILT_SHIFT)  ///< IMU_TILT_TO_CC covers -IMU_TILT_STEPS..IMU_TILT_STEPS
+
+// Ultrasonic distance in cm, hand close to the sensor is full whammy and
+// PITCH_BEND_MAX_CM ("no signal") leaves the note alone
+typedef ExpCurve<0, PITCH_BEND_MAX_CM, CONTROL_CC_MAX, 0, ULTRA_CC_SHAPE_MILLI> UltraCcCurve;
+typedef LinearCurve<0, PITCH_BEND_MAX_CM, CONTROL_PITCH_BEND_DETUNE, 0> UltraPitchBendCurve;
+CONTROL_TABLE(ULTRA_CM_TO_CC, uint8_t, UltraCcCurve, PITCH_BEND_MIN_CM, PITCH_BEND_MAX_CM);
+CONTROL_TABLE(ULTRA_CM_TO_PITCH_BEND, int16_t, UltraPitchBendCurve, PITCH_BEND_MIN_CM, PITCH_BEND_MAX_CM);
+
+// Potentiometer position from PotAdc
+typedef LinearCurve<0, POT_VALUE_MAX, 0, CONTROL_CC_MAX> PotCcCurve;
+CONTROL_TABLE(POT_TO_CC, uint8_t, PotCcCurve, 0, POT_VALUE_MAX);
+
+// IMU tilt on one axis, index with milli-g >> IMU_TILT_SHIFT through MapClamped()
+typedef LinearCurve<-IMU_TILT_STEPS, IMU_TILT_STEPS, 0, CONTROL_CC_MAX> ImuTiltCcCurve;
+CONTROL_TABLE(IMU_TILT_TO_CC, uint8_t, ImuTiltCcCurve, -IMU_TILT_STEPS, IMU_TILT_STEPS);
+
+#endif  // __CONTROL_CURVES_HPP__
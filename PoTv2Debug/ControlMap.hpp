@@ -0,0 +1,202 @@
+/*!
+ * @file ControlMap.hpp
+ *
+ * \brief Compile-time lookup tables for sensor-to-control curves
+ *
+ * A curve is a type describing an input range, the outputs at its two ends
+ * and a constexpr Eval() in between. CONTROL_TABLE() evaluates a curve at
+ * every input while compiling and stores the results in flash, so mapping a
+ * reading at run time is a single indexed load with no pow(), float or
+ * division. Curves only ever run in the compiler, so they may use double.
+ *
+ * Any type with the same static members as LinearCurve can be used as a
+ * user-defined curve.
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#ifndef __CONTROL_MAP_HPP__
+#define __CONTROL_MAP_HPP__
+
+#include <stdint.h>
+
+#define CONTROL_TABLE_MAX_ENTRIES  4096  ///< Largest input range a table may cover, keeps flash use bounded
+
+/**************************************************************************/
+/*!
+    @brief    Integer division rounded half away from zero, for constexpr curves
+*/
+/**************************************************************************/
+constexpr int32_t ControlMapDivRound(int32_t num, int32_t den)
+{
+  return ((num < 0) != (den < 0)) ? (num - den / 2) / den : (num + den / 2) / den;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Round a double to the nearest integer, half away from zero, for constexpr curves
+*/
+/**************************************************************************/
+constexpr int32_t ControlMapRound(double value)
+{
+  return (value < 0) ? (int32_t) (value - 0.5) : (int32_t) (value + 0.5);
+}
+
+/**************************************************************************/
+/*!
+    @brief    e^x for constexpr curves: halve x until small, sum the Taylor series, square back up
+*/
+/**************************************************************************/
+constexpr double ControlMapExp(double x)
+{
+  uint8_t halvings = 0;
+  while (x > 0.5 || x < -0.5)
+  {
+    x /= 2;
+    halvings++;
+  }
+  double sum = 1.0;
+  double term = 1.0;
+  for (uint8_t n=1; n<16; n++)
+  {
+    term *= x / n;
+    sum += term;
+  }
+  while (halvings-- > 0)
+  {
+    sum *= sum;
+  }
+  return sum;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Straight line from (InFirst, OutFirst) to (InLast, OutLast)
+    OutLast may be below OutFirst for a falling curve.
+*/
+/**************************************************************************/
+template <int32_t InFirst, int32_t InLast, int32_t OutFirst, int32_t OutLast>
+struct LinearCurve
+{
+  static constexpr int32_t inFirst = InFirst;  ///< Lowest input
+  static constexpr int32_t inLast = InLast;  ///< Highest input
+  static constexpr int32_t outFirst = OutFirst;  ///< Output at inFirst
+  static constexpr int32_t outLast = OutLast;  ///< Output at inLast
+
+  static constexpr int32_t Eval(int32_t x)
+  {
+    return OutFirst + ControlMapDivRound((x - InFirst) * (OutLast - OutFirst), InLast - InFirst);
+  }
+};
+
+/**************************************************************************/
+/*!
+    @brief  Exponential curve through the same end points as LinearCurve
+    ShapeMilli sets the steepness k in thousandths, output follows
+    (e^(k*t) - 1) / (e^k - 1) of the way from OutFirst to OutLast with t
+    going 0 to 1 across the input. Positive k puts the resolution at the
+    start of the input, negative k at the end, 0 is a straight line.
+*/
+/**************************************************************************/
+template <int32_t InFirst, int32_t InLast, int32_t OutFirst, int32_t OutLast, int32_t ShapeMilli>
+struct ExpCurve
+{
+  static constexpr int32_t inFirst = InFirst;  ///< Lowest input
+  static constexpr int32_t inLast = InLast;  ///< Highest input
+  static constexpr int32_t outFirst = OutFirst;  ///< Output at inFirst
+  static constexpr int32_t outLast = OutLast;  ///< Output at inLast
+
+  static constexpr int32_t Eval(int32_t x)
+  {
+    double t = (double) (x - InFirst) / (InLast - InFirst);
+    double k = ShapeMilli / 1000.0;
+    double shaped = (ShapeMilli == 0) ? t : (ControlMapExp(k * t) - 1.0) / (ControlMapExp(k) - 1.0);
+    return OutFirst + ControlMapRound(shaped * (OutLast - OutFirst));
+  }
+};
+
+/**************************************************************************/
+/*!
+    @brief  Curve evaluated at every input of its range, built by MakeControlTable()
+*/
+/**************************************************************************/
+template <typename T, typename Curve>
+struct ControlTable
+{
+  static_assert(Curve::inLast > Curve::inFirst, "ControlTable curve has an empty input range");
+  static_assert(Curve::inLast - Curve::inFirst < CONTROL_TABLE_MAX_ENTRIES, "ControlTable input range too wide for a lookup table");
+  static_assert((T) Curve::outFirst == Curve::outFirst && (T) Curve::outLast == Curve::outLast,
+                "ControlTable curve output does not fit the table type");
+
+  static constexpr int32_t inFirst = Curve::inFirst;  ///< Input stored in values[0]
+  static constexpr int32_t inLast = Curve::inLast;  ///< Input stored in the last entry
+
+  T values[Curve::inLast - Curve::inFirst + 1];  ///< Curve output for each input, from inFirst
+
+  /**************************************************************************/
+  /*!
+      @brief    Map an input the caller already keeps within [inFirst, inLast]
+  */
+  /**************************************************************************/
+  T Map(int32_t x) const
+  {
+    return values[x - Curve::inFirst];
+  }
+
+  /**************************************************************************/
+  /*!
+      @brief    Map an input that may fall outside [inFirst, inLast], clamping it first
+  */
+  /**************************************************************************/
+  T MapClamped(int32_t x) const
+  {
+    return values[(x < Curve::inFirst) ? 0 : (x > Curve::inLast) ? Curve::inLast - Curve::inFirst : x - Curve::inFirst];
+  }
+};
+
+/**************************************************************************/
+/*!
+    @brief    Evaluate a curve at every input, only ever called in constant expressions
+*/
+/**************************************************************************/
+template <typename T, typename Curve>
+constexpr ControlTable<T, Curve> MakeControlTable(void)
+{
+  ControlTable<T, Curve> table = {};
+  for (int32_t x=Curve::inFirst; x<=Curve::inLast; x++)
+  {
+    table.values[x - Curve::inFirst] = (T) Curve::Eval(x);
+  }
+  return table;
+}
+
+/**************************************************************************/
+/*!
+    @brief    True if every entry lies between the curve's end-point outputs
+*/
+/**************************************************************************/
+template <typename T, typename Curve>
+constexpr bool ControlTableIsBounded(const ControlTable<T, Curve> &table)
+{
+  int32_t low = (Curve::outFirst < Curve::outLast) ? Curve::outFirst : Curve::outLast;
+  int32_t high = (Curve::outFirst < Curve::outLast) ? Curve::outLast : Curve::outFirst;
+  for (int32_t i=0; i<=Curve::inLast - Curve::inFirst; i++)
+  {
+    if (table.values[i] < low || table.values[i] > high || Curve::Eval(i + Curve::inFirst) != table.values[i])
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+///< \def CONTROL_TABLE(name, type, curve, sensorFirst, sensorLast)
+///< Define a flash lookup table of curve, and check at compile time that it
+///< covers every reading [sensorFirst, sensorLast] its sensor can produce
+///< and that no entry strays outside the curve's output range or its type.
+#define CONTROL_TABLE(name, type, curve, sensorFirst, sensorLast) \
+  static constexpr ControlTable<type, curve> name = MakeControlTable<type, curve>(); \
+  static_assert(curve::inFirst <= (sensorFirst) && (sensorLast) <= curve::inLast, #name " does not cover its sensor's range"); \
+  static_assert(ControlTableIsBounded(name), #name " has entries outside its output range")
+
+#endif  // __CONTROL_MAP_HPP__
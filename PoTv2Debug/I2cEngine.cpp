@@ -0,0 +1,536 @@
+/*!
+ * @file I2cEngine.cpp
+ *
+ * \brief Non-blocking I2C transaction queue, one engine per hardware bus
+ *
+ * The fretBoard sits alone on Wire while the strumBoard and the MMA8452Q share
+ * Wire1. Rather than spinning on each transfer in turn, loop() submits every
+ * transaction it needs up front and then calls Service() on both engines, so
+ * both buses are kept busy at once and the CPU is free in between.
+ *
+ * Setup code uses Transfer() instead, which waits for one transaction but is
+ * still bounded by the engine's timeouts, so a NACK or a device holding SDA
+ * low costs a few milliseconds rather than hanging the paddle.
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#include <string.h>
+
+#include "I2cEngine.hpp"
+
+/**************************************************************************/
+/*!
+    @brief    Create an empty, never-submitted transaction
+*/
+/**************************************************************************/
+I2cTransaction::I2cTransaction(void)
+{
+  addr = 0;
+  writeLen = 0;
+  readLen = 0;
+  readCount = 0;
+  readBuf = NULL;
+  status = I2C_STATUS_IDLE;
+  maxRetries = I2C_DEFAULT_RETRIES;
+  attempts = 0;
+  callback = NULL;
+  context = NULL;
+  next = NULL;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Set up a register read: write startReg, repeated start, read count bytes
+    @param    devAddr
+              7-bit I2C device address
+    @param    startReg
+              First register address to read
+    @param    dest
+              Buffer of at least count bytes to hold the register values
+    @param    count
+              Number of consecutive registers to read
+*/
+/**************************************************************************/
+void I2cTransaction::SetupRead(uint8_t devAddr, uint8_t startReg, uint8_t *dest, uint8_t count)
+{
+  addr = devAddr;
+  writeBuf[0] = startReg;
+  writeLen = 1;
+  readBuf = dest;
+  readLen = count;
+  readCount = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Set up a register write of count bytes starting at startReg
+    @param    devAddr
+              7-bit I2C device address
+    @param    startReg
+              First register address to write
+    @param    src
+              Values to write, copied into the transaction
+    @param    count
+              Number of consecutive registers to write
+    @return   True on success, False if count does not fit in I2C_TXN_MAX_WRITE
+*/
+/**************************************************************************/
+bool I2cTransaction::SetupWrite(uint8_t devAddr, uint8_t startReg, const uint8_t *src, uint8_t count)
+{
+  if (count >= I2C_TXN_MAX_WRITE)
+  {
+    return false;
+  }
+  addr = devAddr;
+  writeBuf[0] = startReg;
+  memcpy(&writeBuf[1], src, count);
+  writeLen = count + 1;
+  readBuf = NULL;
+  readLen = 0;
+  readCount = 0;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Check whether the transaction is still queued or on the bus
+    @return   True until the transaction completes or fails
+*/
+/**************************************************************************/
+bool I2cTransaction::IsPending(void) const
+{
+  return (status == I2C_STATUS_QUEUED || status == I2C_STATUS_BUSY);
+}
+
+/**************************************************************************/
+/*!
+    @brief    Check whether the transaction completed successfully
+*/
+/**************************************************************************/
+bool I2cTransaction::IsOk(void) const
+{
+  return (status == I2C_STATUS_DONE);
+}
+
+/**************************************************************************/
+/*!
+    @brief    Create an engine for one bus
+    @param    driver
+              Driver for the bus, must outlive the engine
+    @param    clock
+              Microsecond time source, NULL for no timeouts (a driver that
+              always finishes, like the host fake bus)
+*/
+/**************************************************************************/
+I2cEngine::I2cEngine(I2cBusDriver &driver, I2cClock clock)
+{
+  _driver = &driver;
+  _clock = clock;
+  _head = NULL;
+  _tail = NULL;
+  _isActive = false;
+  _startMicros = 0;
+  _busClockHz = 0;
+  memset(_devices, 0, sizeof(_devices));
+  _numDevices = 0;
+  _recoveries = 0;
+  _statsMicros = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Append a transaction to this bus's queue, does not touch the bus
+    @param    txn
+              Transaction to run, must stay alive until it completes
+    @return   True if queued, False if txn is already pending
+*/
+/**************************************************************************/
+bool I2cEngine::Submit(I2cTransaction &txn)
+{
+  if (txn.IsPending())
+  {
+    return false;
+  }
+  txn.status = I2C_STATUS_QUEUED;
+  txn.readCount = 0;
+  txn.attempts = 0;
+  txn.next = NULL;
+
+  if (_tail == NULL)
+  {
+    _head = &txn;
+  }
+  else
+  {
+    _tail->next = &txn;
+  }
+  _tail = &txn;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Advance the bus state machine without blocking
+
+    Starts the next queued transaction as soon as the previous one finishes,
+    so a driver that completes synchronously drains the whole queue in one call.
+*/
+/**************************************************************************/
+void I2cEngine::Service(void)
+{
+  while (_head != NULL)
+  {
+    I2cDeviceStats *dev = _FindDevice(_head->addr);
+    uint32_t clockHz = (dev != NULL) ? dev->clockHz : I2C_CLOCK_DEFAULT_HZ;
+
+    if (!_isActive)
+    {
+      if (clockHz != _busClockHz)
+      {
+        if (!_driver->SetClock(clockHz))
+        {
+          return;  // Bus not ready yet, try again next call
+        }
+        _busClockHz = clockHz;
+      }
+      _head->status = I2C_STATUS_BUSY;
+      if (!_driver->Start(_head))
+      {
+        _head->status = I2C_STATUS_QUEUED;  // Bus not ready yet, try again next call
+        return;
+      }
+      _isActive = true;
+      _startMicros = (_clock != NULL) ? _clock() : 0;
+      if (dev != NULL)
+      {
+        dev->transactions++;
+      }
+    }
+
+    uint8_t status = _driver->Poll();
+    if (status == I2C_STATUS_BUSY)
+    {
+      if (_clock == NULL || _clock() - _startMicros <= _TimeoutMicros(_head, clockHz))
+      {
+        return;
+      }
+      status = I2C_STATUS_TIMEOUT;
+    }
+
+    // A NACK leaves the bus idle, anything else may have left a device mid-byte
+    if (status == I2C_STATUS_TIMEOUT || status == I2C_STATUS_ERROR)
+    {
+      _driver->Recover();
+      _recoveries++;
+    }
+    if (dev != NULL)
+    {
+      switch (status)
+      {
+        case I2C_STATUS_DONE:    dev->bytes += _head->writeLen + _head->readCount; break;
+        case I2C_STATUS_NACK:    dev->nacks++; break;
+        case I2C_STATUS_TIMEOUT: dev->timeouts++; break;
+        default:                 dev->errors++; break;
+      }
+    }
+
+    if (status != I2C_STATUS_DONE && _head->attempts < _head->maxRetries)
+    {
+      _head->attempts++;
+      _head->readCount = 0;
+      _isActive = false;
+      if (dev != NULL)
+      {
+        dev->retries++;
+      }
+      continue;
+    }
+    _Complete(status);
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Check whether there is nothing left for this engine to do
+*/
+/**************************************************************************/
+bool I2cEngine::IsIdle(void) const
+{
+  return (_head == NULL);
+}
+
+/**************************************************************************/
+/*!
+    @brief    Run one transaction and wait for it, for setup code only
+
+    Everything queued ahead of txn runs first. Without a clock source a
+    driver that never finishes would hang here, so the firmware always
+    passes micros().
+    @param    txn
+              Transaction to run
+    @return   True if it completed successfully, else False
+*/
+/**************************************************************************/
+bool I2cEngine::Transfer(I2cTransaction &txn)
+{
+  if (!Submit(txn))
+  {
+    return false;
+  }
+  while (txn.IsPending())
+  {
+    Service();
+  }
+  return txn.IsOk();
+}
+
+/**************************************************************************/
+/*!
+    @brief    Select the clock a device's transactions run at
+    @param    addr
+              7-bit device address
+    @param    hz
+              SCL rate, the driver switches to it before each of the device's transactions
+*/
+/**************************************************************************/
+void I2cEngine::SetDeviceClock(uint8_t addr, uint32_t hz)
+{
+  I2cDeviceStats *dev = _FindDevice(addr);
+  if (dev != NULL)
+  {
+    dev->clockHz = hz;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Find the fastest clock a device answers reliably at, for setup code only
+
+    Tries each clock in turn, reading idReg I2C_PROBE_READS times without
+    retries, and keeps the first one where every read returns idValue.
+    @param    addr
+              7-bit device address
+    @param    idReg
+              Register holding a fixed ID
+    @param    idValue
+              Value idReg always holds
+    @param    clocks
+              Candidate SCL rates, fastest first
+    @param    numClocks
+              Number of entries in clocks
+    @return   Selected clock, or 0 if the device never answered, which
+              leaves it at the last (slowest) candidate
+*/
+/**************************************************************************/
+uint32_t I2cEngine::ProbeClock(uint8_t addr, uint8_t idReg, uint8_t idValue, const uint32_t *clocks, uint8_t numClocks)
+{
+  I2cTransaction txn;
+  uint8_t value;
+
+  txn.maxRetries = 0;
+  for (uint8_t c=0; c<numClocks; c++)
+  {
+    SetDeviceClock(addr, clocks[c]);
+    uint8_t passes = 0;
+    while (passes < I2C_PROBE_READS)
+    {
+      value = (uint8_t) ~idValue;
+      txn.SetupRead(addr, idReg, &value, 1);
+      if (!Transfer(txn) || value != idValue)
+      {
+        break;
+      }
+      passes++;
+    }
+    if (passes == I2C_PROBE_READS)
+    {
+      return clocks[c];
+    }
+  }
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Number of device addresses with settings and counters
+*/
+/**************************************************************************/
+uint8_t I2cEngine::GetNumDevices(void) const
+{
+  return _numDevices;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Settings and counters of one device
+    @param    index
+              0 to GetNumDevices() - 1, in the order the addresses were first used
+*/
+/**************************************************************************/
+const I2cDeviceStats &I2cEngine::GetDeviceStats(uint8_t index) const
+{
+  return _devices[(index < _numDevices) ? index : 0];
+}
+
+/**************************************************************************/
+/*!
+    @brief    Throughput of one device since the counters were last reset
+    @param    index
+              0 to GetNumDevices() - 1
+    @return   Bytes per second, 0 without a clock source
+*/
+/**************************************************************************/
+uint32_t I2cEngine::GetBytesPerSecond(uint8_t index) const
+{
+  uint32_t elapsed = (_clock != NULL) ? _clock() - _statsMicros : 0;
+  if (elapsed == 0 || index >= _numDevices)
+  {
+    return 0;
+  }
+  return (uint32_t) ((uint64_t) _devices[index].bytes * 1000000 / elapsed);
+}
+
+/**************************************************************************/
+/*!
+    @brief    Number of times the bus was recovered after a timeout or bus error
+*/
+/**************************************************************************/
+uint32_t I2cEngine::GetRecoveries(void) const
+{
+  return _recoveries;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Zero every counter, keeping the device clocks
+*/
+/**************************************************************************/
+void I2cEngine::ResetStats(void)
+{
+  for (uint8_t i=0; i<_numDevices; i++)
+  {
+    _devices[i].transactions = 0;
+    _devices[i].nacks = 0;
+    _devices[i].timeouts = 0;
+    _devices[i].errors = 0;
+    _devices[i].retries = 0;
+    _devices[i].bytes = 0;
+  }
+  _recoveries = 0;
+  _statsMicros = (_clock != NULL) ? _clock() : 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Entry for a device address, added at I2C_CLOCK_DEFAULT_HZ the first time it is used
+    @param    addr
+              7-bit device address
+    @return   The entry, or NULL if I2C_MAX_DEVICES addresses already have one
+*/
+/**************************************************************************/
+I2cDeviceStats *I2cEngine::_FindDevice(uint8_t addr)
+{
+  for (uint8_t i=0; i<_numDevices; i++)
+  {
+    if (_devices[i].addr == addr)
+    {
+      return &_devices[i];
+    }
+  }
+  if (_numDevices == I2C_MAX_DEVICES)
+  {
+    return NULL;
+  }
+  I2cDeviceStats *dev = &_devices[_numDevices++];
+  memset(dev, 0, sizeof(*dev));
+  dev->addr = addr;
+  dev->clockHz = I2C_CLOCK_DEFAULT_HZ;
+  return dev;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Time limit of one attempt at txn
+    @param    txn
+              Transaction on the bus
+    @param    clockHz
+              Clock it runs at
+    @return   I2C_TIMEOUT_BASE_US plus I2C_TIMEOUT_MARGIN times its bytes on the wire, in microseconds
+*/
+/**************************************************************************/
+uint32_t I2cEngine::_TimeoutMicros(const I2cTransaction *txn, uint32_t clockHz) const
+{
+  // Address byte of the write and of the repeated-start read
+  uint32_t bytes = 2 + txn->writeLen + txn->readLen;
+  return I2C_TIMEOUT_BASE_US + (uint32_t) ((uint64_t) bytes * I2C_BITS_PER_BYTE * I2C_TIMEOUT_MARGIN * 1000000 / clockHz);
+}
+
+/**************************************************************************/
+/*!
+    @brief    Retire the active transaction and notify its owner
+    @param    status
+              Final I2C_STATUS_* value reported by the driver
+*/
+/**************************************************************************/
+void I2cEngine::_Complete(uint8_t status)
+{
+  I2cTransaction *txn = _head;
+
+  _head = txn->next;
+  if (_head == NULL)
+  {
+    _tail = NULL;
+  }
+  _isActive = false;
+
+  txn->next = NULL;
+  txn->status = status;
+
+  // Callback runs after unlinking so it may resubmit txn
+  if (txn->callback != NULL)
+  {
+    txn->callback(txn);
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Give each engine one non-blocking service pass
+    @param    engines
+              Array of engines, one per bus
+    @param    count
+              Number of entries in engines
+*/
+/**************************************************************************/
+void I2cServiceAll(I2cEngine **engines, uint8_t count)
+{
+  for (uint8_t i=0; i<count; i++)
+  {
+    engines[i]->Service();
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Service all engines round-robin until every queue is empty
+    @param    engines
+              Array of engines, one per bus
+    @param    count
+              Number of entries in engines
+*/
+/**************************************************************************/
+void I2cWaitAll(I2cEngine **engines, uint8_t count)
+{
+  bool isBusy = true;
+
+  while (isBusy)
+  {
+    isBusy = false;
+    for (uint8_t i=0; i<count; i++)
+    {
+      engines[i]->Service();
+      isBusy |= !engines[i]->IsIdle();
+    }
+  }
+}
@@ -0,0 +1,153 @@
+/*!
+ * @file I2cEngine.hpp
+ *
+ * \brief Header for non-blocking I2C transaction queue, one engine per hardware bus
+ *
+ * The engine itself is plain C++ with no Arduino dependencies so its scheduling
+ * logic can also be built on a host against a fake bus driver
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#ifndef __I2C_ENGINE_HPP__
+#define __I2C_ENGINE_HPP__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define I2C_TXN_MAX_WRITE  16  ///< Max bytes (including register address) a transaction can write
+#define I2C_TXN_MAX_READ  32  ///< Max bytes a transaction should read, the Teensy LC Wire buffer
+
+#define I2C_STATUS_IDLE    0  ///< Transaction has never been submitted
+#define I2C_STATUS_QUEUED  1  ///< Transaction is waiting behind others on its bus
+#define I2C_STATUS_BUSY    2  ///< Transaction is currently on the bus
+#define I2C_STATUS_DONE    3  ///< Transaction completed successfully
+#define I2C_STATUS_NACK    4  ///< Device did not acknowledge
+#define I2C_STATUS_ERROR   5  ///< Bus error, arbitration loss or short read
+#define I2C_STATUS_TIMEOUT 6  ///< Did not finish within its time limit, the bus was recovered
+
+#define I2C_CLOCK_DEFAULT_HZ  100000  ///< Clock of a device until SetDeviceClock() or ProbeClock() picks one
+#define I2C_MAX_DEVICES  4  ///< Devices per bus with their own clock and statistics
+#define I2C_DEFAULT_RETRIES  2  ///< Extra attempts a failed transaction gets before it completes with the error
+#define I2C_BITS_PER_BYTE  9  ///< Eight data bits plus ACK
+#define I2C_TIMEOUT_BASE_US  1000  ///< Fixed part of a transaction's time limit, covers clock stretching
+#define I2C_TIMEOUT_MARGIN  4  ///< A transaction may take this many times its time on the wire on top of the base
+#define I2C_PROBE_READS  8  ///< ID reads in a row that must all come back right for ProbeClock() to accept a clock
+
+struct I2cTransaction;
+typedef void (*I2cCallback)(I2cTransaction *txn);  ///< Completion callback, called from I2cEngine::Service()
+typedef uint32_t (*I2cClock)(void);  ///< Microsecond time source for timeouts and bytes/s, micros() on the Teensy
+
+/**************************************************************************/
+/*!
+    @brief  A single write, read, or write-then-repeated-start-read I2C transfer
+    Transactions are owned by the caller and linked into the engine queue
+    without any allocation, so they must stay alive until completed.
+*/
+/**************************************************************************/
+struct I2cTransaction
+{
+  uint8_t addr;  ///< 7-bit device address
+  uint8_t writeLen;  ///< Bytes of writeBuf to send, may be 0 for a pure read
+  uint8_t writeBuf[I2C_TXN_MAX_WRITE];  ///< Bytes to send, usually register address first
+  uint8_t readLen;  ///< Bytes to read after a repeated start, may be 0 for a pure write
+  uint8_t readCount;  ///< Bytes actually read so far
+  uint8_t *readBuf;  ///< Destination for read bytes, at least readLen long
+  volatile uint8_t status;  ///< One of the I2C_STATUS_* values
+  uint8_t maxRetries;  ///< Extra attempts after a NACK, error or timeout, I2C_DEFAULT_RETRIES unless changed
+  uint8_t attempts;  ///< Retries used so far, engine only
+  I2cCallback callback;  ///< Optional completion callback, NULL for none
+  void *context;  ///< Caller data for use in callback
+  I2cTransaction *next;  ///< Engine queue link, do not touch
+
+  I2cTransaction(void);
+  void SetupRead(uint8_t devAddr, uint8_t startReg, uint8_t *dest, uint8_t count);
+  bool SetupWrite(uint8_t devAddr, uint8_t startReg, const uint8_t *src, uint8_t count);
+  bool IsPending(void) const;
+  bool IsOk(void) const;
+};
+
+/**************************************************************************/
+/*!
+    @brief  Per-device bus settings and counters kept by an I2cEngine
+*/
+/**************************************************************************/
+struct I2cDeviceStats
+{
+  uint8_t addr;  ///< 7-bit device address
+  uint32_t clockHz;  ///< SCL rate the device's transactions run at
+  uint32_t transactions;  ///< Attempts put on the bus, retries included
+  uint32_t nacks;  ///< Attempts the device did not acknowledge
+  uint32_t timeouts;  ///< Attempts that ran out of time
+  uint32_t errors;  ///< Attempts lost to bus errors, arbitration or short reads
+  uint32_t retries;  ///< Failed attempts that were tried again
+  uint32_t bytes;  ///< Register address and data bytes of successful attempts
+};
+
+/**************************************************************************/
+/*!
+    @brief  Hardware (or fake) bus that runs one transaction at a time
+    Start() must not block on the bus; Poll() advances the transfer and
+    returns I2C_STATUS_BUSY until it finishes. SetClock() is only called
+    between transactions and may refuse while the last STOP is going out.
+    Recover() abandons whatever is on the bus and frees a device holding SDA.
+*/
+/**************************************************************************/
+class I2cBusDriver
+{
+  public:
+    virtual ~I2cBusDriver() { }
+    virtual bool Start(I2cTransaction *txn) = 0;
+    virtual uint8_t Poll(void) = 0;
+    virtual bool SetClock(uint32_t hz) { (void) hz; return true; }
+    virtual void Recover(void) { }
+};
+
+/**************************************************************************/
+/*!
+    @brief  FIFO of transactions for one bus, advanced by calling Service()
+    Each device address gets its own clock, switched to before each of its
+    transactions, and its own counters. With a clock source every attempt
+    has a time limit, after which the driver recovers the bus. A failed
+    attempt is retried up to the transaction's maxRetries before it
+    completes with the error.
+*/
+/**************************************************************************/
+class I2cEngine
+{
+  private:
+    I2cBusDriver *_driver;  ///< Bus this engine drives
+    I2cClock _clock;  ///< Time source, NULL disables timeouts and bytes/s
+    I2cTransaction *_head;  ///< Active or next transaction
+    I2cTransaction *_tail;  ///< Last queued transaction
+    bool _isActive;  ///< True if _head has been started on the driver
+    uint32_t _startMicros;  ///< _clock() when _head was started
+    uint32_t _busClockHz;  ///< Clock the driver was last set to
+    I2cDeviceStats _devices[I2C_MAX_DEVICES];  ///< Settings and counters per address seen
+    uint8_t _numDevices;  ///< Valid entries in _devices
+    uint32_t _recoveries;  ///< Times the driver was asked to recover the bus
+    uint32_t _statsMicros;  ///< _clock() when the counters were last reset
+
+    I2cDeviceStats *_FindDevice(uint8_t addr);
+    uint32_t _TimeoutMicros(const I2cTransaction *txn, uint32_t clockHz) const;
+    void _Complete(uint8_t status);
+
+  public:
+    I2cEngine(I2cBusDriver &driver, I2cClock clock = NULL);
+    bool Submit(I2cTransaction &txn);
+    void Service(void);
+    bool IsIdle(void) const;
+    bool Transfer(I2cTransaction &txn);
+    void SetDeviceClock(uint8_t addr, uint32_t hz);
+    uint32_t ProbeClock(uint8_t addr, uint8_t idReg, uint8_t idValue, const uint32_t *clocks, uint8_t numClocks);
+    uint8_t GetNumDevices(void) const;
+    const I2cDeviceStats &GetDeviceStats(uint8_t index) const;
+    uint32_t GetBytesPerSecond(uint8_t index) const;
+    uint32_t GetRecoveries(void) const;
+    void ResetStats(void);
+};
+
+void I2cServiceAll(I2cEngine **engines, uint8_t count);
+void I2cWaitAll(I2cEngine **engines, uint8_t count);
+
+#endif  // __I2C_ENGINE_HPP__
@@ -0,0 +1,87 @@
+/*!
+ * @file ImuFilter.cpp
+ *
+ * \brief On-target per-sample cost of each IMU filter, POTV2_PROFILE builds only
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#include "LoopProfiler.hpp"
+#include "ImuFilter.hpp"
+
+#if POTV2_PROFILE
+
+#define IMU_BENCH_SAMPLES  1024  ///< Samples run through each filter
+#define IMU_BENCH_TABLE_LEN  64  ///< Distinct input samples, power of two
+#define IMU_BENCH_GSCALE  2  ///< Full-scale range used for the milli-g conversion
+
+/**************************************************************************/
+/*!
+    @brief    Time IMU_BENCH_SAMPLES filter steps plus milli-g conversions
+    @param    samples
+              IMU_BENCH_TABLE_LEN raw counts to cycle through
+    @return   Elapsed LoopProfiler::Now() ticks
+*/
+/**************************************************************************/
+template <typename Filter>
+static uint32_t _BenchFilter(const int16_t *samples)
+{
+  Filter filter;
+  volatile int16_t sink;
+
+  filter.Reset(samples[0]);
+  uint32_t start = LoopProfiler::Now();
+  for (uint16_t i=0; i<IMU_BENCH_SAMPLES; i++)
+  {
+    sink = ImuToMilliG(filter.Step(samples[i & (IMU_BENCH_TABLE_LEN - 1)]), IMU_BENCH_GSCALE);
+  }
+  uint32_t elapsed = LoopProfiler::Now() - start;
+  (void) sink;
+  return elapsed;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Print one benchmark line with the per-sample cost to two decimals
+*/
+/**************************************************************************/
+static void _PrintBenchLine(Print &out, const char *name, uint32_t ticks)
+{
+  uint32_t perSample100 = (uint32_t) ((uint64_t) ticks * 100 / IMU_BENCH_SAMPLES);
+
+  out.print(name); out.print(' ');
+  out.print(IMU_BENCH_SAMPLES); out.print(' ');
+  out.print(ticks); out.print(' ');
+  out.print(perSample100 / 100); out.print('.');
+  if (perSample100 % 100 < 10) out.print('0');
+  out.println(perSample100 % 100);
+}
+
+/**************************************************************************/
+/*!
+    @brief    Run every IMU filter over the same synthetic samples and print its cost
+    Times include the loop and the milli-g conversion, the "none" line is the baseline.
+    @param    out
+              Where to print, normally Serial
+*/
+/**************************************************************************/
+void ImuFilterBenchmark(Print &out)
+{
+  int16_t samples[IMU_BENCH_TABLE_LEN];
+  uint32_t lcg = 12345;
+
+  // 1g step with +/-32 counts of noise
+  for (uint8_t i=0; i<IMU_BENCH_TABLE_LEN; i++)
+  {
+    lcg = lcg * 1664525 + 1013904223;
+    samples[i] = ((i < IMU_BENCH_TABLE_LEN / 2) ? 0 : 1024) + (int16_t) ((lcg >> 24) & 0x3F) - 32;
+  }
+
+  out.print("filter samples total_"); out.print(PROFILE_TICK_UNIT);
+  out.print(" per_sample_"); out.println(PROFILE_TICK_UNIT);
+  _PrintBenchLine(out, "none", _BenchFilter<ImuPassFilter>(samples));
+  _PrintBenchLine(out, "ema", _BenchFilter<ImuEmaFilter>(samples));
+  _PrintBenchLine(out, "biquad", _BenchFilter<ImuBiquadFilter>(samples));
+}
+
+#endif  // POTV2_PROFILE
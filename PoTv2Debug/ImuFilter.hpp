@@ -0,0 +1,174 @@
+/*!
+ * @file ImuFilter.hpp
+ *
+ * \brief Integer Q-format low-pass filters for IMU samples
+ *
+ * The Teensy LC has no FPU, so every float multiply or conversion is a
+ * soft-float library call. These filters take raw 12-bit accelerometer
+ * counts, keep their state in fixed point and hand back values that
+ * ImuToMilliG() turns into signed milli-g with one multiply and a shift.
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#ifndef __IMU_FILTER_HPP__
+#define __IMU_FILTER_HPP__
+
+#include <stdint.h>
+
+#define IMU_FILTER_NONE    0  ///< Pass raw counts straight through
+#define IMU_FILTER_EMA     1  ///< First-order exponential moving average
+#define IMU_FILTER_BIQUAD  2  ///< Second-order Butterworth low-pass
+
+#ifndef IMU_FILTER_TYPE
+#define IMU_FILTER_TYPE  IMU_FILTER_EMA  ///< Filter behind the ImuFilter typedef
+#endif
+
+#define IMU_FILTER_FRAC_BITS  4  ///< Fraction bits of filter values, 12-bit counts become Q11.4
+
+#ifndef IMU_EMA_SHIFT
+#define IMU_EMA_SHIFT  2  ///< EMA weight of each new sample is 1/2^IMU_EMA_SHIFT
+#endif
+
+// Biquad coefficients in Q2.14, a0 normalized to 1. The defaults are the RBJ
+// cookbook Butterworth low-pass at fc = fs/10, 20Hz at a 200Hz data rate.
+#define IMU_BIQUAD_COEF_BITS  14  ///< Fraction bits of the biquad coefficients
+#ifndef IMU_BIQUAD_B0
+#define IMU_BIQUAD_B0   1105   ///< Feed-forward coefficient of x[n]
+#define IMU_BIQUAD_B1   2210   ///< Feed-forward coefficient of x[n-1]
+#define IMU_BIQUAD_B2   1105   ///< Feed-forward coefficient of x[n-2]
+#define IMU_BIQUAD_A1  -18727  ///< Feedback coefficient of y[n-1]
+#define IMU_BIQUAD_A2   6763   ///< Feedback coefficient of y[n-2]
+#endif
+
+/**************************************************************************/
+/*!
+    @brief  No filtering, raw counts in the common fixed-point format
+*/
+/**************************************************************************/
+class ImuPassFilter
+{
+  public:
+    void Reset(int16_t counts) { (void) counts; }
+    int32_t Step(int16_t counts) { return (int32_t) counts << IMU_FILTER_FRAC_BITS; }
+};
+
+/**************************************************************************/
+/*!
+    @brief  y += (x - y) / 2^IMU_EMA_SHIFT, one subtract, shift and add per sample
+*/
+/**************************************************************************/
+class ImuEmaFilter
+{
+  private:
+    int32_t _y;  ///< Filter output, Q11.4
+
+  public:
+    ImuEmaFilter(void) : _y(0) { }
+
+    /**************************************************************************/
+    /*!
+        @brief    Settle the filter on counts, avoiding a start-up ramp from zero
+    */
+    /**************************************************************************/
+    void Reset(int16_t counts)
+    {
+      _y = (int32_t) counts << IMU_FILTER_FRAC_BITS;
+    }
+
+    /**************************************************************************/
+    /*!
+        @brief    Filter one sample
+        @param    counts
+                  Raw 12-bit accelerometer count
+        @return   Filtered value, Q11.4 counts
+    */
+    /**************************************************************************/
+    int32_t Step(int16_t counts)
+    {
+      _y += (((int32_t) counts << IMU_FILTER_FRAC_BITS) - _y) >> IMU_EMA_SHIFT;
+      return _y;
+    }
+};
+
+/**************************************************************************/
+/*!
+    @brief  Direct form I biquad, five 32-bit multiplies per sample
+    With Q11.4 samples and Q2.14 coefficients every product is below 2^30,
+    so the accumulator cannot overflow for any stable low-pass design.
+*/
+/**************************************************************************/
+class ImuBiquadFilter
+{
+  private:
+    int32_t _x1;  ///< x[n-1], Q11.4
+    int32_t _x2;  ///< x[n-2], Q11.4
+    int32_t _y1;  ///< y[n-1], Q11.4
+    int32_t _y2;  ///< y[n-2], Q11.4
+
+  public:
+    ImuBiquadFilter(void) : _x1(0), _x2(0), _y1(0), _y2(0) { }
+
+    /**************************************************************************/
+    /*!
+        @brief    Settle the filter on counts, avoiding a start-up ramp from zero
+    */
+    /**************************************************************************/
+    void Reset(int16_t counts)
+    {
+      _x1 = _x2 = _y1 = _y2 = (int32_t) counts << IMU_FILTER_FRAC_BITS;
+    }
+
+    /**************************************************************************/
+    /*!
+        @brief    Filter one sample
+        @param    counts
+                  Raw 12-bit accelerometer count
+        @return   Filtered value, Q11.4 counts
+    */
+    /**************************************************************************/
+    int32_t Step(int16_t counts)
+    {
+      int32_t x = (int32_t) counts << IMU_FILTER_FRAC_BITS;
+      int32_t acc = IMU_BIQUAD_B0 * x + IMU_BIQUAD_B1 * _x1 + IMU_BIQUAD_B2 * _x2
+                    - IMU_BIQUAD_A1 * _y1 - IMU_BIQUAD_A2 * _y2;
+      int32_t y = (acc + (1 << (IMU_BIQUAD_COEF_BITS - 1))) >> IMU_BIQUAD_COEF_BITS;
+
+      _x2 = _x1;
+      _x1 = x;
+      _y2 = _y1;
+      _y1 = y;
+      return y;
+    }
+};
+
+#if IMU_FILTER_TYPE == IMU_FILTER_BIQUAD
+typedef ImuBiquadFilter ImuFilter;  ///< Filter selected by IMU_FILTER_TYPE
+#elif IMU_FILTER_TYPE == IMU_FILTER_EMA
+typedef ImuEmaFilter ImuFilter;  ///< Filter selected by IMU_FILTER_TYPE
+#else
+typedef ImuPassFilter ImuFilter;  ///< Filter selected by IMU_FILTER_TYPE
+#endif
+
+/**************************************************************************/
+/*!
+    @brief    Convert a filter value to milli-g
+    At +/-gScale g full scale a 12-bit count is gScale * 1000 / 2048 mg,
+    i.e. gScale * 125 / 256, so this folds to one multiply and one shift.
+    @param    value
+              Filter output, Q11.4 counts
+    @param    gScale
+              Full-scale range in g, 2, 4 or 8
+    @return   Acceleration in milli-g, rounded to nearest
+*/
+/**************************************************************************/
+static inline int16_t ImuToMilliG(int32_t value, uint8_t gScale)
+{
+  const uint8_t shift = 8 + IMU_FILTER_FRAC_BITS;
+  return (int16_t) ((value * (gScale * 125) + (1 << (shift - 1))) >> shift);
+}
+
+class Print;
+void ImuFilterBenchmark(Print &out);
+
+#endif  // __IMU_FILTER_HPP__
@@ -0,0 +1,166 @@
+/*!
+ * @file LoopProfiler.cpp
+ *
+ * \brief Per-stage loop profiler with scoped timers
+ *
+ * The scheduler reports per-task worst case times in microseconds, which is
+ * too coarse to see where the time inside a task goes. Wrapping a block in
+ * PROFILE_SCOPE() records its run time in DWT cycles on the Teensy 4.0, or in
+ * micros() on the LC, into per-stage min/mean/max and a log2 histogram.
+ * With POTV2_PROFILE left at 0 none of this is built.
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#include <string.h>
+
+#include "LoopProfiler.hpp"
+
+#if POTV2_PROFILE
+
+LoopProfiler loopProfiler;
+
+/**************************************************************************/
+/*!
+    @brief    Create a profiler with no named stages
+*/
+/**************************************************************************/
+LoopProfiler::LoopProfiler(void)
+{
+  for (uint8_t i=0; i<PROFILE_MAX_STAGES; i++)
+  {
+    _stages[i].name = NULL;
+  }
+  Reset();
+}
+
+/**************************************************************************/
+/*!
+    @brief    Start the tick source, call once from setup()
+*/
+/**************************************************************************/
+void LoopProfiler::Begin(void)
+{
+#if defined(__IMXRT1062__)
+  ARM_DEMCR |= ARM_DEMCR_TRCENA;
+  ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+#endif
+  Reset();
+}
+
+/**************************************************************************/
+/*!
+    @brief    Name a stage so it shows up in the report
+    @param    stage
+              Stage ID, below PROFILE_MAX_STAGES
+    @param    name
+              Short name, must be a string literal
+*/
+/**************************************************************************/
+void LoopProfiler::SetStageName(uint8_t stage, const char *name)
+{
+  if (stage < PROFILE_MAX_STAGES)
+  {
+    _stages[stage].name = name;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Add one run of a stage to its statistics
+    @param    stage
+              Stage ID
+    @param    ticks
+              Run time in LoopProfiler::Now() ticks
+*/
+/**************************************************************************/
+void LoopProfiler::Record(uint8_t stage, uint32_t ticks)
+{
+  if (stage >= PROFILE_MAX_STAGES)
+  {
+    return;
+  }
+  ProfileStage &s = _stages[stage];
+
+  s.count++;
+  s.totalTicks += ticks;
+  if (ticks < s.minTicks)
+  {
+    s.minTicks = ticks;
+  }
+  if (ticks > s.maxTicks)
+  {
+    s.maxTicks = ticks;
+  }
+
+  uint8_t bucket = (ticks == 0) ? 0 : 32 - __builtin_clz(ticks);
+  if (bucket >= PROFILE_NUM_BUCKETS)
+  {
+    bucket = PROFILE_NUM_BUCKETS - 1;
+  }
+  if (s.histogram[bucket] != 0xFFFF)
+  {
+    s.histogram[bucket]++;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Clear the statistics of every stage, keeping their names
+*/
+/**************************************************************************/
+void LoopProfiler::Reset(void)
+{
+  for (uint8_t i=0; i<PROFILE_MAX_STAGES; i++)
+  {
+    ProfileStage &s = _stages[i];
+    s.count = 0;
+    s.minTicks = 0xFFFFFFFF;
+    s.maxTicks = 0;
+    s.totalTicks = 0;
+    memset(s.histogram, 0, sizeof(s.histogram));
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Print one line per named stage: count, min, mean, max and the histogram
+    @param    out
+              Where to print, normally Serial
+*/
+/**************************************************************************/
+void LoopProfiler::PrintStats(Print &out)
+{
+  out.print("stage count min_"); out.print(PROFILE_TICK_UNIT);
+  out.print(" mean_"); out.print(PROFILE_TICK_UNIT);
+  out.print(" max_"); out.print(PROFILE_TICK_UNIT);
+  out.println(" log2_hist");
+  for (uint8_t i=0; i<PROFILE_MAX_STAGES; i++)
+  {
+    ProfileStage &s = _stages[i];
+    if (s.name == NULL)
+    {
+      continue;
+    }
+
+    out.print(s.name); out.print(' ');
+    out.print(s.count); out.print(' ');
+    out.print((s.count > 0) ? s.minTicks : 0); out.print(' ');
+    out.print((s.count > 0) ? (uint32_t) (s.totalTicks / s.count) : 0); out.print(' ');
+    out.print(s.maxTicks);
+
+    // Trailing empty buckets are left off
+    uint8_t lastBucket = PROFILE_NUM_BUCKETS;
+    while (lastBucket > 0 && s.histogram[lastBucket - 1] == 0)
+    {
+      lastBucket--;
+    }
+    for (uint8_t b=0; b<lastBucket; b++)
+    {
+      out.print(' '); out.print(s.histogram[b]);
+    }
+    out.println();
+  }
+}
+
+#endif  // POTV2_PROFILE
@@ -0,0 +1,112 @@
+/*!
+ * @file LoopProfiler.hpp
+ *
+ * \brief Header for per-stage loop profiler with scoped timers
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#ifndef __LOOP_PROFILER_HPP__
+#define __LOOP_PROFILER_HPP__
+
+#include "Arduino.h"
+
+#ifndef POTV2_PROFILE
+#define POTV2_PROFILE  0  ///< Set to 1 to build the loop profiler, 0 compiles every PROFILE_SCOPE away
+#endif
+
+#define PROFILE_MAX_STAGES  12  ///< Max stages that can be timed
+
+#if defined(__IMXRT1062__)
+#define PROFILE_NUM_BUCKETS  24  ///< log2 histogram buckets, the last also counts anything longer
+#define PROFILE_TICK_UNIT  "cycles"  ///< Unit of every reported time
+#else
+#define PROFILE_NUM_BUCKETS  16  ///< log2 histogram buckets, the last also counts anything longer
+#define PROFILE_TICK_UNIT  "us"  ///< Unit of every reported time
+#endif
+
+#if POTV2_PROFILE
+
+/**************************************************************************/
+/*!
+    @brief  Timing statistics of one profiled stage
+    Bucket b of the histogram counts runs of [2^(b-1), 2^b) ticks, bucket 0
+    counts runs too short to measure.
+*/
+/**************************************************************************/
+struct ProfileStage
+{
+  const char *name;  ///< Short name used in the report, NULL if unused
+  uint32_t count;  ///< Runs since the last Reset()
+  uint32_t minTicks;  ///< Shortest run
+  uint32_t maxTicks;  ///< Longest run
+  uint64_t totalTicks;  ///< Sum of all runs, for the mean
+  uint16_t histogram[PROFILE_NUM_BUCKETS];  ///< log2 run-time histogram, saturates at 0xFFFF
+};
+
+/**************************************************************************/
+/*!
+    @brief  Collects min/mean/max and a log2 histogram of run time per stage
+    Times are DWT cycle counts on the Teensy 4.0 and micros() elsewhere.
+*/
+/**************************************************************************/
+class LoopProfiler
+{
+  private:
+    ProfileStage _stages[PROFILE_MAX_STAGES];  ///< Stage statistics, indexed by stage ID
+
+  public:
+    LoopProfiler(void);
+    void Begin(void);
+    void SetStageName(uint8_t stage, const char *name);
+    void Record(uint8_t stage, uint32_t ticks);
+    void Reset(void);
+    void PrintStats(Print &out);
+
+    /**************************************************************************/
+    /*!
+        @brief    Current tick count, wraps
+    */
+    /**************************************************************************/
+    static inline uint32_t Now(void)
+    {
+#if defined(__IMXRT1062__)
+      return ARM_DWT_CYCCNT;
+#else
+      return micros();
+#endif
+    }
+};
+
+extern LoopProfiler loopProfiler;
+
+/**************************************************************************/
+/*!
+    @brief  Times from construction to the end of the enclosing scope
+*/
+/**************************************************************************/
+class ProfileScope
+{
+  private:
+    uint8_t _stage;  ///< Stage ID the time is recorded against
+    uint32_t _start;  ///< LoopProfiler::Now() at construction
+
+  public:
+    ProfileScope(uint8_t stage) : _stage(stage), _start(LoopProfiler::Now()) { }
+    ~ProfileScope() { loopProfiler.Record(_stage, LoopProfiler::Now() - _start); }
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+///< \def PROFILE_SCOPE(stage)
+///< Record the time from here to the end of the enclosing block against stage
+#define PROFILE_SCOPE(stage) ProfileScope PROFILE_CONCAT(_profileScope, __LINE__)(stage)
+
+#else
+
+#define PROFILE_SCOPE(stage) do { } while (0)
+
+#endif  // POTV2_PROFILE
+
+#endif  // __LOOP_PROFILER_HPP__
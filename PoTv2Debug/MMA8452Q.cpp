@@ -29,16 +29,24 @@ local, and you've found our code helpful, please buy us a round!
 Distributed as-is; no warranty is given.
 ******************************************************************************/
 
+#include <string.h>
+
 #include "Arduino.h"
 #include "MMA8452Q.hpp"
-#include <Wire.h>
-
-static byte readRegister(byte addressToRead);
-static void readRegisters(byte addressToRead, int bytesToRead, byte * dest);
-static void writeRegister(byte addressToWrite, byte dataToWrite);
-static void MMA8452Standby(void);
-static void MMA8452Active(void);
 
+// Written by init(): CTRL_REG1 first puts the chip in standby for the rest.
+// Data rate, power mode and fast read start at the power-on defaults,
+// SetDataRate()/ SetPowerMode()/ SetFastRead() change them afterwards
+static constexpr RegisterWrite MMA8452Q_INIT[] =
+{
+  MMA8452QMap::Ctrl1::Set(0),
+  MMA8452QMap::Ctrl2::Set(MMA8452Q_MODS_NORMAL),
+  MMA8452QMap::Ctrl3::Set(0),
+  MMA8452QMap::Ctrl4::Set(0),
+  MMA8452QMap::Ctrl5::Set(0),
+  MMA8452QMap::XyzDataCfg::Set(MMA8452Q_FSR_BITS),
+};
+static_assert(RegisterBurstCount(MMA8452Q_INIT) == 2, "control registers should go out in one burst");
 
 /**************************************************************************/
 /*!
@@ -48,6 +56,19 @@ static void MMA8452Active(void);
 MMA8452Q::MMA8452Q(void)
 {
   _slave_addr = MMA8452Q_SLAVE_ADDR;
+  _engine = NULL;
+  memset(_ctrlShadow, 0, sizeof(_ctrlShadow));
+  _isUpdateRequested = false;
+  _isFastRead = false;
+  _dataRate = MMA8452Q_ODR_800HZ;
+  _intPin = MMA8452Q_NO_INT_PIN;
+  _isFilterPrimed = false;
+  _plIntPin = MMA8452Q_NO_INT_PIN;
+  _isPortraitLandscapeEnabled = false;
+  _leftyOrientation = MMA8452Q_LAPO_LANDSCAPE_LEFT;
+  _isLefty = false;
+  _plStatus = 0;
+  _isOrientationRequested = false;
   x = 0;
   y = 0;
   z = 0;
@@ -56,169 +77,567 @@ MMA8452Q::MMA8452Q(void)
 /**************************************************************************/
 /*!
     @brief  Test and set up the IMU
+    @param  engine
+            I2cEngine driving Wire1, used by every blocking register access
+    @param  log
+            Where the online message or the failure warnings are printed
     @return 0 == failure, else 1
 */
 /**************************************************************************/
-int8_t MMA8452Q::init(void)
+int8_t MMA8452Q::init(I2cEngine &engine, Print &log)
 {
-  byte c = readRegister(MMA8452Q_WHOAMI_REG);  // Read WHOAMI register
+  _engine = &engine;
+  byte c = _ReadRegister(MMA8452Q_WHOAMI_REG);  // Read WHOAMI register
   if (c == MMA8452Q_WHOAMI_VAL) // WHOAMI should always be 0x2A
   {  
-    Serial.println("INFO: MMA8452Q is online...");
+    log.println("INFO: MMA8452Q is online...");
   }
   else
   {
-    Serial.print("WARNING: Could not connect to MMA8452Q: 0x");
-    Serial.println(c, HEX);
-    Serial.println("WARNING: Failed to init accelerometer!");  
+    log.print("WARNING: Could not connect to MMA8452Q: 0x");
+    log.println(c, HEX);
+    log.println("WARNING: Failed to init accelerometer!");
     return 0;
   }
   
-  MMA8452Standby();  // Must be in standby to change registers
-
-  byte fsr = GSCALE;  // Set up the full scale range to 2, 4, or 8g.
-  if(fsr > 8) fsr = 8;  //Easy error check
-  fsr >>= 2;  // Neat trick, see page 22. 00 = 2G, 01 = 4A, 10 = 8G
-  writeRegister(MMA8452Q_XYZ_DATA_CFG_REG, fsr);
-
-  // The default data rate is 800Hz and we don't modify it in this example code
+  if (!_WriteTable(MMA8452Q_INIT, sizeof(MMA8452Q_INIT) / sizeof(MMA8452Q_INIT[0])))
+  {
+    return 0;
+  }
+  _isFastRead = false;
+  _dataRate = MMA8452Q_ODR_800HZ;
 
-  MMA8452Active();  // Set to active to start reading
-  return 1;
+  return _Active() ? 1 : 0;  // Set to active to start reading
 }
 
 /**************************************************************************/
 /*! 
     @brief  Update the accelerometer values, store them in class vars x,y,z 
+    Does nothing if the INT line shows no sample is pending.
  */
 /**************************************************************************/
  
 void MMA8452Q::Update(void)
 {
-  byte rawData[6];  // x/y/z accel register data stored here
+  if (!_IsDataPending())
+  {
+    return;
+  }
+  _ReadRegisters(MMA8452Q_STATUS_REG, _ReadLen(), _rawData);  // Read STATUS and the raw data registers into data array
+  _ConvertRawData();
+}
 
-  readRegisters(MMA8452Q_OUT_X_MSB_REG, 6, rawData);  // Read the six raw data registers into data array
-  
-  x = ((short)(rawData[0]<<8 | rawData[1])) >> 4;
-  y = ((short)(rawData[2]<<8 | rawData[3])) >> 4;
-  z = ((short)(rawData[4]<<8 | rawData[5])) >> 4;
+/**************************************************************************/
+/*! 
+    @brief  Queue a burst read of the x/y/z output registers without waiting for it
+    @param  engine
+            I2cEngine driving Wire1
+    @return True if queued, False if the previous read has not been finished yet
+ */
+/**************************************************************************/
+bool MMA8452Q::StartUpdate(I2cEngine &engine)
+{
+  if (_isUpdateRequested || !_IsDataPending())
+  {
+    return false;
+  }
+  _updateTxn.SetupRead(_slave_addr, MMA8452Q_STATUS_REG, _rawData, _ReadLen());
+  engine.Submit(_updateTxn);
+  _isUpdateRequested = true;
+  return true;
+}
+
+/**************************************************************************/
+/*! 
+    @brief  Store x,y,z from the read queued by StartUpdate() once it has completed
+    @return True if x,y,z were updated with a new sample, else False
+ */
+/**************************************************************************/
+bool MMA8452Q::FinishUpdate(void)
+{
+  if (!_isUpdateRequested || _updateTxn.IsPending())
+  {
+    return false;
+  }
+  _isUpdateRequested = false;
+  if (!_updateTxn.IsOk())
+  {
+    return false;
+  }
+  return _ConvertRawData();
+}
+
+/**************************************************************************/
+/*! 
+    @brief  Filter the samples in _rawData into x,y,z if STATUS flags a new one
+    Fast-read samples are the top 8 bits of the 12-bit value, so both
+    formats are filtered as 12-bit counts. Integer only, no soft-float.
+    @return True if x,y,z were updated, else False
+ */
+/**************************************************************************/
+bool MMA8452Q::_ConvertRawData(void)
+{
+  int16_t countX, countY, countZ;
+
+  if (!(_rawData[0] & MMA8452Q_STATUS_ZYXDR))
+  {
+    return false;
+  }
+  if (_isFastRead)
+  {
+    countX = (int8_t) _rawData[1] * 16;
+    countY = (int8_t) _rawData[2] * 16;
+    countZ = (int8_t) _rawData[3] * 16;
+  }
+  else
+  {
+    countX = ((int16_t) (_rawData[1] << 8 | _rawData[2])) >> 4;
+    countY = ((int16_t) (_rawData[3] << 8 | _rawData[4])) >> 4;
+    countZ = ((int16_t) (_rawData[5] << 8 | _rawData[6])) >> 4;
+  }
+
+  if (!_isFilterPrimed)
+  {
+    _filterX.Reset(countX);
+    _filterY.Reset(countY);
+    _filterZ.Reset(countZ);
+    _isFilterPrimed = true;
+  }
+  x = ImuToMilliG(_filterX.Step(countX), GSCALE);
+  y = ImuToMilliG(_filterY.Step(countY), GSCALE);
+  z = ImuToMilliG(_filterZ.Step(countZ), GSCALE);
+  return true;
+}
+
+/**************************************************************************/
+/*! 
+    @brief  Whether a read can return a new sample
+    @return False only if an INT line is wired and deasserted
+ */
+/**************************************************************************/
+bool MMA8452Q::_IsDataPending(void)
+{
+  // INT is level-triggered and stays asserted until the sample is read, so
+  // sampling it from the IMU task never misses data and costs no ISR per sample
+  return (_intPin == MMA8452Q_NO_INT_PIN) || (digitalRead(_intPin) == LOW);
+}
+
+/**************************************************************************/
+/*! 
+    @brief  Length of a STATUS-plus-sample burst read in the current read mode
+ */
+/**************************************************************************/
+uint8_t MMA8452Q::_ReadLen(void)
+{
+  return _isFastRead ? MMA8452Q_FAST_READ_LEN : MMA8452Q_READ_LEN;
+}
+
+/**************************************************************************/
+/*! 
+    @brief  Change a control register field with the chip in standby
+    Works from the shadow copy, so a change that leaves the register as it
+    was costs no bus time at all. Must not be called while a StartUpdate()
+    read is outstanding.
+    @param  reg
+            Control register address
+    @param  mask
+            Bits of reg to change
+    @param  value
+            New value of the masked bits
+    @return True if the register holds the new bits and the chip is active again, else False
+ */
+/**************************************************************************/
+bool MMA8452Q::_UpdateCtrlReg(uint8_t reg, uint8_t mask, uint8_t value)
+{
+  uint8_t index = reg - MMA8452Q_CTRL1_REG;
+  if (index >= MMA8452Q_NUM_CTRL_REGS)
+  {
+    return false;
+  }
+  if (reg == MMA8452Q_CTRL1_REG)
+  {
+    mask &= ~MMA8452Q_CTRL1_ACTIVE;  // _Active() owns the active bit
+  }
+  if (((_ctrlShadow[index] ^ value) & mask) == 0)
+  {
+    return true;
+  }
+  // Control registers other than ACTIVE ignore writes in active mode
+  bool isOk = _Standby() && _WriteRegister(reg, (_ctrlShadow[index] & ~mask) | (value & mask));
+  return _Active() && isOk;
+}
+
+/**************************************************************************/
+/*! 
+    @brief  Select the output data rate
+    @param  odr
+            One of MMA8452Q_ODR_*
+    @return True if the chip took the new rate, else False and the old rate stays
+ */
+/**************************************************************************/
+bool MMA8452Q::SetDataRate(uint8_t odr)
+{
+  uint8_t dataRate = odr & (MMA8452Q_CTRL1_DR_MASK >> MMA8452Q_CTRL1_DR_SHIFT);
+  if (!_UpdateCtrlReg(MMA8452Q_CTRL1_REG, MMA8452Q_CTRL1_DR_MASK, dataRate << MMA8452Q_CTRL1_DR_SHIFT))
+  {
+    return false;
+  }
+  _dataRate = dataRate;
+  return true;
+}
+
+/**************************************************************************/
+/*! 
+    @brief  Select the active mode power/ oversampling scheme
+    @param  mods
+            One of MMA8452Q_MODS_*
+    @return True if the chip took the new mode, else False
+ */
+/**************************************************************************/
+bool MMA8452Q::SetPowerMode(uint8_t mods)
+{
+  return _UpdateCtrlReg(MMA8452Q_CTRL2_REG, MMA8452Q_CTRL2_MODS_MASK, mods);
+}
+
+/**************************************************************************/
+/*! 
+    @brief  Switch between 12-bit reads and 8-bit F_READ reads
+    F_READ cuts each sample read from 7 to 4 bytes at the cost of the low 4 bits.
+    @param  isFastRead
+            True to read only the MSB registers
+    @return True if the chip took the new read mode, else False and reads stay as they were
+ */
+/**************************************************************************/
+bool MMA8452Q::SetFastRead(bool isFastRead)
+{
+  if (!_UpdateCtrlReg(MMA8452Q_CTRL1_REG, MMA8452Q_CTRL1_F_READ, isFastRead ? MMA8452Q_CTRL1_F_READ : 0))
+  {
+    return false;
+  }
+  _isFastRead = isFastRead;
+  return true;
+}
+
+/**************************************************************************/
+/*! 
+    @brief  Route the data-ready interrupt, active low, to INT1 or INT2
+    @param  pin
+            Teensy pin wired to that INT line, or MMA8452Q_NO_INT_PIN to leave
+            the interrupt off and read on every request
+    @param  intLine
+            MMA8452Q_INT1 or MMA8452Q_INT2
+    @return True if the chip took the interrupt setup, else False and every request reads the bus
+ */
+/**************************************************************************/
+bool MMA8452Q::EnableDataReady(int8_t pin, uint8_t intLine)
+{
+  _intPin = MMA8452Q_NO_INT_PIN;
+  if (pin == MMA8452Q_NO_INT_PIN)
+  {
+    return _UpdateCtrlReg(MMA8452Q_CTRL4_REG, MMA8452Q_CTRL4_INT_EN_DRDY, 0);
+  }
+  pinMode(pin, INPUT_PULLUP);
+  if (!_UpdateCtrlReg(MMA8452Q_CTRL3_REG, MMA8452Q_CTRL3_IPOL, 0) ||
+      !_UpdateCtrlReg(MMA8452Q_CTRL5_REG, MMA8452Q_CTRL5_INT_CFG_DRDY,
+                      (intLine == MMA8452Q_INT1) ? MMA8452Q_CTRL5_INT_CFG_DRDY : 0) ||
+      !_UpdateCtrlReg(MMA8452Q_CTRL4_REG, MMA8452Q_CTRL4_INT_EN_DRDY, MMA8452Q_CTRL4_INT_EN_DRDY))
+  {
+    return false;
+  }
+  _intPin = pin;
+  return true;
+}
+
+/**************************************************************************/
+/*! 
+    @brief  Time between samples at the selected output data rate
+    @return Sample period in microseconds
+ */
+/**************************************************************************/
+uint32_t MMA8452Q::GetSamplePeriodMicros(void)
+{
+  static const uint32_t periods[] = { 1250, 2500, 5000, 10000, 20000, 80000, 160000, 640000 };
+  return periods[_dataRate];
 }
 
 
 /**************************************************************************/
 /*!
-    @brief  Print current IMU x,y,z as a float
+    @brief  Print current IMU x,y,z in milli-g
 */
 /**************************************************************************/
 void MMA8452Q::PrintAccel(void)
 {  
     Serial.print("\rINFO: X_ACCEL: ");
-    Serial.print((float) x, 4);
+    Serial.print(x);
     Serial.print(", Y_ACCEL: ");
-    Serial.print((float) y, 4);
+    Serial.print(y);
     Serial.print(", Z_ACCEL: ");
-    Serial.print((float) z, 4);
+    Serial.print(z);
 }
 
 /**************************************************************************/
 /*!
     @brief  Return whether paddle is physically lefty-flipped
-    accelerometer value of (x < 0) implies a left-handed person
-    is using the instrument
+    With the portrait/landscape engine enabled this is the last debounced
+    orientation, otherwise an accelerometer value of (x < 0) implies a
+    left-handed person is using the instrument
     
     @return bool True == The paddle is lefty flipped, else False
 */
 /**************************************************************************/
 bool MMA8452Q::IsLeftyFlipped(void)
 {
-  return (x < 0);
+  return _isPortraitLandscapeEnabled ? _isLefty : (x < 0);
+}
+
+/**************************************************************************/
+/*! 
+    @brief  Turn on hardware portrait/landscape detection and use it for lefty state
+    @param  leftyOrientation
+            MMA8452Q_LAPO_* orientation the paddle is in when lefty-flipped,
+            its opposite means righty and the other two keep the last state
+    @param  debounceCount
+            Samples a new orientation must hold before it is reported
+    @param  pin
+            Teensy pin wired to the orientation-change INT line, or
+            MMA8452Q_NO_INT_PIN to read PL_STATUS on every request
+    @param  intLine
+            MMA8452Q_INT1 or MMA8452Q_INT2
+    @return True if the chip took the whole setup, else False and lefty state stays on the sign of x
+ */
+/**************************************************************************/
+bool MMA8452Q::EnablePortraitLandscape(uint8_t leftyOrientation, uint8_t debounceCount, int8_t pin, uint8_t intLine)
+{
+  _leftyOrientation = leftyOrientation & (MMA8452Q_PL_STATUS_LAPO_MASK >> MMA8452Q_PL_STATUS_LAPO_SHIFT);
+  _plIntPin = MMA8452Q_NO_INT_PIN;
+
+  // Four consecutive registers, a single burst
+  const RegisterWrite plConfig[] =
+  {
+    MMA8452QMap::PlCfg::Set(MMA8452Q_PL_CFG_DBCNTM | MMA8452Q_PL_CFG_PL_EN),
+    MMA8452QMap::PlCount::Set(debounceCount),
+    MMA8452QMap::PlBfZcomp::Set(MMA8452Q_PL_BF_ZCOMP_VAL),
+    MMA8452QMap::PlThs::Set(MMA8452Q_PL_THS_VAL),
+  };
+  bool isOk = _Standby() && _WriteTable(plConfig, sizeof(plConfig) / sizeof(plConfig[0]));
+  if (!_Active() || !isOk)
+  {
+    return false;
+  }
+
+  if (pin != MMA8452Q_NO_INT_PIN)
+  {
+    pinMode(pin, INPUT_PULLUP);
+    if (!_UpdateCtrlReg(MMA8452Q_CTRL3_REG, MMA8452Q_CTRL3_IPOL, 0) ||
+        !_UpdateCtrlReg(MMA8452Q_CTRL5_REG, MMA8452Q_CTRL5_INT_CFG_LNDPRT,
+                        (intLine == MMA8452Q_INT1) ? MMA8452Q_CTRL5_INT_CFG_LNDPRT : 0) ||
+        !_UpdateCtrlReg(MMA8452Q_CTRL4_REG, MMA8452Q_CTRL4_INT_EN_LNDPRT, MMA8452Q_CTRL4_INT_EN_LNDPRT))
+    {
+      return false;
+    }
+    _plIntPin = pin;
+  }
+
+  // Start from the sign of x until the engine reports its first orientation
+  _isLefty = (x < 0);
+  _isPortraitLandscapeEnabled = true;
+  return true;
+}
+
+/**************************************************************************/
+/*! 
+    @brief  Queue a read of PL_STATUS, skipped while the orientation INT line is deasserted
+    @param  engine
+            I2cEngine driving Wire1
+    @return True if queued, else False
+ */
+/**************************************************************************/
+bool MMA8452Q::StartOrientationRead(I2cEngine &engine)
+{
+  if (!_isPortraitLandscapeEnabled || _isOrientationRequested)
+  {
+    return false;
+  }
+  if (_plIntPin != MMA8452Q_NO_INT_PIN && digitalRead(_plIntPin) != LOW)
+  {
+    return false;
+  }
+  _plTxn.SetupRead(_slave_addr, MMA8452Q_PL_STATUS_REG, &_plStatus, 1);
+  engine.Submit(_plTxn);
+  _isOrientationRequested = true;
+  return true;
+}
+
+/**************************************************************************/
+/*! 
+    @brief  Update lefty state from the read queued by StartOrientationRead()
+    @return True if the hardware reported a new orientation, else False
+ */
+/**************************************************************************/
+bool MMA8452Q::FinishOrientationRead(void)
+{
+  if (!_isOrientationRequested || _plTxn.IsPending())
+  {
+    return false;
+  }
+  _isOrientationRequested = false;
+  if (!_plTxn.IsOk())
+  {
+    return false;
+  }
+  return _ApplyPlStatus();
+}
+
+/**************************************************************************/
+/*! 
+    @brief  Map a freshly read PL_STATUS onto lefty state
+    @return True if PL_STATUS reported a new orientation, else False
+ */
+/**************************************************************************/
+bool MMA8452Q::_ApplyPlStatus(void)
+{
+  if (!(_plStatus & MMA8452Q_PL_STATUS_NEWLP))
+  {
+    return false;
+  }
+  if (_plStatus & MMA8452Q_PL_STATUS_LO)
+  {
+    return true;  // lying too flat to tell, keep the last state
+  }
+  uint8_t lapo = (_plStatus & MMA8452Q_PL_STATUS_LAPO_MASK) >> MMA8452Q_PL_STATUS_LAPO_SHIFT;
+  if (lapo == _leftyOrientation)
+  {
+    _isLefty = true;
+  }
+  else if (lapo == (_leftyOrientation ^ 1))
+  {
+    _isLefty = false;
+  }
+  return true;
 }
 
 
 /**************************************************************************/
 /*!
-    @brief  Read a single byte from addressToRead and return it as a byte
-    @param  addressToRead 
+    @brief  Read a single register and wait for it
+    @param  reg
             The address of the register to read
-    @return byte Value returned from register
+    @return Value returned from register, 0 if the IMU did not answer
 */
 /**************************************************************************/
-static byte readRegister(byte addressToRead)
+uint8_t MMA8452Q::_ReadRegister(uint8_t reg)
 {
-  Wire1.beginTransmission(MMA8452Q_SLAVE_ADDR);
-  Wire1.write(addressToRead);
-  Wire1.endTransmission(false); //endTransmission but keep the connection active
-
-  Wire1.requestFrom(MMA8452Q_SLAVE_ADDR, 1); //Ask for 1 byte, once done, bus is released by default
+  uint8_t value = 0;
 
-  while(!Wire1.available()) ; //Wait for the data to come back
-  return Wire1.read(); //Return this one byte
+  _ReadRegisters(reg, 1, &value);
+  return value;
 }
 
 /**************************************************************************/
 /*!
-    @brief  Read bytesToRead sequentially, starting at addressToRead into the dest byte array
-    @param  addressToRead 
-            the address of the register to read
-    @param  bytesToRead 
+    @brief  Read count registers sequentially, starting at reg, into dest and wait for them
+    @param  reg
+            the address of the first register to read
+    @param  count
             count of bytes to read
-    @param  dest 
+    @param  dest
             pointer to the destination buffer for data
+    @return True if every byte was read, else False
 */
 /**************************************************************************/
-static void readRegisters(byte addressToRead, int bytesToRead, byte * dest)
+bool MMA8452Q::_ReadRegisters(uint8_t reg, uint8_t count, uint8_t *dest)
 {
-  Wire1.beginTransmission(MMA8452Q_SLAVE_ADDR);
-  Wire1.write(addressToRead);
-  Wire1.endTransmission(false); //endTransmission but keep the connection active
+  I2cTransaction txn;
 
-  Wire1.requestFrom(MMA8452Q_SLAVE_ADDR, bytesToRead); //Ask for bytes, once done, bus is released by default
+  txn.SetupRead(_slave_addr, reg, dest, count);
+  return _engine->Transfer(txn);
+}
 
-  while(Wire1.available() < bytesToRead); //Hang out until we get the # of bytes we expect
+/**************************************************************************/
+/*!
+    @brief  Write a single register and wait for it, keeping the control register shadow
+    @param  reg
+            the address of the register to be written into
+    @param  value
+            byte of data to be written
+    @return True if the write was acknowledged, else False and the shadow keeps the old value
+*/
+/**************************************************************************/
+bool MMA8452Q::_WriteRegister(uint8_t reg, uint8_t value)
+{
+  I2cTransaction txn;
 
-  for(int x = 0 ; x < bytesToRead ; x++)
+  txn.SetupWrite(_slave_addr, reg, &value, 1);
+  if (!_engine->Transfer(txn))
+  {
+    return false;
+  }
+  if ((uint8_t) (reg - MMA8452Q_CTRL1_REG) < MMA8452Q_NUM_CTRL_REGS)
   {
-    dest[x] = Wire1.read();
-  }    
+    _ctrlShadow[reg - MMA8452Q_CTRL1_REG] = value;
+  }
+  return true;
 }
 
 /**************************************************************************/
 /*!
-    @brief  Writes a single byte (dataToWrite) into addressToWrite
-    @param  addressToWrite
-            the address of the register to be written into
-    @param  dataToWrite 
-            byte of data to be written
+    @brief  Write a register table in coalesced bursts, keeping the control register shadow
+    @param  table
+            Entries in write order
+    @param  count
+            Entries in table
+    @return True if every burst was acknowledged, else False and the shadow is left as it was
 */
 /**************************************************************************/
-static void writeRegister(byte addressToWrite, byte dataToWrite)
+bool MMA8452Q::_WriteTable(const RegisterWrite *table, size_t count)
 {
-  Wire1.beginTransmission(MMA8452Q_SLAVE_ADDR);
-  Wire1.write(addressToWrite);
-  Wire1.write(dataToWrite);
-  Wire1.endTransmission(); //Stop transmitting
+  if (!RegisterMapWrite(*_engine, _slave_addr, table, count))
+  {
+    return false;
+  }
+  for (size_t i=0; i<count; i++)
+  {
+    for (uint8_t r=0; r<table[i].count; r++)
+    {
+      uint8_t index = table[i].reg + r - MMA8452Q_CTRL1_REG;
+      if (index < MMA8452Q_NUM_CTRL_REGS)
+      {
+        _ctrlShadow[index] = table[i].value;
+      }
+    }
+  }
+  return true;
 }
 
 /**************************************************************************/
 /*!
     @brief  set MMA8452Q into standby mode
     The chip must be in standby to change most register settings
+    @return True if the chip is in standby, else False
 */
 /**************************************************************************/
-static void MMA8452Standby(void)
+bool MMA8452Q::_Standby(void)
 {
-  byte c = readRegister(MMA8452Q_CTRL1_REG);
-  writeRegister(MMA8452Q_CTRL1_REG, c & ~(0x01)); //Clear the active bit to go into standby
+  if (_ctrlShadow[0] & MMA8452Q_CTRL1_ACTIVE)
+  {
+    return _WriteRegister(MMA8452Q_CTRL1_REG, _ctrlShadow[0] & ~MMA8452Q_CTRL1_ACTIVE);
+  }
+  return true;
 }
 
 /**************************************************************************/
 /*!
     @brief  set MMA8452Q into active mode
     The chip must be in active mode to update and output data
+    @return True if the chip is active, else False
 */
 /**************************************************************************/
-static void MMA8452Active(void)
+bool MMA8452Q::_Active(void)
 {
-  byte c = readRegister(MMA8452Q_CTRL1_REG);
-  writeRegister(MMA8452Q_CTRL1_REG, c | 0x01); //Set the active bit to begin detection
+  if (!(_ctrlShadow[0] & MMA8452Q_CTRL1_ACTIVE))
+  {
+    return _WriteRegister(MMA8452Q_CTRL1_REG, _ctrlShadow[0] | MMA8452Q_CTRL1_ACTIVE);
+  }
+  return true;
 }
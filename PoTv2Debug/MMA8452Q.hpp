@@ -10,25 +10,121 @@
 #define __MMA8452Q_HPP__
  
 #include "Arduino.h"
+#include "I2cEngine.hpp"
+#include "ImuFilter.hpp"
+#include "RegisterMap.hpp"
 
 // MMA8452Q Slave Addr and simple WHOAMI response
 #define MMA8452Q_SLAVE_ADDR     0x1D  ///< Address for contacting MMA8452Q
 #define MMA8452Q_WHOAMI_REG     0x0D  ///< Register WHOAMI for conducting sanity checks
 #define MMA8452Q_WHOAMI_VAL     0x2A  ///< Expected value from datasheet for reading WHOAMI register
+#define MMA8452Q_MAX_CLOCK_HZ   400000  ///< Fastest SCL the MMA8452Q is rated for
 
 // MMA8452Q Registers
+#define MMA8452Q_STATUS_REG       0x00  ///< Address for STATUS register, directly precedes OUT_X_MSB
+#define MMA8452Q_PL_STATUS_REG    0x10  ///< Address for PL_STATUS register, reading it clears NEWLP
+#define MMA8452Q_PL_CFG_REG       0x11  ///< Address for PL_CFG register
+#define MMA8452Q_PL_COUNT_REG     0x12  ///< Address for PL_COUNT debounce register
+#define MMA8452Q_PL_BF_ZCOMP_REG  0x13  ///< Address for PL_BF_ZCOMP register
+#define MMA8452Q_PL_THS_REG       0x14  ///< Address for P_L_THS_REG register
 #define MMA8452Q_CTRL1_REG        0x2A  ///< Address for CTRL 1 register
+#define MMA8452Q_CTRL2_REG        0x2B  ///< Address for CTRL 2 register
+#define MMA8452Q_CTRL3_REG        0x2C  ///< Address for CTRL 3 register
+#define MMA8452Q_CTRL4_REG        0x2D  ///< Address for CTRL 4 register
+#define MMA8452Q_CTRL5_REG        0x2E  ///< Address for CTRL 5 register
 #define MMA8452Q_XYZ_DATA_CFG_REG 0x0E  ///< Address for XYZ_DATA_CFG register
 #define MMA8452Q_OUT_X_MSB_REG    0x01  ///< Address for MSB of multi-byte X-axis output
                                         ///< NOTE: a continuous read is done starting from this address to read the rest of the registers
+#define MMA8452Q_NUM_CTRL_REGS    5  ///< CTRL_REG1 to CTRL_REG5, consecutive and shadowed by the driver
+
+// MMA8452Q register fields
+#define MMA8452Q_STATUS_ZYXDR     0x08  ///< STATUS: new x/y/z sample available
+#define MMA8452Q_CTRL1_ACTIVE     0x01  ///< CTRL_REG1: active mode
+#define MMA8452Q_CTRL1_F_READ     0x02  ///< CTRL_REG1: burst reads skip the LSB registers
+#define MMA8452Q_CTRL1_DR_SHIFT   3     ///< CTRL_REG1: position of the 3-bit output data rate field
+#define MMA8452Q_CTRL1_DR_MASK    0x38  ///< CTRL_REG1: output data rate field
+#define MMA8452Q_CTRL2_MODS_MASK  0x03  ///< CTRL_REG2: active mode power/ oversampling field
+#define MMA8452Q_CTRL3_IPOL       0x02  ///< CTRL_REG3: interrupt pins active high, cleared for active low
+#define MMA8452Q_CTRL4_INT_EN_DRDY  0x01  ///< CTRL_REG4: data-ready interrupt enable
+#define MMA8452Q_CTRL4_INT_EN_LNDPRT  0x10  ///< CTRL_REG4: orientation-change interrupt enable
+#define MMA8452Q_CTRL5_INT_CFG_DRDY 0x01  ///< CTRL_REG5: data-ready interrupt on INT1, cleared for INT2
+#define MMA8452Q_CTRL5_INT_CFG_LNDPRT  0x10  ///< CTRL_REG5: orientation-change interrupt on INT1, cleared for INT2
+#define MMA8452Q_PL_STATUS_NEWLP  0x80  ///< PL_STATUS: orientation changed since the last read
+#define MMA8452Q_PL_STATUS_LO     0x40  ///< PL_STATUS: z-tilt lockout, LAPO is not valid
+#define MMA8452Q_PL_STATUS_LAPO_SHIFT  1  ///< PL_STATUS: position of the 2-bit LAPO field
+#define MMA8452Q_PL_STATUS_LAPO_MASK   0x06  ///< PL_STATUS: landscape/ portrait orientation field
+#define MMA8452Q_PL_CFG_DBCNTM    0x80  ///< PL_CFG: clear the debounce counter when the new orientation does not hold
+#define MMA8452Q_PL_CFG_PL_EN     0x40  ///< PL_CFG: portrait/ landscape detection enable
+#define MMA8452Q_PL_BF_ZCOMP_VAL  0x44  ///< PL_BF_ZCOMP: back/front trip at 75 degrees, z-lockout at 29 degrees (datasheet default)
+#define MMA8452Q_PL_THS_VAL       0x84  ///< P_L_THS_REG: trip at 45 degrees with +/-14 degrees hysteresis (datasheet default)
+
+// Orientations, values of the PL_STATUS LAPO field. Opposite orientations differ only in bit 0.
+#define MMA8452Q_LAPO_PORTRAIT_UP      0  ///< Portrait up
+#define MMA8452Q_LAPO_PORTRAIT_DOWN    1  ///< Portrait down
+#define MMA8452Q_LAPO_LANDSCAPE_RIGHT  2  ///< Landscape right
+#define MMA8452Q_LAPO_LANDSCAPE_LEFT   3  ///< Landscape left
+
+// Output data rates, values of the CTRL_REG1 DR field
+#define MMA8452Q_ODR_800HZ   0  ///< 800Hz output data rate, the power-on default
+#define MMA8452Q_ODR_400HZ   1  ///< 400Hz output data rate
+#define MMA8452Q_ODR_200HZ   2  ///< 200Hz output data rate
+#define MMA8452Q_ODR_100HZ   3  ///< 100Hz output data rate
+#define MMA8452Q_ODR_50HZ    4  ///< 50Hz output data rate
+#define MMA8452Q_ODR_12_5HZ  5  ///< 12.5Hz output data rate
+#define MMA8452Q_ODR_6_25HZ  6  ///< 6.25Hz output data rate
+#define MMA8452Q_ODR_1_56HZ  7  ///< 1.56Hz output data rate
+
+// Active mode power/ oversampling schemes, values of the CTRL_REG2 MODS field
+#define MMA8452Q_MODS_NORMAL     0  ///< Normal, the power-on default
+#define MMA8452Q_MODS_LOW_NOISE  1  ///< Low noise low power
+#define MMA8452Q_MODS_HIGH_RES   2  ///< High resolution, most oversampling
+#define MMA8452Q_MODS_LOW_POWER  3  ///< Low power, least oversampling
+
+#define MMA8452Q_INT1  1  ///< Route an interrupt source to the INT1 pin
+#define MMA8452Q_INT2  2  ///< Route an interrupt source to the INT2 pin
+
+#define MMA8452Q_NO_INT_PIN  -1  ///< EnableDataReady() pin value when no INT line reaches the Teensy
+
+#define MMA8452Q_READ_LEN       7  ///< STATUS plus 12-bit x/y/z, MSB first
+#define MMA8452Q_FAST_READ_LEN  4  ///< STATUS plus 8-bit x/y/z with F_READ set
 
 #define GSCALE 2  ///< Sets full-scale range to +/-2, 4, or 8g. Used to calc real g values.
+#define MMA8452Q_FSR_BITS  (((GSCALE > 8) ? 8 : GSCALE) >> 2)  ///< XYZ_DATA_CFG FS field for GSCALE, see page 22: 00 = 2g, 01 = 4g, 10 = 8g
+
+/**************************************************************************/
+/*!
+    @brief  MMA8452Q registers the driver sets up
+*/
+/**************************************************************************/
+struct MMA8452QMap
+{
+  typedef RegisterBlock<MMA8452Q_XYZ_DATA_CFG_REG> XyzDataCfg;  ///< Full scale range
+  typedef RegisterBlock<MMA8452Q_PL_CFG_REG> PlCfg;  ///< Portrait/landscape enable and debounce mode
+  typedef RegisterBlock<MMA8452Q_PL_COUNT_REG> PlCount;  ///< Portrait/landscape debounce count
+  typedef RegisterBlock<MMA8452Q_PL_BF_ZCOMP_REG> PlBfZcomp;  ///< Back/front trip and z-lockout angles
+  typedef RegisterBlock<MMA8452Q_PL_THS_REG> PlThs;  ///< Portrait/landscape trip angle and hysteresis
+  typedef RegisterBlock<MMA8452Q_CTRL1_REG, MMA8452Q_NUM_CTRL_REGS> Ctrl;  ///< CTRL_REG1 to CTRL_REG5
+  typedef RegisterBlock<MMA8452Q_CTRL1_REG> Ctrl1;  ///< Data rate, F_READ and ACTIVE
+  typedef RegisterBlock<MMA8452Q_CTRL2_REG> Ctrl2;  ///< Active mode oversampling
+  typedef RegisterBlock<MMA8452Q_CTRL3_REG> Ctrl3;  ///< Interrupt pin polarity
+  typedef RegisterBlock<MMA8452Q_CTRL4_REG> Ctrl4;  ///< Interrupt enables
+  typedef RegisterBlock<MMA8452Q_CTRL5_REG> Ctrl5;  ///< Interrupt routing to INT1/ INT2
+};
 
 
 /**************************************************************************/
 /*!
     @brief  Class for interacting with the MMA8452Q IMU
     This class provides just what is needed to get isLefty for the paddle
+    Burst reads start at STATUS so a read only counts as a sample when ZYXDR
+    is set. With the data-ready interrupt routed to a Teensy pin, the bus is
+    not touched at all until the INT line says a sample is pending.
+    Once the portrait/landscape engine is enabled, lefty state comes from its
+    debounced, hysteretic orientation rather than from the sign of x.
+    init() sets every control register, and the driver keeps a copy of them
+    from then on, so standby/active toggles and control field changes are
+    single writes with no read back. The copy only changes once a write is
+    acknowledged, so a failed change is tried again on the next call.
 */
 /**************************************************************************/
 class MMA8452Q
@@ -36,16 +132,57 @@ class MMA8452Q
   private:
     int8_t MMA8452QSetRegisters(void); 
     uint8_t _slave_addr;  ///< I2C Address for this MMA8452Q device
+    I2cEngine *_engine;  ///< Engine of Wire1, set by init()
+    uint8_t _ctrlShadow[MMA8452Q_NUM_CTRL_REGS];  ///< Last values written to CTRL_REG1 to CTRL_REG5
+    uint8_t _rawData[MMA8452Q_READ_LEN];  ///< STATUS and x/y/z register data from the last burst read
+    I2cTransaction _updateTxn;  ///< Async read of _rawData
+    bool _isUpdateRequested;  ///< True from StartUpdate() until FinishUpdate() consumes the result
+    bool _isFastRead;  ///< True while CTRL_REG1 F_READ is set
+    uint8_t _dataRate;  ///< Selected MMA8452Q_ODR_* value
+    int8_t _intPin;  ///< Teensy pin wired to the data-ready INT line, or MMA8452Q_NO_INT_PIN
+    ImuFilter _filterX;  ///< Low-pass on x counts
+    ImuFilter _filterY;  ///< Low-pass on y counts
+    ImuFilter _filterZ;  ///< Low-pass on z counts
+    bool _isFilterPrimed;  ///< True once the filters have been reset to a first sample
+    int8_t _plIntPin;  ///< Teensy pin wired to the orientation-change INT line, or MMA8452Q_NO_INT_PIN
+    bool _isPortraitLandscapeEnabled;  ///< True once EnablePortraitLandscape() has run
+    uint8_t _leftyOrientation;  ///< MMA8452Q_LAPO_* value that means lefty, its opposite means righty
+    bool _isLefty;  ///< Lefty state from the last valid orientation report
+    uint8_t _plStatus;  ///< PL_STATUS from the last orientation read
+    I2cTransaction _plTxn;  ///< Async read of _plStatus
+    bool _isOrientationRequested;  ///< True from StartOrientationRead() until FinishOrientationRead() consumes the result
+
+    bool _IsDataPending(void);
+    uint8_t _ReadLen(void);
+    bool _ConvertRawData(void);
+    bool _ApplyPlStatus(void);
+    bool _UpdateCtrlReg(uint8_t reg, uint8_t mask, uint8_t value);
+    uint8_t _ReadRegister(uint8_t reg);
+    bool _ReadRegisters(uint8_t reg, uint8_t count, uint8_t *dest);
+    bool _WriteRegister(uint8_t reg, uint8_t value);
+    bool _WriteTable(const RegisterWrite *table, size_t count);
+    bool _Standby(void);
+    bool _Active(void);
     
   public:
     MMA8452Q(void);
-    int8_t init(void);
+    int8_t init(I2cEngine &engine, Print &log);
     void Update(void);
+    bool StartUpdate(I2cEngine &engine);
+    bool FinishUpdate(void);
+    bool SetDataRate(uint8_t odr);
+    bool SetPowerMode(uint8_t mods);
+    bool SetFastRead(bool isFastRead);
+    bool EnableDataReady(int8_t pin, uint8_t intLine);
+    uint32_t GetSamplePeriodMicros(void);
+    bool EnablePortraitLandscape(uint8_t leftyOrientation, uint8_t debounceCount, int8_t pin, uint8_t intLine);
+    bool StartOrientationRead(I2cEngine &engine);
+    bool FinishOrientationRead(void);
     void PrintAccel(void);
     bool IsLeftyFlipped(void);
-    float x;  ///< X value from IMU
-    float y;  ///< Y value from IMU
-    float z;  ///< Z value from IMU
+    int16_t x;  ///< Filtered X acceleration in milli-g
+    int16_t y;  ///< Filtered Y acceleration in milli-g
+    int16_t z;  ///< Filtered Z acceleration in milli-g
 };
 
 #endif /* __MMA8452Q_HPP__ */
@@ -0,0 +1,351 @@
+/*!
+ * @file MidiEngine.cpp
+ *
+ * \brief Turn SensorState changes into coalesced MIDI messages
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#include <string.h>
+
+#include "MidiEngine.hpp"
+#include "ControlCurves.hpp"
+#include "TouchKeys.hpp"
+
+#define MIDI_ENGINE_FIELDS  (SCREEN_FIELD_FRET | SCREEN_FIELD_KEYS | SCREEN_FIELD_ULTRASONIC | \
+                             SCREEN_FIELD_ROT_POT | SCREEN_FIELD_ROT_ENC)  ///< SensorSnapshot fields that produce MIDI
+
+// Each string queues at most a note off for what the host last heard and one unsent note on, so with every
+// controller coalesced a queue longer than 2 * MIDI_NUM_STRINGS + 3 never fills. A shorter one, as in the host
+// test, evicts for note offs, and with at most one note off per string a note off always finds room
+static_assert(MIDI_QUEUE_LEN > MIDI_NUM_STRINGS, "MIDI queue must hold a note off for every string");
+
+static_assert(MIDI_LOWEST_OPEN_NOTE + (MIDI_NUM_STRINGS - 1) * MIDI_STRING_INTERVAL + TOUCH_NUM_PADS <= 127,
+              "Highest fret of the highest string must be a valid MIDI note");
+
+/**************************************************************************/
+/*!
+    @brief    Constructor for MidiEngine, starts disabled with nothing sounding
+    @param    sink
+              Transport for the messages, see MidiSinks.hpp
+*/
+/**************************************************************************/
+MidiEngine::MidiEngine(MidiSink &sink) : _sink(sink)
+{
+  _isEnabled = false;
+  memset(&_sent, 0, sizeof(_sent));
+  _sentSequence = 0;
+  _forcedFields = 0;
+  memset(_sounding, MIDI_NOTE_NONE, sizeof(_sounding));
+  _queueCount = 0;
+  _sentCount = 0;
+  _coalescedCount = 0;
+  _droppedCount = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Start or stop MIDI output
+    @param    isEnabled
+              True sends the current controller values and any held notes,
+              False releases every sounding note and then stays silent
+*/
+/**************************************************************************/
+void MidiEngine::SetEnabled(bool isEnabled)
+{
+  if (isEnabled == _isEnabled)
+  {
+    return;
+  }
+  if (isEnabled)
+  {
+    _forcedFields = MIDI_ENGINE_FIELDS;
+  }
+  else
+  {
+    _ReleaseNotes();
+  }
+  _isEnabled = isEnabled;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Whether MIDI output is on
+*/
+/**************************************************************************/
+bool MidiEngine::IsEnabled(void) const
+{
+  return _isEnabled;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Queue MIDI for whatever changed in state since the last call
+    @param    state
+              SensorState whose published snapshot is read
+*/
+/**************************************************************************/
+void MidiEngine::Update(const SensorState &state)
+{
+  SensorSnapshot snap;
+
+  if (!_isEnabled || (!_forcedFields && state.GetSnapshotSequence() == _sentSequence))
+  {
+    return;
+  }
+  _sentSequence = state.ReadSnapshot(snap);
+  uint16_t fields = _forcedFields | SensorSnapshotDiff(_sent, snap);
+  _forcedFields = 0;
+
+  // Controllers first so a new note starts with the current bend and modulation
+  if (fields & SCREEN_FIELD_ULTRASONIC)
+  {
+    uint16_t bend = MIDI_PITCH_BEND_CENTER + ULTRA_CM_TO_PITCH_BEND.MapClamped(snap.ultraCm);
+    _Queue(MIDI_STATUS_PITCH_BEND | MIDI_CHANNEL, bend & 0x7F, bend >> 7);
+  }
+  if (fields & SCREEN_FIELD_ROT_POT)
+  {
+    _Queue(MIDI_STATUS_CONTROL_CHANGE | MIDI_CHANNEL, MIDI_CC_ROT_POT, snap.rotPot);
+  }
+  if (fields & SCREEN_FIELD_ROT_ENC)
+  {
+    _Queue(MIDI_STATUS_CONTROL_CHANGE | MIDI_CHANNEL, MIDI_CC_ROT_ENC, snap.rotEnc);
+  }
+  if (fields & (SCREEN_FIELD_FRET | SCREEN_FIELD_KEYS))
+  {
+    _UpdateNotes(snap);
+  }
+  _sent = snap;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Hand queued messages to the sink while it can take them, then flush once
+*/
+/**************************************************************************/
+void MidiEngine::Service(void)
+{
+  uint8_t sent = 0;
+
+  while (sent < _queueCount && _sink.CanSend())
+  {
+    _sink.Send(_queue[sent++]);
+  }
+  if (sent == 0)
+  {
+    return;
+  }
+  _queueCount -= sent;
+  memmove(_queue, &_queue[sent], _queueCount * sizeof(MidiMessage));
+  _sentCount += sent;
+  _sink.Flush();
+}
+
+/**************************************************************************/
+/*!
+    @brief    Number of messages handed to the sink
+*/
+/**************************************************************************/
+uint32_t MidiEngine::GetSentCount(void) const
+{
+  return _sentCount;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Number of queued controller values replaced by a newer value before going out
+*/
+/**************************************************************************/
+uint32_t MidiEngine::GetCoalescedCount(void) const
+{
+  return _coalescedCount;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Number of note ons lost to a full queue, controllers that did not fit are resent instead
+*/
+/**************************************************************************/
+uint32_t MidiEngine::GetDroppedCount(void) const
+{
+  return _droppedCount;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Add a message to the queue, coalescing controllers per channel
+    @param    status
+              MIDI_STATUS_* | channel
+    @param    data1
+              First data byte
+    @param    data2
+              Second data byte
+*/
+/**************************************************************************/
+void MidiEngine::_Queue(uint8_t status, uint8_t data1, uint8_t data2)
+{
+  uint8_t type = status & MIDI_STATUS_TYPE_MASK;
+  bool isNote = (type == MIDI_STATUS_NOTE_ON);
+
+  // A controller value that has not gone out yet is superseded in place
+  if (!isNote)
+  {
+    for (uint8_t i=0; i<_queueCount; i++)
+    {
+      if (_queue[i].status == status && (type == MIDI_STATUS_PITCH_BEND || _queue[i].data1 == data1))
+      {
+        _queue[i].data1 = data1;
+        _queue[i].data2 = data2;
+        _coalescedCount++;
+        return;
+      }
+    }
+  }
+
+  // A note off cancels its note on if that never went out, and repeats nothing if its note off is still queued
+  bool isNoteOff = isNote && (data2 == 0);
+  for (uint8_t i=_queueCount; isNoteOff && i>0; i--)
+  {
+    if (_queue[i - 1].status == status && _queue[i - 1].data1 == data1)
+    {
+      if (_queue[i - 1].data2 != 0)
+      {
+        _queueCount--;
+        memmove(&_queue[i - 1], &_queue[i], (_queueCount - (i - 1)) * sizeof(MidiMessage));
+      }
+      _coalescedCount++;
+      return;
+    }
+  }
+
+  if (_queueCount == MIDI_QUEUE_LEN)
+  {
+    // A controller does not fit, send it again on the next Update() instead
+    if (!isNote)
+    {
+      _forcedFields |= _ControllerField(status, data1);
+      return;
+    }
+
+    // Notes make room by evicting the oldest controller value, which is resent later. A note off must never
+    // be lost or the note hangs, so it evicts the oldest note on if there is no controller left
+    uint8_t victim = _FindVictim(false);
+    if (victim == MIDI_QUEUE_LEN && isNoteOff)
+    {
+      victim = _FindVictim(true);
+    }
+    if (victim == MIDI_QUEUE_LEN)
+    {
+      _droppedCount++;
+      return;
+    }
+    if ((_queue[victim].status & MIDI_STATUS_TYPE_MASK) == MIDI_STATUS_NOTE_ON)
+    {
+      _droppedCount++;
+    }
+    else
+    {
+      _forcedFields |= _ControllerField(_queue[victim].status, _queue[victim].data1);
+    }
+    _queueCount--;
+    memmove(&_queue[victim], &_queue[victim + 1], (_queueCount - victim) * sizeof(MidiMessage));
+  }
+
+  _queue[_queueCount].status = status;
+  _queue[_queueCount].data1 = data1;
+  _queue[_queueCount].data2 = data2;
+  _queueCount++;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Find the oldest queued message of one kind to evict
+    @param    isNoteOn
+              True looks for a note on, False for a controller or pitch bend
+    @return   Index into _queue, or MIDI_QUEUE_LEN if there is none
+*/
+/**************************************************************************/
+uint8_t MidiEngine::_FindVictim(bool isNoteOn) const
+{
+  for (uint8_t i=0; i<_queueCount; i++)
+  {
+    bool isNote = ((_queue[i].status & MIDI_STATUS_TYPE_MASK) == MIDI_STATUS_NOTE_ON);
+    if (isNote == isNoteOn && (!isNote || _queue[i].data2 != 0))
+    {
+      return i;
+    }
+  }
+  return MIDI_QUEUE_LEN;
+}
+
+/**************************************************************************/
+/*!
+    @brief    SCREEN_FIELD_* that Update() sends a controller message for
+    @param    status
+              MIDI_STATUS_* | channel
+    @param    data1
+              Controller number, ignored for pitch bend
+    @return   The field, or 0 for anything else
+*/
+/**************************************************************************/
+uint16_t MidiEngine::_ControllerField(uint8_t status, uint8_t data1)
+{
+  if ((status & MIDI_STATUS_TYPE_MASK) == MIDI_STATUS_PITCH_BEND)
+  {
+    return SCREEN_FIELD_ULTRASONIC;
+  }
+  if ((status & MIDI_STATUS_TYPE_MASK) == MIDI_STATUS_CONTROL_CHANGE)
+  {
+    return (data1 == MIDI_CC_ROT_POT) ? SCREEN_FIELD_ROT_POT : (data1 == MIDI_CC_ROT_ENC) ? SCREEN_FIELD_ROT_ENC : 0;
+  }
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Move each string's note to match the strum keys held and the fret
+    @param    snap
+              Values to play
+*/
+/**************************************************************************/
+void MidiEngine::_UpdateNotes(const SensorSnapshot &snap)
+{
+  for (uint8_t string=0; string<MIDI_NUM_STRINGS; string++)
+  {
+    uint8_t note = MIDI_NOTE_NONE;
+    if (snap.key & (1 << string))
+    {
+      note = MIDI_LOWEST_OPEN_NOTE + string * MIDI_STRING_INTERVAL + snap.fret;
+    }
+    if (note == _sounding[string])
+    {
+      continue;
+    }
+    if (_sounding[string] != MIDI_NOTE_NONE)
+    {
+      _Queue(MIDI_STATUS_NOTE_ON | MIDI_CHANNEL, _sounding[string], 0);
+    }
+    if (note != MIDI_NOTE_NONE)
+    {
+      _Queue(MIDI_STATUS_NOTE_ON | MIDI_CHANNEL, note, MIDI_NOTE_VELOCITY);
+    }
+    _sounding[string] = note;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Queue a note off for every sounding note
+*/
+/**************************************************************************/
+void MidiEngine::_ReleaseNotes(void)
+{
+  for (uint8_t string=0; string<MIDI_NUM_STRINGS; string++)
+  {
+    if (_sounding[string] != MIDI_NOTE_NONE)
+    {
+      _Queue(MIDI_STATUS_NOTE_ON | MIDI_CHANNEL, _sounding[string], 0);
+      _sounding[string] = MIDI_NOTE_NONE;
+    }
+  }
+}
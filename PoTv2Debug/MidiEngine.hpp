@@ -0,0 +1,107 @@
+/*!
+ * @file MidiEngine.hpp
+ *
+ * \brief Header for turning SensorState changes into coalesced MIDI messages
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#ifndef __MIDI_ENGINE_HPP__
+#define __MIDI_ENGINE_HPP__
+
+#include <stdint.h>
+#include "SensorState.hpp"
+
+#define MIDI_STATUS_NOTE_ON  0x90  ///< Note on, velocity 0 doubles as note off so running status holds across both
+#define MIDI_STATUS_CONTROL_CHANGE  0xB0  ///< Control change
+#define MIDI_STATUS_PITCH_BEND  0xE0  ///< Pitch bend, 14-bit value LSB first
+#define MIDI_STATUS_TYPE_MASK  0xF0  ///< Message type bits of a status byte
+#define MIDI_STATUS_CHANNEL_MASK  0x0F  ///< Channel bits of a status byte, 0-based
+#define MIDI_PITCH_BEND_CENTER  8192  ///< 14-bit pitch bend with no bend applied
+
+#define MIDI_CHANNEL  0  ///< 0-based channel every message goes out on, channel 1 to the user
+#define MIDI_CC_ROT_POT  1  ///< Controller the rotary potentiometer drives, modulation wheel
+#define MIDI_CC_ROT_ENC  74  ///< Controller the rotary encoder drives, brightness
+#define MIDI_NOTE_VELOCITY  100  ///< Velocity of every note on, the paddle has no velocity sensing
+#define MIDI_NUM_STRINGS  4  ///< One string per strum key
+#define MIDI_LOWEST_OPEN_NOTE  40  ///< Open note of strum key 0, E2
+#define MIDI_STRING_INTERVAL  5  ///< Semitones between the open notes of neighbouring strings, tuned in fourths
+#define MIDI_NOTE_NONE  0xFF  ///< No note sounding on a string
+#ifndef MIDI_QUEUE_LEN
+#define MIDI_QUEUE_LEN  16  ///< Messages waiting for the sink, fits a full set of note changes plus every controller
+#endif
+
+/**************************************************************************/
+/*!
+    @brief  One channel voice message
+*/
+/**************************************************************************/
+struct MidiMessage
+{
+  uint8_t status;  ///< MIDI_STATUS_* | channel
+  uint8_t data1;  ///< Note, controller number or pitch bend LSB
+  uint8_t data2;  ///< Velocity, controller value or pitch bend MSB
+};
+
+/**************************************************************************/
+/*!
+    @brief  Interface to a MIDI transport, see MidiSinks.hpp
+*/
+/**************************************************************************/
+class MidiSink
+{
+  public:
+    virtual ~MidiSink() { }
+    virtual bool CanSend(void) = 0;
+    virtual void Send(const MidiMessage &msg) = 0;
+    virtual void Flush(void) = 0;
+};
+
+/**************************************************************************/
+/*!
+    @brief  Turn SensorState changes into MIDI
+    Strum keys are strings: holding one sounds its open note plus the current
+    fret, and changing the fret while it is held moves the note. The
+    ultrasonic drives pitch bend through ULTRA_CM_TO_PITCH_BEND, the
+    potentiometer and encoder drive one CC each. Messages wait in a bounded
+    queue while the sink is busy; a newer value for the same controller or
+    pitch bend overwrites the queued one, and a note off cancels a note on
+    that never went out. When the queue is full notes evict the oldest
+    controller value, and a controller that does not fit or is evicted is
+    sent again on the next Update(), so none is lost.
+    Call Update() and Service() from the main loop every pass.
+*/
+/**************************************************************************/
+class MidiEngine
+{
+  private:
+    MidiSink &_sink;  ///< Transport the queue drains into
+    bool _isEnabled;  ///< False sends nothing, notes are released when disabled
+    SensorSnapshot _sent;  ///< Snapshot the queued messages describe
+    uint32_t _sentSequence;  ///< Seqlock sequence of _sent
+    uint16_t _forcedFields;  ///< SCREEN_FIELD_* to send even if unchanged
+    uint8_t _sounding[MIDI_NUM_STRINGS];  ///< Note sounding on each string, or MIDI_NOTE_NONE
+    MidiMessage _queue[MIDI_QUEUE_LEN];  ///< Messages waiting for the sink, oldest first
+    uint8_t _queueCount;  ///< Valid entries in _queue
+    uint32_t _sentCount;  ///< Messages handed to the sink
+    uint32_t _coalescedCount;  ///< Queued controller values overwritten by newer ones
+    uint32_t _droppedCount;  ///< Note ons lost to a full queue
+
+    void _Queue(uint8_t status, uint8_t data1, uint8_t data2);
+    uint8_t _FindVictim(bool isNoteOn) const;
+    static uint16_t _ControllerField(uint8_t status, uint8_t data1);
+    void _UpdateNotes(const SensorSnapshot &snap);
+    void _ReleaseNotes(void);
+
+  public:
+    MidiEngine(MidiSink &sink);
+    void SetEnabled(bool isEnabled);
+    bool IsEnabled(void) const;
+    void Update(const SensorState &state);
+    void Service(void);
+    uint32_t GetSentCount(void) const;
+    uint32_t GetCoalescedCount(void) const;
+    uint32_t GetDroppedCount(void) const;
+};
+
+#endif  // __MIDI_ENGINE_HPP__
@@ -0,0 +1,130 @@
+/*!
+ * @file MidiSinks.cpp
+ *
+ * \brief MidiSink implementations on Teensy USB-MIDI and on byte streams
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#include "MidiSinks.hpp"
+
+/**************************************************************************/
+/*!
+    @brief    Constructor for MidiStreamSink
+    @param    out
+              Stream to write MIDI bytes to, already begun at MIDI_DIN_BAUD if a UART
+*/
+/**************************************************************************/
+MidiStreamSink::MidiStreamSink(Print &out) : _out(out)
+{
+  _runningStatus = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Encode one message, leaving out the status byte when it repeats the last one
+    @param    msg
+              Message to encode
+    @param    dest
+              Buffer of at least MIDI_MESSAGE_MAX_LEN bytes
+    @return   Number of bytes written
+*/
+/**************************************************************************/
+uint8_t MidiStreamSink::Encode(const MidiMessage &msg, uint8_t *dest)
+{
+  uint8_t len = 0;
+
+  if (msg.status != _runningStatus)
+  {
+    dest[len++] = msg.status;
+    _runningStatus = msg.status;
+  }
+  dest[len++] = msg.data1;
+  dest[len++] = msg.data2;
+  return len;
+}
+
+/**************************************************************************/
+/*!
+    @brief    True while the stream has room for a whole message
+*/
+/**************************************************************************/
+bool MidiStreamSink::CanSend(void)
+{
+  return _out.availableForWrite() >= MIDI_MESSAGE_MAX_LEN;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Write one message to the stream
+*/
+/**************************************************************************/
+void MidiStreamSink::Send(const MidiMessage &msg)
+{
+  uint8_t bytes[MIDI_MESSAGE_MAX_LEN];
+
+  _out.write(bytes, Encode(msg, bytes));
+}
+
+/**************************************************************************/
+/*!
+    @brief    Nothing to do, a UART sends each byte as soon as it can
+*/
+/**************************************************************************/
+void MidiStreamSink::Flush(void)
+{
+}
+
+#if MIDI_SINK == MIDI_SINK_USB
+/**************************************************************************/
+/*!
+    @brief    Constructor for UsbMidiSink, starts with a full send budget
+*/
+/**************************************************************************/
+UsbMidiSink::UsbMidiSink(void)
+{
+  _windowMillis = 0;
+  _windowCount = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief    True while the host has configured the device and this millisecond's budget is not spent
+*/
+/**************************************************************************/
+bool UsbMidiSink::CanSend(void)
+{
+  if (!usb_configuration)
+  {
+    return false;
+  }
+  uint32_t now = millis();
+  if (now != _windowMillis)
+  {
+    _windowMillis = now;
+    _windowCount = 0;
+  }
+  return _windowCount < MIDI_USB_EVENTS_PER_MS;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Queue one message in the current USB-MIDI packet
+*/
+/**************************************************************************/
+void UsbMidiSink::Send(const MidiMessage &msg)
+{
+  _windowCount++;
+  usbMIDI.send(msg.status & MIDI_STATUS_TYPE_MASK, msg.data1, msg.data2, (msg.status & MIDI_STATUS_CHANNEL_MASK) + 1, 0);
+}
+
+/**************************************************************************/
+/*!
+    @brief    Send the partly filled USB-MIDI packet now
+*/
+/**************************************************************************/
+void UsbMidiSink::Flush(void)
+{
+  usbMIDI.send_now();
+}
+#endif
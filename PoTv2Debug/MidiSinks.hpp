@@ -0,0 +1,80 @@
+/*!
+ * @file MidiSinks.hpp
+ *
+ * \brief Header for MidiSink implementations on Teensy USB-MIDI and on byte streams
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#ifndef __MIDI_SINKS_HPP__
+#define __MIDI_SINKS_HPP__
+
+#include <Arduino.h>
+#include "MidiEngine.hpp"
+
+#define MIDI_SINK_NONE  0  ///< No MIDI output, MidiEngine is left out of the build
+#define MIDI_SINK_USB  1  ///< UsbMidiSink, needs a Tools > USB Type that includes MIDI
+#define MIDI_SINK_SERIAL1  2  ///< MidiStreamSink on Serial1 at MIDI_DIN_BAUD for a 5-pin DIN jack
+
+#ifndef MIDI_SINK
+#if defined(MIDI_INTERFACE)
+#define MIDI_SINK  MIDI_SINK_USB  ///< Transport the sketch sends MIDI on
+#else
+#define MIDI_SINK  MIDI_SINK_NONE  ///< Transport the sketch sends MIDI on
+#endif
+#endif
+
+#define MIDI_DIN_BAUD  31250  ///< Serial MIDI bit rate
+#define MIDI_MESSAGE_MAX_LEN  3  ///< Bytes of the longest channel voice message
+#define MIDI_USB_EVENTS_PER_MS  16  ///< USB-MIDI messages sent per millisecond at most, one full-speed 64 byte packet per frame
+
+/**************************************************************************/
+/*!
+    @brief  MidiSink writing a MIDI byte stream to any Print, such as a UART
+    Repeated status bytes are left out (running status), which for a stream
+    of one controller or of notes saves a third of the bytes. Only sends
+    while the Print reports room for a whole message, so it never blocks.
+*/
+/**************************************************************************/
+class MidiStreamSink : public MidiSink
+{
+  private:
+    Print &_out;  ///< Stream the bytes go to
+    uint8_t _runningStatus;  ///< Status byte last sent, 0 if none
+
+  public:
+    MidiStreamSink(Print &out);
+    uint8_t Encode(const MidiMessage &msg, uint8_t *dest);
+    virtual bool CanSend(void);
+    virtual void Send(const MidiMessage &msg);
+    virtual void Flush(void);
+};
+
+#if MIDI_SINK == MIDI_SINK_USB
+/**************************************************************************/
+/*!
+    @brief  MidiSink on the Teensy usbMIDI interface
+    USB-MIDI event packets always carry their status, so there is no running
+    status here; Flush() sends a partly filled USB packet right away instead
+    of waiting for it to fill, which keeps latency well under a millisecond.
+    usbMIDI cannot report how much room it has, so CanSend() limits the rate
+    to what one USB frame carries and refuses while the device is not
+    configured. A host that stops reading then backs up MidiEngine's queue,
+    where controllers coalesce, instead of blocking in usbMIDI.send().
+*/
+/**************************************************************************/
+class UsbMidiSink : public MidiSink
+{
+  private:
+    uint32_t _windowMillis;  ///< millis() the current send budget belongs to
+    uint8_t _windowCount;  ///< Messages sent during _windowMillis
+
+  public:
+    UsbMidiSink(void);
+    virtual bool CanSend(void);
+    virtual void Send(const MidiMessage &msg);
+    virtual void Flush(void);
+};
+#endif
+
+#endif  // __MIDI_SINKS_HPP__
@@ -26,36 +26,250 @@
  * 
  */
 #include <Wire.h>
-#include <Encoder.h>
-#include <NewPing.h>
 #include "BoardLayout.hpp"
 #include "QTouchBoard.hpp"
+#include "TouchKeys.hpp"
 #include "SensorState.hpp"
+#include "SerialTx.hpp"
+#include "MidiEngine.hpp"
+#include "MidiSinks.hpp"
+#include "CaptureBuffer.hpp"
 #include "Ultrasonic.hpp"
+#include "QuadratureEncoder.hpp"
 #include "MMA8452Q.hpp"
+#include "PotAdc.hpp"
+#include "ControlCurves.hpp"
+#include "I2cEngine.hpp"
+#include "WireI2cDriver.hpp"
+#include "TaskScheduler.hpp"
+#include "LoopProfiler.hpp"
 
-NewPing Ultrasonic = NewPing(PIN_ULTRA_TRIG, PIN_ULTRA_SENS, PITCH_BEND_MAX_CM+1);
-Encoder RotaryEncoder = Encoder(PIN_ROT_ENC_A, PIN_ROT_ENC_C);
+#define NUM_I2C_ENGINES 2  ///< One I2cEngine per hardware bus, Wire and Wire1
+#define I2C_PROBE_CLOCKS_HZ  { 1000000, 400000, I2C_CLOCK_DEFAULT_HZ }  ///< SCL rates a device may be probed at in setup, fastest first
+
+#define OUTPUT_MODE_TUI        0  ///< Human-readable TUI from SensorState::CheckUpdateScreen
+#define OUTPUT_MODE_TELEMETRY  1  ///< COBS-framed binary packet from SensorState::SendTelemetry every TASK_PERIOD_TELEMETRY_US
+#define OUTPUT_MODE_QTOUCH_RAW  2  ///< COBS-framed per-key QTouch signal and reference packets from TaskQTouchRaw only
+#define OUTPUT_MODE_DEFAULT  OUTPUT_MODE_TUI  ///< Output mode at power-on
+
+// Single-character commands accepted over serial
+#define CMD_OUTPUT_TUI        't'  ///< Switch to OUTPUT_MODE_TUI and redraw the screen
+#define CMD_OUTPUT_TELEMETRY  'b'  ///< Switch to OUTPUT_MODE_TELEMETRY
+#define CMD_OUTPUT_QTOUCH_RAW  'r'  ///< Switch to OUTPUT_MODE_QTOUCH_RAW
+#define CMD_SCREEN_FULL       'f'  ///< Use SCREEN_MODE_FULL for the TUI
+#define CMD_SCREEN_DELTA      'd'  ///< Use SCREEN_MODE_DELTA for the TUI
+#define CMD_PRINT_STATS       's'  ///< Print and reset per-task scheduler and per-device I2C statistics
+#define CMD_PRINT_PROFILE     'p'  ///< Print and reset per-stage profiler statistics, POTV2_PROFILE builds only
+#define CMD_BENCH_IMU_FILTER  'i'  ///< Print the per-sample cost of each IMU filter, POTV2_PROFILE builds only
+#define CMD_MIDI_TOGGLE       'm'  ///< Turn MIDI output on or off, builds with a MIDI_SINK only
+#define CMD_CAPTURE_ARM       'c'  ///< Arm a capture with the selected trigger, or cancel one in progress
+#define CMD_CAPTURE_TRIGGER   'g'  ///< Select the next CAPTURE_TRIGGER_* for the next capture
+
+#define MIDI_OUTPUT_DEFAULT  true  ///< MIDI output state at power-on when built with a MIDI_SINK
+
+// Sensor capture, see CaptureBuffer.hpp for the per-board storage and rate
+#define CAPTURE_CHANNELS  CAPTURE_CHANNEL_ALL  ///< CAPTURE_CHANNEL_* bits recorded, fewer channels give a longer capture
+#define CAPTURE_TRIGGER_DEFAULT  CAPTURE_TRIGGER_FRET  ///< Trigger selected at power-on
+#define CAPTURE_PRE_TRIGGER_PERCENT  25  ///< Share of the capture taken from before the trigger
+#define CAPTURE_ULTRA_TRIGGER_CM  20  ///< CAPTURE_TRIGGER_ULTRA fires when a hand comes closer than this
+
+// IMU sampling, the IMU task runs once per sample at IMU_DATA_RATE
+#define IMU_DATA_RATE  MMA8452Q_ODR_200HZ  ///< Lefty detection and the TUI need far less than the 800Hz default
+#define IMU_FAST_READ  true  ///< 8-bit F_READ samples, 4-byte reads instead of 7 on the shared Wire1
+#define IMU_LEFTY_ORIENTATION  MMA8452Q_LAPO_LANDSCAPE_LEFT  ///< Portrait/landscape orientation of a lefty-flipped paddle
+#define IMU_LEFTY_DEBOUNCE  40  ///< Samples a flip must hold before it counts, 200ms at IMU_DATA_RATE
+
+// Boot sequence, TaskBoot brings each sensor up as soon as its devices answer
+#define BOOT_LED_STEP_US  130000  ///< Time each color of the boot LED pattern shows, the last one stays on
+#define BOOT_SENSOR_TIMEOUT_US  300000  ///< A sensor whose devices have not all answered by then is left out
+#define BOOT_STATE_PROBING  0  ///< Waiting for the sensor's devices to answer
+#define BOOT_STATE_READY    1  ///< Set up, its tasks are running
+#define BOOT_STATE_ABSENT   2  ///< Did not answer within BOOT_SENSOR_TIMEOUT_US
+
+// Task periods, each sensor runs at a rate that suits it
+#define TASK_PERIOD_BOOT_US  2000  ///< Boot sequence tick: one presence probe or sensor setup per bus, and the LED pattern
+#define TASK_PERIOD_QTOUCH_US  250  ///< Drain QTouch change events, bounds touch and MIDI note latency
+#define TASK_PERIOD_LEFTY_US  20000  ///< Orientation-change check, reads PL_STATUS only while PIN_IMU_PL_INT is asserted if it is wired
+#define TASK_PERIOD_ROT_ENC_US  2000  ///< Rotary encoder switch and the position its ISR keeps
+#define TASK_PERIOD_ULTRA_US  5000  ///< Drain timed echoes, pings themselves go out every ULTRASONIC_PING_PERIOD_MICROS
+#define TASK_PERIOD_ROT_POT_US  10000  ///< Fold queued rotary potentiometer readings into SensorState
+#define TASK_PERIOD_TUI_US  20000  ///< TUI refresh, faster is not readable
+#define TASK_PERIOD_TELEMETRY_US  2000  ///< Binary telemetry packet rate, ~11KB/s at 22 bytes per packet
+#define TASK_PERIOD_CAPTURE_US  CAPTURE_PERIOD_US  ///< Capture sample rate, the task idles unless a capture is armed
+#define TASK_PERIOD_QTOUCH_RAW_US  5000  ///< Raw QTouch sample rate of both boards, ~2ms of each bus at 400kHz; only runs in OUTPUT_MODE_QTOUCH_RAW
+
+static_assert(QTOUCH_RAW_NUM_KEYS == TELEMETRY_QTOUCH_RAW_KEYS, "A raw QTouch packet carries every key of a board");
+
+// Stages timed by PROFILE_SCOPE when POTV2_PROFILE is set
+#define PROFILE_STAGE_LOOP  0  ///< Whole loop() pass
+#define PROFILE_STAGE_QTOUCH  1  ///< Drain QTouch change events and queue key status reads
+#define PROFILE_STAGE_FRET  2  ///< FretBoard key bitmap edge detection and highest fret
+#define PROFILE_STAGE_STRUM  3  ///< StrumBoard key bitmap edge detection and key groups
+#define PROFILE_STAGE_IMU  4  ///< Hand a finished IMU read to SensorState
+#define PROFILE_STAGE_ROT_ENC  5  ///< Encoder position and switch
+#define PROFILE_STAGE_ROT_POT  6  ///< Drain PotAdc and UpdateRotPot
+#define PROFILE_STAGE_ULTRA  7  ///< Echo median filter, ping trigger and range scaling
+#define PROFILE_STAGE_OUTPUT  8  ///< Serial commands plus CheckUpdateScreen or SendTelemetry
+#define PROFILE_STAGE_I2C  9  ///< I2cServiceAll on both buses
+#define PROFILE_STAGE_SERIAL_TX  10  ///< Queue capture dump packets and hand queued output to Serial
+#define PROFILE_STAGE_MIDI  11  ///< Turn SensorState changes into MIDI and send them
+
+UltrasonicRanger ultrasonic = UltrasonicRanger(PIN_ULTRA_TRIG, PIN_ULTRA_SENS);
+QuadratureEncoder rotEnc = QuadratureEncoder(PIN_ROT_ENC_A, PIN_ROT_ENC_C);
 QTouchBoard fretBoard = QTouchBoard(PIN_FRET_1070_INT, PIN_FRET_2120_INT);
 QTouchBoard strumBoard = QTouchBoard(PIN_STRUM_1070_INT, PIN_STRUM_2120_INT);
-SensorState state = SensorState();
+TouchTracker fretTouch = TouchTracker(QTOUCH_BOARD_FRET);
+TouchTracker strumTouch = TouchTracker(QTOUCH_BOARD_STRUM);
+SerialTx serialTx;
+SensorState state = SensorState(serialTx);
+#if MIDI_SINK == MIDI_SINK_USB
+UsbMidiSink midiSink;
+#elif MIDI_SINK == MIDI_SINK_SERIAL1
+MidiStreamSink midiSink = MidiStreamSink(Serial1);
+#endif
+#if MIDI_SINK != MIDI_SINK_NONE
+MidiEngine midiEngine = MidiEngine(midiSink);
+#endif
+CaptureBuffer capture;
 MMA8452Q accel;
+PotAdc rotPot = PotAdc(PIN_ROT_POT);
 
-static void pingCheck(void);
-static void RotEncSetLED(uint8_t color);
-static void RotEncStandardPattern(void);
+// I2C transaction engines: fretBoard on Wire, strumBoard and accel share Wire1
+WireI2cDriver wireDriver = WireI2cDriver(Wire, PIN_WIRE_SDA, PIN_WIRE_SCL);
+WireI2cDriver wire1Driver = WireI2cDriver(Wire1, PIN_WIRE1_SDA, PIN_WIRE1_SCL);
+I2cEngine wireEngine = I2cEngine(wireDriver, micros);
+I2cEngine wire1Engine = I2cEngine(wire1Driver, micros);
+I2cEngine *i2cEngines[NUM_I2C_ENGINES] = { &wireEngine, &wire1Engine };
 
-// utrasonic variables
-unsigned long ping_time;
-unsigned long range_in_us;
-unsigned long range_in_cm;
+/**************************************************************************/
+/*!
+    @brief  One I2C device the boot sequence waits for, by its ID register
+*/
+/**************************************************************************/
+struct BootProbe
+{
+  const char *name;  ///< Device name for the boot log
+  I2cEngine *engine;  ///< Engine of the device's bus
+  uint8_t addr;  ///< 7-bit device address
+  uint8_t idReg;  ///< ID register to read back
+  uint8_t idValue;  ///< Value idReg must hold
+  uint32_t maxClockHz;  ///< Fastest SCL the device is rated for, faster I2C_PROBE_CLOCKS_HZ are skipped
+};
+
+/**************************************************************************/
+/*!
+    @brief  A sensor TaskBoot sets up once every one of its devices answers
+*/
+/**************************************************************************/
+struct BootSensor
+{
+  const char *name;  ///< Sensor name for the boot log
+  const BootProbe *probes;  ///< Devices that must answer first
+  uint8_t numProbes;  ///< Entries in probes
+  void (*start)(void);  ///< Sets the sensor up and starts its tasks
+  uint8_t nextProbe;  ///< First device that has not answered yet
+  uint8_t state;  ///< BOOT_STATE_*
+  uint32_t readyMicros;  ///< micros() when the sensor was set up
+};
+
+/**************************************************************************/
+/*!
+    @brief  One bus of the boot sequence, its sensors take turns probing a device each
+*/
+/**************************************************************************/
+struct BootBus
+{
+  BootSensor *sensor;  ///< Sensor whose turn it is, NULL until the first tick
+  uint8_t clockIndex;  ///< Candidate clock being tried, see BootProbeClock()
+  uint8_t passes;  ///< ID reads that came back right at that clock
+  uint8_t value;  ///< Destination of the ID read
+  bool isReadSent;  ///< True while txn has results the next tick has not looked at
+  I2cTransaction txn;  ///< ID read, resubmitted by BootProbeRead() until I2C_PROBE_READS pass or one fails
+};
+
+TaskScheduler scheduler;
+int8_t bootTaskId;
+int8_t imuTaskId;
+int8_t leftyTaskId;
+int8_t outputTaskId;
+int8_t qtouchRawTaskId;
+
+static void HandleSerialCommands(void);
+static void TaskBoot(void);
+static void BootAdvanceBus(BootBus &boot, I2cEngine *engine, uint32_t now);
+static BootSensor *BootNextSensor(const I2cEngine *engine, const BootSensor *after);
+static uint32_t BootProbeClock(const BootProbe &probe, uint8_t index);
+static void BootProbeRead(I2cTransaction *txn);
+static void StartFretBoard(void);
+static void StartStrumBoard(void);
+static void StartImu(void);
+static void SetOutputMode(uint8_t mode);
+static void TaskQTouch(void);
+static void TaskImu(void);
+static void TaskLefty(void);
+static void TaskRotEnc(void);
+static void TaskRotPot(void);
+static void TaskUltrasonic(void);
+static void TaskOutput(void);
+static void TaskCapture(void);
+static void TaskQTouchRaw(void);
+static void SendQTouchRaw(QTouchBoard &board, uint8_t boardId);
+static void DrainTouchEvents(void);
+static void CollectI2cReads(void);
+static void PrintI2cStats(I2cEngine &engine, const char *name);
+static void RotEncSetLED(uint8_t color);
 
 // QTouchBoard variables
-uint8_t strumStatus0, strumStatus1, strumStatus2;
-uint8_t keyStatus0, keyStatus1, keyStatus2;
+uint32_t touchKeys;
+uint32_t touchMicros;
+
+// Selected OUTPUT_MODE_*
+uint8_t outputMode = OUTPUT_MODE_DEFAULT;
+
+// CAPTURE_TRIGGER_* the next capture arms with
+uint8_t captureTrigger = CAPTURE_TRIGGER_DEFAULT;
+
+// True while TaskOutput holds back for a capture dump
+bool isOutputPaused = false;
+
+// True until the first raw QTouch packet after switching to OUTPUT_MODE_QTOUCH_RAW
+bool isQTouchRawResync = false;
 
-// Rotary Encoder read variable
-int32_t rotEncRetval;
+// True until the first telemetry packet after switching to OUTPUT_MODE_TELEMETRY
+bool isTelemetryResync = false;
+
+// micros() when setup() started, boot times are reported from here
+uint32_t bootStartMicros;
+
+const BootProbe fretProbes[] =
+{
+  { "qt2120", &wireEngine, QTOUCH2120_ADDR, REG_QT2120_CHIP_ID, VAL_QT2120_CHIP_ID, QTOUCH2120_MAX_CLOCK_HZ },
+  { "qt1070", &wireEngine, QTOUCH1070_ADDR, REG_QT1070_CHIP_ID, VAL_QT1070_CHIP_ID, QTOUCH1070_MAX_CLOCK_HZ },
+};
+const BootProbe strumProbes[] =
+{
+  { "qt2120", &wire1Engine, QTOUCH2120_ADDR, REG_QT2120_CHIP_ID, VAL_QT2120_CHIP_ID, QTOUCH2120_MAX_CLOCK_HZ },
+  { "qt1070", &wire1Engine, QTOUCH1070_ADDR, REG_QT1070_CHIP_ID, VAL_QT1070_CHIP_ID, QTOUCH1070_MAX_CLOCK_HZ },
+};
+const BootProbe imuProbes[] =
+{
+  { "mma8452q", &wire1Engine, MMA8452Q_SLAVE_ADDR, MMA8452Q_WHOAMI_REG, MMA8452Q_WHOAMI_VAL, MMA8452Q_MAX_CLOCK_HZ },
+};
+
+// Sensors on different buses come up independently of each other
+BootSensor bootSensors[] =
+{
+  { "fretboard", fretProbes, 2, StartFretBoard, 0, BOOT_STATE_PROBING, 0 },
+  { "strumboard", strumProbes, 2, StartStrumBoard, 0, BOOT_STATE_PROBING, 0 },
+  { "imu", imuProbes, 1, StartImu, 0, BOOT_STATE_PROBING, 0 },
+};
+#define NUM_BOOT_SENSORS  (sizeof(bootSensors) / sizeof(bootSensors[0]))  ///< Entries in bootSensors
+
+// Boot probe state of each bus, indexed like i2cEngines
+BootBus bootBuses[NUM_I2C_ENGINES];
+
+// Boot LED pattern, one color per BOOT_LED_STEP_US
+const uint8_t bootLedPattern[] = { LED_BLUE, LED_PURPLE, LED_GREEN, LED_CYAN, LED_RED, LED_YELLOW, LED_WHITE };
 
 /**************************************************************************/
 /*!
@@ -64,136 +278,805 @@ int32_t rotEncRetval;
 /**************************************************************************/
 void setup() 
 {
+  bootStartMicros = micros();
   Serial.begin(500000);
-  delay(1000);
   
-  Serial.println("*** Paddle of Theseus Test Software v2 ***");
-  Serial.println();
+  serialTx.BeginFrame();
+  serialTx.println("*** Paddle of Theseus Test Software v2 ***");
+  serialTx.println();
+  serialTx.EndFrame(false);
 
-  Serial.println("*** Setup FretBoard ***");
-  Wire.begin();
-  fretBoard.begin(Wire);
-  Serial.println("*** Done ***");
+  pinMode(PIN_ROT_LEDB, OUTPUT);
+  pinMode(PIN_ROT_LEDG, OUTPUT);
+  pinMode(PIN_ROT_LEDR, OUTPUT); 
+  RotEncSetLED(bootLedPattern[0]);
 
-  Serial.println("*** Setup StrumBoard ***");
+  // Devices come up in TaskBoot as they answer, the rest is ready now
+  Wire.begin();
   Wire1.begin();
-  strumBoard.begin(Wire1);
-  Serial.println("*** Done ***");
 
-  accel.init();
+  rotPot.Begin();
+  ultrasonic.Begin();
+  rotEnc.Begin();
+  rotEnc.SetReversed(!state.GetIsLeftyFlipped());
 
-  pinMode(PIN_ROT_LEDB, OUTPUT);
-  pinMode(PIN_ROT_LEDG, OUTPUT);
-  pinMode(PIN_ROT_LEDR, OUTPUT); 
-  RotEncStandardPattern();
+#if MIDI_SINK == MIDI_SINK_SERIAL1
+  Serial1.begin(MIDI_DIN_BAUD);
+#endif
+#if MIDI_SINK != MIDI_SINK_NONE
+  midiEngine.SetEnabled(MIDI_OUTPUT_DEFAULT);
+#endif
 
-  delay(1000);
+  bootTaskId = scheduler.AddTask("boot", TaskBoot, TASK_PERIOD_BOOT_US, 0);
+  scheduler.AddTask("qtouch", TaskQTouch, TASK_PERIOD_QTOUCH_US, 0);
+  imuTaskId = scheduler.AddTask("imu", TaskImu, accel.GetSamplePeriodMicros(), 0);
+  leftyTaskId = scheduler.AddTask("lefty", TaskLefty, TASK_PERIOD_LEFTY_US, 0);
+  scheduler.AddTask("rotenc", TaskRotEnc, TASK_PERIOD_ROT_ENC_US, 0);
+  scheduler.AddTask("rotpot", TaskRotPot, TASK_PERIOD_ROT_POT_US, 0);
+  scheduler.AddTask("ultra", TaskUltrasonic, TASK_PERIOD_ULTRA_US, 0);
+  outputTaskId = scheduler.AddTask("output", TaskOutput, TASK_PERIOD_TUI_US, 0);
+  scheduler.AddTask("capture", TaskCapture, TASK_PERIOD_CAPTURE_US, 0);
+  qtouchRawTaskId = scheduler.AddTask("qtraw", TaskQTouchRaw, TASK_PERIOD_QTOUCH_RAW_US, 0);
+  SetOutputMode(outputMode);
 
-  Serial.println();
+  // Started by TaskBoot: the IMU tasks once it is set up, output once the boot log is complete
+  scheduler.StopTask(imuTaskId);
+  scheduler.StopTask(leftyTaskId);
+  scheduler.StopTask(outputTaskId);
+
+#if POTV2_PROFILE
+  loopProfiler.SetStageName(PROFILE_STAGE_LOOP, "loop");
+  loopProfiler.SetStageName(PROFILE_STAGE_QTOUCH, "qtouch");
+  loopProfiler.SetStageName(PROFILE_STAGE_FRET, "fret");
+  loopProfiler.SetStageName(PROFILE_STAGE_STRUM, "strum");
+  loopProfiler.SetStageName(PROFILE_STAGE_IMU, "imu");
+  loopProfiler.SetStageName(PROFILE_STAGE_ROT_ENC, "rotenc");
+  loopProfiler.SetStageName(PROFILE_STAGE_ROT_POT, "rotpot");
+  loopProfiler.SetStageName(PROFILE_STAGE_ULTRA, "ultra");
+  loopProfiler.SetStageName(PROFILE_STAGE_OUTPUT, "output");
+  loopProfiler.SetStageName(PROFILE_STAGE_I2C, "i2c");
+  loopProfiler.SetStageName(PROFILE_STAGE_SERIAL_TX, "serialtx");
+  loopProfiler.SetStageName(PROFILE_STAGE_MIDI, "midi");
+  loopProfiler.Begin();
+#endif
+  scheduler.Start();
 }
 
 /**************************************************************************/
 /*!
-    @brief    Poll sensors, detect changes, and update Serial UI when variables update
+    @brief    Run whichever sensor tasks are due and hand finished I2C reads to SensorState
 */
 /**************************************************************************/
 void loop()
 {
-  if (fretBoard.isValueUpdate())
-  {    
-    keyStatus0 = fretBoard.QT2120ReadSingleReg(REG_QT2120_KEY_STATUS_0);
-    keyStatus1 = fretBoard.QT2120ReadSingleReg(REG_QT2120_KEY_STATUS_1);
-    keyStatus2 = fretBoard.QT1070ReadSingleReg(REG_QT1070_KEY_STATUS_0);
-    state.UpdateFret(keyStatus0, keyStatus1, keyStatus2);
+  PROFILE_SCOPE(PROFILE_STAGE_LOOP);
+
+  scheduler.RunPending();
+
+  // Reads queued by the tasks progress in the background on Wire and Wire1
+  {
+    PROFILE_SCOPE(PROFILE_STAGE_I2C);
+    I2cServiceAll(i2cEngines, NUM_I2C_ENGINES);
+  }
+  CollectI2cReads();
+
+#if MIDI_SINK != MIDI_SINK_NONE
+  // Every pass rather than a task, so MIDI follows a new reading within one loop pass
+  {
+    PROFILE_SCOPE(PROFILE_STAGE_MIDI);
+    midiEngine.Update(state);
+    midiEngine.Service();
+  }
+#endif
+
+  // Output drains only as fast as the host takes it, never blocking the sensors
+  {
+    PROFILE_SCOPE(PROFILE_STAGE_SERIAL_TX);
+    capture.Service(serialTx);
+    serialTx.Service();
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Advance the boot LED pattern and bring up sensors whose devices now answer
+
+    Each bus takes one step per tick: it looks at the ID reads it submitted
+    the tick before and then submits the next ones, or sets up a sensor whose
+    devices have all answered. Wire and Wire1 probe at the same time, and
+    sensors sharing a bus take turns a device at a time. A sensor keeps
+    retrying until its devices pass or BOOT_SENSOR_TIMEOUT_US runs out, so a
+    slow device only delays its own sensor. Output starts once every sensor
+    is up or given up on, and the task stops itself once the LED pattern has
+    finished too.
+*/
+/**************************************************************************/
+static void TaskBoot(void)
+{
+  static uint8_t ledStep = 0;
+  static bool isBootLogDone = false;
+  uint32_t now = micros();
+  bool isProbing = false;
+
+  for (uint8_t bus=0; bus<NUM_I2C_ENGINES; bus++)
+  {
+    BootAdvanceBus(bootBuses[bus], i2cEngines[bus], now);
+  }
+  for (uint8_t i=0; i<NUM_BOOT_SENSORS; i++)
+  {
+    isProbing |= (bootSensors[i].state == BOOT_STATE_PROBING);
+  }
+  if (!isProbing && !isBootLogDone)
+  {
+    isBootLogDone = true;
+    serialTx.BeginFrame();
+    serialTx.println();
+    serialTx.EndFrame(false);
+    scheduler.ResumeTask(outputTaskId);
   }
 
-  if (strumBoard.isValueUpdate())
+  uint32_t step = (now - bootStartMicros) / BOOT_LED_STEP_US;
+  while (ledStep < step && ledStep < sizeof(bootLedPattern) - 1)
   {
-    strumStatus0 = strumBoard.QT2120ReadSingleReg(REG_QT2120_KEY_STATUS_0);
-    strumStatus1 = strumBoard.QT2120ReadSingleReg(REG_QT2120_KEY_STATUS_1);
-    strumStatus2 = strumBoard.QT1070ReadSingleReg(REG_QT1070_KEY_STATUS_0);
-    state.UpdateStrumKey(strumStatus0, strumStatus1, strumStatus2);
+    ledStep++;
+    RotEncSetLED(bootLedPattern[ledStep]);
   }
+  if (isBootLogDone && ledStep == sizeof(bootLedPattern) - 1)
+  {
+    scheduler.StopTask(bootTaskId);
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Take one boot step on a bus: probe a device at a clock, or set up a sensor
+    @param    boot
+              Entry of bootBuses
+    @param    engine
+              Engine of the bus
+    @param    now
+              micros() of this tick
+*/
+/**************************************************************************/
+static void BootAdvanceBus(BootBus &boot, I2cEngine *engine, uint32_t now)
+{
+  if (boot.txn.IsPending())
+  {
+    return;  // ID reads from the last tick are still on the bus
+  }
+
+  // Keep the clock every read passed at, else try the next slower one. The turn passes on once the device
+  // has answered or failed at every clock
+  if (boot.isReadSent)
+  {
+    boot.isReadSent = false;
+    const BootProbe &probe = boot.sensor->probes[boot.sensor->nextProbe];
+    if (boot.passes == I2C_PROBE_READS)
+    {
+      serialTx.BeginFrame();
+      serialTx.print("I2C "); serialTx.print(probe.name);
+      serialTx.print(" clock "); serialTx.println(BootProbeClock(probe, boot.clockIndex));
+      serialTx.EndFrame(false);
+      boot.sensor->nextProbe++;
+      boot.clockIndex = 0;
+      boot.sensor = BootNextSensor(engine, boot.sensor);
+    }
+    else if (BootProbeClock(probe, ++boot.clockIndex) == 0)
+    {
+      // Not answering at any rate, leave it at the default for its next turn
+      engine->SetDeviceClock(probe.addr, I2C_CLOCK_DEFAULT_HZ);
+      boot.clockIndex = 0;
+      boot.sensor = BootNextSensor(engine, boot.sensor);
+    }
+  }
+  if (boot.sensor == NULL || boot.sensor->state != BOOT_STATE_PROBING)
+  {
+    boot.sensor = BootNextSensor(engine, boot.sensor);
+    if (boot.sensor == NULL)
+    {
+      return;  // Every sensor on this bus is up or given up on
+    }
+  }
+  BootSensor &sensor = *boot.sensor;
+
+  if (sensor.nextProbe == sensor.numProbes)
+  {
+    // One frame with the driver's own setup lines, so the boot log never loses half a sensor
+    serialTx.BeginFrame();
+    sensor.start();
+    sensor.readyMicros = micros();
+    sensor.state = BOOT_STATE_READY;
+    serialTx.print("*** "); serialTx.print(sensor.name);
+    serialTx.print(" ready after "); serialTx.print(sensor.readyMicros - bootStartMicros); serialTx.println(" us ***");
+    serialTx.EndFrame(false);
+    return;
+  }
+  const BootProbe &probe = sensor.probes[sensor.nextProbe];
+  if (now - bootStartMicros >= BOOT_SENSOR_TIMEOUT_US)
+  {
+    sensor.state = BOOT_STATE_ABSENT;
+    engine->SetDeviceClock(probe.addr, I2C_CLOCK_DEFAULT_HZ);
+    serialTx.BeginFrame();
+    serialTx.print("WARNING: "); serialTx.print(sensor.name); serialTx.print(" left out, ");
+    serialTx.print(probe.name); serialTx.println(" did not answer");
+    serialTx.EndFrame(false);
+    return;
+  }
+
+  // The first read goes out now, BootProbeRead() chains the rest while the main loop services the bus
+  engine->SetDeviceClock(probe.addr, BootProbeClock(probe, boot.clockIndex));
+  boot.passes = 0;
+  boot.value = (uint8_t) ~probe.idValue;
+  boot.txn.SetupRead(probe.addr, probe.idReg, &boot.value, 1);
+  boot.txn.maxRetries = 0;
+  boot.txn.callback = BootProbeRead;
+  boot.txn.context = &boot;
+  boot.isReadSent = engine->Submit(boot.txn);
+}
+
+/**************************************************************************/
+/*!
+    @brief    Find the sensor on a bus whose turn is next
+    @param    engine
+              Engine of the bus
+    @param    after
+              Sensor that had the last turn, or NULL to start from the first
+    @return   The next sensor on the bus still probing, after itself if it is the only one, or NULL if none is
+*/
+/**************************************************************************/
+static BootSensor *BootNextSensor(const I2cEngine *engine, const BootSensor *after)
+{
+  uint8_t first = (after == NULL) ? 0 : (after - bootSensors) + 1;
+
+  for (uint8_t n=0; n<NUM_BOOT_SENSORS; n++)
+  {
+    BootSensor &sensor = bootSensors[(first + n) % NUM_BOOT_SENSORS];
+    if (sensor.probes[0].engine == engine && sensor.state == BOOT_STATE_PROBING)
+    {
+      return &sensor;
+    }
+  }
+  return NULL;
+}
+
+/**************************************************************************/
+/*!
+    @brief    One of the I2C_PROBE_CLOCKS_HZ a device may be probed at
+    Rates above the device's rating are never tried, a part can read back
+    fine out of spec and still fail once warm or with longer wires.
+    @param    probe
+              Device being probed
+    @param    index
+              0 for the fastest candidate
+    @return   The clock, or 0 past the slowest
+*/
+/**************************************************************************/
+static uint32_t BootProbeClock(const BootProbe &probe, uint8_t index)
+{
+  static const uint32_t allClocks[] = I2C_PROBE_CLOCKS_HZ;
+
+  for (uint8_t i=0; i<sizeof(allClocks) / sizeof(allClocks[0]); i++)
+  {
+    if (allClocks[i] <= probe.maxClockHz && index-- == 0)
+    {
+      return allClocks[i];
+    }
+  }
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Completion of a boot ID read, reads again until I2C_PROBE_READS in a row pass or one fails
+    @param    txn
+              BootBus::txn, its context is the BootBus
+*/
+/**************************************************************************/
+static void BootProbeRead(I2cTransaction *txn)
+{
+  BootBus &boot = *(BootBus *) txn->context;
+  const BootProbe &probe = boot.sensor->probes[boot.sensor->nextProbe];
+
+  if (!txn->IsOk() || boot.value != probe.idValue)
+  {
+    return;
+  }
+  boot.passes++;
+  if (boot.passes < I2C_PROBE_READS)
+  {
+    boot.value = (uint8_t) ~probe.idValue;
+    probe.engine->Submit(*txn);
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Set up the FretBoard chips on Wire and start taking its change interrupts
+*/
+/**************************************************************************/
+static void StartFretBoard(void)
+{
+  fretBoard.begin(wireEngine, serialTx);
+  fretBoard.EnableChangeInterrupts(QTOUCH_BOARD_FRET);
+}
+
+/**************************************************************************/
+/*!
+    @brief    Set up the StrumBoard chips on Wire1 and start taking its change interrupts
+*/
+/**************************************************************************/
+static void StartStrumBoard(void)
+{
+  strumBoard.begin(wire1Engine, serialTx);
+  strumBoard.EnableChangeInterrupts(QTOUCH_BOARD_STRUM);
+}
+
+/**************************************************************************/
+/*!
+    @brief    Set up the IMU on Wire1 and start its sampling and orientation tasks
+*/
+/**************************************************************************/
+static void StartImu(void)
+{
+  accel.init(wire1Engine, serialTx);
+  accel.SetDataRate(IMU_DATA_RATE);
+  accel.SetFastRead(IMU_FAST_READ);
+  accel.EnableDataReady(PIN_IMU_INT, MMA8452Q_INT1);
+  accel.EnablePortraitLandscape(IMU_LEFTY_ORIENTATION, IMU_LEFTY_DEBOUNCE, PIN_IMU_PL_INT, MMA8452Q_INT2);
+  scheduler.SetTaskPeriod(imuTaskId, accel.GetSamplePeriodMicros(), 0);
+  scheduler.ResumeTask(imuTaskId);
+  scheduler.ResumeTask(leftyTaskId);
+}
 
-  state.UpdateRotPot(); 
+/**************************************************************************/
+/*!
+    @brief    Task: queue key status reads for QTouch boards that raised a change interrupt
+*/
+/**************************************************************************/
+static void TaskQTouch(void)
+{
+  PROFILE_SCOPE(PROFILE_STAGE_QTOUCH);
+  QTouchEvent event;
+
+  DrainTouchEvents();
+
+  // Catch changes that landed while the status registers were last being read
+  fretBoard.RearmIfAsserted();
+  strumBoard.RearmIfAsserted();
+
+  while (QTouchBoard::PopEvent(event))
+  {
+    if (event.boardId == QTOUCH_BOARD_FRET)
+    {
+      fretBoard.StartKeyStatusRead(wireEngine, event.timestamp);
+    }
+    else
+    {
+      strumBoard.StartKeyStatusRead(wire1Engine, event.timestamp);
+    }
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Task: queue a read of the IMU sample, skipped while its INT line shows none pending
+*/
+/**************************************************************************/
+static void TaskImu(void)
+{
+  accel.StartUpdate(wire1Engine);
+}
+
+/**************************************************************************/
+/*!
+    @brief    Task: queue a read of the IMU orientation, skipped while its INT line shows no change
+*/
+/**************************************************************************/
+static void TaskLefty(void)
+{
+  accel.StartOrientationRead(wire1Engine);
+}
+
+/**************************************************************************/
+/*!
+    @brief    Task: take the position the rotary encoder ISR keeps and sample its switch
+*/
+/**************************************************************************/
+static void TaskRotEnc(void)
+{
+  PROFILE_SCOPE(PROFILE_STAGE_ROT_ENC);
   state.UpdateRotEncSwitch();
+  state.UpdateRotEnc(rotEnc.GetPosition());
+}
+
+/**************************************************************************/
+/*!
+    @brief    Task: take the filtered rotary potentiometer position, the ADC samples in the background
+*/
+/**************************************************************************/
+static void TaskRotPot(void)
+{
+  PROFILE_SCOPE(PROFILE_STAGE_ROT_POT);
+  rotPot.Service();
+  state.UpdateRotPot(rotPot.GetValue());
+}
+
+/**************************************************************************/
+/*!
+    @brief    Task: filter the echoes timed since the last run and trigger the next ping when due
+*/
+/**************************************************************************/
+static void TaskUltrasonic(void)
+{
+  PROFILE_SCOPE(PROFILE_STAGE_ULTRA);
 
-  // handle rotary encoder state
-  rotEncRetval = state.ProcessRotEnc(RotaryEncoder.read()); 
-  RotaryEncoder.write( (state.GetIsLeftyFlipped()) ? 
-                      rotEncRetval : (-1 *rotEncRetval) );
-  state.UpdateRotEnc((uint8_t) rotEncRetval);
+  ultrasonic.Service();
+  ultrasonic.StartPing();
 
-  // Get Ultrasonic Distance sensor reading
-  if (micros() >= ping_time)
+  // Without recent echoes report "no signal" so the whammy releases
+  bool isValid = ultrasonic.IsValid();
+  uint8_t rangeCm = (isValid) ? ultrasonic.GetDistanceCm() : PITCH_BEND_MAX_CM;
+  state.UpdateUltrasonic(rangeCm, isValid);
+}
+
+/**************************************************************************/
+/*!
+    @brief    Task: handle serial commands and emit the TUI or a telemetry packet
+*/
+/**************************************************************************/
+static void TaskOutput(void)
+{
+  PROFILE_SCOPE(PROFILE_STAGE_OUTPUT);
+  HandleSerialCommands();
+
+  // A capture dump gets the link to itself, the TUI redraws in full afterwards
+  if (capture.GetState() == CAPTURE_STATE_DUMPING)
   {
-    // due to using newPing timer, this has to indirectly set range_in_us
-    Ultrasonic.ping_timer(pingCheck);
-    range_in_cm = range_in_us / US_ROUNDTRIP_CM; // NOTE this US_ROUNDTRIP_CM is in NewPing source code 
-    ping_time += ULTRASONIC_PING_PERIOD_MICROS;
+    isOutputPaused = true;
+    return;
+  }
+  if (isOutputPaused)
+  {
+    isOutputPaused = false;
+    state.SetScreenMode(state.GetScreenMode());
   }
 
-  // constrain range_in_cm, but sufficiently low values are treated as high ones
-  if (range_in_cm < PITCH_BEND_MIN_CM || range_in_cm > PITCH_BEND_MAX_CM)
+  if (outputMode == OUTPUT_MODE_TELEMETRY)
   {
-    range_in_cm = PITCH_BEND_MAX_CM;
+    if (state.SendTelemetry(micros(), isTelemetryResync))
+    {
+      isTelemetryResync = false;
+    }
   }
-  
-  state.UpdateUltrasonic(ONEBYTE_SCALED_PITCH_BEND(range_in_cm));
+  else if (outputMode == OUTPUT_MODE_TUI)
+  {
+    // if any variables changed since last refresh, update screen
+    state.CheckUpdateScreen();
+  }
+}
 
-  // Check Lefty Flip status
-  accel.Update();
-  state.SetIsLeftyFlipped(accel.IsLeftyFlipped());
-  state.UpdateXYZ(accel.x, accel.y, accel.z);
+/**************************************************************************/
+/*!
+    @brief    Task: record the latest value of every channel while a capture is armed
+*/
+/**************************************************************************/
+static void TaskCapture(void)
+{
+  CaptureSample sample;
 
-  // if any variables changed this iter, wipe and update screen
-  state.CheckUpdateScreen();
-  delay(100); //
+  if (!capture.IsSampling())
+  {
+    return;
+  }
+
+  // Drain the ISR rings here too so the capture sees readings as they land, not at the slower task rates
+  rotPot.Service();
+  ultrasonic.Service();
+
+  uint32_t echoMicros = ultrasonic.GetEchoWidthMicros();
+  sample.timestamp = micros();
+  sample.potRaw = rotPot.GetRaw();
+  sample.echoMicros = (echoMicros > 0xFFFF) ? 0xFFFF : (uint16_t) echoMicros;
+  sample.imuX = accel.x;
+  sample.imuY = accel.y;
+  sample.imuZ = accel.z;
+  sample.fretKeys = fretTouch.GetKeys();
+  sample.strumKeys = strumTouch.GetKeys();
+  capture.Record(sample);
 }
 
 /**************************************************************************/
 /*!
-    @brief    Callback function to check whether ultrasonic sonar has returned data
+    @brief    Task: send the raw QTouch samples read since the last run and queue the next reads
+
+    Each run reads every key's signal and reference registers on both boards,
+    so the host sees all 38 channels at 1 / TASK_PERIOD_QTOUCH_RAW_US.
 */
 /**************************************************************************/
-static void pingCheck(void)
+static void TaskQTouchRaw(void)
 {
-  range_in_us = (Ultrasonic.check_timer()) ? Ultrasonic.ping_result : range_in_us +2;
+  uint32_t now = micros();
+
+  SendQTouchRaw(fretBoard, QTOUCH_BOARD_FRET);
+  SendQTouchRaw(strumBoard, QTOUCH_BOARD_STRUM);
+  fretBoard.StartRawRead(wireEngine, now);
+  strumBoard.StartRawRead(wire1Engine, now);
 }
 
 /**************************************************************************/
 /*!
-    @brief    Set the LED on the Illuminated Rotary Encoder
-    @param    color
-              One of the color values defined in BoardLayout.hpp, a bitmap to RGB on/off    
+    @brief    Queue a finished raw read of a board as a TELEMETRY_TYPE_QTOUCH_RAW packet
+    @param    board
+              fretBoard or strumBoard
+    @param    boardId
+              QTOUCH_BOARD_* of board
 */
 /**************************************************************************/
-static void RotEncSetLED(uint8_t color)
+static void SendQTouchRaw(QTouchBoard &board, uint8_t boardId)
 {
-  digitalWrite(PIN_ROT_LEDR, color & 0x1);
-  digitalWrite(PIN_ROT_LEDG, color & 0x2);
-  digitalWrite(PIN_ROT_LEDB, color & 0x4);
+  static uint8_t sequence[QTOUCH_NUM_BOARDS] = { 0, 0 };
+  TelemetryQTouchRaw raw;
+  uint8_t payload[TELEMETRY_QTOUCH_RAW_LEN];
+  uint8_t frame[TELEMETRY_MAX_FRAME_LEN];
+
+  if (!board.CollectRaw(raw.signal, raw.reference, raw.timestamp))
+  {
+    return;
+  }
+  raw.board = boardId;
+  raw.sequence = sequence[boardId]++;
+
+  // Every sample counts towards the noise figures, so none replaces another; a full ring drops it
+  size_t frameLen = TelemetryEncodeFrame(payload, TelemetryPackQTouchRaw(raw, payload), frame);
+  serialTx.BeginFrame();
+  if (isQTouchRawResync)
+  {
+    // End any TUI text still in the host's decoder so it cannot corrupt the first packet
+    serialTx.write((uint8_t) 0x00);
+  }
+  serialTx.write(frame, frameLen);
+  if (serialTx.EndFrame(false))
+  {
+    isQTouchRawResync = false;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Empty the TouchTracker event ring, streaming each edge in OUTPUT_MODE_TELEMETRY
+*/
+/**************************************************************************/
+static void DrainTouchEvents(void)
+{
+  TouchEvent event;
+  TelemetryTouchEvent packet;
+  uint8_t payload[TELEMETRY_TOUCH_EVENT_LEN];
+  uint8_t frame[TELEMETRY_MAX_FRAME_LEN];
+
+  while (TouchTracker::PopEvent(event))
+  {
+    if (outputMode != OUTPUT_MODE_TELEMETRY)
+    {
+      continue;
+    }
+    packet.board = event.boardId;
+    packet.pad = event.pad;
+    packet.isPress = event.isPress;
+    packet.timestamp = event.timestamp;
+
+    // Snapshots only carry the latest bitmap, so an edge must not be replaced by a later one
+    size_t frameLen = TelemetryEncodeFrame(payload, TelemetryPackTouchEvent(packet, payload), frame);
+    serialTx.BeginFrame();
+    if (isTelemetryResync)
+    {
+      // An edge can beat the first snapshot out after the switch, end the TUI text in front of it
+      serialTx.write((uint8_t) 0x00);
+    }
+    serialTx.write(frame, frameLen);
+    if (serialTx.EndFrame(false))
+    {
+      isTelemetryResync = false;
+    }
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Apply any single-character commands received over serial
+*/
+/**************************************************************************/
+static void HandleSerialCommands(void)
+{
+  while (Serial.available() > 0)
+  {
+    switch (Serial.read())
+    {
+      case CMD_OUTPUT_TUI:
+        SetOutputMode(OUTPUT_MODE_TUI);
+        state.SetScreenMode(state.GetScreenMode());  // force a full redraw
+        break;
+      case CMD_OUTPUT_TELEMETRY:
+        SetOutputMode(OUTPUT_MODE_TELEMETRY);
+        break;
+      case CMD_OUTPUT_QTOUCH_RAW:
+        SetOutputMode(OUTPUT_MODE_QTOUCH_RAW);
+        break;
+      case CMD_SCREEN_FULL:
+        state.SetScreenMode(SCREEN_MODE_FULL);
+        break;
+      case CMD_SCREEN_DELTA:
+        state.SetScreenMode(SCREEN_MODE_DELTA);
+        break;
+      case CMD_PRINT_STATS:
+        serialTx.BeginFrame();
+        scheduler.PrintStats(serialTx);
+        serialTx.print("serialtx replaced "); serialTx.print(serialTx.GetReplacedFrames());
+        serialTx.print(" dropped "); serialTx.println(serialTx.GetDroppedFrames());
+        serialTx.print("touch events dropped "); serialTx.println(TouchTracker::GetDroppedEvents());
+#if MIDI_SINK != MIDI_SINK_NONE
+        serialTx.print("midi sent "); serialTx.print(midiEngine.GetSentCount());
+        serialTx.print(" coalesced "); serialTx.print(midiEngine.GetCoalescedCount());
+        serialTx.print(" dropped "); serialTx.println(midiEngine.GetDroppedCount());
+#endif
+        serialTx.print("rotenc position "); serialTx.print(rotEnc.GetPosition());
+        serialTx.print(" velocity "); serialTx.print(rotEnc.GetVelocity()); serialTx.println(" detents/s");
+        serialTx.print("capture state "); serialTx.print(capture.GetState());
+        serialTx.print(" trigger "); serialTx.print(captureTrigger);
+        serialTx.print(" records "); serialTx.print(capture.GetCount());
+        serialTx.print(" of "); serialTx.println(capture.GetCapacity());
+        PrintI2cStats(wireEngine, "wire");
+        PrintI2cStats(wire1Engine, "wire1");
+        for (uint8_t i=0; i<NUM_BOOT_SENSORS; i++)
+        {
+          serialTx.print("boot "); serialTx.print(bootSensors[i].name);
+          if (bootSensors[i].state == BOOT_STATE_READY)
+          {
+            serialTx.print(" ready "); serialTx.print(bootSensors[i].readyMicros - bootStartMicros); serialTx.println(" us");
+          }
+          else
+          {
+            serialTx.println((bootSensors[i].state == BOOT_STATE_ABSENT) ? " absent" : " probing");
+          }
+        }
+        serialTx.EndFrame(false);
+        scheduler.ResetStats();
+        wireEngine.ResetStats();
+        wire1Engine.ResetStats();
+        break;
+      case CMD_CAPTURE_ARM:
+        if (capture.GetState() == CAPTURE_STATE_IDLE)
+        {
+          capture.Arm(CAPTURE_CHANNELS, captureTrigger, CAPTURE_ULTRA_TRIGGER_CM * ULTRASONIC_US_PER_CM,
+                      CAPTURE_PRE_TRIGGER_PERCENT, TASK_PERIOD_CAPTURE_US);
+        }
+        else
+        {
+          capture.Cancel();
+        }
+        break;
+      case CMD_CAPTURE_TRIGGER:
+        captureTrigger = (captureTrigger + 1) % CAPTURE_NUM_TRIGGERS;
+        break;
+#if MIDI_SINK != MIDI_SINK_NONE
+      case CMD_MIDI_TOGGLE:
+        midiEngine.SetEnabled(!midiEngine.IsEnabled());
+        break;
+#endif
+#if POTV2_PROFILE
+      case CMD_PRINT_PROFILE:
+        serialTx.BeginFrame();
+        loopProfiler.PrintStats(serialTx);
+        serialTx.EndFrame(false);
+        loopProfiler.Reset();
+        break;
+      case CMD_BENCH_IMU_FILTER:
+        serialTx.BeginFrame();
+        ImuFilterBenchmark(serialTx);
+        serialTx.EndFrame(false);
+        break;
+#endif
+      default:
+        break;
+    }
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Select what TaskOutput emits and how often
+    @param    mode
+              One of the OUTPUT_MODE_* values
+*/
+/**************************************************************************/
+static void SetOutputMode(uint8_t mode)
+{
+  outputMode = mode;
+  isTelemetryResync = (mode == OUTPUT_MODE_TELEMETRY);
+  scheduler.SetTaskPeriod(outputTaskId,
+                          (mode == OUTPUT_MODE_TELEMETRY) ? TASK_PERIOD_TELEMETRY_US : TASK_PERIOD_TUI_US, 0);
+  if (mode == OUTPUT_MODE_QTOUCH_RAW)
+  {
+    isQTouchRawResync = true;
+    scheduler.ResumeTask(qtouchRawTaskId);
+  }
+  else
+  {
+    scheduler.StopTask(qtouchRawTaskId);
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Hand finished QTouch and IMU reads to SensorState
+*/
+/**************************************************************************/
+static void CollectI2cReads(void)
+{
+  if (fretBoard.CollectKeys(touchKeys, touchMicros))
+  {
+    PROFILE_SCOPE(PROFILE_STAGE_FRET);
+    fretTouch.Update(touchKeys, touchMicros);
+    state.UpdateFret(touchKeys);
+  }
+
+  if (strumBoard.CollectKeys(touchKeys, touchMicros))
+  {
+    PROFILE_SCOPE(PROFILE_STAGE_STRUM);
+    strumTouch.Update(touchKeys, touchMicros);
+    state.UpdateStrumKey(touchKeys);
+  }
+
+  if (accel.FinishUpdate())
+  {
+    PROFILE_SCOPE(PROFILE_STAGE_IMU);
+    state.UpdateXYZ(accel.x, accel.y, accel.z);
+  }
+
+  // Check Lefty Flip status
+  if (accel.FinishOrientationRead())
+  {
+    state.SetIsLeftyFlipped(accel.IsLeftyFlipped());
+    // Right-handed the A/C wiring counts the wrong way round, a flipped paddle counts it as wired
+    rotEnc.SetReversed(!accel.IsLeftyFlipped());
+  }
 }
 
 /**************************************************************************/
 /*!
-    @brief    Blocking function to display a sort of rainbow color pattern on Illuminated Rotary Encoder
+    @brief    Print one line of counters per device on a bus, plus its recoveries
+    @param    engine
+              Engine of the bus
+    @param    name
+              Bus name to prefix each line with
 */
 /**************************************************************************/
-static void RotEncStandardPattern(void)
+static void PrintI2cStats(I2cEngine &engine, const char *name)
 {
-  RotEncSetLED(LED_BLUE);
-  delay(130);  
-  RotEncSetLED(LED_PURPLE);
-  delay(130);  
-  RotEncSetLED(LED_GREEN);
-  delay(130);  
-  RotEncSetLED(LED_CYAN);
-  delay(130);  
-  RotEncSetLED(LED_RED);
-  delay(130);  
-  RotEncSetLED(LED_YELLOW);
-  delay(130);  
-  RotEncSetLED(LED_WHITE);
-  delay(2000);  
+  for (uint8_t i=0; i<engine.GetNumDevices(); i++)
+  {
+    const I2cDeviceStats &dev = engine.GetDeviceStats(i);
+    serialTx.print(name); serialTx.print(" 0x"); serialTx.print(dev.addr, HEX);
+    serialTx.print(" clock "); serialTx.print(dev.clockHz);
+    serialTx.print(" txn "); serialTx.print(dev.transactions);
+    serialTx.print(" nack "); serialTx.print(dev.nacks);
+    serialTx.print(" timeout "); serialTx.print(dev.timeouts);
+    serialTx.print(" err "); serialTx.print(dev.errors);
+    serialTx.print(" retry "); serialTx.print(dev.retries);
+    serialTx.print(" B/s "); serialTx.println(engine.GetBytesPerSecond(i));
+  }
+  serialTx.print(name); serialTx.print(" recoveries "); serialTx.println(engine.GetRecoveries());
+}
+
+/**************************************************************************/
+/*!
+    @brief    Set the LED on the Illuminated Rotary Encoder
+    @param    color
+              One of the color values defined in BoardLayout.hpp, a bitmap to RGB on/off    
+*/
+/**************************************************************************/
+static void RotEncSetLED(uint8_t color)
+{
+  digitalWrite(PIN_ROT_LEDR, color & 0x1);
+  digitalWrite(PIN_ROT_LEDG, color & 0x2);
+  digitalWrite(PIN_ROT_LEDB, color & 0x4);
 }
@@ -0,0 +1,164 @@
+/*!
+ * @file PotAdc.cpp
+ *
+ * \brief Continuously sampled, decimated and hysteresis-filtered potentiometer reader
+ *
+ * The ADC is first set up through the core's analogRead() so resolution,
+ * averaging, calibration and the pin mux all come from the Teensy core, then
+ * switched to continuous conversion with its result interrupt enabled.
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#include "PotAdc.hpp"
+
+PotAdc *PotAdc::_instance = NULL;
+SpscRing<uint16_t, POT_ADC_QUEUE_LEN> PotAdc::_blocks;
+
+/**************************************************************************/
+/*!
+    @brief    Constructor for PotAdc, Begin() must be called before use
+    @param    pin
+              Analog pin to sample, must be the one POT_ADC_CHANNEL names
+*/
+/**************************************************************************/
+PotAdc::PotAdc(uint8_t pin)
+{
+  _pin = pin;
+  _accum = 0;
+  _accumCount = 0;
+  _raw = 0;
+  _value = 0;
+  _isPrimed = false;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Configure the ADC, take a first reading and start continuous conversion
+*/
+/**************************************************************************/
+void PotAdc::Begin(void)
+{
+  _instance = this;
+  analogReadResolution(POT_ADC_BITS);
+  analogReadAveraging(POT_ADC_HW_AVERAGING);
+  _raw = (uint16_t) analogRead(_pin);
+  _ApplyReading(_raw);
+
+#if defined(__IMXRT1062__)
+  attachInterruptVector(IRQ_ADC1, _OnConversion);
+  NVIC_ENABLE_IRQ(IRQ_ADC1);
+  ADC1_GC |= ADC_GC_ADCO;
+  ADC1_HC0 = ADC_HC_AIEN | ADC_HC_ADCH(POT_ADC_CHANNEL);  // writing HC0 starts the first conversion
+#elif defined(__MKL26Z64__)
+  attachInterruptVector(IRQ_ADC0, _OnConversion);
+  NVIC_ENABLE_IRQ(IRQ_ADC0);
+  ADC0_SC3 |= ADC_SC3_ADCO;
+  ADC0_SC1A = ADC_SC1_AIEN | ADC_SC1_ADCH(POT_ADC_CHANNEL);  // writing SC1A starts the first conversion
+#endif
+}
+
+/**************************************************************************/
+/*!
+    @brief    Fold every block queued since the last call into the output value
+
+    Without continuous conversion this takes one blocking analogRead() per
+    call instead, which is what the host simulator uses.
+*/
+/**************************************************************************/
+void PotAdc::Service(void)
+{
+  uint32_t sum = 0;
+  uint8_t count = 0;
+  uint16_t block;
+
+#if !POT_ADC_CONTINUOUS
+  _blocks.Push((uint16_t) analogRead(_pin));
+#endif
+  while (_blocks.Pop(block))
+  {
+    sum += block;
+    count++;
+  }
+  if (count == 0)
+  {
+    return;
+  }
+  _raw = (uint16_t) (sum / count);
+  _ApplyReading(_raw);
+}
+
+/**************************************************************************/
+/*!
+    @brief    Latest filtered potentiometer position, does not touch the ADC
+    @return   Position from 0 to POT_VALUE_MAX
+*/
+/**************************************************************************/
+uint8_t PotAdc::GetValue(void) const
+{
+  return _value;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Latest decimated reading before hysteresis, for debugging
+    @return   Reading in POT_ADC_BITS counts
+*/
+/**************************************************************************/
+uint16_t PotAdc::GetRaw(void) const
+{
+  return _raw;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Sum one hardware-averaged result into the current block, called from interrupt context
+    @param    result
+              Conversion result in POT_ADC_BITS counts
+*/
+/**************************************************************************/
+void PotAdc::_AddResult(uint16_t result)
+{
+  _accum += result;
+  if (++_accumCount < (1 << POT_ADC_DECIMATION_SHIFT))
+  {
+    return;
+  }
+  // A full ring means the loop is behind, drop the block rather than stall the ADC
+  _blocks.Push((uint16_t) (_accum >> POT_ADC_DECIMATION_SHIFT));
+  _accum = 0;
+  _accumCount = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Move the output step only once a reading is clearly outside the current one
+    @param    reading
+              Decimated reading in POT_ADC_BITS counts
+*/
+/**************************************************************************/
+void PotAdc::_ApplyReading(uint16_t reading)
+{
+  uint16_t lower = (uint16_t) _value << POT_VALUE_SHIFT;
+  uint16_t upper = lower + (1 << POT_VALUE_SHIFT);
+
+  if (!_isPrimed || reading + POT_HYSTERESIS < lower || reading >= upper + POT_HYSTERESIS)
+  {
+    _value = (uint8_t) (reading >> POT_VALUE_SHIFT);
+    _isPrimed = true;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    ADC conversion-complete ISR, reading the result register clears the request
+*/
+/**************************************************************************/
+void PotAdc::_OnConversion(void)
+{
+#if defined(__IMXRT1062__)
+  _instance->_AddResult((uint16_t) ADC1_R0);
+#elif defined(__MKL26Z64__)
+  _instance->_AddResult((uint16_t) ADC0_RA);
+#endif
+}
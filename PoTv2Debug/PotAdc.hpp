@@ -0,0 +1,72 @@
+/*!
+ * @file PotAdc.hpp
+ *
+ * \brief Header for the continuously sampled rotary potentiometer ADC engine
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#ifndef __POT_ADC_HPP__
+#define __POT_ADC_HPP__
+
+#include <Arduino.h>
+#include "SpscRing.hpp"
+
+#define POT_ADC_BITS  12  ///< Conversion resolution
+#define POT_ADC_HW_AVERAGING  32  ///< Conversions the ADC hardware averages into each result
+#define POT_ADC_DECIMATION_SHIFT  4  ///< log2 of the averaged results the ISR sums into each queued block
+#define POT_ADC_QUEUE_LEN  16  ///< Capacity of the ISR->loop block ring, must be a power of two
+#define POT_VALUE_MAX  127  ///< Largest GetValue() result, a MIDI data byte
+#define POT_VALUE_SHIFT  (POT_ADC_BITS - 7)  ///< Counts per output step are 1 << POT_VALUE_SHIFT
+#define POT_HYSTERESIS  8  ///< Counts past the edge of the current step before the output moves
+
+///< \def POT_ADC_CONTINUOUS
+///< 1 where the ADC free-runs and interrupts per result, 0 where Service() must poll analogRead()
+#if defined(__IMXRT1062__)
+  #define POT_ADC_CONTINUOUS  1
+  #define POT_ADC_CHANNEL  8  ///< ADC1 input behind PIN_ROT_POT, A1 is GPIO_AD_B1_03 = ADC1_IN8
+#elif defined(__MKL26Z64__)
+  #define POT_ADC_CONTINUOUS  1
+  #define POT_ADC_CHANNEL  14  ///< ADC0 input behind PIN_ROT_POT, A1 is PTC0 = ADC0_SE14
+#else
+  #define POT_ADC_CONTINUOUS  0
+#endif
+
+/**************************************************************************/
+/*!
+    @brief  Free-running, oversampled reader for one analog pin
+    On Teensy 4.0 and LC the ADC converts continuously with hardware
+    averaging and its conversion-complete interrupt sums results into blocks
+    of 1 << POT_ADC_DECIMATION_SHIFT, queued to the loop through an SpscRing.
+    Elsewhere Service() falls back to one analogRead() per call.
+    Service() drains the ring and applies hysteresis, so GetValue() is O(1)
+    and nothing on the hot path waits for a conversion.
+    The engine owns the ADC after Begin(), nothing else may call analogRead().
+*/
+/**************************************************************************/
+class PotAdc
+{
+  private:
+    uint8_t _pin;  ///< Analog pin sampled
+    uint32_t _accum;  ///< Sum of the results of the block being built, ISR only
+    uint8_t _accumCount;  ///< Number of results in _accum, ISR only
+    uint16_t _raw;  ///< Latest decimated reading, POT_ADC_BITS counts
+    uint8_t _value;  ///< Output step after hysteresis, 0 to POT_VALUE_MAX
+    bool _isPrimed;  ///< True once _value has been set from a first reading
+
+    static PotAdc *_instance;  ///< Engine served by the ISR trampoline
+    static SpscRing<uint16_t, POT_ADC_QUEUE_LEN> _blocks;  ///< Decimated readings, oldest first
+
+    void _AddResult(uint16_t result);
+    void _ApplyReading(uint16_t reading);
+    static void _OnConversion(void);
+
+  public:
+    PotAdc(uint8_t pin);
+    void Begin(void);
+    void Service(void);
+    uint8_t GetValue(void) const;
+    uint16_t GetRaw(void) const;
+};
+
+#endif  // __POT_ADC_HPP__
@@ -13,6 +13,31 @@
  */
 #include "QTouchBoard.hpp"
 
+QTouchBoard *QTouchBoard::_boards[QTOUCH_NUM_BOARDS] = { NULL, NULL };
+SpscRing<QTouchEvent, QTOUCH_EVENT_QUEUE_LEN> QTouchBoard::_events;
+
+// Register settings written by initQTouch(), TODO revisit these settings
+static constexpr RegisterWrite QT1070_INIT[] =
+{
+  QT1070Map::AveAks::Set(0x20),
+  QT1070Map::Integration::Set(4),
+  QT1070Map::LowPowerMode::Set(1),
+};
+static constexpr RegisterWrite QT2120_INIT[] =
+{
+  QT2120Map::Integration::Set(4),
+  QT2120Map::DriftHold::Set(3),
+  QT2120Map::DetectThreshold::Set(19),
+};
+static_assert(RegisterBurstCount(QT1070_INIT) == 2, "AVE/AKS and integrator registers are adjacent, one burst for both");
+static_assert(RegisterBurstCount(QT2120_INIT) == 3, "QT2120 init should take one burst per register range");
+
+// Raw reads: the AT42QT1070's signals and references in one burst, the AT42QT2120's in one burst each
+static_assert(QT1070Map::Reference::reg == QT1070Map::Signal::reg + QT1070Map::Signal::count, "QT1070 references must follow its key signals");
+static_assert(QT1070Map::Signal::count + QT1070Map::Reference::count <= I2C_TXN_MAX_READ, "QT1070 raw read must fit one transaction");
+static_assert(QT2120Map::Signal::count <= I2C_TXN_MAX_READ && QT2120Map::Reference::count <= I2C_TXN_MAX_READ,
+              "QT2120 key signals and references must each fit one transaction");
+
 /**************************************************************************/
 /*!
     @brief    Creates QTouchBoard connected to one of the two I2c instances and sets up chips
@@ -24,9 +49,20 @@
 /**************************************************************************/
 QTouchBoard::QTouchBoard(int int1070, int int2120)
 {
-  // set _i2cStream later in setup()
+  // set _engine later in setup()
+  _engine = NULL;
   _intPin1070 = int1070;
   _intPin2120 = int2120;
+  _boardId = QTOUCH_NUM_BOARDS;
+  _isServicePending = false;
+  _isKeyStatusRequested = false;
+  _keyStatusMicros = 0;
+  memset(_qt2120Status, 0, sizeof(_qt2120Status));
+  memset(_qt1070Status, 0, sizeof(_qt1070Status));
+  _isRawRequested = false;
+  _rawMicros = 0;
+  memset(_qt2120Raw, 0, sizeof(_qt2120Raw));
+  memset(_qt1070Raw, 0, sizeof(_qt1070Raw));
 
   pinMode(_intPin1070, INPUT);
   pinMode(_intPin2120, INPUT);
@@ -34,13 +70,17 @@ QTouchBoard::QTouchBoard(int int1070, int int2120)
 
 /**************************************************************************/
 /*!
-    @brief    Take in initialized TwoWire object and add it to the QTouchBoard
+    @brief    Take in the I2cEngine of an initialized bus and set up the chips through it
+    @param    engine
+              I2cEngine of the bus the board is wired to
+    @param    log
+              Where the chip IDs and any setup warnings are printed
 */
 /**************************************************************************/
-void QTouchBoard::begin(TwoWire &inStream)
+void QTouchBoard::begin(I2cEngine &engine, Print &log)
 {
-  _i2cStream = &inStream;
-  initQTouch();
+  _engine = &engine;
+  initQTouch(log);
 }
 
 QTouchBoard::~QTouchBoard() { }
@@ -50,10 +90,10 @@ QTouchBoard::~QTouchBoard() { }
     @brief    Creates QTouchBoard and initializes pins
 */
 /**************************************************************************/
-void QTouchBoard::initQTouch()
+void QTouchBoard::initQTouch(Print &log)
 {
-    _InitQT1070();
-    _InitQT2120();  
+    _InitQT1070(log);
+    _InitQT2120(log);
 }
 
 /**************************************************************************/
@@ -61,27 +101,16 @@ void QTouchBoard::initQTouch()
     @brief    Initialize the register settings for the AT42QT1070
 */
 /**************************************************************************/
-void QTouchBoard::_InitQT1070()
+void QTouchBoard::_InitQT1070(Print &log)
 {
-  // Get Chip ID
-  uint8_t chipId = _ReadSingleReg(false, REG_QT1070_CHIP_ID);
-  Serial.print("QT1070 chipId = 0x"); Serial.print(chipId, HEX); Serial.print(", should be 0x"); Serial.println(VAL_QT1070_CHIP_ID, HEX);
+  uint8_t id[QT1070Map::Id::count] = { 0, 0 };
 
-  // Get FW version
-  uint8_t versionByte = _ReadSingleReg(false, REG_QT1070_VERSION);
-  uint8_t versionMajor = (versionByte & 0xF0) >> 4;
-  uint8_t versionMinor = (versionByte & 0x0F);
-  Serial.print("Firmware version = "); Serial.print(versionMajor); Serial.print("."); Serial.println(versionMinor);
-
-  // Set touch integration
-  for (int i=0; i<7; i++)
+  ReadRegs(false, QT1070Map::Id::reg, sizeof(id), id);
+  _PrintId(log, "QT1070", id, VAL_QT1070_CHIP_ID);
+  if (!RegisterMapWrite(*_engine, QTOUCH1070_ADDR, QT1070_INIT))
   {
-    _WriteSingleReg(false, i + REG_QT1070_INTEGRATION, 4); // TODO revisit these settings
-    _WriteSingleReg(false, i + REG_QT1070_AVE_AKS, 0x20); // TODO revisit these settings
+    log.println("WARNING: QT1070 settings were not all written");
   }
-
-  // Set Low Power Mode
-  _WriteSingleReg(false, 54, 1); // TODO revisit these settings
 }
 
 /**************************************************************************/
@@ -89,29 +118,38 @@ void QTouchBoard::_InitQT1070()
     @brief    Initialize the register settings for the AT42QT2120
 */
 /**************************************************************************/
-void QTouchBoard::_InitQT2120()
+void QTouchBoard::_InitQT2120(Print &log)
 {
-  // Get Chip ID
-  uint8_t chipId = _ReadSingleReg(true, REG_QT2120_CHIP_ID);
-  Serial.print("QT2120 chipId = 0x"); Serial.print(chipId, HEX); Serial.print(", should be 0x"); Serial.println(VAL_QT2120_CHIP_ID, HEX);
+  uint8_t id[QT2120Map::Id::count] = { 0, 0 };
 
-  // Get FW version
-  uint8_t versionByte = _ReadSingleReg(true, REG_QT2120_VERSION);
-  uint8_t versionMajor = (versionByte & 0xF0) >> 4;
-  uint8_t versionMinor = (versionByte & 0x0F);
-  Serial.print("Firmware version = "); Serial.print(versionMajor); Serial.print("."); Serial.println(versionMinor);
-
-  // Set touch integration
-  _WriteSingleReg(true, 11, 4); // TODO revisit these settings
+  ReadRegs(true, QT2120Map::Id::reg, sizeof(id), id);
+  _PrintId(log, "QT2120", id, VAL_QT2120_CHIP_ID);
+  if (!RegisterMapWrite(*_engine, QTOUCH2120_ADDR, QT2120_INIT))
+  {
+    log.println("WARNING: QT2120 settings were not all written");
+  }
+}
 
-  // Set drift hold time
-  _WriteSingleReg(true, 13, 3); // TODO revisit these settings
+/**************************************************************************/
+/*!
+    @brief    Print the chip ID and firmware version of an AT42QTx part
+    @param    log
+              Where to print
+    @param    name
+              Part name to print
+    @param    id
+              CHIP_ID and VERSION registers as read
+    @param    expectedChipId
+              Value CHIP_ID should hold
+*/
+/**************************************************************************/
+void QTouchBoard::_PrintId(Print &log, const char *name, const uint8_t *id, uint8_t expectedChipId)
+{
+  uint8_t versionMajor = (id[1] & 0xF0) >> 4;
+  uint8_t versionMinor = (id[1] & 0x0F);
 
-  // Set detect threshold
-  for (int i=0; i<12; i++)
-  {
-      _WriteSingleReg(true, 16+i, 19); // TODO revisit these settings
-  } 
+  log.print(name); log.print(" chipId = 0x"); log.print(id[0], HEX); log.print(", should be 0x"); log.println(expectedChipId, HEX);
+  log.print("Firmware version = "); log.print(versionMajor); log.print("."); log.println(versionMinor);
 }
 
 /**************************************************************************/
@@ -121,21 +159,204 @@ void QTouchBoard::_InitQT2120()
               True to communicate with QTOUCH2120_ADDR, else communicate with QTOUCH1070_ADDR 
     @param    reg
               Register address to read
-    @return   Value returned from I2C device at register address reg    
+    @return   Value returned from I2C device at register address reg, 0 if it did not answer
 */
 /**************************************************************************/
 uint8_t QTouchBoard::_ReadSingleReg(bool isQTouch2120, uint8_t reg)
 {
-  uint8_t i2cAddr = (isQTouch2120) ? QTOUCH2120_ADDR : QTOUCH1070_ADDR;
-  
-  _i2cStream->beginTransmission(i2cAddr);
-  _i2cStream->write(reg);
-  _i2cStream->endTransmission(false); // endTransmission but keep the connection active
+  uint8_t value = 0;
+
+  ReadRegs(isQTouch2120, reg, 1, &value);
+  return value;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Read count consecutive AT42QTx registers in a single I2C transaction
+    
+    Both AT42QT parts auto-increment their address pointer on reads, so
+    adjacent registers cost one address write plus one repeated-start read
+    instead of a full transaction each. Waits for the read, so for setup
+    code only; the engine's timeouts and retries bound the wait.
+    @param    isQTouch2120
+              True to communicate with QTOUCH2120_ADDR, else communicate with QTOUCH1070_ADDR 
+    @param    startReg
+              First register address to read
+    @param    count
+              Number of consecutive registers to read
+    @param    dest
+              Buffer of at least count bytes to hold the register values
+    @return   True if all count bytes were returned, else False
+*/
+/**************************************************************************/
+bool QTouchBoard::ReadRegs(bool isQTouch2120, uint8_t startReg, uint8_t count, uint8_t *dest)
+{
+  I2cTransaction txn;
+
+  txn.SetupRead((isQTouch2120) ? QTOUCH2120_ADDR : QTOUCH1070_ADDR, startReg, dest, count);
+  return _engine->Transfer(txn);
+}
+
+/**************************************************************************/
+/*!
+    @brief    Read the key status of both chips on this board in two burst transactions
+    
+    DETECTION_STATUS is read along with the key status bytes, which is what
+    releases each chip's CHANGE line.
+    @param    ks0
+              Output of AT42QT2120 status register LSB
+    @param    ks1
+              Output of AT42QT2120 status register MSB
+    @param    ks2
+              Output of AT42QT1070 status register
+*/
+/**************************************************************************/
+void QTouchBoard::ReadKeyStatus(uint8_t &ks0, uint8_t &ks1, uint8_t &ks2)
+{
+  ReadRegs(true, QT2120Map::Status::reg, sizeof(_qt2120Status), _qt2120Status);
+  ReadRegs(false, QT1070Map::Status::reg, sizeof(_qt1070Status), _qt1070Status);
+  _UnpackKeyStatus(ks0, ks1, ks2);
+}
+
+/**************************************************************************/
+/*!
+    @brief    Queue the two key status burst reads on engine without waiting for them
+    
+    The engine must drive the same bus this board was begin()-ed on.
+    @param    engine
+              I2cEngine for this board's bus
+    @param    changeMicros
+              Timestamp of the QTouchEvent that prompted the read, handed back by CollectKeys()
+    @return   True if queued, False if a previous read has not been collected yet
+*/
+/**************************************************************************/
+bool QTouchBoard::StartKeyStatusRead(I2cEngine &engine, uint32_t changeMicros)
+{
+  if (_isKeyStatusRequested)
+  {
+    return false;
+  }
+  _qt2120StatusTxn.SetupRead(QTOUCH2120_ADDR, QT2120Map::Status::reg, _qt2120Status, sizeof(_qt2120Status));
+  _qt1070StatusTxn.SetupRead(QTOUCH1070_ADDR, QT1070Map::Status::reg, _qt1070Status, sizeof(_qt1070Status));
+  engine.Submit(_qt2120StatusTxn);
+  engine.Submit(_qt1070StatusTxn);
+  _keyStatusMicros = changeMicros;
+  _isKeyStatusRequested = true;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Hand out the result of StartKeyStatusRead() once both reads finish
+    @param    keys
+              Output bitmap of every pad, see TouchPackKeys()
+    @param    changeMicros
+              Output timestamp given to StartKeyStatusRead()
+    @return   True exactly once per successful StartKeyStatusRead(), else False
+*/
+/**************************************************************************/
+bool QTouchBoard::CollectKeys(uint32_t &keys, uint32_t &changeMicros)
+{
+  uint8_t ks0, ks1, ks2;
+
+  if (!_isKeyStatusRequested || _qt2120StatusTxn.IsPending() || _qt1070StatusTxn.IsPending())
+  {
+    return false;
+  }
+  _isKeyStatusRequested = false;
+  if (!_qt2120StatusTxn.IsOk() || !_qt1070StatusTxn.IsOk())
+  {
+    return false;
+  }
+  _UnpackKeyStatus(ks0, ks1, ks2);
+  keys = TouchPackKeys(ks0, ks1, ks2);
+  changeMicros = _keyStatusMicros;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Queue burst reads of every key's signal and reference counts without waiting for them
+
+    Three reads in all, the AT42QT2120 block is split to keep each within
+    I2C_TXN_MAX_READ. Does nothing until EnableChangeInterrupts(), so a
+    board that is still booting or was left out is never read. The engine
+    must drive the same bus this board was begin()-ed on.
+    @param    engine
+              I2cEngine for this board's bus
+    @param    sampleMicros
+              Timestamp handed back by CollectRaw()
+    @return   True if queued, False if the board is not up or a previous read has not been collected yet
+*/
+/**************************************************************************/
+bool QTouchBoard::StartRawRead(I2cEngine &engine, uint32_t sampleMicros)
+{
+  if (_boardId >= QTOUCH_NUM_BOARDS || _isRawRequested)
+  {
+    return false;
+  }
+  _qt2120SignalTxn.SetupRead(QTOUCH2120_ADDR, QT2120Map::Signal::reg, _qt2120Raw, QT2120Map::Signal::count);
+  _qt2120ReferenceTxn.SetupRead(QTOUCH2120_ADDR, QT2120Map::Reference::reg, &_qt2120Raw[QT2120Map::Signal::count],
+                                QT2120Map::Reference::count);
+  _qt1070RawTxn.SetupRead(QTOUCH1070_ADDR, QT1070Map::Signal::reg, _qt1070Raw, sizeof(_qt1070Raw));
+  engine.Submit(_qt2120SignalTxn);
+  engine.Submit(_qt2120ReferenceTxn);
+  engine.Submit(_qt1070RawTxn);
+  _rawMicros = sampleMicros;
+  _isRawRequested = true;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Hand out the result of StartRawRead() once all its reads finish
+    @param    signal
+              Output of QTOUCH_RAW_NUM_KEYS key signal counts, the AT42QT2120's keys then the AT42QT1070's
+    @param    reference
+              Output of QTOUCH_RAW_NUM_KEYS reference counts in the same order
+    @param    sampleMicros
+              Output timestamp given to StartRawRead()
+    @return   True exactly once per successful StartRawRead(), else False
+*/
+/**************************************************************************/
+bool QTouchBoard::CollectRaw(uint16_t *signal, uint16_t *reference, uint32_t &sampleMicros)
+{
+  if (!_isRawRequested || _qt2120SignalTxn.IsPending() || _qt2120ReferenceTxn.IsPending() || _qt1070RawTxn.IsPending())
+  {
+    return false;
+  }
+  _isRawRequested = false;
+  if (!_qt2120SignalTxn.IsOk() || !_qt2120ReferenceTxn.IsOk() || !_qt1070RawTxn.IsOk())
+  {
+    return false;
+  }
 
-  _i2cStream->requestFrom((int) i2cAddr, 1); // Ask for 1 byte, once done, bus is released by default
+  const uint8_t *qt2120Reference = &_qt2120Raw[QT2120Map::Signal::count];
+  for (uint8_t k=0; k<QT2120_NUM_KEYS; k++)
+  {
+    signal[k] = _qt2120Raw[2 * k] | (_qt2120Raw[2 * k + 1] << 8);
+    reference[k] = qt2120Reference[2 * k] | (qt2120Reference[2 * k + 1] << 8);
+  }
+  const uint8_t *qt1070Reference = &_qt1070Raw[QT1070Map::Signal::count];
+  for (uint8_t k=0; k<QT1070_NUM_KEYS; k++)
+  {
+    signal[QT2120_NUM_KEYS + k] = (_qt1070Raw[2 * k] << 8) | _qt1070Raw[2 * k + 1];
+    reference[QT2120_NUM_KEYS + k] = (qt1070Reference[2 * k] << 8) | qt1070Reference[2 * k + 1];
+  }
+  sampleMicros = _rawMicros;
+  return true;
+}
 
-  while(!_i2cStream->available()) ; // Wait for the data to come back
-  return _i2cStream->read(); // Return this one byte
+/**************************************************************************/
+/*!
+    @brief    Pull the key status bytes out of the burst-read buffers
+*/
+/**************************************************************************/
+void QTouchBoard::_UnpackKeyStatus(uint8_t &ks0, uint8_t &ks1, uint8_t &ks2)
+{
+  ks0 = _qt2120Status[REG_QT2120_KEY_STATUS_0 - REG_QT2120_DETECTION_STATUS];
+  ks1 = _qt2120Status[REG_QT2120_KEY_STATUS_1 - REG_QT2120_DETECTION_STATUS];
+  ks2 = _qt1070Status[REG_QT1070_KEY_STATUS_0 - REG_QT1070_DETECTION_STATUS];
 }
 
 /**************************************************************************/
@@ -151,12 +372,10 @@ uint8_t QTouchBoard::_ReadSingleReg(bool isQTouch2120, uint8_t reg)
 /**************************************************************************/
 void QTouchBoard::_WriteSingleReg(bool isQTouch2120, uint8_t reg, uint8_t value)
 {
-  uint8_t i2cAddr = (isQTouch2120) ? QTOUCH2120_ADDR : QTOUCH1070_ADDR;
-  
-  _i2cStream->beginTransmission(i2cAddr);
-  _i2cStream->write(reg);
-  _i2cStream->write(value);
-  _i2cStream->endTransmission();
+  I2cTransaction txn;
+
+  txn.SetupWrite((isQTouch2120) ? QTOUCH2120_ADDR : QTOUCH1070_ADDR, reg, &value, 1);
+  _engine->Transfer(txn);
 }
 
 /**************************************************************************/
@@ -171,6 +390,123 @@ bool QTouchBoard::isValueUpdate()
   return (!digitalRead(_intPin1070) || !digitalRead(_intPin2120));
 }
 
+/**************************************************************************/
+/*!
+    @brief    Attach CHANGE line interrupts for both chips on this board
+    
+    Both AT42QT chips hold their active-low CHANGE line down until their
+    status is read, so a falling edge on either one means the board needs
+    service. Each edge pushes a timestamped QTouchEvent for PopEvent().
+    @param    boardId
+              QTOUCH_BOARD_FRET or QTOUCH_BOARD_STRUM, reported in the events
+    @return   True on success, False if boardId is invalid or already taken
+*/
+/**************************************************************************/
+bool QTouchBoard::EnableChangeInterrupts(uint8_t boardId)
+{
+  if (boardId >= QTOUCH_NUM_BOARDS || _boards[boardId] != NULL)
+  {
+    return false;
+  }
+  _boardId = boardId;
+  _boards[boardId] = this;
+
+  void (*isr)(void) = (boardId == QTOUCH_BOARD_FRET) ? _OnChangeFret : _OnChangeStrum;
+  attachInterrupt(digitalPinToInterrupt(_intPin1070), isr, FALLING);
+  attachInterrupt(digitalPinToInterrupt(_intPin2120), isr, FALLING);
+
+  // A line that was already low before attaching will never produce an edge
+  RearmIfAsserted();
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Queue a service event if a CHANGE line is still held low
+    
+    Call after servicing the board: a change that lands between reading the
+    status registers and the chip releasing its line produces no new edge.
+    Does nothing until EnableChangeInterrupts(), so a board that is still
+    booting is never read.
+*/
+/**************************************************************************/
+void QTouchBoard::RearmIfAsserted(void)
+{
+  if (_boardId >= QTOUCH_NUM_BOARDS)
+  {
+    return;
+  }
+  // Mask interrupts so this and the ISRs never act as producers at the same time
+  noInterrupts();
+  if (!_isServicePending && isValueUpdate())
+  {
+    _OnChange();
+  }
+  interrupts();
+}
+
+/**************************************************************************/
+/*!
+    @brief    Take the oldest pending service event from any board
+    @param    event
+              Destination for the popped event
+    @return   True if an event was popped, else False
+*/
+/**************************************************************************/
+bool QTouchBoard::PopEvent(QTouchEvent &event)
+{
+  if (!_events.Pop(event))
+  {
+    return false;
+  }
+  // Clear before the caller reads the chips so an edge during the read re-queues
+  _boards[event.boardId]->_isServicePending = false;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Record a service request for this board, called from interrupt context
+    
+    Only one event per board is outstanding at a time, so the ring can never
+    overflow and every board is guaranteed to be serviced after its first edge.
+*/
+/**************************************************************************/
+void QTouchBoard::_OnChange(void)
+{
+  if (_isServicePending)
+  {
+    return;
+  }
+  QTouchEvent event;
+  event.timestamp = micros();
+  event.boardId = _boardId;
+  if (_events.Push(event))
+  {
+    _isServicePending = true;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    ISR trampoline for the FretBoard CHANGE lines
+*/
+/**************************************************************************/
+void QTouchBoard::_OnChangeFret(void)
+{
+  _boards[QTOUCH_BOARD_FRET]->_OnChange();
+}
+
+/**************************************************************************/
+/*!
+    @brief    ISR trampoline for the StrumBoard CHANGE lines
+*/
+/**************************************************************************/
+void QTouchBoard::_OnChangeStrum(void)
+{
+  _boards[QTOUCH_BOARD_STRUM]->_OnChange();
+}
+
 /**************************************************************************/
 /*!
     @brief    Alias for reading register of QT2120
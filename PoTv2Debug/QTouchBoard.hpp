@@ -9,25 +9,91 @@
 #ifndef __QTOUCHBOARD_HPP__
 #define __QTOUCHBOARD_HPP__
 
-#include <Wire.h>
+#include <Arduino.h>
+#include "SpscRing.hpp"
+#include "TouchKeys.hpp"
+#include "I2cEngine.hpp"
+#include "RegisterMap.hpp"
 
 #define QTOUCH2120_ADDR  0x1C  ///< Static I2C address for AT42QT2120 part
 #define QTOUCH1070_ADDR  0x1B  ///< Static I2C address for AT42QT1070 part
+#define QTOUCH2120_MAX_CLOCK_HZ  400000  ///< Fastest SCL the AT42QT2120 is rated for
+#define QTOUCH1070_MAX_CLOCK_HZ  400000  ///< Fastest SCL the AT42QT1070 is rated for
 
 #define REG_QT1070_CHIP_ID 0  ///< AT42QT1070 CHIP_ID register
 #define VAL_QT1070_CHIP_ID 0x2E ///< AT42QT1070 Expected response for reading CHIP_ID register
 #define REG_QT1070_VERSION 1  ///< AT42QT1070 VERSION register
+#define REG_QT1070_DETECTION_STATUS 2  ///< AT42QT1070 DETECTION_STATUS register, directly precedes KEY_STATUS
 #define REG_QT1070_KEY_STATUS_0 3  ///< AT42QT1070 KEY_STATUS register
+#define REG_QT1070_KEY_SIGNAL  4  ///< AT42QT1070 first of QT1070_NUM_KEYS key signal registers, 16-bit MSB first
+#define REG_QT1070_REFERENCE  18  ///< AT42QT1070 first of QT1070_NUM_KEYS reference registers, 16-bit MSB first, directly follows the key signals
 
-#define REG_QT1070_INTEGRATION  46  ///< TODO figure out why this gets its own definition
-#define REG_QT1070_AVE_AKS  39  ///< TODO figure out why this gets its own definition
+#define REG_QT1070_AVE_AKS  39  ///< AT42QT1070 first of QT1070_NUM_KEYS AVE/AKS (averaging factor, adjacent key suppression) registers
+#define REG_QT1070_INTEGRATION  46  ///< AT42QT1070 first of QT1070_NUM_KEYS detection integrator registers
+#define REG_QT1070_LP_MODE  54  ///< AT42QT1070 LP_MODE register, measurement interval in 8ms steps
+#define QT1070_NUM_KEYS  7  ///< AT42QT1070 keys, each with its own AVE/AKS and integrator register
 
 #define REG_QT2120_CHIP_ID 0  ///< AT42QT2120 CHIP_ID register 
 #define VAL_QT2120_CHIP_ID 0x3E  ///< AT42QT2120 Expected response for reading CHIP_ID register
 #define REG_QT2120_VERSION 1  ///< AT42QT2120 VERSION register
+#define REG_QT2120_DETECTION_STATUS 2  ///< AT42QT2120 DETECTION_STATUS register, directly precedes KEY_STATUS
 #define REG_QT2120_KEY_STATUS_0 3  ///< AT42QT2120 KEY_STATUS register
 #define REG_QT2120_KEY_STATUS_1 4  ///< AT42QT2120 KEY_STATUS register
+#define REG_QT2120_DI  11  ///< AT42QT2120 DI register, detection integrator shared by all keys
+#define REG_QT2120_DHT  13  ///< AT42QT2120 DHT register, drift hold time
+#define REG_QT2120_DTHR  16  ///< AT42QT2120 first of QT2120_NUM_KEYS detect threshold registers
+#define REG_QT2120_KEY_SIGNAL  52  ///< AT42QT2120 first of QT2120_NUM_KEYS key signal registers, 16-bit LSB first
+#define REG_QT2120_REFERENCE  76  ///< AT42QT2120 first of QT2120_NUM_KEYS reference registers, 16-bit LSB first
+#define QT2120_NUM_KEYS  12  ///< AT42QT2120 keys, each with its own detect threshold register
 
+#define QTOUCH_BOARD_FRET  0  ///< Board ID used in QTouchEvent for the FretBoard
+#define QTOUCH_BOARD_STRUM  1  ///< Board ID used in QTouchEvent for the StrumBoard
+#define QTOUCH_NUM_BOARDS  2  ///< Number of QTouch boards that can raise change interrupts
+#define QTOUCH_EVENT_QUEUE_LEN  8  ///< Capacity of the ISR->loop event ring, must be a power of two
+#define QTOUCH_RAW_NUM_KEYS  (QT2120_NUM_KEYS + QT1070_NUM_KEYS)  ///< Keys of a board in raw reads, the AT42QT2120's first
+
+/**************************************************************************/
+/*!
+    @brief  AT42QT1070 registers QTouchBoard reads and sets up
+*/
+/**************************************************************************/
+struct QT1070Map
+{
+  typedef RegisterBlock<REG_QT1070_CHIP_ID, 2> Id;  ///< CHIP_ID and VERSION
+  typedef RegisterBlock<REG_QT1070_DETECTION_STATUS, 2> Status;  ///< DETECTION_STATUS and KEY_STATUS
+  typedef RegisterBlock<REG_QT1070_AVE_AKS, QT1070_NUM_KEYS> AveAks;  ///< Per-key AVE/AKS
+  typedef RegisterBlock<REG_QT1070_INTEGRATION, QT1070_NUM_KEYS> Integration;  ///< Per-key detection integrator
+  typedef RegisterBlock<REG_QT1070_LP_MODE> LowPowerMode;  ///< Measurement interval
+  typedef RegisterBlock<REG_QT1070_KEY_SIGNAL, 2 * QT1070_NUM_KEYS> Signal;  ///< Per-key signal counts
+  typedef RegisterBlock<REG_QT1070_REFERENCE, 2 * QT1070_NUM_KEYS> Reference;  ///< Per-key reference counts
+};
+
+/**************************************************************************/
+/*!
+    @brief  AT42QT2120 registers QTouchBoard reads and sets up
+*/
+/**************************************************************************/
+struct QT2120Map
+{
+  typedef RegisterBlock<REG_QT2120_CHIP_ID, 2> Id;  ///< CHIP_ID and VERSION
+  typedef RegisterBlock<REG_QT2120_DETECTION_STATUS, 3> Status;  ///< DETECTION_STATUS and both KEY_STATUS
+  typedef RegisterBlock<REG_QT2120_DI> Integration;  ///< Detection integrator
+  typedef RegisterBlock<REG_QT2120_DHT> DriftHold;  ///< Drift hold time
+  typedef RegisterBlock<REG_QT2120_DTHR, QT2120_NUM_KEYS> DetectThreshold;  ///< Per-key detect threshold
+  typedef RegisterBlock<REG_QT2120_KEY_SIGNAL, 2 * QT2120_NUM_KEYS> Signal;  ///< Per-key signal counts
+  typedef RegisterBlock<REG_QT2120_REFERENCE, 2 * QT2120_NUM_KEYS> Reference;  ///< Per-key reference counts
+};
+
+/**************************************************************************/
+/*!
+    @brief  "Board N needs service" notification produced by the CHANGE line ISRs
+*/
+/**************************************************************************/
+struct QTouchEvent
+{
+  uint32_t timestamp;  ///< micros() at the falling edge of the CHANGE line
+  uint8_t boardId;  ///< One of QTOUCH_BOARD_FRET/ QTOUCH_BOARD_STRUM
+};
 
 /**************************************************************************/
 /*!
@@ -41,21 +107,56 @@
 class QTouchBoard 
 {
   private:
-    TwoWire *_i2cStream;  ///< One of Wire/ Wire1 class for I2C
+    I2cEngine *_engine;  ///< Engine of the board's bus, Wire or Wire1
     int _intPin1070;  ///< GPIO interrupt pin for AT42QT1070
     int _intPin2120;  ///< GPIO interrupt pin for AT42QT2120
+    uint8_t _boardId;  ///< Board ID reported in QTouchEvents
+    volatile bool _isServicePending;  ///< True from the first edge until the event is popped
+
+    uint8_t _qt2120Status[QT2120Map::Status::count];  ///< Burst-read DETECTION_STATUS, KEY_STATUS_0, KEY_STATUS_1 of the AT42QT2120
+    uint8_t _qt1070Status[QT1070Map::Status::count];  ///< Burst-read DETECTION_STATUS, KEY_STATUS_0 of the AT42QT1070
+    I2cTransaction _qt2120StatusTxn;  ///< Async read of _qt2120Status
+    I2cTransaction _qt1070StatusTxn;  ///< Async read of _qt1070Status
+    bool _isKeyStatusRequested;  ///< True from StartKeyStatusRead() until CollectKeys() hands out the result
+    uint32_t _keyStatusMicros;  ///< Change timestamp passed to StartKeyStatusRead()
+
+    uint8_t _qt2120Raw[QT2120Map::Signal::count + QT2120Map::Reference::count];  ///< Key signal then reference registers of the AT42QT2120
+    uint8_t _qt1070Raw[QT1070Map::Signal::count + QT1070Map::Reference::count];  ///< Key signal then reference registers of the AT42QT1070
+    I2cTransaction _qt2120SignalTxn;  ///< Async read of the AT42QT2120 half of _qt2120Raw with the key signals
+    I2cTransaction _qt2120ReferenceTxn;  ///< Async read of the AT42QT2120 half of _qt2120Raw with the references
+    I2cTransaction _qt1070RawTxn;  ///< Async read of all of _qt1070Raw
+    bool _isRawRequested;  ///< True from StartRawRead() until CollectRaw() hands out the result
+    uint32_t _rawMicros;  ///< Sample timestamp passed to StartRawRead()
+
+    static QTouchBoard *_boards[QTOUCH_NUM_BOARDS];  ///< Boards indexed by ID for the ISR trampolines
+    static SpscRing<QTouchEvent, QTOUCH_EVENT_QUEUE_LEN> _events;  ///< Events from all boards, oldest first
+
+    static void _OnChangeFret(void);
+    static void _OnChangeStrum(void);
+    void _OnChange(void);
+    void _UnpackKeyStatus(uint8_t &ks0, uint8_t &ks1, uint8_t &ks2);
     
-    void _InitQT1070(void);
-    void _InitQT2120(void);
+    void _InitQT1070(Print &log);
+    void _InitQT2120(Print &log);
+    void _PrintId(Print &log, const char *name, const uint8_t *id, uint8_t expectedChipId);
     uint8_t _ReadSingleReg(bool isQTouch2120, uint8_t reg);
     void _WriteSingleReg(bool isQTouch2120, uint8_t reg, uint8_t value);  
     
   public:
     QTouchBoard(int int1070, int int2120);
-    void begin(TwoWire &inStream);
+    void begin(I2cEngine &engine, Print &log);
     ~QTouchBoard();
-    void initQTouch(void);
+    void initQTouch(Print &log);
     bool isValueUpdate(void);
+    bool ReadRegs(bool isQTouch2120, uint8_t startReg, uint8_t count, uint8_t *dest);
+    void ReadKeyStatus(uint8_t &ks0, uint8_t &ks1, uint8_t &ks2);
+    bool StartKeyStatusRead(I2cEngine &engine, uint32_t changeMicros);
+    bool CollectKeys(uint32_t &keys, uint32_t &changeMicros);
+    bool StartRawRead(I2cEngine &engine, uint32_t sampleMicros);
+    bool CollectRaw(uint16_t *signal, uint16_t *reference, uint32_t &sampleMicros);
+    bool EnableChangeInterrupts(uint8_t boardId);
+    void RearmIfAsserted(void);
+    static bool PopEvent(QTouchEvent &event);
     uint8_t QT2120ReadSingleReg(uint8_t reg);
     uint8_t QT1070ReadSingleReg(uint8_t reg);
     void QT1070WriteSingleReg(uint8_t reg, uint8_t value);
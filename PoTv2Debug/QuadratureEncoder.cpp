@@ -0,0 +1,171 @@
+/*!
+ * @file QuadratureEncoder.cpp
+ *
+ * \brief Table-driven quadrature decoding with acceleration in the pin interrupts
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#include <string.h>
+
+#include "QuadratureEncoder.hpp"
+
+QuadratureEncoder *QuadratureEncoder::_instance = NULL;
+
+// Count change for each (old AB << 2) | new AB. 00 -> 01 -> 11 -> 10 -> 00 counts up,
+// no change and both lines changing at once (a missed edge) count nothing
+static const int8_t QUADRATURE_TABLE[16] =
+{
+   0, +1, -1,  0,
+  -1,  0,  0, +1,
+  +1,  0,  0, -1,
+   0, -1, +1,  0
+};
+
+/**************************************************************************/
+/*!
+    @brief    Constructor for QuadratureEncoder, Begin() must be called before use
+    @param    pinA
+              A line of the encoder
+    @param    pinC
+              C line of the encoder
+*/
+/**************************************************************************/
+QuadratureEncoder::QuadratureEncoder(uint8_t pinA, uint8_t pinC)
+{
+  _pinA = pinA;
+  _pinC = pinC;
+  _prevAB = 0;
+  _position = ROT_ENC_MIN;
+  _isReversed = false;
+  _lastStep = 0;
+  memset(_edgeTimes, 0, sizeof(_edgeTimes));
+  _edgeIndex = 0;
+  _edgeCount = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Set up both lines and attach their interrupts
+*/
+/**************************************************************************/
+void QuadratureEncoder::Begin(void)
+{
+  _instance = this;
+  pinMode(_pinA, INPUT_PULLUP);
+  pinMode(_pinC, INPUT_PULLUP);
+  _prevAB = (digitalRead(_pinA) << 1) | digitalRead(_pinC);
+  attachInterrupt(digitalPinToInterrupt(_pinA), _OnEdge, CHANGE);
+  attachInterrupt(digitalPinToInterrupt(_pinC), _OnEdge, CHANGE);
+}
+
+/**************************************************************************/
+/*!
+    @brief    Choose which way of turning counts up, takes effect from the next edge
+    @param    isReversed
+              True counts down where the A/C wiring counts up
+*/
+/**************************************************************************/
+void QuadratureEncoder::SetReversed(bool isReversed)
+{
+  _isReversed = isReversed;
+}
+
+/**************************************************************************/
+/*!
+    @brief    ISR body: decode one line change and move the position
+
+    Public so the host benchmark can drive it without pin interrupts.
+    @param    ab
+              Line states now, A in bit 1 and C in bit 0
+    @param    now
+              micros() of the change
+*/
+/**************************************************************************/
+void QuadratureEncoder::Decode(uint8_t ab, uint32_t now)
+{
+  int8_t step = QUADRATURE_TABLE[(_prevAB << 2) | ab];
+  _prevAB = ab;
+  if (step == 0)
+  {
+    return;
+  }
+  if (_isReversed)
+  {
+    step = -step;
+  }
+
+  // A detent's worth of edges rather than the last edge alone, edges within a detent bunch up as it snaps
+  if (step != _lastStep)
+  {
+    _lastStep = step;
+    _edgeCount = 0;
+  }
+  uint32_t detentMicros = (_edgeCount == ROT_ENC_EDGES_PER_DETENT) ? now - _edgeTimes[_edgeIndex] : 0;
+  _edgeTimes[_edgeIndex] = now;
+  _edgeIndex = (_edgeIndex + 1) % ROT_ENC_EDGES_PER_DETENT;
+  if (_edgeCount < ROT_ENC_EDGES_PER_DETENT)
+  {
+    _edgeCount++;
+  }
+
+  int16_t count = 1;
+  if (detentMicros != 0 && detentMicros < ROT_ENC_ACCEL_FAST_US)
+  {
+    count = ROT_ENC_ACCEL_FAST_STEP;
+  }
+  else if (detentMicros != 0 && detentMicros < ROT_ENC_ACCEL_MEDIUM_US)
+  {
+    count = ROT_ENC_ACCEL_MEDIUM_STEP;
+  }
+  int16_t position = _position + step * count;
+  _position = (uint8_t) constrain(position, ROT_ENC_MIN, ROT_ENC_MAX);
+
+  QuadratureMotion motion;
+  motion.edgeMicros = now;
+  motion.detentMicros = step * (int32_t) detentMicros;
+  _motion.Publish(motion);
+}
+
+/**************************************************************************/
+/*!
+    @brief    Saturated position, a single byte so reading it needs no lock
+    @return   ROT_ENC_MIN to ROT_ENC_MAX
+*/
+/**************************************************************************/
+uint8_t QuadratureEncoder::GetPosition(void) const
+{
+  return _position;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Turning speed from the timing of the last detent
+    @return   Detents per second, negative when counting down, 0 when the
+              knob has been still for ROT_ENC_VELOCITY_STALE_US
+*/
+/**************************************************************************/
+int32_t QuadratureEncoder::GetVelocity(void) const
+{
+  QuadratureMotion motion;
+
+  _motion.Read(motion);
+  if (motion.detentMicros == 0 || micros() - motion.edgeMicros > ROT_ENC_VELOCITY_STALE_US)
+  {
+    return 0;
+  }
+  return 1000000L / motion.detentMicros;
+}
+
+/**************************************************************************/
+/*!
+    @brief    ISR for both lines, reads them and hands the change to the instance
+*/
+/**************************************************************************/
+void QuadratureEncoder::_OnEdge(void)
+{
+  if (_instance != NULL)
+  {
+    _instance->Decode((digitalRead(_instance->_pinA) << 1) | digitalRead(_instance->_pinC), micros());
+  }
+}
@@ -0,0 +1,72 @@
+/*!
+ * @file QuadratureEncoder.hpp
+ *
+ * \brief Header for the interrupt-driven rotary encoder decoder
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#ifndef __QUADRATURE_ENCODER_HPP__
+#define __QUADRATURE_ENCODER_HPP__
+
+#include <Arduino.h>
+#include "Seqlock.hpp"
+#include "SensorState.hpp"
+
+#define ROT_ENC_EDGES_PER_DETENT  4  ///< Quadrature edges between two detents of the knob
+#define ROT_ENC_ACCEL_FAST_US  20000  ///< Detents shorter than this, over 50 per second, move ROT_ENC_ACCEL_FAST_STEP per edge
+#define ROT_ENC_ACCEL_FAST_STEP  4  ///< Counts per edge of a fast spin
+#define ROT_ENC_ACCEL_MEDIUM_US  50000  ///< Detents shorter than this, over 20 per second, move ROT_ENC_ACCEL_MEDIUM_STEP per edge
+#define ROT_ENC_ACCEL_MEDIUM_STEP  2  ///< Counts per edge of a brisk turn
+#define ROT_ENC_VELOCITY_STALE_US  250000  ///< Velocity reads 0 once the newest edge is older than this
+
+/**************************************************************************/
+/*!
+    @brief  Timing of the newest decoded edge, published by the ISR
+*/
+/**************************************************************************/
+struct QuadratureMotion
+{
+  uint32_t edgeMicros;  ///< micros() of the newest edge
+  int32_t detentMicros;  ///< Time the last ROT_ENC_EDGES_PER_DETENT edges took, negative when counting down, 0 until a full detent
+};
+
+/**************************************************************************/
+/*!
+    @brief  Rotary encoder decoded entirely in its pin interrupts
+    Both lines interrupt on CHANGE and the ISR looks the old and new line
+    states up in a transition table, so bounces cancel out and impossible
+    double transitions are ignored. The ISR owns the position: it applies
+    the direction, accelerates by how long the last detent took, and
+    saturates at ROT_ENC_MIN..ROT_ENC_MAX, so the main loop never writes
+    back and only reads the one-byte position.
+*/
+/**************************************************************************/
+class QuadratureEncoder
+{
+  private:
+    uint8_t _pinA;  ///< A line, needs interrupt support
+    uint8_t _pinC;  ///< C line, needs interrupt support
+    uint8_t _prevAB;  ///< Line states at the last edge, A in bit 1 and C in bit 0
+    volatile uint8_t _position;  ///< Saturated count, written by the ISR only
+    volatile bool _isReversed;  ///< True counts down where the wiring counts up
+    int8_t _lastStep;  ///< Direction of the last edge, +1 or -1
+    uint32_t _edgeTimes[ROT_ENC_EDGES_PER_DETENT];  ///< micros() of the last edges in one direction, oldest at _edgeIndex
+    uint8_t _edgeIndex;  ///< Slot of _edgeTimes to overwrite next
+    uint8_t _edgeCount;  ///< Valid entries in _edgeTimes
+    SeqlockBuffer<QuadratureMotion> _motion;  ///< Newest edge timing for GetVelocity()
+
+    static QuadratureEncoder *_instance;  ///< Encoder served by the ISR trampoline
+
+    static void _OnEdge(void);
+
+  public:
+    QuadratureEncoder(uint8_t pinA, uint8_t pinC);
+    void Begin(void);
+    void SetReversed(bool isReversed);
+    void Decode(uint8_t ab, uint32_t now);
+    uint8_t GetPosition(void) const;
+    int32_t GetVelocity(void) const;
+};
+
+#endif  // __QUADRATURE_ENCODER_HPP__
@@ -0,0 +1,73 @@
+/*!
+ * @file RegisterMap.cpp
+ *
+ * \brief Table-driven register writes, coalesced into auto-increment bursts
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#include "RegisterMap.hpp"
+
+/**************************************************************************/
+/*!
+    @brief    Send one burst and wait for it
+    @return   True if the device took every byte
+*/
+/**************************************************************************/
+static bool FlushBurst(I2cEngine &engine, uint8_t addr, uint8_t startReg, const uint8_t *values, uint8_t len)
+{
+  I2cTransaction txn;
+
+  if (len == 0)
+  {
+    return true;
+  }
+  txn.SetupWrite(addr, startReg, values, len);
+  return engine.Transfer(txn);
+}
+
+/**************************************************************************/
+/*!
+    @brief    Write an init table in order, one burst per run of consecutive registers
+
+    The device must auto-increment its register pointer on writes, which
+    the AT42QT1070, AT42QT2120 and MMA8452Q all do. Bursts are split at
+    REGISTER_BURST_MAX, so RegisterBurstCount() gives the transaction count.
+    Waits for every burst, so for setup code only.
+    @param    engine
+              Engine of the device's bus
+    @param    addr
+              7-bit device address
+    @param    table
+              Entries in write order; a register may appear more than once
+    @param    count
+              Entries in table
+    @return   True if every burst was acknowledged, else False (later bursts are still sent)
+*/
+/**************************************************************************/
+bool RegisterMapWrite(I2cEngine &engine, uint8_t addr, const RegisterWrite *table, size_t count)
+{
+  uint8_t values[REGISTER_BURST_MAX];
+  uint8_t burstLen = 0;
+  uint8_t startReg = 0;
+  uint16_t nextReg = REGISTER_SPACE;
+  bool isOk = true;
+
+  for (size_t i=0; i<count; i++)
+  {
+    for (uint8_t r=0; r<table[i].count; r++)
+    {
+      uint16_t reg = table[i].reg + r;
+      if (reg != nextReg || burstLen == REGISTER_BURST_MAX)
+      {
+        isOk &= FlushBurst(engine, addr, startReg, values, burstLen);
+        startReg = (uint8_t) reg;
+        burstLen = 0;
+      }
+      values[burstLen++] = table[i].value;
+      nextReg = reg + 1;
+    }
+  }
+  isOk &= FlushBurst(engine, addr, startReg, values, burstLen);
+  return isOk;
+}
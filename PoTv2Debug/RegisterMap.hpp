@@ -0,0 +1,112 @@
+/*!
+ * @file RegisterMap.hpp
+ *
+ * \brief Compile-time register descriptors and table-driven burst init writes
+ *
+ * A device's registers are declared once as RegisterBlock types, and its
+ * init sequence as a table of RegisterWrite entries built from them.
+ * RegisterMapWrite() puts the table on the bus in order, merging every run
+ * of consecutive registers into one auto-increment burst, so a sequence of
+ * per-register settings costs one transaction per contiguous range.
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#ifndef __REGISTER_MAP_HPP__
+#define __REGISTER_MAP_HPP__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "I2cEngine.hpp"
+
+#define REGISTER_BURST_MAX  (I2C_TXN_MAX_WRITE - 1)  ///< Register values per burst write, the register address takes the first byte
+#define REGISTER_SPACE  256  ///< 8-bit register addresses
+
+/**************************************************************************/
+/*!
+    @brief  One init table entry: count consecutive registers from reg all set to value
+*/
+/**************************************************************************/
+struct RegisterWrite
+{
+  uint8_t reg;  ///< First register to write
+  uint8_t count;  ///< Consecutive registers set to value
+  uint8_t value;  ///< Value written to each of them
+};
+
+/**************************************************************************/
+/*!
+    @brief  Descriptor of one register, or of Count consecutive ones such as a per-key array
+*/
+/**************************************************************************/
+template <uint8_t Reg, uint8_t Count = 1>
+struct RegisterBlock
+{
+  static_assert(Count > 0 && Reg + Count <= REGISTER_SPACE, "register block must lie inside the 8-bit register space");
+
+  static constexpr uint8_t reg = Reg;  ///< First register
+  static constexpr uint8_t count = Count;  ///< Registers in the block
+
+  /**************************************************************************/
+  /*!
+      @brief    Address of one register of the block
+      @param    index
+                0 to Count - 1
+  */
+  /**************************************************************************/
+  static constexpr uint8_t At(uint8_t index) { return Reg + index; }
+
+  /**************************************************************************/
+  /*!
+      @brief    Init table entry setting every register of the block to value
+  */
+  /**************************************************************************/
+  static constexpr RegisterWrite Set(uint8_t value) { return RegisterWrite { Reg, Count, value }; }
+};
+
+/**************************************************************************/
+/*!
+    @brief    Number of bus transactions RegisterMapWrite() turns a table into
+    Lets a driver static_assert that its init table coalesces as intended.
+    @param    table
+              Entries in write order
+*/
+/**************************************************************************/
+template <size_t N>
+constexpr uint8_t RegisterBurstCount(const RegisterWrite (&table)[N])
+{
+  uint8_t bursts = 0;
+  uint16_t nextReg = REGISTER_SPACE;  // register the open burst would continue with, none yet
+  uint8_t burstLen = 0;
+
+  for (size_t i=0; i<N; i++)
+  {
+    for (uint8_t r=0; r<table[i].count; r++)
+    {
+      uint16_t reg = table[i].reg + r;
+      if (reg != nextReg || burstLen == REGISTER_BURST_MAX)
+      {
+        bursts++;
+        burstLen = 0;
+      }
+      nextReg = reg + 1;
+      burstLen++;
+    }
+  }
+  return bursts;
+}
+
+bool RegisterMapWrite(I2cEngine &engine, uint8_t addr, const RegisterWrite *table, size_t count);
+
+/**************************************************************************/
+/*!
+    @brief    RegisterMapWrite() for a whole table
+*/
+/**************************************************************************/
+template <size_t N>
+bool RegisterMapWrite(I2cEngine &engine, uint8_t addr, const RegisterWrite (&table)[N])
+{
+  return RegisterMapWrite(engine, addr, table, N);
+}
+
+#endif  // __REGISTER_MAP_HPP__
@@ -12,141 +12,184 @@
 
 #include "SensorState.hpp"
 #include "Ultrasonic.hpp"
+#include "ControlCurves.hpp"
+#include "TelemetryCodec.hpp"
+#include "TouchKeys.hpp"
 
+#define SCREEN_ROWS  13  ///< Lines in the TUI frame
+#define SCREEN_NUM_WIDTH  3  ///< Chars used by every unsigned byte field
+#define SCREEN_MILLI_G_WIDTH  5  ///< Chars used by every signed milli-g field
+#define STRUM_NUM_KEYS  4  ///< Strum keys shown in the TUI, bits of SensorSnapshot::key
+#define STRUM_PADS_PER_KEY  4  ///< Consecutive StrumBoard pads wired together as one key
+#define STRUM_KEY_PAD_MASK  ((1UL << STRUM_PADS_PER_KEY) - 1)  ///< Pads of strum key 0
+#define ANSI_CLEAR_HOME  "\x1b[2J\x1b[H"  ///< Erase display and move cursor to row 1, col 1
+
+///< Static TUI frame, numeric and checkbox cells are left blank and patched in from SCREEN_CELLS
+static const char * const SCREEN_FRAME[SCREEN_ROWS] = {
+  "+=============================================================================+",
+  "|                    * Paddle of Theseus v2 Debug Tool *                      |",
+  "|                                                                             |",
+  "|                        Written by Chase E. Stewart                          |",
+  "|                         For Hidden Layer Design                             |",
+  "|                                                                             |",
+  "+=============================================================================+",
+  "| Curr Fret:   / 19                 | Keys Pressed  3:[ ] 2:[ ] 1:[ ] 0:[ ]   |",
+  "+-----------------------------------+-----------------------------------------+",
+  "| RotEnc Value:     RotEnc SW: [ ]  | Potentiometer value:   /128             |",
+  "+------------ IMU (mg) -------------+-----------------------------------------+",
+  "| x:      y:      z:      Lefty:[ ] | Ultrasonic Distance:                    |",
+  "+===================================+=========================================+",
+};
+
+/**************************************************************************/
+/*!
+    @brief  Location of one value on the TUI frame
+*/
+/**************************************************************************/
+struct ScreenCell
+{
+  uint8_t row;  ///< 1-based terminal row
+  uint8_t col;  ///< 1-based terminal column
+  uint16_t field;  ///< SCREEN_FIELD_* this cell displays
+};
+
+///< Cells of SCREEN_FRAME, indexed by SCREEN_CELL_*
+static const ScreenCell SCREEN_CELLS[SCREEN_NUM_CELLS] = {
+  {  8, 13, SCREEN_FIELD_FRET },
+  {  8, 56, SCREEN_FIELD_KEYS },
+  {  8, 62, SCREEN_FIELD_KEYS },
+  {  8, 68, SCREEN_FIELD_KEYS },
+  {  8, 74, SCREEN_FIELD_KEYS },
+  { 10, 17, SCREEN_FIELD_ROT_ENC },
+  { 10, 33, SCREEN_FIELD_ROT_ENC_SW },
+  { 10, 59, SCREEN_FIELD_ROT_POT },
+  { 12,  5, SCREEN_FIELD_IMU },
+  { 12, 13, SCREEN_FIELD_IMU },
+  { 12, 21, SCREEN_FIELD_IMU },
+  { 12, 34, SCREEN_FIELD_LEFTY },
+  { 12, 60, SCREEN_FIELD_ULTRASONIC },
+};
+
+char SensorState::_screenBuf[SCREEN_BUF_LEN];
+static_assert(TELEMETRY_MAX_FRAME_LEN <= SCREEN_BUF_LEN, "Telemetry frames must fit the render buffer");
+
+
+/**************************************************************************/
+/*!
+    @brief    Bitmask of the screen fields that differ between two snapshots
+    @param    prev
+              Snapshot last shown
+    @param    curr
+              Newer snapshot
+    @return   SCREEN_FIELD_* values whose cells need redrawing
+*/
+/**************************************************************************/
+uint16_t SensorSnapshotDiff(const SensorSnapshot &prev, const SensorSnapshot &curr)
+{
+  uint16_t fields = 0;
+
+  if (prev.fret != curr.fret) fields |= SCREEN_FIELD_FRET;
+  if (prev.key != curr.key) fields |= SCREEN_FIELD_KEYS;
+  if (prev.rotEnc != curr.rotEnc) fields |= SCREEN_FIELD_ROT_ENC;
+  if (prev.rotEncSwitch != curr.rotEncSwitch) fields |= SCREEN_FIELD_ROT_ENC_SW;
+  if (prev.rotPot != curr.rotPot) fields |= SCREEN_FIELD_ROT_POT;
+  if ((prev.imuX != curr.imuX) || (prev.imuY != curr.imuY) || (prev.imuZ != curr.imuZ)) fields |= SCREEN_FIELD_IMU;
+  if (prev.isLefty != curr.isLefty) fields |= SCREEN_FIELD_LEFTY;
+  if ((prev.ultraDist != curr.ultraDist) || (prev.isUltraValid != curr.isUltraValid)) fields |= SCREEN_FIELD_ULTRASONIC;
+  return fields;
+}
 
 /**************************************************************************/
 /*!
     @brief    Create SensorState class and set variables to default values
+    @param    tx
+              Transmit ring for the TUI and telemetry
 */
 /**************************************************************************/
-SensorState::SensorState(void)
+SensorState::SensorState(SerialTx &tx) : _tx(tx)
 {
-  _fret = 0;
-  _prevFret = 0;
-  _key = 0;
-  _prevKey = 0;
-  _rotEncSwitch = false;
-  _prevRotEncSwitch = false;
-  _rotEnc = 0;
-  _prevRotEnc = 0;
-  _rotPot = 0;
-  _prevRotPot = 0;
-  _ultraDist = 0;
-  _prevUltraDist = 0;
-  _imuX = 0;
-  _imuY = 0;
-  _imuZ = 0;
-  _isScreenUpdate = false;
-  _isLefty = false;  
+  memset(&_live, 0, sizeof(_live));
+  _published.Publish(_live);
+  _shownSequence = _published.Read(_shown);
+  _forcedFields = 0;
+  _screenMode = SCREEN_MODE_DEFAULT;
+  _isFrameDrawn = false;
+  _txReplaced = 0;
+  _unsentBase = _shown;
+  _unsentForced = 0;
+  _wasFrameDrawn = false;
    pinMode(PIN_ROT_POT, INPUT);      
    pinMode(PIN_ROT_ENC_SW, INPUT);      
 }
 
+/**************************************************************************/
+/*!
+    @brief    Make _live visible to readers, called by the Update*() methods on a change
+*/
+/**************************************************************************/
+void SensorState::_Publish(void)
+{
+  _published.Publish(_live);
+}
+
  /**************************************************************************/
 /*!
-    @brief    Update _fret member with the highest fret currently pressed
-    @param    ks0
-              Output of AT42QT2120 status register LSB
-    @param    ks1
-              Output of AT42QT2120 status register MSB 
-    @param    ks2
-              Output of AT42QT1070 status register 
+    @brief    Update fret with the highest fret currently pressed
+    @param    keys
+              FretBoard bitmap from TouchPackKeys(), fret n in bit n-1
 */
 /**************************************************************************/
-void SensorState::UpdateFret(uint8_t ks0, uint8_t ks1, uint8_t ks2)
+void SensorState::UpdateFret(uint32_t keys)
 {
-  // Efficiently check FretBoard status registers for highest pressed fret
-  _fret = 0;
+  uint8_t fret = TouchHighestPad(keys);
 
-  if (ks2)
-  {
-    if (ks2 & 0x40) _fret = 19;
-    else if (ks2 & 0x20) _fret = 18;
-    else if (ks2 & 0x10) _fret = 17;
-    else if (ks2 & 0x08) _fret = 16;
-    else if (ks2 & 0x04) _fret = 15;
-    else if (ks2 & 0x02) _fret = 14;
-    else if (ks2 & 0x01) _fret = 13;
-  }
-  else if (ks1)
+  if (fret != _live.fret)
   {
-    if      (ks1 & 0x08) _fret = 12;
-    else if (ks1 & 0x04) _fret = 11;
-    else if (ks1 & 0x02) _fret = 10;
-    else if (ks1 & 0x01) _fret = 9;
-  }
-  else if (ks0)
-  {
-    if (ks0 & 0x80) _fret = 8;
-    else if (ks0 & 0x40) _fret = 7;
-    else if (ks0 & 0x20) _fret = 6;
-    else if (ks0 & 0x10) _fret = 5;
-    else if (ks0 & 0x08) _fret = 4;
-    else if (ks0 & 0x04) _fret = 3;
-    else if (ks0 & 0x02) _fret = 2;
-    else if (ks0 & 0x01) _fret = 1;
-    else _fret = 0;
-  }
-  if (_fret != _prevFret)
-  {
-    _isScreenUpdate = true;
-    _prevFret = _fret;
+    _live.fret = fret;
+    _Publish();
   }
 }
 
 /**************************************************************************/
 /*!
-    @brief    Update _key member with the set of keys currently pressed, if any
-    @param    ss0
-              Output of AT42QT2120 status register LSB
-    @param    ss1
-              Output of AT42QT2120 status register MSB 
-    @param    ss2
-              Output of AT42QT1070 status register 
+    @brief    Update key with the set of keys currently pressed, if any
+    @param    keys
+              StrumBoard bitmap from TouchPackKeys(), each key is a group of STRUM_PADS_PER_KEY pads
 */
 /**************************************************************************/
-void SensorState::UpdateStrumKey(uint8_t ss0, uint8_t ss1, uint8_t ss2)
+void SensorState::UpdateStrumKey(uint32_t keys)
 {
   uint8_t result = 0;
 
-  if (ss0 & 0x0F)
+  for (uint8_t key=0; key<STRUM_NUM_KEYS; key++)
   {
-    result |= 0x1;
+    if (keys & (STRUM_KEY_PAD_MASK << (key * STRUM_PADS_PER_KEY)))
+    {
+      result |= 1 << key;
+    }
   }
-  if ((ss0 >> 4) & 0x0F)
-  {
-    result |= 0x2;
-  } 
-  if (ss1 & 0x0F)
+  if (result != _live.key)
   {
-    result |= 0x4;
-  } 
-  if (ss2 & 0x0F)
-  {
-    result |= 0x8;
-  } 
-  _key = result;
-  if (_key != _prevKey);
-  {
-    _isScreenUpdate = true;
-    _prevKey = _key;
+    _live.key = result;
+    _Publish();
   }
 }
 
 /**************************************************************************/
 /*!
-    @brief    Read voltage val of rotary potentiometer and store value
+    @brief    Store position of rotary potentiometer, reversed while lefty flipped
+    @param    newValue
+              Filtered position from PotAdc, 0 to POT_VALUE_MAX
 */
 /**************************************************************************/
-void SensorState::UpdateRotPot(void)
+void SensorState::UpdateRotPot(uint8_t newValue)
 {
-  float intermediate = (this->GetIsLeftyFlipped()) ? floor((1024 - analogRead(PIN_ROT_POT)) * 127.0/1024.0) : floor(analogRead(PIN_ROT_POT) * 127.0/1024.0) ;
-  _rotPot = (uint8_t) intermediate;
+  uint8_t rotPot = POT_TO_CC.Map((this->GetIsLeftyFlipped()) ? (POT_VALUE_MAX - newValue) : newValue);
 
-  if (_rotPot != _prevRotPot)
+  if (rotPot != _live.rotPot)
   {
-    _isScreenUpdate = true;
-    _prevRotPot = _rotPot;
+    _live.rotPot = rotPot;
+    _Publish();
   }  
 }
 
@@ -157,26 +200,15 @@ void SensorState::UpdateRotPot(void)
 /**************************************************************************/
 void SensorState::UpdateRotEncSwitch(void)
 {
-  _rotEncSwitch = digitalRead(PIN_ROT_ENC_SW);
+  bool rotEncSwitch = digitalRead(PIN_ROT_ENC_SW);
  
-  if (_rotEncSwitch != _prevRotEncSwitch)
+  if (rotEncSwitch != _live.rotEncSwitch)
   {
-    _isScreenUpdate = true;
-    _prevRotEncSwitch = _rotEncSwitch;
+    _live.rotEncSwitch = rotEncSwitch;
+    _Publish();
   }
 }
 
-/**************************************************************************/
-/*!
-    @brief    Process and constrain output of Encoder.read()
-*/
-/**************************************************************************/
-int32_t SensorState::ProcessRotEnc(int32_t rotEncReading)
-{
-  int32_t rotEnc = (this->GetIsLeftyFlipped()) ? rotEncReading : (-1 * rotEncReading) ;
-  return constrain(rotEnc, 0,255);
-}
-
 /**************************************************************************/
 /*!
     @brief    Store value of Rotary Encoder knob
@@ -184,26 +216,30 @@ int32_t SensorState::ProcessRotEnc(int32_t rotEncReading)
 /**************************************************************************/
 void SensorState::UpdateRotEnc(uint8_t newValue)
 {   
-  _rotEnc=newValue;
-  if (_prevRotEnc != _rotEnc)
+  if (newValue != _live.rotEnc)
   {
-    _isScreenUpdate = true;
-    _prevRotEnc = _rotEnc;
+    _live.rotEnc = newValue;
+    _Publish();
   }
 }
 
 /**************************************************************************/
 /*!
-    @brief    Store value of Ultrasonic Rangefinder
+    @brief    Store value of Ultrasonic Rangefinder, scaled through ULTRA_CM_TO_CC
+    @param    rangeCm
+              Distance already median filtered by UltrasonicRanger, PITCH_BEND_MIN_CM to PITCH_BEND_MAX_CM
+    @param    isValid
+              False while the rangefinder has no recent echoes, rangeCm is then "no signal"
 */
 /**************************************************************************/
-void SensorState::UpdateUltrasonic(uint8_t newValue)
+void SensorState::UpdateUltrasonic(uint8_t rangeCm, bool isValid)
 {
-  _ultraDist = newValue;
-  if (_ultraDist != _prevUltraDist && abs(_ultraDist - _prevUltraDist) < MAX_PITCH_BEND_DELTA)
+  if (rangeCm != _live.ultraCm || isValid != _live.isUltraValid)
   {
-    _isScreenUpdate = true;
-    _prevUltraDist = _ultraDist;
+    _live.ultraCm = rangeCm;
+    _live.ultraDist = ULTRA_CM_TO_CC.Map(rangeCm);
+    _live.isUltraValid = isValid;
+    _Publish();
   }
 }
 
@@ -215,11 +251,10 @@ void SensorState::UpdateUltrasonic(uint8_t newValue)
 /**************************************************************************/
 void SensorState::SetIsLeftyFlipped(bool isFlipped)
 {
-  _isLefty = isFlipped;
-  if (_isLefty != _prevIsLefty)
+  if (isFlipped != _live.isLefty)
   {
-    _isScreenUpdate = true;
-    _prevIsLefty = _isLefty;  
+    _live.isLefty = isFlipped;
+    _Publish();
   }
 }
 
@@ -232,7 +267,7 @@ void SensorState::SetIsLeftyFlipped(bool isFlipped)
 /**************************************************************************/
 bool SensorState::GetIsLeftyFlipped(void)
 {
-  return _isLefty;
+  return _live.isLefty;
 }
 
 /**************************************************************************/
@@ -240,18 +275,14 @@ bool SensorState::GetIsLeftyFlipped(void)
     @brief    Update \{X, Y, Z\} variables from IMU
 */
 /**************************************************************************/
-void SensorState::UpdateXYZ(uint8_t x, uint8_t y, uint8_t z)
+void SensorState::UpdateXYZ(int16_t x, int16_t y, int16_t z)
 {
-  _imuX = x;
-  _imuY = y;
-  _imuZ = z;
-
-  if ((_imuX != _prevImuX) || (_imuY != _prevImuY) || (_imuZ != _prevImuZ))
+  if ((x != _live.imuX) || (y != _live.imuY) || (z != _live.imuZ))
   {
-    _isScreenUpdate = true;
-    _prevImuX = _imuX;
-    _prevImuY = _imuY;
-    _prevImuZ = _imuZ;    
+    _live.imuX = x;
+    _live.imuY = y;
+    _live.imuZ = z;
+    _Publish();
   }
 }
 
@@ -263,21 +294,263 @@ void SensorState::UpdateXYZ(uint8_t x, uint8_t y, uint8_t z)
 /**************************************************************************/
 uint8_t SensorState::GetRotEncValue(void)
 {
-  return _rotEnc;
+  return _live.rotEnc;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Take a consistent copy of the last published values, safe from any context
+    @param    snap
+              Destination for the copy
+    @return   Seqlock sequence of the copy, equal sequences mean equal snapshots
+*/
+/**************************************************************************/
+uint32_t SensorState::ReadSnapshot(SensorSnapshot &snap) const
+{
+  return _published.Read(snap);
+}
+
+/**************************************************************************/
+/*!
+    @brief    Sequence of the last published values, cheap check for whether ReadSnapshot() would return anything new
+*/
+/**************************************************************************/
+uint32_t SensorState::GetSnapshotSequence(void) const
+{
+  return _published.GetSequence();
+}
+
+
+/**************************************************************************/
+/*!
+    @brief    Choose how CheckUpdateScreen() draws the TUI
+    @param    mode
+              SCREEN_MODE_FULL to redraw the whole frame on every change,
+              SCREEN_MODE_DELTA to draw the frame once and then only send changed fields
+*/
+/**************************************************************************/
+void SensorState::SetScreenMode(uint8_t mode)
+{
+  _screenMode = mode;
+  _isFrameDrawn = false;
+  _forcedFields = SCREEN_FIELD_ALL;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Get the current TUI drawing mode
+    @return   SCREEN_MODE_FULL or SCREEN_MODE_DELTA
+*/
+/**************************************************************************/
+uint8_t SensorState::GetScreenMode(void)
+{
+  return _screenMode;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Send the current state as one COBS-framed binary telemetry packet
+    
+    Alternative to CheckUpdateScreen() for automated logging: every call emits
+    a packet whether or not anything changed, see TelemetryCodec.hpp for the layout.
+    @param    timestamp
+              micros() at which this sample was taken
+    @param    isResync
+              True to lead with a 0x00 so TUI text sent before it cannot
+              corrupt the frame; such a frame is never replaced
+    @return   True if the packet was queued
+*/
+/**************************************************************************/
+bool SensorState::SendTelemetry(uint32_t timestamp, bool isResync)
+{
+  SensorSnapshot values;
+  TelemetrySnapshot snap;
+  uint8_t payload[TELEMETRY_SNAPSHOT_LEN];
+
+  uint32_t sequence = ReadSnapshot(values);
+  snap.fret = values.fret;
+  snap.key = values.key;
+  snap.rotEnc = values.rotEnc;
+  snap.flags = (values.rotEncSwitch ? TELEMETRY_FLAG_ROT_ENC_SW : 0) | (values.isLefty ? TELEMETRY_FLAG_LEFTY : 0) |
+               (values.isUltraValid ? TELEMETRY_FLAG_ULTRA_VALID : 0);
+  snap.rotPot = values.rotPot;
+  snap.ultraDist = values.ultraDist;
+  snap.imuX = values.imuX;
+  snap.imuY = values.imuY;
+  snap.imuZ = values.imuZ;
+  snap.timestamp = timestamp;
+
+  size_t payloadLen = TelemetryPackSnapshot(snap, payload);
+  size_t frameLen = TelemetryEncodeFrame(payload, payloadLen, (uint8_t *) _screenBuf);
+  // A packet the host has not taken yet is stale, this one replaces it
+  _tx.BeginFrame();
+  if (isResync)
+  {
+    _tx.write((uint8_t) 0x00);
+  }
+  _tx.write((const uint8_t *) _screenBuf, frameLen);
+  bool isQueued = _tx.EndFrame(!isResync);
+
+  // Whatever changed has now been reported, and the TUI must redraw fully when re-entered
+  _shown = values;
+  _shownSequence = sequence;
+  _forcedFields = 0;
+  _isFrameDrawn = false;
+  _wasFrameDrawn = false;
+  _txReplaced = _tx.GetReplacedFrames();
+  return isQueued;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Convenience function equivalent of %3u with a leading zero below 10
+    @param    value
+              byte integer to format
+    @param    dest
+              Buffer to receive exactly SCREEN_NUM_WIDTH chars, not NUL-terminated
+*/
+/**************************************************************************/
+void SensorState::_FormatUint8_t(uint8_t value, char *dest)
+{
+  dest[0] = (value < 100) ? ' ' : ('0' + value / 100);
+  dest[1] = '0' + (value / 10) % 10;
+  dest[2] = '0' + value % 10;
 }
 
 /**************************************************************************/
 /*!
-    @brief    Convenience function equivalent of %02u
+    @brief    Convenience function equivalent of %5d, for milli-g values
     @param    value
-              byte integer to print 
+              Signed value to format, clamped to -9999..9999
+    @param    dest
+              Buffer to receive exactly SCREEN_MILLI_G_WIDTH chars, not NUL-terminated
+*/
+/**************************************************************************/
+void SensorState::_FormatInt16_t(int16_t value, char *dest)
+{
+  bool isNegative = (value < 0);
+  uint16_t magnitude = isNegative ? -value : value;
+  int8_t i = SCREEN_MILLI_G_WIDTH - 1;
+
+  if (magnitude > 9999)
+  {
+    magnitude = 9999;
+  }
+  do
+  {
+    dest[i--] = '0' + magnitude % 10;
+    magnitude /= 10;
+  } while (magnitude > 0);
+  if (isNegative)
+  {
+    dest[i--] = '-';
+  }
+  while (i >= 0)
+  {
+    dest[i--] = ' ';
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Format the value of one screen cell
+    @param    snap
+              Values to display
+    @param    cell
+              One of the SCREEN_CELL_* indices
+    @param    dest
+              Buffer to receive the cell text, not NUL-terminated
+    @return   Number of chars written
+*/
+/**************************************************************************/
+uint8_t SensorState::_FormatCell(const SensorSnapshot &snap, uint8_t cell, char *dest)
+{
+  switch (cell)
+  {
+    case SCREEN_CELL_FRET:       _FormatUint8_t(snap.fret, dest); return SCREEN_NUM_WIDTH;
+    case SCREEN_CELL_KEY3:       dest[0] = (snap.key & 0x8) ? 'x' : ' '; return 1;
+    case SCREEN_CELL_KEY2:       dest[0] = (snap.key & 0x4) ? 'x' : ' '; return 1;
+    case SCREEN_CELL_KEY1:       dest[0] = (snap.key & 0x2) ? 'x' : ' '; return 1;
+    case SCREEN_CELL_KEY0:       dest[0] = (snap.key & 0x1) ? 'x' : ' '; return 1;
+    case SCREEN_CELL_ROT_ENC:    _FormatUint8_t(snap.rotEnc, dest); return SCREEN_NUM_WIDTH;
+    case SCREEN_CELL_ROT_ENC_SW: dest[0] = (snap.rotEncSwitch) ? 'x' : ' '; return 1;
+    case SCREEN_CELL_ROT_POT:    _FormatUint8_t(snap.rotPot, dest); return SCREEN_NUM_WIDTH;
+    case SCREEN_CELL_IMU_X:      _FormatInt16_t(snap.imuX, dest); return SCREEN_MILLI_G_WIDTH;
+    case SCREEN_CELL_IMU_Y:      _FormatInt16_t(snap.imuY, dest); return SCREEN_MILLI_G_WIDTH;
+    case SCREEN_CELL_IMU_Z:      _FormatInt16_t(snap.imuZ, dest); return SCREEN_MILLI_G_WIDTH;
+    case SCREEN_CELL_LEFTY:      dest[0] = (snap.isLefty) ? 'x' : ' '; return 1;
+    case SCREEN_CELL_ULTRASONIC:
+      if (snap.isUltraValid)
+      {
+        _FormatUint8_t(snap.ultraDist, dest);
+      }
+      else
+      {
+        memset(dest, '-', SCREEN_NUM_WIDTH);
+      }
+      return SCREEN_NUM_WIDTH;
+    default: return 0;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Write the whole frame with the values of snap, one SerialTx write per line
+    @param    snap
+              Values to display
+*/
+/**************************************************************************/
+void SensorState::_RenderFull(const SensorSnapshot &snap)
+{
+  for (uint8_t row=1; row<=SCREEN_ROWS; row++)
+  {
+    uint8_t len = strlen(SCREEN_FRAME[row - 1]);
+    memcpy(_screenBuf, SCREEN_FRAME[row - 1], len);
+
+    for (uint8_t cell=0; cell<SCREEN_NUM_CELLS; cell++)
+    {
+      if (SCREEN_CELLS[cell].row == row)
+      {
+        _FormatCell(snap, cell, &_screenBuf[SCREEN_CELLS[cell].col - 1]);
+      }
+    }
+    _screenBuf[len++] = '\r';
+    _screenBuf[len++] = '\n';
+    _tx.write((const uint8_t *) _screenBuf, len);
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Send only the cells belonging to fields, each behind an ANSI cursor-position sequence
+    @param    snap
+              Values to display
+    @param    fields
+              Bitmask of SCREEN_FIELD_* values that changed since the last render
 */
 /**************************************************************************/
-void SensorState::_printUint8_t(uint8_t value)
+void SensorState::_RenderDelta(const SensorSnapshot &snap, uint16_t fields)
 {
-  Serial.print((value < 100) ? " " : ""); 
-  Serial.print((value < 10) ? "0" : ""); 
-  Serial.print(value, DEC);
+  uint8_t len = 0;
+
+  for (uint8_t cell=0; cell<SCREEN_NUM_CELLS; cell++)
+  {
+    if (!(SCREEN_CELLS[cell].field & fields))
+    {
+      continue;
+    }
+    // ESC [ row ; col H
+    _screenBuf[len++] = '\x1b';
+    _screenBuf[len++] = '[';
+    if (SCREEN_CELLS[cell].row >= 10) _screenBuf[len++] = '0' + SCREEN_CELLS[cell].row / 10;
+    _screenBuf[len++] = '0' + SCREEN_CELLS[cell].row % 10;
+    _screenBuf[len++] = ';';
+    if (SCREEN_CELLS[cell].col >= 10) _screenBuf[len++] = '0' + SCREEN_CELLS[cell].col / 10;
+    _screenBuf[len++] = '0' + SCREEN_CELLS[cell].col % 10;
+    _screenBuf[len++] = 'H';
+    len += _FormatCell(snap, cell, &_screenBuf[len]);
+  }
+  _tx.write((const uint8_t *) _screenBuf, len);
 }
 
 /**************************************************************************/
@@ -286,40 +559,71 @@ void SensorState::_printUint8_t(uint8_t value)
     
 This serial output is designed to be the only output on the screen
 and provide a user interface as opposed to a logfile format.
-The goal is to re-write this full output as quickly as possible whenever
+The goal is to re-write this output as quickly as possible whenever
 a variable changes, thus providing a responsive interface that lets a user
-benchmark the sensors by comparing printed screen values with sensor input
+benchmark the sensors by comparing printed screen values with sensor input.
+In SCREEN_MODE_DELTA the static frame is only drawn once and each later update
+sends just the changed fields, typically a few tens of bytes.
+Never waits on the host: if the previous update is still queued in the
+SerialTx it is replaced, and this one is diffed against what the terminal
+showed before it.
 */
 /**************************************************************************/
 void SensorState::CheckUpdateScreen(void)
 {
-  if (_isScreenUpdate)
+  SensorSnapshot snap;
+
+  if (!_forcedFields && GetSnapshotSequence() == _shownSequence && _tx.GetReplacedFrames() == _txReplaced)
   {
-    _isScreenUpdate = false;
-    Serial.print('\f');  // Wipe the screen output on compliant terminals before re-writing
-    Serial.println("+=============================================================================+");
-    Serial.println("|                    * Paddle of Theseus v2 Debug Tool *                      |");
-    Serial.println("|                                                                             |");
-    Serial.println("|                        Written by Chase E. Stewart                          |");
-    Serial.println("|                         For Hidden Layer Design                             |");
-    Serial.println("|                                                                             |");
-    Serial.println("+=============================================================================+");
-    Serial.print("| Curr Fret:"); _printUint8_t(_fret);
-    Serial.print("/ 19                 | ");
-    Serial.print("Keys Pressed  3:["); Serial.print((_key & 0x8) ? 'x' : ' '); Serial.print("] 2:["); 
-    Serial.print((_key & 0x4) ? 'x' : ' '); Serial.print("] 1:["); Serial.print((_key & 0x2) ? 'x' : ' '); 
-    Serial.print("] 0:["); Serial.print((_key & 0x1) ? 'x' : ' '); Serial.println("]   |");
-    Serial.println("+-----------------------------------+-----------------------------------------+");
-    Serial.print("| RotEnc Value: "); _printUint8_t(this->GetRotEncValue());
-    Serial.print(" RotEnc SW: ["); Serial.print((_rotEncSwitch) ? 'x' : ' '); Serial.print("]  | Potentiometer value:");
-    _printUint8_t(_rotPot); Serial.println("/128             |");
-    Serial.println("+-----------------------------------+-----------------------------------------+");
-    Serial.print("| IMU x:"); _printUint8_t(_imuX);
-    Serial.print(" y:"); _printUint8_t(_imuY);
-    Serial.print(" z:"); _printUint8_t(_imuZ);
-    Serial.print("  Lefty: ["); Serial.print((this->GetIsLeftyFlipped()) ? 'x' : ' ');
-    Serial.print("] | Ultrasonic Distance: "); _printUint8_t(_ultraDist);
-    Serial.println("                |");
-    Serial.println("+===================================+=========================================+");
-  }  
+    return;
+  }
+
+  _tx.BeginFrame();
+  if (_tx.GetReplacedFrames() != _txReplaced)
+  {
+    // The last frame never went out, the terminal still shows what preceded it
+    _shown = _unsentBase;
+    _forcedFields |= _unsentForced;
+    _isFrameDrawn = _isFrameDrawn && _wasFrameDrawn;
+    _txReplaced = _tx.GetReplacedFrames();
+  }
+  uint32_t sequence = ReadSnapshot(snap);
+  uint16_t fields = _forcedFields | SensorSnapshotDiff(_shown, snap);
+  if (!fields)
+  {
+    _tx.EndFrame();
+    _shownSequence = sequence;
+    return;
+  }
+
+  bool isFull = !(_screenMode == SCREEN_MODE_DELTA && _isFrameDrawn);
+  if (!isFull)
+  {
+    _RenderDelta(snap, fields);
+  }
+  else
+  {
+    // Wipe the screen output on compliant terminals before re-writing
+    if (_screenMode == SCREEN_MODE_DELTA)
+    {
+      _tx.write((const uint8_t *) ANSI_CLEAR_HOME, sizeof(ANSI_CLEAR_HOME) - 1);
+    }
+    else
+    {
+      _tx.write('\f');
+    }
+    _RenderFull(snap);
+  }
+  if (!_tx.EndFrame())
+  {
+    // No room while the host is behind, try again next call
+    return;
+  }
+  _unsentBase = _shown;
+  _unsentForced = _forcedFields;
+  _wasFrameDrawn = _isFrameDrawn;
+  _shown = snap;
+  _shownSequence = sequence;
+  _forcedFields = 0;
+  _isFrameDrawn = _isFrameDrawn || isFull;
 }
@@ -11,61 +11,126 @@
 
 #include <stdint.h>
 #include "BoardLayout.hpp"
+#include "Seqlock.hpp"
+#include "SerialTx.hpp"
 
 
 #define ROT_ENC_MIN 0  ///< Minimum value to constrain rotaryEncoder reading
 #define ROT_ENC_MAX 127  ///< Maximum value to constrain rotaryEncoder reading
 
+#define SCREEN_MODE_FULL   0  ///< Redraw the whole TUI frame on every change, needs only form-feed support
+#define SCREEN_MODE_DELTA  1  ///< Draw the frame once, then only changed fields via ANSI cursor positioning
+#define SCREEN_MODE_DEFAULT  SCREEN_MODE_DELTA  ///< Set to SCREEN_MODE_FULL for terminals without ANSI support
+
+#define SCREEN_FIELD_FRET        0x0001  ///< Dirty bit for SensorSnapshot::fret
+#define SCREEN_FIELD_KEYS        0x0002  ///< Dirty bit for SensorSnapshot::key
+#define SCREEN_FIELD_ROT_ENC     0x0004  ///< Dirty bit for SensorSnapshot::rotEnc
+#define SCREEN_FIELD_ROT_ENC_SW  0x0008  ///< Dirty bit for SensorSnapshot::rotEncSwitch
+#define SCREEN_FIELD_ROT_POT     0x0010  ///< Dirty bit for SensorSnapshot::rotPot
+#define SCREEN_FIELD_IMU         0x0020  ///< Dirty bit for SensorSnapshot::imuX, imuY, imuZ
+#define SCREEN_FIELD_LEFTY       0x0040  ///< Dirty bit for SensorSnapshot::isLefty
+#define SCREEN_FIELD_ULTRASONIC  0x0080  ///< Dirty bit for SensorSnapshot::ultraDist and isUltraValid, ultraCm changes with ultraDist
+#define SCREEN_FIELD_ALL         0x00FF  ///< Every dirty bit
+
+#define SCREEN_CELL_FRET        0   ///< Screen cell index of fret number
+#define SCREEN_CELL_KEY3        1   ///< Screen cell index of key 3 checkbox
+#define SCREEN_CELL_KEY2        2   ///< Screen cell index of key 2 checkbox
+#define SCREEN_CELL_KEY1        3   ///< Screen cell index of key 1 checkbox
+#define SCREEN_CELL_KEY0        4   ///< Screen cell index of key 0 checkbox
+#define SCREEN_CELL_ROT_ENC     5   ///< Screen cell index of rotary encoder value
+#define SCREEN_CELL_ROT_ENC_SW  6   ///< Screen cell index of rotary encoder switch checkbox
+#define SCREEN_CELL_ROT_POT     7   ///< Screen cell index of potentiometer value
+#define SCREEN_CELL_IMU_X       8   ///< Screen cell index of IMU x
+#define SCREEN_CELL_IMU_Y       9   ///< Screen cell index of IMU y
+#define SCREEN_CELL_IMU_Z       10  ///< Screen cell index of IMU z
+#define SCREEN_CELL_LEFTY       11  ///< Screen cell index of lefty checkbox
+#define SCREEN_CELL_ULTRASONIC  12  ///< Screen cell index of ultrasonic value
+#define SCREEN_NUM_CELLS        13  ///< Number of screen cells
+
+#define SCREEN_BUF_LEN  160  ///< Render buffer, fits one frame line, a delta of every cell or a telemetry frame
+
+/**************************************************************************/
+/*!
+    @brief  Every displayed sensor value at one instant, plain data so it can be copied whole
+*/
+/**************************************************************************/
+struct SensorSnapshot
+{
+  uint8_t fret;  ///< Number of fret currently pressed
+  uint8_t key;  ///< Bitfield of pressed strum keys
+  uint8_t rotEnc;  ///< Value of rotary encoder
+  bool rotEncSwitch;  ///< True if rotEnc switch currently pressed, else False
+  uint8_t rotPot;  ///< Value of rotary potentiometer
+  uint8_t ultraDist;  ///< Scaled distance from ultrasonic rangefinder
+  uint8_t ultraCm;  ///< Unscaled distance in cm, PITCH_BEND_MAX_CM for "no signal"
+  bool isUltraValid;  ///< True if ultraDist comes from recent echoes, else False
+  bool isLefty;  ///< True if Lefty mode is enabled, else False
+  int16_t imuX;  ///< X-value of IMU in milli-g
+  int16_t imuY;  ///< Y-value of IMU in milli-g
+  int16_t imuZ;  ///< Z-value of IMU in milli-g
+};
+
+uint16_t SensorSnapshotDiff(const SensorSnapshot &prev, const SensorSnapshot &curr);
+
 /**************************************************************************/
 /*!
     @brief  Class to keep and display all sensor values
     Displaying sensor values is the primary goal of this project, so
     the data conversions and checking for new values can be abstracted into
-    this class rather than busying up the main loop with globals and logic
+    this class rather than busying up the main loop with globals and logic.
+    The Update*() methods are the writer side: they edit a working snapshot
+    and publish it through a seqlock when a value changed. The TUI and
+    telemetry are readers: they take a consistent copy with ReadSnapshot()
+    and find what changed by diffing it against the last one they showed.
+    All Update*() calls must come from one context, ISR or main loop.
+    Output goes through a SerialTx, so a frame the host never took is
+    replaced by the next one and the TUI falls back to diffing against
+    what the terminal last received.
 */
 /**************************************************************************/
 class SensorState 
 {
-  // TODO turn this giant list of member vars to a pair of current/ prev structs
   private:
-    uint8_t _fret;  ///< Number of fret currently pressed
-    uint8_t _prevFret;  ///< Number of fret pressed last loop iter
-    uint8_t _key;  ///< Bitfield of pressed keys
-    uint8_t _prevKey;  ///< Bitfield of pressed keys from last loop iter
-    bool _rotEncSwitch;  ///< True if rotEnc switch currently pressed, else False
-    bool _prevRotEncSwitch;  ///< True if rotEnc switch pressed last loop iter, else False
-    uint8_t _rotEnc;  ///< Value of rotary encoder
-    uint8_t _prevRotEnc;  ///< Value of rotary encoder last loop iter
-    uint8_t _rotPot;  ///< Value of rotary potentiometer
-    uint8_t _prevRotPot;  ///< Value of rotary potentiometer
-    uint8_t _ultraDist;  ///< Distance in cm from ultrasonic rangefinder
-    uint8_t _prevUltraDist;  ///< Distance in cm from ultrasonic rangefinder
-    uint8_t _imuX;  ///< X-value of IMU
-    uint8_t _prevImuX;  ///< X-value of IMU last loop iter
-    uint8_t _imuY;  ///< Y-value of IMU
-    uint8_t _prevImuY;    ///< Y-value of IMU last loop iter
-    uint8_t _imuZ;  ///< Z-value of IMU
-    uint8_t _prevImuZ;  ///< Z-value of IMU last loop iter
-    bool _isScreenUpdate;  ///< True if screen should be updated this iter, else False
-    bool _isLefty;  ///< True if Lefty mode is enabled this Iter, else False
-    bool _prevIsLefty;  ///< True if Lefty mode was enabled last loop Iter, else False
+    SensorSnapshot _live;  ///< Writer-side working copy, newest values
+    SeqlockBuffer<SensorSnapshot> _published;  ///< _live as of the last publish, safe to read from any context
+    SensorSnapshot _shown;  ///< Snapshot the TUI last rendered
+    uint32_t _shownSequence;  ///< Seqlock sequence of _shown
+    uint16_t _forcedFields;  ///< SCREEN_FIELD_* values to redraw even if unchanged
+    uint8_t _screenMode;  ///< SCREEN_MODE_FULL or SCREEN_MODE_DELTA
+    bool _isFrameDrawn;  ///< True once the static frame has been drawn in SCREEN_MODE_DELTA
+    SerialTx &_tx;  ///< Transmit ring all output goes through
+    uint32_t _txReplaced;  ///< SerialTx::GetReplacedFrames() when the last frame was queued
+    SensorSnapshot _unsentBase;  ///< _shown before the last queued frame, restored if that frame is replaced
+    uint16_t _unsentForced;  ///< _forcedFields the last queued frame cleared
+    bool _wasFrameDrawn;  ///< _isFrameDrawn before the last queued frame
     
-    void _printUint8_t(uint8_t value);
+    static char _screenBuf[SCREEN_BUF_LEN];  ///< Shared render buffer for TUI text and encoded telemetry frames, written into SerialTx
+
+    void _Publish(void);
+    void _FormatUint8_t(uint8_t value, char *dest);
+    void _FormatInt16_t(int16_t value, char *dest);
+    uint8_t _FormatCell(const SensorSnapshot &snap, uint8_t cell, char *dest);
+    void _RenderFull(const SensorSnapshot &snap);
+    void _RenderDelta(const SensorSnapshot &snap, uint16_t fields);
     
   public:
-    SensorState(void);
-    void UpdateFret(uint8_t ks0, uint8_t ks1, uint8_t ks2);
-    void UpdateRotPot(void);
+    SensorState(SerialTx &tx);
+    void UpdateFret(uint32_t keys);
+    void UpdateRotPot(uint8_t newValue);
     void UpdateRotEncSwitch(void);
-    int32_t ProcessRotEnc(int32_t rotEncReading);
     void UpdateRotEnc(uint8_t newValue);
     uint8_t GetRotEncValue(void);
-    void UpdateStrumKey(uint8_t ss0, uint8_t ss1, uint8_t ss2);
-    void UpdateUltrasonic(uint8_t newValue);
+    void UpdateStrumKey(uint32_t keys);
+    void UpdateUltrasonic(uint8_t rangeCm, bool isValid);
+    uint32_t ReadSnapshot(SensorSnapshot &snap) const;
+    uint32_t GetSnapshotSequence(void) const;
     void CheckUpdateScreen(void);
+    void SetScreenMode(uint8_t mode);
+    uint8_t GetScreenMode(void);
+    bool SendTelemetry(uint32_t timestamp, bool isResync = false);
     void SetIsLeftyFlipped(bool isFlipped);
     bool GetIsLeftyFlipped(void);
-    void UpdateXYZ(uint8_t x, uint8_t y, uint8_t z);
+    void UpdateXYZ(int16_t x, int16_t y, int16_t z);
 };
 
 #endif  // __SENSORSTATE_HPP__
@@ -0,0 +1,91 @@
+/*!
+ * @file Seqlock.hpp
+ *
+ * \brief Double-buffered sequence lock for publishing plain-data snapshots
+ *
+ * One writer publishes whole values of T, any number of readers copy the
+ * latest one out without disabling interrupts. The writer fills the slot
+ * readers are not using, so it never waits; a reader only retries if the
+ * writer preempted it twice during its copy. The writer may be an ISR or
+ * the main loop but must be a single context, like the producer of a SpscRing.
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#ifndef __SEQLOCK_HPP__
+#define __SEQLOCK_HPP__
+
+#include <stdint.h>
+#include "SpscRing.hpp"
+
+/**************************************************************************/
+/*!
+    @brief  Latest published value of a plain-data type T
+    _seq advances by two per Publish() and is odd while a write is in
+    progress; bit 1 selects the slot holding the newest complete value.
+*/
+/**************************************************************************/
+template <typename T>
+class SeqlockBuffer
+{
+  private:
+    T _slots[2];  ///< Newest complete value and the slot being written
+    volatile uint32_t _seq;  ///< Write sequence, odd while Publish() is running
+
+  public:
+    SeqlockBuffer(void) : _slots(), _seq(0) { }
+
+    /**************************************************************************/
+    /*!
+        @brief    Make item the value readers see, writer side only
+        @param    item
+                  Value to copy into the idle slot
+    */
+    /**************************************************************************/
+    void Publish(const T &item)
+    {
+      uint32_t seq = _seq;
+      _seq = seq + 1;
+      SPSC_COMPILER_BARRIER();
+      _slots[((seq >> 1) + 1) & 1] = item;
+      SPSC_COMPILER_BARRIER();
+      _seq = seq + 2;
+    }
+
+    /**************************************************************************/
+    /*!
+        @brief    Copy out the newest complete value, retrying if it was overwritten meanwhile
+        @param    item
+                  Destination for the copy
+        @return   Sequence number of the copied value, see GetSequence()
+    */
+    /**************************************************************************/
+    uint32_t Read(T &item) const
+    {
+      uint32_t before;
+      uint32_t after;
+
+      do
+      {
+        before = _seq;
+        SPSC_COMPILER_BARRIER();
+        item = _slots[(before >> 1) & 1];
+        SPSC_COMPILER_BARRIER();
+        after = _seq;
+        // The copied slot is only rewritten by the second Publish() that starts after 'before'
+      } while ((uint32_t) (after - (before & ~1UL)) > 2);
+      return before & ~1UL;
+    }
+
+    /**************************************************************************/
+    /*!
+        @brief    Sequence of the newest complete value, changes on every Publish()
+    */
+    /**************************************************************************/
+    uint32_t GetSequence(void) const
+    {
+      return _seq & ~1UL;
+    }
+};
+
+#endif  // __SEQLOCK_HPP__
@@ -0,0 +1,216 @@
+/*!
+ * @file SerialTx.cpp
+ *
+ * \brief Non-blocking, frame-coalescing transmit ring in front of USB Serial
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#include "SerialTx.hpp"
+
+static_assert((SERIAL_TX_RING_LEN & (SERIAL_TX_RING_LEN - 1)) == 0, "SerialTx ring length must be a power of two");
+static_assert(SERIAL_TX_RING_LEN <= 32768, "SerialTx indices are 16-bit");
+
+/**************************************************************************/
+/*!
+    @brief    Constructor for SerialTx, starts empty with no frame open
+*/
+/**************************************************************************/
+SerialTx::SerialTx(void)
+{
+  _head = 0;
+  _tail = 0;
+  _frameStart = 0;
+  _isFrameOpen = false;
+  _isFrameOverflow = false;
+  _replaceableStart = 0;
+  _hasReplaceable = false;
+  _flushAt = 0;
+  _isFlushDue = false;
+  _replacedFrames = 0;
+  _droppedFrames = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Start a new frame, replacing the last one if none of it has gone out yet
+*/
+/**************************************************************************/
+void SerialTx::BeginFrame(void)
+{
+  if (_hasReplaceable && (int16_t) (_tail - _replaceableStart) <= 0)
+  {
+    _head = _replaceableStart;
+    _replacedFrames++;
+    if (_isFlushDue)
+    {
+      _flushAt = _head;
+    }
+  }
+  _hasReplaceable = false;
+  _frameStart = _head;
+  _isFrameOpen = true;
+  _isFrameOverflow = false;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Finish the open frame and make it eligible for transmission
+    @param    isReplaceable
+              True if a later frame supersedes this one, False for output that
+              must not be lost such as statistics printouts
+    @return   True if the frame was queued, False if it did not fit and was dropped
+*/
+/**************************************************************************/
+bool SerialTx::EndFrame(bool isReplaceable)
+{
+  _isFrameOpen = false;
+  if (_isFrameOverflow)
+  {
+    _head = _frameStart;
+    _droppedFrames++;
+    return false;
+  }
+  if (_head == _frameStart)
+  {
+    return true;
+  }
+  _replaceableStart = _frameStart;
+  _hasReplaceable = isReplaceable;
+  _flushAt = _head;
+  _isFlushDue = true;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Append one byte, see write(const uint8_t *, size_t)
+*/
+/**************************************************************************/
+size_t SerialTx::write(uint8_t c)
+{
+  return write(&c, 1);
+}
+
+/**************************************************************************/
+/*!
+    @brief    Append bytes to the open frame, or as their own unreplaceable output outside one
+    @param    buffer
+              Bytes to queue
+    @param    size
+              Number of bytes
+    @return   size if queued, 0 if the ring is full
+*/
+/**************************************************************************/
+size_t SerialTx::write(const uint8_t *buffer, size_t size)
+{
+  if (!_isFrameOpen)
+  {
+    // Whatever follows the last frame pins it in place
+    _hasReplaceable = false;
+  }
+  else if (_isFrameOverflow)
+  {
+    return 0;
+  }
+
+  if (size > (size_t) (SERIAL_TX_RING_LEN - (uint16_t) (_head - _tail)))
+  {
+    if (_isFrameOpen)
+    {
+      _isFrameOverflow = true;
+    }
+    else
+    {
+      _droppedFrames++;
+    }
+    return 0;
+  }
+
+  uint16_t offset = _head & (SERIAL_TX_RING_LEN - 1);
+  size_t firstLen = SERIAL_TX_RING_LEN - offset;
+  if (firstLen > size)
+  {
+    firstLen = size;
+  }
+  memcpy(&_buf[offset], buffer, firstLen);
+  memcpy(_buf, buffer + firstLen, size - firstLen);
+  _head += size;
+  return size;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Hand as much queued output to Serial as it can take without blocking, call every loop pass
+*/
+/**************************************************************************/
+void SerialTx::Service(void)
+{
+  while (_tail != _head)
+  {
+    int space = Serial.availableForWrite();
+    if (space <= 0)
+    {
+      break;
+    }
+    uint16_t offset = _tail & (SERIAL_TX_RING_LEN - 1);
+    uint16_t len = _head - _tail;
+    if (len > SERIAL_TX_RING_LEN - offset)
+    {
+      len = SERIAL_TX_RING_LEN - offset;
+    }
+    if (len > space)
+    {
+      len = space;
+    }
+    Serial.write(&_buf[offset], len);
+    _tail += len;
+  }
+
+  // One flush per frame end pushes out the partial last USB packet
+  if (_isFlushDue && (int16_t) (_tail - _flushAt) >= 0)
+  {
+    Serial.send_now();
+    _isFlushDue = false;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Bytes queued but not yet handed to Serial
+*/
+/**************************************************************************/
+uint16_t SerialTx::GetPending(void) const
+{
+  return _head - _tail;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Bytes that can be written without dropping anything
+*/
+/**************************************************************************/
+uint16_t SerialTx::GetFree(void) const
+{
+  return SERIAL_TX_RING_LEN - (uint16_t) (_head - _tail);
+}
+
+/**************************************************************************/
+/*!
+    @brief    Number of stale frames replaced before any of them went out
+*/
+/**************************************************************************/
+uint32_t SerialTx::GetReplacedFrames(void) const
+{
+  return _replacedFrames;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Number of frames or unframed writes dropped because they did not fit
+*/
+/**************************************************************************/
+uint32_t SerialTx::GetDroppedFrames(void) const
+{
+  return _droppedFrames;
+}
@@ -0,0 +1,58 @@
+/*!
+ * @file SerialTx.hpp
+ *
+ * \brief Non-blocking, frame-coalescing transmit ring in front of USB Serial
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#ifndef __SERIAL_TX_HPP__
+#define __SERIAL_TX_HPP__
+
+#include <Arduino.h>
+
+#define SERIAL_TX_RING_LEN  2048  ///< Bytes buffered for the host, a power of two that fits two full TUI frames
+
+/**************************************************************************/
+/*!
+    @brief  Transmit ring that never waits for the host
+    Output is written between BeginFrame() and EndFrame() into a fixed ring,
+    and Service() hands it to Serial only as fast as Serial.availableForWrite()
+    allows. A frame that has not started going out when the next one begins
+    is stale and gets replaced instead of queued behind. A frame that does
+    not fit is dropped whole. Serial.send_now() is called once each time the
+    end of a frame has been handed over, so Teensy USB serial fills whole
+    64-byte packets in between. All calls must come from the main loop.
+*/
+/**************************************************************************/
+class SerialTx : public Print
+{
+  private:
+    uint8_t _buf[SERIAL_TX_RING_LEN];  ///< Ring storage
+    uint16_t _head;  ///< Next byte to write, free-running
+    uint16_t _tail;  ///< Next byte to hand to Serial, free-running
+    uint16_t _frameStart;  ///< Start of the open frame
+    bool _isFrameOpen;  ///< True between BeginFrame() and EndFrame()
+    bool _isFrameOverflow;  ///< True once the open frame ran out of room
+    uint16_t _replaceableStart;  ///< Start of the last frame EndFrame() allowed to be replaced
+    bool _hasReplaceable;  ///< True while _replaceableStart is valid
+    uint16_t _flushAt;  ///< End of the newest frame, Serial.send_now() once _tail reaches it
+    bool _isFlushDue;  ///< True while _flushAt is still ahead of _tail
+    uint32_t _replacedFrames;  ///< Stale frames overwritten before they went out
+    uint32_t _droppedFrames;  ///< Frames or unframed writes that did not fit
+
+  public:
+    SerialTx(void);
+    void BeginFrame(void);
+    bool EndFrame(bool isReplaceable = true);
+    virtual size_t write(uint8_t c);
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    using Print::write;
+    void Service(void);
+    uint16_t GetPending(void) const;
+    uint16_t GetFree(void) const;
+    uint32_t GetReplacedFrames(void) const;
+    uint32_t GetDroppedFrames(void) const;
+};
+
+#endif  // __SERIAL_TX_HPP__
@@ -0,0 +1,108 @@
+/*!
+ * @file SpscRing.hpp
+ *
+ * \brief Lock-free single-producer/single-consumer ring buffer
+ *
+ * Used to hand data from interrupt handlers to the main loop without
+ * disabling interrupts. Exactly one context may call Push() and exactly
+ * one context may call Pop(); on a single-core Cortex-M this holds as long
+ * as all producers are ISRs of the same priority (they cannot preempt each other).
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#ifndef __SPSC_RING_HPP__
+#define __SPSC_RING_HPP__
+
+#include <stdint.h>
+
+///< \def SPSC_COMPILER_BARRIER()
+///< Keep the compiler from reordering buffer accesses across index updates.
+///< Cortex-M0+/M7 with a single core need no hardware barrier for this.
+#define SPSC_COMPILER_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+/**************************************************************************/
+/*!
+    @brief  Fixed-size SPSC queue of N elements of type T
+    N must be a power of two no larger than 128 so that the free-running
+    uint8_t head/tail indices wrap correctly
+*/
+/**************************************************************************/
+template <typename T, uint8_t N>
+class SpscRing
+{
+  static_assert(N > 0 && N <= 128, "SpscRing size must be 1..128");
+  static_assert((N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+  private:
+    T _buf[N];  ///< Element storage
+    volatile uint8_t _head;  ///< Next slot to write, only modified by producer
+    volatile uint8_t _tail;  ///< Next slot to read, only modified by consumer
+
+  public:
+    SpscRing(void) : _head(0), _tail(0) { }
+
+    /**************************************************************************/
+    /*!
+        @brief    Add an element to the ring, producer side only
+        @param    item
+                  Element to copy into the ring
+        @return   True if stored, False if the ring was full
+    */
+    /**************************************************************************/
+    bool Push(const T &item)
+    {
+      uint8_t head = _head;
+      if ((uint8_t)(head - _tail) >= N)
+      {
+        return false;
+      }
+      _buf[head & (N - 1)] = item;
+      SPSC_COMPILER_BARRIER();
+      _head = head + 1;
+      return true;
+    }
+
+    /**************************************************************************/
+    /*!
+        @brief    Remove the oldest element from the ring, consumer side only
+        @param    item
+                  Destination for the removed element
+        @return   True if an element was removed, False if the ring was empty
+    */
+    /**************************************************************************/
+    bool Pop(T &item)
+    {
+      uint8_t tail = _tail;
+      if (tail == _head)
+      {
+        return false;
+      }
+      item = _buf[tail & (N - 1)];
+      SPSC_COMPILER_BARRIER();
+      _tail = tail + 1;
+      return true;
+    }
+
+    /**************************************************************************/
+    /*!
+        @brief    Number of elements currently queued
+    */
+    /**************************************************************************/
+    uint8_t Count(void) const
+    {
+      return (uint8_t)(_head - _tail);
+    }
+
+    /**************************************************************************/
+    /*!
+        @brief    True if there is nothing to Pop()
+    */
+    /**************************************************************************/
+    bool IsEmpty(void) const
+    {
+      return _head == _tail;
+    }
+};
+
+#endif  // __SPSC_RING_HPP__
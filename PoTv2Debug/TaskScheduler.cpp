@@ -0,0 +1,248 @@
+/*!
+ * @file TaskScheduler.cpp
+ *
+ * \brief Cooperative micros()-driven task scheduler with per-task deadlines
+ *
+ * Every sensor used to be sampled once per loop() followed by delay(100), so the
+ * fastest sensors were held to the rate of the slowest one. Each sensor is now a
+ * task with its own period, and the scheduler reports overruns and the achieved
+ * rate of every task so the chosen periods can be checked on real hardware.
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#include "TaskScheduler.hpp"
+
+///< \def TIME_REACHED(now, t)
+///< True once micros() value now is at or past t, safe across the 32-bit wrap
+#define TIME_REACHED(now, t) ((int32_t) ((now) - (t)) >= 0)
+
+/**************************************************************************/
+/*!
+    @brief    Create a scheduler with no tasks
+*/
+/**************************************************************************/
+TaskScheduler::TaskScheduler(void)
+{
+  _numTasks = 0;
+  _statsStart = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Register a periodic task
+    @param    name
+              Short name used in the stats report, must be a string literal
+    @param    run
+              Task body
+    @param    periodMicros
+              Time between releases
+    @param    deadlineMicros
+              Task must finish within this long after its release, 0 means the period
+    @return   Task ID for SetTaskPeriod()/ StopTask()/ ResumeTask(), or SCHEDULER_INVALID_TASK if the table is full
+*/
+/**************************************************************************/
+int8_t TaskScheduler::AddTask(const char *name, TaskFunction run, uint32_t periodMicros, uint32_t deadlineMicros)
+{
+  if (_numTasks >= SCHEDULER_MAX_TASKS)
+  {
+    return SCHEDULER_INVALID_TASK;
+  }
+  SchedulerTask &task = _tasks[_numTasks];
+  task.name = name;
+  task.run = run;
+  task.nextRelease = 0;
+  task.isRunning = true;
+  SetTaskPeriod(_numTasks, periodMicros, deadlineMicros);
+  _numTasks++;
+  return _numTasks - 1;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Change the timing of a registered task, takes effect from its next release
+    @param    taskId
+              Value returned by AddTask()
+    @param    periodMicros
+              Time between releases
+    @param    deadlineMicros
+              Task must finish within this long after its release, 0 means the period
+*/
+/**************************************************************************/
+void TaskScheduler::SetTaskPeriod(int8_t taskId, uint32_t periodMicros, uint32_t deadlineMicros)
+{
+  if (taskId < 0 || taskId >= SCHEDULER_MAX_TASKS)
+  {
+    return;
+  }
+  _tasks[taskId].periodMicros = periodMicros;
+  _tasks[taskId].deadlineMicros = (deadlineMicros > 0) ? deadlineMicros : periodMicros;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Stop releasing a task until ResumeTask(), for tasks whose device is not up yet or is done
+    @param    taskId
+              Value returned by AddTask()
+*/
+/**************************************************************************/
+void TaskScheduler::StopTask(int8_t taskId)
+{
+  if (taskId < 0 || taskId >= _numTasks)
+  {
+    return;
+  }
+  _tasks[taskId].isRunning = false;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Release a stopped task now and at its period from then on
+    @param    taskId
+              Value returned by AddTask()
+*/
+/**************************************************************************/
+void TaskScheduler::ResumeTask(int8_t taskId)
+{
+  if (taskId < 0 || taskId >= _numTasks || _tasks[taskId].isRunning)
+  {
+    return;
+  }
+  _tasks[taskId].nextRelease = micros();
+  _tasks[taskId].isRunning = true;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Release every task now and start a fresh statistics window
+*/
+/**************************************************************************/
+void TaskScheduler::Start(void)
+{
+  uint32_t now = micros();
+  for (uint8_t i=0; i<_numTasks; i++)
+  {
+    _tasks[i].nextRelease = now;
+  }
+  ResetStats();
+}
+
+/**************************************************************************/
+/*!
+    @brief    Run the tasks that are due, earliest deadline first, then return
+*/
+/**************************************************************************/
+void TaskScheduler::RunPending(void)
+{
+  int8_t taskId;
+
+  // Bounded so an overloaded schedule still returns to loop() and lets the core service USB
+  for (uint8_t n=0; n<_numTasks; n++)
+  {
+    taskId = _NextDueTask(micros());
+    if (taskId == SCHEDULER_INVALID_TASK)
+    {
+      break;
+    }
+    SchedulerTask &task = _tasks[taskId];
+    uint32_t release = task.nextRelease;
+    uint32_t start = micros();
+
+    task.run();
+
+    uint32_t finish = micros();
+    uint32_t late = start - release;
+    uint32_t runtime = finish - start;
+
+    task.runCount++;
+    if (late > task.maxLateMicros) task.maxLateMicros = late;
+    if (runtime > task.maxRunMicros) task.maxRunMicros = runtime;
+    if (!TIME_REACHED(release + task.deadlineMicros, finish))
+    {
+      task.overrunCount++;
+    }
+
+    task.nextRelease = release + task.periodMicros;
+    if (TIME_REACHED(finish, task.nextRelease + task.periodMicros))
+    {
+      // More than a whole period behind: drop the missed releases and count them
+      uint32_t missed = (finish - task.nextRelease) / task.periodMicros;
+      task.overrunCount += missed;
+      task.nextRelease += missed * task.periodMicros;
+    }
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Clear run counts and worst-case times of every task
+*/
+/**************************************************************************/
+void TaskScheduler::ResetStats(void)
+{
+  for (uint8_t i=0; i<_numTasks; i++)
+  {
+    _tasks[i].runCount = 0;
+    _tasks[i].overrunCount = 0;
+    _tasks[i].maxLateMicros = 0;
+    _tasks[i].maxRunMicros = 0;
+  }
+  _statsStart = micros();
+}
+
+/**************************************************************************/
+/*!
+    @brief    Print period, achieved rate, overruns and worst-case times of every task
+    @param    out
+              Stream to print to, usually Serial
+*/
+/**************************************************************************/
+void TaskScheduler::PrintStats(Print &out)
+{
+  uint32_t elapsed = micros() - _statsStart;
+
+  out.println("task period_us target_hz actual_hz runs overruns max_late_us max_run_us");
+  for (uint8_t i=0; i<_numTasks; i++)
+  {
+    SchedulerTask &task = _tasks[i];
+    uint32_t actualHz = (elapsed > 0) ? (uint32_t) ((uint64_t) task.runCount * 1000000 / elapsed) : 0;
+
+    out.print(task.name); out.print(' ');
+    out.print(task.periodMicros); out.print(' ');
+    out.print(1000000 / task.periodMicros); out.print(' ');
+    out.print(actualHz); out.print(' ');
+    out.print(task.runCount); out.print(' ');
+    out.print(task.overrunCount); out.print(' ');
+    out.print(task.maxLateMicros); out.print(' ');
+    out.println(task.maxRunMicros);
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Find the due task with the earliest absolute deadline
+    @param    now
+              Current micros()
+    @return   Task ID, or SCHEDULER_INVALID_TASK if nothing is due
+*/
+/**************************************************************************/
+int8_t TaskScheduler::_NextDueTask(uint32_t now)
+{
+  int8_t best = SCHEDULER_INVALID_TASK;
+  uint32_t bestDeadline = 0;
+
+  for (uint8_t i=0; i<_numTasks; i++)
+  {
+    if (!_tasks[i].isRunning || !TIME_REACHED(now, _tasks[i].nextRelease))
+    {
+      continue;
+    }
+    uint32_t deadline = _tasks[i].nextRelease + _tasks[i].deadlineMicros;
+    if (best == SCHEDULER_INVALID_TASK || (int32_t) (deadline - bestDeadline) < 0)
+    {
+      best = i;
+      bestDeadline = deadline;
+    }
+  }
+  return best;
+}
@@ -0,0 +1,68 @@
+/*!
+ * @file TaskScheduler.hpp
+ *
+ * \brief Header for cooperative micros()-driven task scheduler with per-task deadlines
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#ifndef __TASK_SCHEDULER_HPP__
+#define __TASK_SCHEDULER_HPP__
+
+#include "Arduino.h"
+
+#define SCHEDULER_MAX_TASKS  10  ///< Max tasks that can be registered
+#define SCHEDULER_INVALID_TASK  -1  ///< Returned by AddTask() when the table is full
+
+typedef void (*TaskFunction)(void);  ///< Task body, must run to completion without blocking
+
+/**************************************************************************/
+/*!
+    @brief  One periodic task and its timing statistics
+*/
+/**************************************************************************/
+struct SchedulerTask
+{
+  const char *name;  ///< Short name used in the stats report
+  TaskFunction run;  ///< Task body
+  uint32_t periodMicros;  ///< Time between releases
+  uint32_t deadlineMicros;  ///< Task must finish within this long after its release
+  uint32_t nextRelease;  ///< micros() at which the task is next due
+  bool isRunning;  ///< False while stopped by StopTask(), never released
+  uint32_t runCount;  ///< Runs since the last ResetStats()
+  uint32_t overrunCount;  ///< Runs that finished after their deadline, or releases skipped entirely
+  uint32_t maxLateMicros;  ///< Worst delay between release and start
+  uint32_t maxRunMicros;  ///< Worst execution time
+};
+
+/**************************************************************************/
+/*!
+    @brief  Runs each registered task at its own period from loop()
+    RunPending() is non-preemptive earliest-deadline-first: whenever several
+    tasks are due, the one whose deadline is nearest runs first. Tasks that
+    fall more than a period behind skip the missed releases rather than
+    bursting to catch up.
+*/
+/**************************************************************************/
+class TaskScheduler
+{
+  private:
+    SchedulerTask _tasks[SCHEDULER_MAX_TASKS];  ///< Registered tasks
+    uint8_t _numTasks;  ///< Number of valid entries in _tasks
+    uint32_t _statsStart;  ///< micros() at the last ResetStats()
+
+    int8_t _NextDueTask(uint32_t now);
+
+  public:
+    TaskScheduler(void);
+    int8_t AddTask(const char *name, TaskFunction run, uint32_t periodMicros, uint32_t deadlineMicros);
+    void SetTaskPeriod(int8_t taskId, uint32_t periodMicros, uint32_t deadlineMicros);
+    void StopTask(int8_t taskId);
+    void ResumeTask(int8_t taskId);
+    void Start(void);
+    void RunPending(void);
+    void ResetStats(void);
+    void PrintStats(Print &out);
+};
+
+#endif  // __TASK_SCHEDULER_HPP__
@@ -0,0 +1,593 @@
+/*!
+ * @file TelemetryCodec.cpp
+ *
+ * \brief Binary telemetry packet layout, CRC16 and COBS framing
+ *
+ * Every packet is serialized to a payload whose first two bytes are the packet
+ * type and TELEMETRY_VERSION, a CRC16-CCITT of the payload is appended, and the
+ * result is COBS-encoded and terminated with a single 0x00. Because COBS never
+ * emits 0x00 inside a frame, a reader can join the stream at any point and
+ * resynchronize on the next delimiter.
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#include <string.h>
+
+#include "TelemetryCodec.hpp"
+
+static_assert(TELEMETRY_CAPTURE_BLOCK_OVERHEAD + CAPTURE_RECORD_MAX_LEN <= TELEMETRY_MAX_PAYLOAD,
+              "A capture block must hold at least one full record");
+static_assert(TELEMETRY_QTOUCH_RAW_LEN <= TELEMETRY_MAX_PAYLOAD, "A raw QTouch sample must fit one packet");
+
+/**************************************************************************/
+/*!
+    @brief    Store a 16-bit value little-endian
+*/
+/**************************************************************************/
+static void PutLe16(uint8_t *dest, uint16_t value)
+{
+  dest[0] = (uint8_t) value;
+  dest[1] = (uint8_t) (value >> 8);
+}
+
+/**************************************************************************/
+/*!
+    @brief    Store a 32-bit value little-endian
+*/
+/**************************************************************************/
+static void PutLe32(uint8_t *dest, uint32_t value)
+{
+  PutLe16(dest, (uint16_t) value);
+  PutLe16(dest + 2, (uint16_t) (value >> 16));
+}
+
+/**************************************************************************/
+/*!
+    @brief    Load a little-endian 16-bit value
+*/
+/**************************************************************************/
+static uint16_t GetLe16(const uint8_t *src)
+{
+  return (uint16_t) (src[0] | (src[1] << 8));
+}
+
+/**************************************************************************/
+/*!
+    @brief    Load a little-endian 32-bit value
+*/
+/**************************************************************************/
+static uint32_t GetLe32(const uint8_t *src)
+{
+  return (uint32_t) GetLe16(src) | ((uint32_t) GetLe16(src + 2) << 16);
+}
+
+/**************************************************************************/
+/*!
+    @brief    CRC16-CCITT (poly 0x1021, init 0xFFFF, no reflection)
+    @param    data
+              Bytes to checksum
+    @param    len
+              Number of bytes in data
+    @return   CRC of data
+*/
+/**************************************************************************/
+uint16_t TelemetryCrc16(const uint8_t *data, size_t len)
+{
+  uint16_t crc = 0xFFFF;
+
+  for (size_t i=0; i<len; i++)
+  {
+    crc ^= (uint16_t) data[i] << 8;
+    for (uint8_t bit=0; bit<8; bit++)
+    {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+    }
+  }
+  return crc;
+}
+
+/**************************************************************************/
+/*!
+    @brief    COBS-encode len bytes so the output contains no 0x00
+    @param    src
+              Bytes to encode
+    @param    len
+              Number of bytes in src
+    @param    dest
+              Buffer of at least COBS_MAX_ENCODED_LEN(len) bytes, must not overlap src
+    @return   Number of bytes written to dest, excluding any delimiter
+*/
+/**************************************************************************/
+size_t CobsEncode(const uint8_t *src, size_t len, uint8_t *dest)
+{
+  size_t readIndex = 0;
+  size_t writeIndex = 1;
+  size_t codeIndex = 0;
+  uint8_t code = 1;
+
+  while (readIndex < len)
+  {
+    if (src[readIndex] == 0)
+    {
+      dest[codeIndex] = code;
+      code = 1;
+      codeIndex = writeIndex++;
+      readIndex++;
+    }
+    else
+    {
+      dest[writeIndex++] = src[readIndex++];
+      code++;
+      if (code == 0xFF)
+      {
+        dest[codeIndex] = code;
+        code = 1;
+        codeIndex = writeIndex++;
+      }
+    }
+  }
+  dest[codeIndex] = code;
+  return writeIndex;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Decode one COBS frame, without its 0x00 delimiter
+    @param    src
+              Encoded bytes
+    @param    len
+              Number of bytes in src
+    @param    dest
+              Buffer of at least len bytes
+    @return   Number of decoded bytes, 0 if src is not valid COBS
+*/
+/**************************************************************************/
+size_t CobsDecode(const uint8_t *src, size_t len, uint8_t *dest)
+{
+  size_t readIndex = 0;
+  size_t writeIndex = 0;
+
+  while (readIndex < len)
+  {
+    uint8_t code = src[readIndex++];
+    if (code == 0)
+    {
+      return 0;
+    }
+    for (uint8_t i=1; i<code; i++)
+    {
+      if (readIndex >= len || src[readIndex] == 0)
+      {
+        return 0;
+      }
+      dest[writeIndex++] = src[readIndex++];
+    }
+    if (code != 0xFF && readIndex < len)
+    {
+      dest[writeIndex++] = 0;
+    }
+  }
+  return writeIndex;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Serialize a snapshot into a TELEMETRY_TYPE_SNAPSHOT payload
+    @param    snap
+              Sample to serialize
+    @param    payload
+              Buffer of at least TELEMETRY_SNAPSHOT_LEN bytes
+    @return   TELEMETRY_SNAPSHOT_LEN
+*/
+/**************************************************************************/
+size_t TelemetryPackSnapshot(const TelemetrySnapshot &snap, uint8_t *payload)
+{
+  payload[0] = TELEMETRY_TYPE_SNAPSHOT;
+  payload[1] = TELEMETRY_VERSION;
+  payload[2] = snap.fret;
+  payload[3] = snap.key;
+  payload[4] = snap.rotEnc;
+  payload[5] = snap.flags;
+  payload[6] = snap.rotPot;
+  payload[7] = snap.ultraDist;
+  payload[8] = (uint8_t) snap.imuX;
+  payload[9] = (uint8_t) ((uint16_t) snap.imuX >> 8);
+  payload[10] = (uint8_t) snap.imuY;
+  payload[11] = (uint8_t) ((uint16_t) snap.imuY >> 8);
+  payload[12] = (uint8_t) snap.imuZ;
+  payload[13] = (uint8_t) ((uint16_t) snap.imuZ >> 8);
+  payload[14] = (uint8_t) snap.timestamp;
+  payload[15] = (uint8_t) (snap.timestamp >> 8);
+  payload[16] = (uint8_t) (snap.timestamp >> 16);
+  payload[17] = (uint8_t) (snap.timestamp >> 24);
+  return TELEMETRY_SNAPSHOT_LEN;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Deserialize a TELEMETRY_TYPE_SNAPSHOT payload (CRC already stripped)
+    @param    payload
+              Decoded payload bytes
+    @param    len
+              Number of bytes in payload
+    @param    snap
+              Destination for the sample
+    @return   True if payload is a snapshot of this TELEMETRY_VERSION, else False
+*/
+/**************************************************************************/
+bool TelemetryUnpackSnapshot(const uint8_t *payload, size_t len, TelemetrySnapshot &snap)
+{
+  if (len != TELEMETRY_SNAPSHOT_LEN || payload[0] != TELEMETRY_TYPE_SNAPSHOT || payload[1] != TELEMETRY_VERSION)
+  {
+    return false;
+  }
+  snap.fret = payload[2];
+  snap.key = payload[3];
+  snap.rotEnc = payload[4];
+  snap.flags = payload[5];
+  snap.rotPot = payload[6];
+  snap.ultraDist = payload[7];
+  snap.imuX = (int16_t) (payload[8] | (payload[9] << 8));
+  snap.imuY = (int16_t) (payload[10] | (payload[11] << 8));
+  snap.imuZ = (int16_t) (payload[12] | (payload[13] << 8));
+  snap.timestamp = (uint32_t) payload[14] | ((uint32_t) payload[15] << 8) |
+                   ((uint32_t) payload[16] << 16) | ((uint32_t) payload[17] << 24);
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Bytes one capture record takes
+    @param    channels
+              CAPTURE_CHANNEL_* bits stored
+    @return   Record length, the 2-byte timestamp plus each enabled channel
+*/
+/**************************************************************************/
+size_t TelemetryCaptureRecordLen(uint8_t channels)
+{
+  size_t len = 2;
+
+  len += (channels & CAPTURE_CHANNEL_POT) ? 2 : 0;
+  len += (channels & CAPTURE_CHANNEL_ECHO) ? 2 : 0;
+  len += (channels & CAPTURE_CHANNEL_IMU) ? 6 : 0;
+  len += (channels & CAPTURE_CHANNEL_QTOUCH) ? 6 : 0;
+  return len;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Serialize the enabled channels of a sample into a capture record
+    @param    sample
+              Sample to serialize
+    @param    channels
+              CAPTURE_CHANNEL_* bits to store
+    @param    record
+              Buffer of at least TelemetryCaptureRecordLen(channels) bytes
+    @return   Number of bytes written
+*/
+/**************************************************************************/
+size_t TelemetryPackCaptureRecord(const CaptureSample &sample, uint8_t channels, uint8_t *record)
+{
+  uint8_t *dest = record;
+
+  PutLe16(dest, (uint16_t) sample.timestamp);
+  dest += 2;
+  if (channels & CAPTURE_CHANNEL_POT)
+  {
+    PutLe16(dest, sample.potRaw);
+    dest += 2;
+  }
+  if (channels & CAPTURE_CHANNEL_ECHO)
+  {
+    PutLe16(dest, sample.echoMicros);
+    dest += 2;
+  }
+  if (channels & CAPTURE_CHANNEL_IMU)
+  {
+    PutLe16(dest, (uint16_t) sample.imuX);
+    PutLe16(dest + 2, (uint16_t) sample.imuY);
+    PutLe16(dest + 4, (uint16_t) sample.imuZ);
+    dest += 6;
+  }
+  if (channels & CAPTURE_CHANNEL_QTOUCH)
+  {
+    // Key bitmaps are TOUCH_NUM_PADS = 19 bits, three bytes each
+    PutLe16(dest, (uint16_t) sample.fretKeys);
+    dest[2] = (uint8_t) (sample.fretKeys >> 16);
+    PutLe16(dest + 3, (uint16_t) sample.strumKeys);
+    dest[5] = (uint8_t) (sample.strumKeys >> 16);
+    dest += 6;
+  }
+  return dest - record;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Deserialize a capture record, channels not stored read as 0
+    @param    record
+              Bytes written by TelemetryPackCaptureRecord()
+    @param    channels
+              CAPTURE_CHANNEL_* bits the record holds
+    @param    sample
+              Destination, timestamp holds only the stored low 16 bits
+*/
+/**************************************************************************/
+void TelemetryUnpackCaptureRecord(const uint8_t *record, uint8_t channels, CaptureSample &sample)
+{
+  const uint8_t *src = record;
+
+  memset(&sample, 0, sizeof(sample));
+  sample.timestamp = GetLe16(src);
+  src += 2;
+  if (channels & CAPTURE_CHANNEL_POT)
+  {
+    sample.potRaw = GetLe16(src);
+    src += 2;
+  }
+  if (channels & CAPTURE_CHANNEL_ECHO)
+  {
+    sample.echoMicros = GetLe16(src);
+    src += 2;
+  }
+  if (channels & CAPTURE_CHANNEL_IMU)
+  {
+    sample.imuX = (int16_t) GetLe16(src);
+    sample.imuY = (int16_t) GetLe16(src + 2);
+    sample.imuZ = (int16_t) GetLe16(src + 4);
+    src += 6;
+  }
+  if (channels & CAPTURE_CHANNEL_QTOUCH)
+  {
+    sample.fretKeys = GetLe16(src) | ((uint32_t) src[2] << 16);
+    sample.strumKeys = GetLe16(src + 3) | ((uint32_t) src[5] << 16);
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Serialize a capture header into a TELEMETRY_TYPE_CAPTURE_HEADER payload
+    @param    header
+              Header to serialize
+    @param    payload
+              Buffer of at least TELEMETRY_CAPTURE_HEADER_LEN bytes
+    @return   TELEMETRY_CAPTURE_HEADER_LEN
+*/
+/**************************************************************************/
+size_t TelemetryPackCaptureHeader(const TelemetryCaptureHeader &header, uint8_t *payload)
+{
+  payload[0] = TELEMETRY_TYPE_CAPTURE_HEADER;
+  payload[1] = TELEMETRY_VERSION;
+  payload[2] = header.channels;
+  payload[3] = header.trigger;
+  PutLe32(&payload[4], header.periodMicros);
+  PutLe32(&payload[8], header.recordCount);
+  PutLe32(&payload[12], header.triggerIndex);
+  PutLe32(&payload[16], header.triggerTimestamp);
+  return TELEMETRY_CAPTURE_HEADER_LEN;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Deserialize a TELEMETRY_TYPE_CAPTURE_HEADER payload (CRC already stripped)
+    @param    payload
+              Decoded payload bytes
+    @param    len
+              Number of bytes in payload
+    @param    header
+              Destination for the header
+    @return   True if payload is a capture header of this TELEMETRY_VERSION, else False
+*/
+/**************************************************************************/
+bool TelemetryUnpackCaptureHeader(const uint8_t *payload, size_t len, TelemetryCaptureHeader &header)
+{
+  if (len != TELEMETRY_CAPTURE_HEADER_LEN || payload[0] != TELEMETRY_TYPE_CAPTURE_HEADER || payload[1] != TELEMETRY_VERSION)
+  {
+    return false;
+  }
+  header.channels = payload[2];
+  header.trigger = payload[3];
+  header.periodMicros = GetLe32(&payload[4]);
+  header.recordCount = GetLe32(&payload[8]);
+  header.triggerIndex = GetLe32(&payload[12]);
+  header.triggerTimestamp = GetLe32(&payload[16]);
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Serialize consecutive capture records into a TELEMETRY_TYPE_CAPTURE_BLOCK payload
+    @param    firstIndex
+              Index of the first record within the capture
+    @param    records
+              Packed records, count * recordLen bytes
+    @param    count
+              Number of records
+    @param    recordLen
+              TelemetryCaptureRecordLen() of the capture
+    @param    payload
+              Buffer of at least TELEMETRY_MAX_PAYLOAD bytes
+    @return   Payload length, 0 if the records do not fit
+*/
+/**************************************************************************/
+size_t TelemetryPackCaptureBlock(uint32_t firstIndex, const uint8_t *records, uint8_t count, size_t recordLen, uint8_t *payload)
+{
+  size_t len = TELEMETRY_CAPTURE_BLOCK_OVERHEAD + count * recordLen;
+
+  if (len > TELEMETRY_MAX_PAYLOAD)
+  {
+    return 0;
+  }
+  payload[0] = TELEMETRY_TYPE_CAPTURE_BLOCK;
+  payload[1] = TELEMETRY_VERSION;
+  PutLe32(&payload[2], firstIndex);
+  payload[6] = count;
+  memcpy(&payload[TELEMETRY_CAPTURE_BLOCK_OVERHEAD], records, count * recordLen);
+  return len;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Locate the records in a TELEMETRY_TYPE_CAPTURE_BLOCK payload (CRC already stripped)
+    @param    payload
+              Decoded payload bytes
+    @param    len
+              Number of bytes in payload
+    @param    recordLen
+              TelemetryCaptureRecordLen() from the capture header
+    @param    firstIndex
+              Destination for the index of the first record
+    @param    count
+              Destination for the number of records
+    @param    records
+              Set to the first record inside payload
+    @return   True if payload is a capture block of this TELEMETRY_VERSION and recordLen, else False
+*/
+/**************************************************************************/
+bool TelemetryUnpackCaptureBlock(const uint8_t *payload, size_t len, size_t recordLen,
+                                 uint32_t &firstIndex, uint8_t &count, const uint8_t *&records)
+{
+  if (len < TELEMETRY_CAPTURE_BLOCK_OVERHEAD || payload[0] != TELEMETRY_TYPE_CAPTURE_BLOCK ||
+      payload[1] != TELEMETRY_VERSION || len != TELEMETRY_CAPTURE_BLOCK_OVERHEAD + payload[6] * recordLen)
+  {
+    return false;
+  }
+  firstIndex = GetLe32(&payload[2]);
+  count = payload[6];
+  records = &payload[TELEMETRY_CAPTURE_BLOCK_OVERHEAD];
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Serialize a raw QTouch sample into a TELEMETRY_TYPE_QTOUCH_RAW payload
+    @param    raw
+              Sample to serialize
+    @param    payload
+              Buffer of at least TELEMETRY_QTOUCH_RAW_LEN bytes
+    @return   Payload length
+*/
+/**************************************************************************/
+size_t TelemetryPackQTouchRaw(const TelemetryQTouchRaw &raw, uint8_t *payload)
+{
+  uint8_t *reference = &payload[8 + 2 * TELEMETRY_QTOUCH_RAW_KEYS];
+
+  payload[0] = TELEMETRY_TYPE_QTOUCH_RAW;
+  payload[1] = TELEMETRY_VERSION;
+  payload[2] = raw.board;
+  payload[3] = raw.sequence;
+  PutLe32(&payload[4], raw.timestamp);
+  for (uint8_t k=0; k<TELEMETRY_QTOUCH_RAW_KEYS; k++)
+  {
+    PutLe16(&payload[8 + 2 * k], raw.signal[k]);
+    PutLe16(&reference[2 * k], raw.reference[k]);
+  }
+  return TELEMETRY_QTOUCH_RAW_LEN;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Deserialize a TELEMETRY_TYPE_QTOUCH_RAW payload (CRC already stripped)
+    @param    payload
+              Decoded payload bytes
+    @param    len
+              Number of bytes in payload
+    @param    raw
+              Destination for the sample
+    @return   True if payload is a raw QTouch sample of this TELEMETRY_VERSION, else False
+*/
+/**************************************************************************/
+bool TelemetryUnpackQTouchRaw(const uint8_t *payload, size_t len, TelemetryQTouchRaw &raw)
+{
+  const uint8_t *reference = &payload[8 + 2 * TELEMETRY_QTOUCH_RAW_KEYS];
+
+  if (len != TELEMETRY_QTOUCH_RAW_LEN || payload[0] != TELEMETRY_TYPE_QTOUCH_RAW || payload[1] != TELEMETRY_VERSION)
+  {
+    return false;
+  }
+  raw.board = payload[2];
+  raw.sequence = payload[3];
+  raw.timestamp = GetLe32(&payload[4]);
+  for (uint8_t k=0; k<TELEMETRY_QTOUCH_RAW_KEYS; k++)
+  {
+    raw.signal[k] = GetLe16(&payload[8 + 2 * k]);
+    raw.reference[k] = GetLe16(&reference[2 * k]);
+  }
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Serialize a touch event into a TELEMETRY_TYPE_TOUCH_EVENT payload
+    @param    event
+              Event to serialize
+    @param    payload
+              Buffer of at least TELEMETRY_TOUCH_EVENT_LEN bytes
+    @return   Payload length
+*/
+/**************************************************************************/
+size_t TelemetryPackTouchEvent(const TelemetryTouchEvent &event, uint8_t *payload)
+{
+  payload[0] = TELEMETRY_TYPE_TOUCH_EVENT;
+  payload[1] = TELEMETRY_VERSION;
+  payload[2] = event.board;
+  payload[3] = event.pad;
+  payload[4] = event.isPress ? 1 : 0;
+  PutLe32(&payload[5], event.timestamp);
+  return TELEMETRY_TOUCH_EVENT_LEN;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Deserialize a TELEMETRY_TYPE_TOUCH_EVENT payload (CRC already stripped)
+    @param    payload
+              Decoded payload bytes
+    @param    len
+              Number of bytes in payload
+    @param    event
+              Destination for the event
+    @return   True if payload is a touch event of this TELEMETRY_VERSION, else False
+*/
+/**************************************************************************/
+bool TelemetryUnpackTouchEvent(const uint8_t *payload, size_t len, TelemetryTouchEvent &event)
+{
+  if (len != TELEMETRY_TOUCH_EVENT_LEN || payload[0] != TELEMETRY_TYPE_TOUCH_EVENT || payload[1] != TELEMETRY_VERSION)
+  {
+    return false;
+  }
+  event.board = payload[2];
+  event.pad = payload[3];
+  event.isPress = (payload[4] != 0);
+  event.timestamp = GetLe32(&payload[5]);
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Append CRC16 to payload, COBS-encode it and terminate with 0x00
+    @param    payload
+              Serialized packet, at most TELEMETRY_MAX_PAYLOAD bytes
+    @param    len
+              Number of bytes in payload
+    @param    frame
+              Buffer of at least TELEMETRY_MAX_FRAME_LEN bytes
+    @return   Number of bytes to send, 0 if payload is too long
+*/
+/**************************************************************************/
+size_t TelemetryEncodeFrame(const uint8_t *payload, size_t len, uint8_t *frame)
+{
+  uint8_t raw[TELEMETRY_MAX_PAYLOAD + TELEMETRY_CRC_LEN];
+
+  if (len > TELEMETRY_MAX_PAYLOAD)
+  {
+    return 0;
+  }
+  memcpy(raw, payload, len);
+  uint16_t crc = TelemetryCrc16(payload, len);
+  raw[len] = (uint8_t) crc;
+  raw[len + 1] = (uint8_t) (crc >> 8);
+
+  size_t frameLen = CobsEncode(raw, len + TELEMETRY_CRC_LEN, frame);
+  frame[frameLen++] = 0x00;
+  return frameLen;
+}
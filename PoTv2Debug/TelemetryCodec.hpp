@@ -0,0 +1,175 @@
+/*!
+ * @file TelemetryCodec.hpp
+ *
+ * \brief Header for binary telemetry packet layout, CRC16 and COBS framing
+ *
+ * Shared verbatim between the firmware and the host-side decoder, so it must
+ * stay free of Arduino dependencies.
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#ifndef __TELEMETRY_CODEC_HPP__
+#define __TELEMETRY_CODEC_HPP__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define TELEMETRY_TYPE_SNAPSHOT  0x01  ///< Packet type of a SensorState snapshot
+#define TELEMETRY_TYPE_CAPTURE_HEADER  0x02  ///< Packet type that starts a capture dump, see TelemetryCaptureHeader
+#define TELEMETRY_TYPE_CAPTURE_BLOCK  0x03  ///< Packet type carrying consecutive capture records
+#define TELEMETRY_TYPE_QTOUCH_RAW  0x04  ///< Packet type carrying one board's per-key QTouch signal and reference counts
+#define TELEMETRY_TYPE_TOUCH_EVENT  0x05  ///< Packet type carrying one pad press or release
+#define TELEMETRY_VERSION  2  ///< Bump whenever the layout of an existing packet type changes
+
+#define TELEMETRY_FLAG_ROT_ENC_SW  0x01  ///< Snapshot flags bit: rotary encoder switch pressed
+#define TELEMETRY_FLAG_LEFTY       0x02  ///< Snapshot flags bit: paddle is lefty flipped
+#define TELEMETRY_FLAG_ULTRA_VALID 0x04  ///< Snapshot flags bit: ultraDist comes from recent echoes
+
+#define TELEMETRY_SNAPSHOT_LEN  18  ///< Serialized snapshot payload bytes, excluding CRC
+#define TELEMETRY_CAPTURE_HEADER_LEN  20  ///< Serialized capture header payload bytes, excluding CRC
+#define TELEMETRY_CAPTURE_BLOCK_OVERHEAD  7  ///< Capture block payload bytes ahead of the records
+#define TELEMETRY_QTOUCH_RAW_KEYS  19  ///< Keys per raw QTouch packet, the AT42QT2120's 12 then the AT42QT1070's 7
+#define TELEMETRY_QTOUCH_RAW_LEN  (8 + 4 * TELEMETRY_QTOUCH_RAW_KEYS)  ///< Serialized raw QTouch payload bytes, excluding CRC
+#define TELEMETRY_TOUCH_EVENT_LEN  9  ///< Serialized touch event payload bytes, excluding CRC
+#define TELEMETRY_CRC_LEN  2  ///< CRC16 bytes appended to every payload
+#define TELEMETRY_MAX_PAYLOAD  128  ///< Largest payload (excluding CRC) of any packet type
+
+#define CAPTURE_CHANNEL_POT     0x01  ///< Capture channel bit: raw rotary potentiometer ADC counts, 2 bytes
+#define CAPTURE_CHANNEL_ECHO    0x02  ///< Capture channel bit: newest raw ultrasonic echo width in us, 2 bytes
+#define CAPTURE_CHANNEL_IMU     0x04  ///< Capture channel bit: IMU x, y and z in milli-g, 6 bytes
+#define CAPTURE_CHANNEL_QTOUCH  0x08  ///< Capture channel bit: FretBoard and StrumBoard key bitmaps, 3 bytes each
+#define CAPTURE_CHANNEL_ALL     0x0F  ///< Every capture channel
+#define CAPTURE_RECORD_MAX_LEN  18  ///< Record bytes with every channel, timestamp included
+
+#define CAPTURE_TRIGGER_NOW     0  ///< Trigger on the first sample, no pre-trigger window
+#define CAPTURE_TRIGGER_FRET    1  ///< Trigger on any FretBoard pad press
+#define CAPTURE_TRIGGER_STRUM   2  ///< Trigger on any StrumBoard pad press
+#define CAPTURE_TRIGGER_ULTRA   3  ///< Trigger when the echo width drops below the threshold, a hand moving closer
+#define CAPTURE_NUM_TRIGGERS    4  ///< Number of CAPTURE_TRIGGER_* types
+
+///< \def COBS_MAX_ENCODED_LEN(n)
+///< Worst-case COBS output for n input bytes, excluding the 0x00 frame delimiter
+#define COBS_MAX_ENCODED_LEN(n) ((n) + ((n) / 254) + 1)
+
+///< Largest frame on the wire: COBS(payload + CRC) plus the 0x00 delimiter
+#define TELEMETRY_MAX_FRAME_LEN  (COBS_MAX_ENCODED_LEN(TELEMETRY_MAX_PAYLOAD + TELEMETRY_CRC_LEN) + 1)
+
+/**************************************************************************/
+/*!
+    @brief  One SensorState sample as carried by a TELEMETRY_TYPE_SNAPSHOT packet
+
+    Wire layout, all multi-byte fields little-endian:
+    type(1) version(1) fret(1) key(1) rotEnc(1) flags(1) rotPot(1) ultraDist(1)
+    imuX(2) imuY(2) imuZ(2) timestamp(4)
+*/
+/**************************************************************************/
+struct TelemetrySnapshot
+{
+  uint8_t fret;  ///< Highest fret pressed, 0 for none
+  uint8_t key;  ///< Bitfield of pressed strum keys
+  uint8_t rotEnc;  ///< Rotary encoder value
+  uint8_t flags;  ///< TELEMETRY_FLAG_* bits
+  uint8_t rotPot;  ///< Rotary potentiometer value
+  uint8_t ultraDist;  ///< Scaled ultrasonic distance
+  int16_t imuX;  ///< IMU x in milli-g
+  int16_t imuY;  ///< IMU y in milli-g
+  int16_t imuZ;  ///< IMU z in milli-g
+  uint32_t timestamp;  ///< micros() when the sample was taken
+};
+
+/**************************************************************************/
+/*!
+    @brief  One sample of every capture channel, only the enabled ones are stored
+
+    Record layout, all multi-byte fields little-endian, channels in bit order:
+    timestamp(2, low bits of micros()) potRaw(2) echoMicros(2)
+    imuX(2) imuY(2) imuZ(2) fretKeys(3) strumKeys(3)
+*/
+/**************************************************************************/
+struct CaptureSample
+{
+  uint32_t timestamp;  ///< micros() when the sample was taken, only the low 16 bits are stored
+  uint16_t potRaw;  ///< Rotary potentiometer ADC counts
+  uint16_t echoMicros;  ///< Newest ultrasonic echo width, 0 before the first echo
+  int16_t imuX;  ///< IMU x in milli-g
+  int16_t imuY;  ///< IMU y in milli-g
+  int16_t imuZ;  ///< IMU z in milli-g
+  uint32_t fretKeys;  ///< FretBoard key bitmap, see TouchPackKeys()
+  uint32_t strumKeys;  ///< StrumBoard key bitmap, see TouchPackKeys()
+};
+
+/**************************************************************************/
+/*!
+    @brief  Describes the records of a capture dump, sent before them in a TELEMETRY_TYPE_CAPTURE_HEADER packet
+
+    Wire layout, all multi-byte fields little-endian:
+    type(1) version(1) channels(1) trigger(1) periodMicros(4) recordCount(4)
+    triggerIndex(4) triggerTimestamp(4)
+*/
+/**************************************************************************/
+struct TelemetryCaptureHeader
+{
+  uint8_t channels;  ///< CAPTURE_CHANNEL_* bits present in every record
+  uint8_t trigger;  ///< CAPTURE_TRIGGER_* that started the post-trigger window
+  uint32_t periodMicros;  ///< Nominal time between records
+  uint32_t recordCount;  ///< Records that follow in TELEMETRY_TYPE_CAPTURE_BLOCK packets
+  uint32_t triggerIndex;  ///< Index of the record that met the trigger, records before it are pre-trigger
+  uint32_t triggerTimestamp;  ///< Full micros() of the trigger record, to unwrap the 16-bit record timestamps
+};
+
+/**************************************************************************/
+/*!
+    @brief  One raw sample of every key of a QTouch board, carried by a TELEMETRY_TYPE_QTOUCH_RAW packet
+
+    Wire layout, all multi-byte fields little-endian:
+    type(1) version(1) board(1) sequence(1) timestamp(4)
+    signal(2 * TELEMETRY_QTOUCH_RAW_KEYS) reference(2 * TELEMETRY_QTOUCH_RAW_KEYS)
+*/
+/**************************************************************************/
+struct TelemetryQTouchRaw
+{
+  uint8_t board;  ///< QTOUCH_BOARD_FRET or QTOUCH_BOARD_STRUM
+  uint8_t sequence;  ///< Counts the board's samples, a gap means packets were dropped
+  uint32_t timestamp;  ///< micros() when the reads were queued
+  uint16_t signal[TELEMETRY_QTOUCH_RAW_KEYS];  ///< Key signal counts
+  uint16_t reference[TELEMETRY_QTOUCH_RAW_KEYS];  ///< Reference counts the chip compares each signal against
+};
+
+/**************************************************************************/
+/*!
+    @brief  One pad going down or up, carried by a TELEMETRY_TYPE_TOUCH_EVENT packet
+
+    Wire layout, all multi-byte fields little-endian:
+    type(1) version(1) board(1) pad(1) isPress(1) timestamp(4)
+*/
+/**************************************************************************/
+struct TelemetryTouchEvent
+{
+  uint8_t board;  ///< QTOUCH_BOARD_FRET or QTOUCH_BOARD_STRUM
+  uint8_t pad;  ///< Pad number from 1
+  bool isPress;  ///< True for touch, False for release
+  uint32_t timestamp;  ///< micros() of the CHANGE edge that led to the read
+};
+
+uint16_t TelemetryCrc16(const uint8_t *data, size_t len);
+size_t CobsEncode(const uint8_t *src, size_t len, uint8_t *dest);
+size_t CobsDecode(const uint8_t *src, size_t len, uint8_t *dest);
+
+size_t TelemetryPackSnapshot(const TelemetrySnapshot &snap, uint8_t *payload);
+bool TelemetryUnpackSnapshot(const uint8_t *payload, size_t len, TelemetrySnapshot &snap);
+size_t TelemetryCaptureRecordLen(uint8_t channels);
+size_t TelemetryPackCaptureRecord(const CaptureSample &sample, uint8_t channels, uint8_t *record);
+void TelemetryUnpackCaptureRecord(const uint8_t *record, uint8_t channels, CaptureSample &sample);
+size_t TelemetryPackCaptureHeader(const TelemetryCaptureHeader &header, uint8_t *payload);
+bool TelemetryUnpackCaptureHeader(const uint8_t *payload, size_t len, TelemetryCaptureHeader &header);
+size_t TelemetryPackCaptureBlock(uint32_t firstIndex, const uint8_t *records, uint8_t count, size_t recordLen, uint8_t *payload);
+bool TelemetryUnpackCaptureBlock(const uint8_t *payload, size_t len, size_t recordLen,
+                                 uint32_t &firstIndex, uint8_t &count, const uint8_t *&records);
+size_t TelemetryPackQTouchRaw(const TelemetryQTouchRaw &raw, uint8_t *payload);
+bool TelemetryUnpackQTouchRaw(const uint8_t *payload, size_t len, TelemetryQTouchRaw &raw);
+size_t TelemetryPackTouchEvent(const TelemetryTouchEvent &event, uint8_t *payload);
+bool TelemetryUnpackTouchEvent(const uint8_t *payload, size_t len, TelemetryTouchEvent &event);
+size_t TelemetryEncodeFrame(const uint8_t *payload, size_t len, uint8_t *frame);
+
+#endif  // __TELEMETRY_CODEC_HPP__
@@ -0,0 +1,103 @@
+/*!
+ * @file TouchKeys.cpp
+ *
+ * \brief XOR edge detection of QTouch key bitmaps into timestamped events
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#include "TouchKeys.hpp"
+
+SpscRing<TouchEvent, TOUCH_EVENT_QUEUE_LEN> TouchTracker::_events;
+uint32_t TouchTracker::_droppedEvents = 0;
+
+/**************************************************************************/
+/*!
+    @brief    Constructor for TouchTracker, starts with no pads touched
+    @param    boardId
+              QTOUCH_BOARD_FRET or QTOUCH_BOARD_STRUM
+*/
+/**************************************************************************/
+TouchTracker::TouchTracker(uint8_t boardId)
+{
+  _boardId = boardId;
+  _keys = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Store a new bitmap and queue one event per pad that changed
+    @param    keys
+              Bitmap from TouchPackKeys()
+    @param    timestamp
+              micros() stamped on the events
+    @return   Bitmap of the pads that changed
+*/
+/**************************************************************************/
+uint32_t TouchTracker::Update(uint32_t keys, uint32_t timestamp)
+{
+  uint32_t changed = keys ^ _keys;
+  uint32_t remaining = changed;
+  TouchEvent event;
+
+  event.timestamp = timestamp;
+  event.boardId = _boardId;
+  // Lowest changed pad first, each pass clears one bit
+  while (remaining != 0)
+  {
+    uint8_t bit = (uint8_t) __builtin_ctz(remaining);
+    remaining &= remaining - 1;
+    event.pad = bit + 1;
+    event.isPress = (keys >> bit) & 1;
+    if (!_events.Push(event))
+    {
+      _droppedEvents++;
+    }
+  }
+  _keys = keys;
+  return changed;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Bitmap from the last Update()
+*/
+/**************************************************************************/
+uint32_t TouchTracker::GetKeys(void) const
+{
+  return _keys;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Highest pad touched, for the FretBoard the fret that sounds
+    @return   Pad number from 1, or TOUCH_PAD_NONE
+*/
+/**************************************************************************/
+uint8_t TouchTracker::GetHighestPad(void) const
+{
+  return TouchHighestPad(_keys);
+}
+
+/**************************************************************************/
+/*!
+    @brief    Take the oldest press/release event of any board
+    @param    event
+              Destination for the popped event
+    @return   True if an event was popped, else False
+*/
+/**************************************************************************/
+bool TouchTracker::PopEvent(TouchEvent &event)
+{
+  return _events.Pop(event);
+}
+
+/**************************************************************************/
+/*!
+    @brief    Number of events dropped because the ring was full
+*/
+/**************************************************************************/
+uint32_t TouchTracker::GetDroppedEvents(void)
+{
+  return _droppedEvents;
+}
@@ -0,0 +1,89 @@
+/*!
+ * @file TouchKeys.hpp
+ *
+ * \brief Packed QTouch key bitmaps with edge detection into press/release events
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#ifndef __TOUCH_KEYS_HPP__
+#define __TOUCH_KEYS_HPP__
+
+#include <stdint.h>
+#include "SpscRing.hpp"
+
+#define TOUCH_QT2120_KEYS  12  ///< Pads on the AT42QT2120, bits 0-11 of a key bitmap
+#define TOUCH_QT1070_KEYS  7  ///< Pads on the AT42QT1070, bits 12-18 of a key bitmap
+#define TOUCH_NUM_PADS  (TOUCH_QT2120_KEYS + TOUCH_QT1070_KEYS)  ///< Pads per QTouch board
+#define TOUCH_PAD_NONE  0  ///< TouchHighestPad() result when nothing is touched, pads count from 1
+#define TOUCH_EVENT_QUEUE_LEN  32  ///< Capacity of the press/release event ring, must be a power of two
+
+/**************************************************************************/
+/*!
+    @brief  One pad going down or up
+*/
+/**************************************************************************/
+struct TouchEvent
+{
+  uint32_t timestamp;  ///< micros() of the CHANGE edge that led to the read
+  uint8_t boardId;  ///< QTOUCH_BOARD_FRET or QTOUCH_BOARD_STRUM
+  uint8_t pad;  ///< Pad number from 1, for the FretBoard this is the fret
+  bool isPress;  ///< True for touch, False for release
+};
+
+/**************************************************************************/
+/*!
+    @brief    Pack one board's KEY_STATUS bytes into a bitmap, pad n in bit n-1
+    @param    ks0
+              AT42QT2120 KEY_STATUS_0, pads 1-8
+    @param    ks1
+              AT42QT2120 KEY_STATUS_1, pads 9-12 in its low nibble
+    @param    ks2
+              AT42QT1070 KEY_STATUS, pads 13-19 in its low 7 bits
+    @return   Bitmap of the TOUCH_NUM_PADS pads
+*/
+/**************************************************************************/
+inline uint32_t TouchPackKeys(uint8_t ks0, uint8_t ks1, uint8_t ks2)
+{
+  return (uint32_t) ks0 | ((uint32_t) (ks1 & 0x0F) << 8) | ((uint32_t) (ks2 & 0x7F) << TOUCH_QT2120_KEYS);
+}
+
+/**************************************************************************/
+/*!
+    @brief    Highest pad touched in a bitmap, a single CLZ on Teensy 4.0
+    @param    keys
+              Bitmap from TouchPackKeys()
+    @return   Pad number from 1, or TOUCH_PAD_NONE
+*/
+/**************************************************************************/
+inline uint8_t TouchHighestPad(uint32_t keys)
+{
+  return (keys == 0) ? TOUCH_PAD_NONE : (uint8_t) (32 - __builtin_clz(keys));
+}
+
+/**************************************************************************/
+/*!
+    @brief  Last known key bitmap of one board, turns each new bitmap into events
+    Events from every tracker share one ring that the main loop produces into
+    and consumes from; when nobody drains it, new events are counted and dropped.
+*/
+/**************************************************************************/
+class TouchTracker
+{
+  private:
+    uint8_t _boardId;  ///< Board ID stamped on events
+    uint32_t _keys;  ///< Bitmap from the last Update()
+
+    static SpscRing<TouchEvent, TOUCH_EVENT_QUEUE_LEN> _events;  ///< Events from all trackers, oldest first
+    static uint32_t _droppedEvents;  ///< Events lost to a full ring
+
+  public:
+    TouchTracker(uint8_t boardId);
+    uint32_t Update(uint32_t keys, uint32_t timestamp);
+    uint32_t GetKeys(void) const;
+    uint8_t GetHighestPad(void) const;
+    static bool PopEvent(TouchEvent &event);
+    static uint32_t GetDroppedEvents(void);
+};
+
+#endif  // __TOUCH_KEYS_HPP__
@@ -0,0 +1,200 @@
+/*!
+ * @file Ultrasonic.cpp
+ *
+ * \brief Interrupt-timed ultrasonic ranging with a streaming median filter
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#include "Ultrasonic.hpp"
+
+UltrasonicRanger *UltrasonicRanger::_instance = NULL;
+SpscRing<UltrasonicEcho, ULTRASONIC_ECHO_QUEUE_LEN> UltrasonicRanger::_echoes;
+
+/**************************************************************************/
+/*!
+    @brief    Constructor for UltrasonicRanger, Begin() must be called before use
+    @param    trigPin
+              Trigger output pin
+    @param    echoPin
+              Echo input pin
+*/
+/**************************************************************************/
+UltrasonicRanger::UltrasonicRanger(uint8_t trigPin, uint8_t echoPin)
+{
+  _trigPin = trigPin;
+  _echoPin = echoPin;
+  _lastPingMicros = 0;
+  _hasPinged = false;
+  _riseMicros = 0;
+  _isEchoHigh = false;
+  _windowIndex = 0;
+  _windowCount = 0;
+  _distCm = PITCH_BEND_MAX_CM;
+  _echoMicros = 0;
+  _echoWidthMicros = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Set up the pins and attach the echo line interrupt
+*/
+/**************************************************************************/
+void UltrasonicRanger::Begin(void)
+{
+  _instance = this;
+  pinMode(_trigPin, OUTPUT);
+  digitalWrite(_trigPin, LOW);
+  pinMode(_echoPin, INPUT);
+  attachInterrupt(digitalPinToInterrupt(_echoPin), _OnEcho, CHANGE);
+}
+
+/**************************************************************************/
+/*!
+    @brief    Trigger a ping if the sensor is ready for one
+
+    Safe to call more often than ULTRASONIC_PING_PERIOD_MICROS, extra calls
+    and calls while the last echo is still in progress do nothing.
+    @return   True if a trigger pulse was sent, else False
+*/
+/**************************************************************************/
+bool UltrasonicRanger::StartPing(void)
+{
+  uint32_t now = micros();
+
+  if (_isEchoHigh || (_hasPinged && now - _lastPingMicros < ULTRASONIC_PING_PERIOD_MICROS))
+  {
+    return false;
+  }
+  digitalWrite(_trigPin, HIGH);
+  delayMicroseconds(ULTRASONIC_TRIGGER_MICROS);
+  digitalWrite(_trigPin, LOW);
+  _lastPingMicros = now;
+  _hasPinged = true;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Fold every echo timed since the last call into the median filter
+*/
+/**************************************************************************/
+void UltrasonicRanger::Service(void)
+{
+  UltrasonicEcho echo;
+
+  while (_echoes.Pop(echo))
+  {
+    uint32_t cm = echo.widthMicros / ULTRASONIC_US_PER_CM;
+
+    // Sufficiently low values are treated as high ones, both mean nothing is in front of the sensor
+    if (echo.widthMicros > ULTRASONIC_MAX_ECHO_MICROS || cm < PITCH_BEND_MIN_CM)
+    {
+      cm = PITCH_BEND_MAX_CM;
+    }
+    _window[_windowIndex] = (uint8_t) cm;
+    _windowIndex = (_windowIndex + 1) % ULTRASONIC_MEDIAN_LEN;
+    if (_windowCount < ULTRASONIC_MEDIAN_LEN)
+    {
+      _windowCount++;
+    }
+    _echoMicros = echo.timestamp;
+    _echoWidthMicros = echo.widthMicros;
+    _distCm = _Median();
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Filtered distance, PITCH_BEND_MAX_CM when nothing is in range
+    @return   Median of the last ULTRASONIC_MEDIAN_LEN echoes in cm
+*/
+/**************************************************************************/
+uint8_t UltrasonicRanger::GetDistanceCm(void) const
+{
+  return _distCm;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Whether GetDistanceCm() reflects what is in front of the sensor now
+    @return   True once the filter holds a majority of its window and the
+              newest echo is younger than ULTRASONIC_STALE_MICROS, else False
+*/
+/**************************************************************************/
+bool UltrasonicRanger::IsValid(void) const
+{
+  return _windowCount > ULTRASONIC_MEDIAN_LEN / 2 && GetAgeMicros() < ULTRASONIC_STALE_MICROS;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Unfiltered width of the newest echo, for characterizing the sensor
+    @return   Round-trip time of flight in microseconds, 0 if there has been no echo yet
+*/
+/**************************************************************************/
+uint32_t UltrasonicRanger::GetEchoWidthMicros(void) const
+{
+  return _echoWidthMicros;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Time since the newest echo folded into the filter
+    @return   Age in microseconds, 0xFFFFFFFF if there has been no echo yet
+*/
+/**************************************************************************/
+uint32_t UltrasonicRanger::GetAgeMicros(void) const
+{
+  return (_windowCount == 0) ? 0xFFFFFFFF : micros() - _echoMicros;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Median of the filled part of _window
+    @return   Middle distance in cm, the upper middle for an even count
+*/
+/**************************************************************************/
+uint8_t UltrasonicRanger::_Median(void)
+{
+  uint8_t sorted[ULTRASONIC_MEDIAN_LEN];
+
+  // Insertion sort, the window is only a handful of bytes
+  for (uint8_t i=0; i<_windowCount; i++)
+  {
+    uint8_t value = _window[i];
+    uint8_t j = i;
+    while (j > 0 && sorted[j - 1] > value)
+    {
+      sorted[j] = sorted[j - 1];
+      j--;
+    }
+    sorted[j] = value;
+  }
+  return sorted[_windowCount / 2];
+}
+
+/**************************************************************************/
+/*!
+    @brief    Echo line ISR, times the pulse between its rising and falling edges
+*/
+/**************************************************************************/
+void UltrasonicRanger::_OnEcho(void)
+{
+  UltrasonicRanger *ranger = _instance;
+  uint32_t now = micros();
+
+  if (digitalRead(ranger->_echoPin) == HIGH)
+  {
+    ranger->_riseMicros = now;
+    ranger->_isEchoHigh = true;
+  }
+  else if (ranger->_isEchoHigh)
+  {
+    UltrasonicEcho echo;
+    echo.timestamp = now;
+    echo.widthMicros = now - ranger->_riseMicros;
+    _echoes.Push(echo);
+    ranger->_isEchoHigh = false;
+  }
+}
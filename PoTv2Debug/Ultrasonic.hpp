@@ -1,34 +1,82 @@
 /*!
  * @file Ultrasonic.hpp
  *
- * \brief Header containing Ultrasonic Rangefinder config and macros
- * 
+ * \brief Header containing Ultrasonic Rangefinder config and the interrupt-driven ranger
+ *
  * Author: Chase E. Stewart for Hidden Layer Design
  *
  */
 #ifndef __ULTRASONIC_HPP__
 #define __ULTRASONIC_HPP__
 
-// This file is now very barebones because the NewPing library is doing the heavy-lifting for the Ultrasonic firmware 
+#include <Arduino.h>
+#include "SpscRing.hpp"
 
-#define PITCH_BEND_MAX_CM 60  ///< Max distance in CM that will be measured by pitch bend 
+#define PITCH_BEND_MAX_CM 60  ///< Max distance in CM that will be measured by pitch bend
                               ///< Distances beyond this will be treated as "no signal"
-#define PITCH_BEND_MIN_CM 1  ///< Min distance in CM that will be measured by pitch bend 
-#define ULTRASONIC_PING_PERIOD_MICROS (unsigned long) (3)  ///< How often to trigger the ultrasonic sensor 
-#define MAX_PITCH_BEND_DELTA 1700  ///< Max value that pitch bend can change by without getting thrown out as anomalous
-                                   ///< This is a unitless raw reading
+#define PITCH_BEND_MIN_CM 1  ///< Min distance in CM that will be measured by pitch bend
+#define ULTRASONIC_PING_PERIOD_MICROS (unsigned long) (30000)  ///< Minimum time between triggers,
+                                                              ///< the sensor needs >= 29ms so the last echo has died out
+#define ULTRASONIC_TRIGGER_MICROS  10  ///< Width of the trigger pulse the sensor needs
+#define ULTRASONIC_US_PER_CM  57  ///< Microseconds of round-trip echo per cm of distance
+#define ULTRASONIC_MAX_ECHO_MICROS  ((PITCH_BEND_MAX_CM + 1) * ULTRASONIC_US_PER_CM)  ///< Longer echoes are out of range
+#define ULTRASONIC_ECHO_QUEUE_LEN  4  ///< Capacity of the ISR->loop echo ring, must be a power of two
+#define ULTRASONIC_MEDIAN_LEN  5  ///< Echoes the median filter spans, odd so it rejects (N-1)/2 consecutive outliers
+#define ULTRASONIC_STALE_MICROS  (4 * ULTRASONIC_PING_PERIOD_MICROS)  ///< Output is invalid once the newest echo is older
+
+/**************************************************************************/
+/*!
+    @brief  One echo pulse timed by the echo line ISR
+*/
+/**************************************************************************/
+struct UltrasonicEcho
+{
+  uint32_t timestamp;  ///< micros() at the falling edge
+  uint32_t widthMicros;  ///< Echo pulse width, the round-trip time of flight
+};
 
+/**************************************************************************/
+/*!
+    @brief  HC-SR04 style rangefinder timed entirely by interrupts
+    StartPing() sends a trigger pulse no more often than the sensor allows,
+    the echo line ISR timestamps both edges and queues the pulse width, and
+    Service() runs each width through a median filter so single spikes and
+    dropouts never reach the output. Out-of-range echoes count as
+    PITCH_BEND_MAX_CM, "no signal", and the output is only valid while
+    echoes keep arriving.
+*/
+/**************************************************************************/
+class UltrasonicRanger
+{
+  private:
+    uint8_t _trigPin;  ///< Trigger output
+    uint8_t _echoPin;  ///< Echo input, needs interrupt support
+    uint32_t _lastPingMicros;  ///< micros() of the last trigger
+    bool _hasPinged;  ///< True once a trigger has been sent
+    volatile uint32_t _riseMicros;  ///< micros() of the rising echo edge, ISR only
+    volatile bool _isEchoHigh;  ///< True while an echo pulse is in progress
+    uint8_t _window[ULTRASONIC_MEDIAN_LEN];  ///< Last distances in cm, oldest overwritten first
+    uint8_t _windowIndex;  ///< Next slot of _window to overwrite
+    uint8_t _windowCount;  ///< Number of valid entries in _window
+    uint8_t _distCm;  ///< Median of _window
+    uint32_t _echoMicros;  ///< Timestamp of the newest echo folded into _window
+    uint32_t _echoWidthMicros;  ///< Unfiltered width of the newest echo
 
-///< \def SCALED_PITCH_BEND(x)
-///< MIDI Pitch bend message accepts a 14-bit twos compliment value, 
-///< but we only want to detune like a whammy bar, so we use 12 bits and subtract 2^12 
-///< such that max val is 0 and whammy goes to half of the full negative (detune) range 
-///< NOTE: use pow(2,13) instead for full range!
-#define SCALED_PITCH_BEND(x) (int) (pow(2,12) * x  / PITCH_BEND_MAX_CM) - pow(2,12)  // Do not adjust!
+    static UltrasonicRanger *_instance;  ///< Ranger served by the ISR trampoline
+    static SpscRing<UltrasonicEcho, ULTRASONIC_ECHO_QUEUE_LEN> _echoes;  ///< Timed echoes, oldest first
 
-///< \def ONEBYTE_SCALED_PITCH_BEND(x)
-///< If using pitch bend for another MIDI control code, the range is only 0-127
-#define ONEBYTE_SCALED_PITCH_BEND(x) (int) (pow(2,7) * (PITCH_BEND_MAX_CM - x)  / PITCH_BEND_MAX_CM)  // Do not adjust!
+    uint8_t _Median(void);
+    static void _OnEcho(void);
 
+  public:
+    UltrasonicRanger(uint8_t trigPin, uint8_t echoPin);
+    void Begin(void);
+    bool StartPing(void);
+    void Service(void);
+    uint8_t GetDistanceCm(void) const;
+    bool IsValid(void) const;
+    uint32_t GetEchoWidthMicros(void) const;
+    uint32_t GetAgeMicros(void) const;
+};
 
 #endif // __ULTRASONIC_HPP__
@@ -0,0 +1,256 @@
+/*!
+ * @file WireI2cDriver.cpp
+ *
+ * \brief I2cBusDriver implementation on top of the Teensy Wire/ Wire1 hardware
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#include "WireI2cDriver.hpp"
+
+#if defined(__IMXRT1062__)
+// LPI2C master command words for MTDR, see i.MX RT1060 reference manual chapter 47
+#define LPI2C_DRV_CMD_TRANSMIT  (0 << 8)  ///< Transmit the low byte
+#define LPI2C_DRV_CMD_RECEIVE   (1 << 8)  ///< Receive (low byte + 1) bytes
+#define LPI2C_DRV_CMD_STOP      (2 << 8)  ///< Generate STOP
+#define LPI2C_DRV_CMD_START     (4 << 8)  ///< Generate (repeated) START and transmit the address byte
+
+#define LPI2C_DRV_MSR_SDF   (1 << 9)   ///< STOP detected
+#define LPI2C_DRV_MSR_NDF   (1 << 10)  ///< NACK detected
+#define LPI2C_DRV_MSR_ALF   (1 << 11)  ///< Arbitration lost
+#define LPI2C_DRV_MSR_FEF   (1 << 12)  ///< FIFO error
+#define LPI2C_DRV_MSR_PLTF  (1 << 13)  ///< Pin low timeout
+#define LPI2C_DRV_MSR_MBF   (1 << 24)  ///< Master busy
+#define LPI2C_DRV_MSR_ERRORS  (LPI2C_DRV_MSR_NDF | LPI2C_DRV_MSR_ALF | LPI2C_DRV_MSR_FEF | LPI2C_DRV_MSR_PLTF)
+
+#define LPI2C_DRV_MCR_RRF  (1 << 8)  ///< Reset receive FIFO
+#define LPI2C_DRV_MCR_RTF  (1 << 9)  ///< Reset transmit FIFO
+#define LPI2C_DRV_MRDR_RXEMPTY  (1 << 14)  ///< Receive FIFO empty, DATA invalid
+#define LPI2C_DRV_MFSR_TXCOUNT(mfsr)  ((mfsr) & 0x7)  ///< Words currently in the transmit FIFO
+#endif
+
+/**************************************************************************/
+/*!
+    @brief    Create a driver for an already begin()-ed TwoWire bus
+    @param    wire
+              Wire or Wire1
+    @param    sdaPin
+              SDA pin the bus is routed to
+    @param    sclPin
+              SCL pin the bus is routed to
+*/
+/**************************************************************************/
+WireI2cDriver::WireI2cDriver(TwoWire &wire, uint8_t sdaPin, uint8_t sclPin)
+{
+  _wire = &wire;
+  _sdaPin = sdaPin;
+  _sclPin = sclPin;
+  _clockHz = I2C_CLOCK_DEFAULT_HZ;
+  _txn = NULL;
+#if defined(__IMXRT1062__)
+  _port = (&wire == &Wire1) ? &IMXRT_LPI2C3 : &IMXRT_LPI2C1;
+  _cmdCount = 0;
+  _cmdIndex = 0;
+#else
+  _result = I2C_STATUS_IDLE;
+#endif
+}
+
+/**************************************************************************/
+/*!
+    @brief    Change the SCL rate between transactions
+    @param    hz
+              New SCL rate
+    @return   True if changed, False if the bus is still busy with a previous STOP
+*/
+/**************************************************************************/
+bool WireI2cDriver::SetClock(uint32_t hz)
+{
+#if defined(__IMXRT1062__)
+  if (_port->MSR & LPI2C_DRV_MSR_MBF)
+  {
+    return false;
+  }
+#endif
+  _wire->setClock(hz);
+  _clockHz = hz;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Abandon the transfer and free a device holding SDA low
+
+    A device interrupted mid-byte keeps driving SDA until it has clocked out
+    the rest of the byte, so SCL is pulsed until SDA is released, then a
+    STOP resets every device. begin() gives the pins back to the peripheral.
+*/
+/**************************************************************************/
+void WireI2cDriver::Recover(void)
+{
+#if defined(__IMXRT1062__)
+  _port->MCR |= LPI2C_DRV_MCR_RTF | LPI2C_DRV_MCR_RRF;
+  _port->MSR = LPI2C_DRV_MSR_SDF | LPI2C_DRV_MSR_ERRORS;
+#endif
+  pinMode(_sdaPin, INPUT_PULLUP);
+  digitalWrite(_sclPin, HIGH);
+  pinMode(_sclPin, OUTPUT_OPENDRAIN);
+  delayMicroseconds(WIRE_RECOVERY_HALF_PERIOD_US);
+
+  for (uint8_t i=0; i<WIRE_RECOVERY_CLOCKS && digitalRead(_sdaPin) == LOW; i++)
+  {
+    digitalWrite(_sclPin, LOW);
+    delayMicroseconds(WIRE_RECOVERY_HALF_PERIOD_US);
+    digitalWrite(_sclPin, HIGH);
+    delayMicroseconds(WIRE_RECOVERY_HALF_PERIOD_US);
+  }
+
+  // START then STOP with SCL high, the STOP resets every device's bus state machine
+  digitalWrite(_sdaPin, LOW);
+  pinMode(_sdaPin, OUTPUT_OPENDRAIN);
+  delayMicroseconds(WIRE_RECOVERY_HALF_PERIOD_US);
+  digitalWrite(_sdaPin, HIGH);
+  delayMicroseconds(WIRE_RECOVERY_HALF_PERIOD_US);
+
+  _wire->begin();
+  _wire->setClock(_clockHz);
+}
+
+#if defined(__IMXRT1062__)
+/**************************************************************************/
+/*!
+    @brief    Build the LPI2C command list for txn and start feeding the FIFO
+    @param    txn
+              Transaction to put on the bus
+    @return   True if started, False if the bus is still busy with a previous STOP
+*/
+/**************************************************************************/
+bool WireI2cDriver::Start(I2cTransaction *txn)
+{
+  if (_port->MSR & LPI2C_DRV_MSR_MBF)
+  {
+    return false;
+  }
+
+  _port->MCR |= LPI2C_DRV_MCR_RTF | LPI2C_DRV_MCR_RRF;
+  _port->MSR = LPI2C_DRV_MSR_SDF | LPI2C_DRV_MSR_ERRORS;  // write 1 to clear
+
+  _cmdCount = 0;
+  if (txn->writeLen > 0)
+  {
+    _cmds[_cmdCount++] = LPI2C_DRV_CMD_START | (txn->addr << 1);
+    for (uint8_t i=0; i<txn->writeLen; i++)
+    {
+      _cmds[_cmdCount++] = LPI2C_DRV_CMD_TRANSMIT | txn->writeBuf[i];
+    }
+  }
+  if (txn->readLen > 0)
+  {
+    _cmds[_cmdCount++] = LPI2C_DRV_CMD_START | (txn->addr << 1) | 0x1;
+    _cmds[_cmdCount++] = LPI2C_DRV_CMD_RECEIVE | (txn->readLen - 1);
+  }
+  _cmds[_cmdCount++] = LPI2C_DRV_CMD_STOP;
+
+  _cmdIndex = 0;
+  _txn = txn;
+  Poll();
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Top up the TX FIFO, drain the RX FIFO and check for completion
+    @return   I2C_STATUS_BUSY while running, else the final I2C_STATUS_* value
+*/
+/**************************************************************************/
+uint8_t WireI2cDriver::Poll(void)
+{
+  uint32_t msr = _port->MSR;
+
+  if (msr & LPI2C_DRV_MSR_ERRORS)
+  {
+    _port->MCR |= LPI2C_DRV_MCR_RTF | LPI2C_DRV_MCR_RRF;
+    _port->MSR = msr & LPI2C_DRV_MSR_ERRORS;
+    return (msr & LPI2C_DRV_MSR_NDF) ? I2C_STATUS_NACK : I2C_STATUS_ERROR;
+  }
+
+  uint32_t txFifoSize = 1 << (_port->PARAM & 0xF);
+  while (_cmdIndex < _cmdCount && LPI2C_DRV_MFSR_TXCOUNT(_port->MFSR) < txFifoSize)
+  {
+    _port->MTDR = _cmds[_cmdIndex++];
+  }
+
+  while (_txn->readCount < _txn->readLen)
+  {
+    uint32_t data = _port->MRDR;
+    if (data & LPI2C_DRV_MRDR_RXEMPTY)
+    {
+      break;
+    }
+    _txn->readBuf[_txn->readCount++] = (uint8_t) data;
+  }
+
+  if (_cmdIndex == _cmdCount && _txn->readCount == _txn->readLen && (msr & LPI2C_DRV_MSR_SDF))
+  {
+    _port->MSR = LPI2C_DRV_MSR_SDF;
+    return I2C_STATUS_DONE;
+  }
+  return I2C_STATUS_BUSY;
+}
+
+#else
+/**************************************************************************/
+/*!
+    @brief    Run txn to completion through the Wire API
+
+    The engine cannot time out a transfer that finishes inside Start(), so
+    this relies on the Wire library's own limits and only checks results.
+    @param    txn
+              Transaction to put on the bus
+    @return   Always True, the result is reported by the next Poll()
+*/
+/**************************************************************************/
+bool WireI2cDriver::Start(I2cTransaction *txn)
+{
+  _txn = txn;
+  _result = I2C_STATUS_DONE;
+
+  if (txn->writeLen > 0)
+  {
+    _wire->beginTransmission(txn->addr);
+    _wire->write(txn->writeBuf, txn->writeLen);
+    uint8_t err = _wire->endTransmission(txn->readLen == 0);  // keep the bus for a repeated-start read
+    if (err != 0)
+    {
+      _result = (err == 2 || err == 3) ? I2C_STATUS_NACK : I2C_STATUS_ERROR;
+      return true;
+    }
+  }
+
+  if (txn->readLen > 0)
+  {
+    uint8_t count = _wire->requestFrom(txn->addr, txn->readLen);
+    for (uint8_t i=0; i<count && i<txn->readLen; i++)
+    {
+      txn->readBuf[i] = _wire->read();
+    }
+    txn->readCount = count;
+    if (count != txn->readLen)
+    {
+      _result = I2C_STATUS_ERROR;
+    }
+  }
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Report the result of the transfer done in Start()
+    @return   Final I2C_STATUS_* value
+*/
+/**************************************************************************/
+uint8_t WireI2cDriver::Poll(void)
+{
+  return _result;
+}
+#endif
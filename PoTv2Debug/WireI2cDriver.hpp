@@ -0,0 +1,56 @@
+/*!
+ * @file WireI2cDriver.hpp
+ *
+ * \brief Header for I2cBusDriver implementation on top of the Teensy Wire/ Wire1 hardware
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#ifndef __WIRE_I2C_DRIVER_HPP__
+#define __WIRE_I2C_DRIVER_HPP__
+
+#include <Wire.h>
+#include "I2cEngine.hpp"
+
+#define WIRE_RECOVERY_CLOCKS  9  ///< SCL pulses that finish any byte a device is stuck sending, plus its ACK
+#define WIRE_RECOVERY_HALF_PERIOD_US  5  ///< Half an SCL period of the recovery pulses, 100kHz
+
+/**************************************************************************/
+/*!
+    @brief  I2cBusDriver for one of the Teensy TwoWire buses
+    On Teensy 4.0 this drives the LPI2C master FIFOs directly so Start() and
+    Poll() never wait on the bus. Other targets (Teensy LC) have no FIFO to
+    queue commands into, so the transfer runs to completion inside Start()
+    through the regular Wire API and Poll() only reports the result.
+    The bus must be set up with begin() before use, and once an engine owns a
+    bus nothing else should call the Wire API on it while transactions are pending.
+    Recover() takes the pins over as GPIO to clock a stuck device free,
+    sends a STOP and hands them back to the peripheral.
+*/
+/**************************************************************************/
+class WireI2cDriver : public I2cBusDriver
+{
+  private:
+    TwoWire *_wire;  ///< Bus to drive, Wire or Wire1
+    uint8_t _sdaPin;  ///< SDA of _wire, for Recover()
+    uint8_t _sclPin;  ///< SCL of _wire, for Recover()
+    uint32_t _clockHz;  ///< Last SetClock() rate, restored after Recover()
+    I2cTransaction *_txn;  ///< Transaction currently on the bus
+#if defined(__IMXRT1062__)
+    IMXRT_LPI2C_t *_port;  ///< LPI2C peripheral behind _wire
+    uint16_t _cmds[I2C_TXN_MAX_WRITE + 4];  ///< Master command words for the active transaction
+    uint8_t _cmdCount;  ///< Number of valid entries in _cmds
+    uint8_t _cmdIndex;  ///< Next entry of _cmds to push into the TX FIFO
+#else
+    uint8_t _result;  ///< Final I2C_STATUS_* of the synchronous transfer
+#endif
+
+  public:
+    WireI2cDriver(TwoWire &wire, uint8_t sdaPin, uint8_t sclPin);
+    bool Start(I2cTransaction *txn);
+    uint8_t Poll(void);
+    bool SetClock(uint32_t hz);
+    void Recover(void);
+};
+
+#endif  // __WIRE_I2C_DRIVER_HPP__
@@ -0,0 +1,94 @@
+/*!
+ * @file imu_filter_bench.cpp
+ *
+ * \brief Host benchmark and sanity check of the fixed-point IMU filters
+ *
+ * Usage: potv2-imu-bench [samples]
+ *
+ * Runs each filter in ImuFilter.hpp over a noisy 1g step, prints the host
+ * cost per sample (filter step plus milli-g conversion), the settled output
+ * and the residual noise, so a filter or coefficient change can be checked
+ * before it is flashed. The on-target cost comes from the sketch's 'i'
+ * command in a POTV2_PROFILE build.
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+
+#include "ImuFilter.hpp"
+
+#define BENCH_DEFAULT_SAMPLES  10000000  ///< Samples run through each filter for timing
+#define BENCH_GSCALE  2  ///< Full-scale range used for the milli-g conversion
+#define BENCH_STEP_COUNTS  1024  ///< 1g at +/-2g full scale
+#define BENCH_NOISE_COUNTS  32  ///< Peak uniform noise added to every sample
+#define BENCH_SETTLE_SAMPLES  200  ///< Step-response samples before the settled output is measured
+
+/**************************************************************************/
+/*!
+    @brief    Time a filter and measure its settled mean and noise on a 1g step
+*/
+/**************************************************************************/
+template <typename Filter>
+static void BenchFilter(const char *name, const std::vector<int16_t> &samples)
+{
+  Filter filter;
+  int64_t checksum = 0;
+
+  filter.Reset(0);
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i=0; i<samples.size(); i++)
+  {
+    checksum += ImuToMilliG(filter.Step(samples[i]), BENCH_GSCALE);
+  }
+  auto end = std::chrono::steady_clock::now();
+  double nsPerSample = std::chrono::duration<double, std::nano>(end - start).count() / samples.size();
+
+  // Step response: settled mean and standard deviation in milli-g
+  Filter stepFilter;
+  double sum = 0, sumSq = 0;
+  unsigned count = 0;
+  stepFilter.Reset(0);
+  for (size_t i=0; i<samples.size() && i<BENCH_SETTLE_SAMPLES * 6; i++)
+  {
+    int16_t mg = ImuToMilliG(stepFilter.Step(samples[i]), BENCH_GSCALE);
+    if (i >= BENCH_SETTLE_SAMPLES)
+    {
+      sum += mg;
+      sumSq += (double) mg * mg;
+      count++;
+    }
+  }
+  double mean = (count > 0) ? sum / count : 0;
+  double stddev = (count > 0) ? sqrt(sumSq / count - mean * mean) : 0;
+
+  printf("%-7s %8.2f %8.1f %8.2f %lld\n", name, nsPerSample, mean, stddev, (long long) (checksum & 0xFFFF));
+}
+
+int main(int argc, char **argv)
+{
+  size_t numSamples = (argc > 1) ? strtoul(argv[1], NULL, 0) : BENCH_DEFAULT_SAMPLES;
+  if (numSamples < BENCH_SETTLE_SAMPLES * 6)
+  {
+    numSamples = BENCH_SETTLE_SAMPLES * 6;
+  }
+
+  // 1g step from the first sample on, with uniform noise
+  std::vector<int16_t> samples(numSamples);
+  uint32_t lcg = 12345;
+  for (size_t i=0; i<numSamples; i++)
+  {
+    lcg = lcg * 1664525 + 1013904223;
+    samples[i] = BENCH_STEP_COUNTS + (int16_t) ((lcg >> 16) % (2 * BENCH_NOISE_COUNTS + 1)) - BENCH_NOISE_COUNTS;
+  }
+
+  printf("filter  ns/sample  mean_mg stddev_mg checksum\n");
+  BenchFilter<ImuPassFilter>("none", samples);
+  BenchFilter<ImuEmaFilter>("ema", samples);
+  BenchFilter<ImuBiquadFilter>("biquad", samples);
+  return 0;
+}
@@ -0,0 +1,443 @@
+/*!
+ * @file sensor_state_bench.cpp
+ *
+ * \brief Host microbenchmark suite for the SensorState hot paths
+ *
+ * Usage: potv2-state-bench [-n ops] [-r repeats] [-j out.json] [-c baseline.json] [-t percent]
+ *
+ * Times the Update*() calls the sensor tasks make, the rotary encoder ISR
+ * body, the ultrasonic control curves and the TUI/telemetry output against the
+ * simulated HAL, whose Serial only counts bytes. Each benchmark runs
+ * `repeats` times over the same precomputed input stream and reports the
+ * fastest run in ns/op, plus bytes emitted per frame for the output paths.
+ * -j writes the results as JSON, one benchmark per line, and -c compares
+ * against such a file from an earlier commit: any benchmark more than
+ * `percent` slower, or emitting more bytes per frame, is listed and the
+ * exit status is 1. Host numbers are only comparable on the same machine.
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+#include <vector>
+
+#include "SimHal.hpp"
+#include "SensorState.hpp"
+#include "SerialTx.hpp"
+#include "ControlCurves.hpp"
+#include "TouchKeys.hpp"
+#include "QuadratureEncoder.hpp"
+
+#define BENCH_DEFAULT_OPS  1000000  ///< Operations timed per run of the cheap benchmarks
+#define BENCH_OUTPUT_DIVISOR  50  ///< Output benchmarks render whole frames, they run ops / this
+#define BENCH_DEFAULT_REPEATS  5  ///< Runs per benchmark, the fastest is reported
+#define BENCH_DEFAULT_THRESHOLD  15.0  ///< Percent slower than the baseline that counts as a regression
+#define BENCH_MAX_HELD_PADS  3  ///< Pads held at once in the synthetic touch stream
+#define BENCH_MAX_RESULTS  16  ///< Benchmarks in the suite
+#define BENCH_NAME_LEN  32  ///< Longest benchmark name, including the terminator
+
+/**************************************************************************/
+/*!
+    @brief  Outcome of one benchmark
+*/
+/**************************************************************************/
+struct BenchResult
+{
+  char name[BENCH_NAME_LEN];  ///< Stable identifier, the key when comparing runs
+  double nsPerOp;  ///< Fastest run in nanoseconds per operation
+  double bytesPerFrame;  ///< Serial bytes per frame, negative for benchmarks that emit nothing
+  uint32_t checksum;  ///< Folded results, keeps the work from being optimized away
+};
+
+/**************************************************************************/
+/*!
+    @brief  Inputs shared by every benchmark, generated once so all runs see the same data
+*/
+/**************************************************************************/
+struct BenchInputs
+{
+  std::vector<uint32_t> keys;  ///< Sparse touch bitmaps, one pad changes per entry
+  std::vector<int16_t> imu;  ///< Noisy milli-g, three per operation
+  std::vector<uint8_t> quadAB;  ///< Encoder line states, turning both ways at varying speed with some bounce
+  std::vector<uint32_t> quadMicros;  ///< Timestamp of each quadAB edge
+  std::vector<uint8_t> cm;  ///< Ultrasonic distances, some out of range
+};
+
+static BenchResult results[BENCH_MAX_RESULTS];
+static uint8_t numResults = 0;
+static SerialTx benchTx;
+static SensorState benchState = SensorState(benchTx);
+
+/**************************************************************************/
+/*!
+    @brief    Time fn over ops operations, repeats times, and record the fastest run
+    @param    name
+              Benchmark identifier
+    @param    ops
+              Operations one call of fn performs
+    @param    repeats
+              Runs to take the minimum of
+    @param    isOutput
+              True to report Serial bytes per operation as bytes per frame
+    @param    fn
+              Runs the benchmark body once over ops operations, returns a checksum
+*/
+/**************************************************************************/
+template <typename Fn>
+static void RunBench(const char *name, size_t ops, unsigned repeats, bool isOutput, Fn fn)
+{
+  BenchResult &result = results[numResults++];
+  double best = 0;
+  uint64_t bytes = 0;
+
+  snprintf(result.name, sizeof(result.name), "%s", name);
+  for (unsigned run=0; run<repeats; run++)
+  {
+    uint64_t bytesBefore = SimHal::GetSerialBytes();
+    auto start = std::chrono::steady_clock::now();
+    result.checksum = fn(ops);
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ops;
+    bytes = SimHal::GetSerialBytes() - bytesBefore;
+    if (run == 0 || ns < best)
+    {
+      best = ns;
+    }
+  }
+  result.nsPerOp = best;
+  result.bytesPerFrame = (isOutput) ? (double) bytes / ops : -1.0;
+  printf("%-24s %10.2f", result.name, result.nsPerOp);
+  if (isOutput)
+  {
+    printf(" %12.1f", result.bytesPerFrame);
+  }
+  else
+  {
+    printf(" %12s", "-");
+  }
+  printf(" %08lX\n", (unsigned long) result.checksum);
+}
+
+/**************************************************************************/
+/*!
+    @brief    Build the input streams with a fixed-seed LCG
+*/
+/**************************************************************************/
+static void MakeInputs(BenchInputs &inputs, size_t ops)
+{
+  uint32_t lcg = 12345;
+  uint32_t keys = 0;
+  static const uint8_t grayAC[4] = { 0x0, 0x1, 0x3, 0x2 };
+  uint8_t phase = 0;
+  uint32_t now = 0;
+
+  inputs.keys.resize(ops);
+  inputs.imu.resize(ops * 3);
+  inputs.quadAB.resize(ops);
+  inputs.quadMicros.resize(ops);
+  inputs.cm.resize(ops);
+  for (size_t i=0; i<ops; i++)
+  {
+    lcg = lcg * 1664525 + 1013904223;
+    uint32_t pad = 1UL << ((lcg >> 16) % TOUCH_NUM_PADS);
+    if ((keys & pad) || __builtin_popcount(keys) < BENCH_MAX_HELD_PADS)
+    {
+      keys ^= pad;
+    }
+    inputs.keys[i] = keys;
+    inputs.imu[i * 3] = (int16_t) ((lcg >> 8) % 64) - 32;
+    inputs.imu[i * 3 + 1] = (int16_t) ((lcg >> 14) % 64) - 32;
+    inputs.imu[i * 3 + 2] = 1000 + (int16_t) ((lcg >> 20) % 64) - 32;
+    // Sweeps of 256 edges each way, an edge every 1-16ms so every acceleration step is hit, 1 in 8 a bounce back
+    int8_t dir = ((i >> 8) & 1) ? 1 : -1;
+    phase = (phase + ((((lcg >> 4) & 0x7) == 0) ? -dir : dir)) & 0x3;
+    now += 1000 * (1 + ((i >> 6) & 0xF));
+    inputs.quadAB[i] = grayAC[phase];
+    inputs.quadMicros[i] = now;
+    inputs.cm[i] = (uint8_t) ((lcg >> 24) % (PITCH_BEND_MAX_CM + 10));
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Change one displayed field per frame, cycling through all of them like a player would
+*/
+/**************************************************************************/
+static void MutateState(const BenchInputs &inputs, size_t i)
+{
+  switch (i % 4)
+  {
+    case 0: benchState.UpdateFret(inputs.keys[i]); break;
+    case 1: benchState.UpdateRotPot((uint8_t) (i % (POT_VALUE_MAX + 1))); break;
+    case 2: benchState.UpdateXYZ(inputs.imu[i * 3], inputs.imu[i * 3 + 1], inputs.imu[i * 3 + 2]); break;
+    default: benchState.UpdateUltrasonic(inputs.cm[i] % PITCH_BEND_MAX_CM + 1, true); break;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Time every hot path and print one line each
+*/
+/**************************************************************************/
+static void RunSuite(const BenchInputs &inputs, size_t ops, unsigned repeats)
+{
+  size_t frames = ops / BENCH_OUTPUT_DIVISOR;
+  frames = (frames == 0) ? 1 : frames;
+
+  printf("benchmark                   ns/op  bytes/frame checksum\n");
+  RunBench("update_fret", ops, repeats, false, [&](size_t n) {
+    for (size_t i=0; i<n; i++)
+    {
+      benchState.UpdateFret(inputs.keys[i]);
+    }
+    return benchState.GetSnapshotSequence();
+  });
+  RunBench("update_strum_key", ops, repeats, false, [&](size_t n) {
+    for (size_t i=0; i<n; i++)
+    {
+      benchState.UpdateStrumKey(inputs.keys[i]);
+    }
+    return benchState.GetSnapshotSequence();
+  });
+  RunBench("update_xyz", ops, repeats, false, [&](size_t n) {
+    for (size_t i=0; i<n; i++)
+    {
+      benchState.UpdateXYZ(inputs.imu[i * 3], inputs.imu[i * 3 + 1], inputs.imu[i * 3 + 2]);
+    }
+    return benchState.GetSnapshotSequence();
+  });
+  RunBench("rot_enc_decode", ops, repeats, false, [&](size_t n) {
+    QuadratureEncoder encoder = QuadratureEncoder(0, 1);
+    uint32_t sum = 0;
+    for (size_t i=0; i<n; i++)
+    {
+      encoder.Decode(inputs.quadAB[i], inputs.quadMicros[i]);
+      sum = sum * 31 + encoder.GetPosition();
+    }
+    return sum;
+  });
+
+  // The pitch-bend and whammy CC macros became these tables, Eval() is the curve computed at run time,
+  // clamped to the same input range MapClamped() uses so both checksums agree
+  RunBench("ultra_cc_eval", ops, repeats, false, [&](size_t n) {
+    uint32_t sum = 0;
+    for (size_t i=0; i<n; i++)
+    {
+      sum = sum * 31 + (uint32_t) UltraCcCurve::Eval(constrain(inputs.cm[i], UltraCcCurve::inFirst, UltraCcCurve::inLast));
+    }
+    return sum;
+  });
+  RunBench("ultra_cc_table", ops, repeats, false, [&](size_t n) {
+    uint32_t sum = 0;
+    for (size_t i=0; i<n; i++)
+    {
+      sum = sum * 31 + ULTRA_CM_TO_CC.MapClamped(inputs.cm[i]);
+    }
+    return sum;
+  });
+  RunBench("ultra_pitch_bend_table", ops, repeats, false, [&](size_t n) {
+    uint32_t sum = 0;
+    for (size_t i=0; i<n; i++)
+    {
+      sum = sum * 31 + (uint32_t) ULTRA_CM_TO_PITCH_BEND.MapClamped(inputs.cm[i]);
+    }
+    return sum;
+  });
+
+  // Output paths: one changed field per frame, drained into the byte-counting Serial every frame
+  benchState.SetScreenMode(SCREEN_MODE_DELTA);
+  benchState.CheckUpdateScreen();
+  benchTx.Service();
+  RunBench("screen_delta", frames, repeats, true, [&](size_t n) {
+    for (size_t i=0; i<n; i++)
+    {
+      MutateState(inputs, i);
+      benchState.CheckUpdateScreen();
+      benchTx.Service();
+    }
+    return benchState.GetSnapshotSequence();
+  });
+  RunBench("screen_delta_idle", ops, repeats, true, [&](size_t n) {
+    for (size_t i=0; i<n; i++)
+    {
+      benchState.CheckUpdateScreen();
+      benchTx.Service();
+    }
+    return benchState.GetSnapshotSequence();
+  });
+  benchState.SetScreenMode(SCREEN_MODE_FULL);
+  RunBench("screen_full", frames, repeats, true, [&](size_t n) {
+    for (size_t i=0; i<n; i++)
+    {
+      MutateState(inputs, i);
+      benchState.CheckUpdateScreen();
+      benchTx.Service();
+    }
+    return benchState.GetSnapshotSequence();
+  });
+  RunBench("send_telemetry", frames, repeats, true, [&](size_t n) {
+    for (size_t i=0; i<n; i++)
+    {
+      MutateState(inputs, i);
+      benchState.SendTelemetry((uint32_t) i);
+      benchTx.Service();
+    }
+    return benchState.GetSnapshotSequence();
+  });
+}
+
+/**************************************************************************/
+/*!
+    @brief    Write the results as JSON, one benchmark object per line
+    @return   True on success
+*/
+/**************************************************************************/
+static bool WriteJson(const char *path, size_t ops, unsigned repeats)
+{
+  FILE *out = fopen(path, "w");
+  if (out == NULL)
+  {
+    perror(path);
+    return false;
+  }
+  fprintf(out, "{\n  \"suite\": \"potv2-state-bench\",\n  \"ops\": %lu,\n  \"repeats\": %u,\n  \"benchmarks\": [\n",
+          (unsigned long) ops, repeats);
+  for (uint8_t i=0; i<numResults; i++)
+  {
+    fprintf(out, "    {\"name\": \"%s\", \"ns_per_op\": %.3f", results[i].name, results[i].nsPerOp);
+    if (results[i].bytesPerFrame >= 0)
+    {
+      fprintf(out, ", \"bytes_per_frame\": %.2f", results[i].bytesPerFrame);
+    }
+    fprintf(out, "}%s\n", (i + 1 < numResults) ? "," : "");
+  }
+  fprintf(out, "  ]\n}\n");
+  fclose(out);
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Compare against a file written by -j and list the regressions
+    @param    path
+              Baseline JSON from an earlier run
+    @param    thresholdPercent
+              Slowdown that counts as a regression
+    @return   Number of regressions, -1 if the baseline cannot be read
+*/
+/**************************************************************************/
+static int CompareBaseline(const char *path, double thresholdPercent)
+{
+  FILE *in = fopen(path, "r");
+  char line[256];
+  int regressions = 0;
+
+  if (in == NULL)
+  {
+    perror(path);
+    return -1;
+  }
+  printf("\nbenchmark                baseline    current   change\n");
+  while (fgets(line, sizeof(line), in) != NULL)
+  {
+    char name[BENCH_NAME_LEN];
+    double baseNs;
+    double baseBytes = -1.0;
+    const char *bytesField = strstr(line, "\"bytes_per_frame\":");
+
+    if (sscanf(line, " {\"name\": \"%31[^\"]\", \"ns_per_op\": %lf", name, &baseNs) != 2)
+    {
+      continue;
+    }
+    if (bytesField != NULL)
+    {
+      sscanf(bytesField, "\"bytes_per_frame\": %lf", &baseBytes);
+    }
+    for (uint8_t i=0; i<numResults; i++)
+    {
+      if (strcmp(results[i].name, name) != 0)
+      {
+        continue;
+      }
+      double change = (baseNs > 0) ? (results[i].nsPerOp - baseNs) * 100.0 / baseNs : 0;
+      bool isSlower = change > thresholdPercent;
+      bool isBigger = baseBytes >= 0 && results[i].bytesPerFrame > baseBytes + 0.005;
+      printf("%-24s %8.2f %10.2f %+7.1f%%%s%s\n", name, baseNs, results[i].nsPerOp, change,
+             isSlower ? " SLOWER" : "", isBigger ? " MORE_BYTES" : "");
+      regressions += (isSlower || isBigger) ? 1 : 0;
+    }
+  }
+  fclose(in);
+  return regressions;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Print usage to stderr
+*/
+/**************************************************************************/
+static void PrintUsage(const char *argv0)
+{
+  fprintf(stderr, "Usage: %s [-n ops] [-r repeats] [-j out.json] [-c baseline.json] [-t percent]\n", argv0);
+  fprintf(stderr, "  -n ops       operations per run (default %d, output benchmarks run 1/%d as many frames)\n",
+          BENCH_DEFAULT_OPS, BENCH_OUTPUT_DIVISOR);
+  fprintf(stderr, "  -r repeats   runs per benchmark, the fastest counts (default %d)\n", BENCH_DEFAULT_REPEATS);
+  fprintf(stderr, "  -j file      write the results as JSON\n");
+  fprintf(stderr, "  -c file      compare against JSON from an earlier run, exit 1 on a regression\n");
+  fprintf(stderr, "  -t percent   slowdown that counts as a regression (default %.0f)\n", BENCH_DEFAULT_THRESHOLD);
+}
+
+int main(int argc, char **argv)
+{
+  size_t ops = BENCH_DEFAULT_OPS;
+  unsigned repeats = BENCH_DEFAULT_REPEATS;
+  const char *jsonPath = NULL;
+  const char *baselinePath = NULL;
+  double threshold = BENCH_DEFAULT_THRESHOLD;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "n:r:j:c:t:h")) != -1)
+  {
+    switch (opt)
+    {
+      case 'n': ops = strtoul(optarg, NULL, 0); break;
+      case 'r': repeats = (unsigned) strtoul(optarg, NULL, 0); break;
+      case 'j': jsonPath = optarg; break;
+      case 'c': baselinePath = optarg; break;
+      case 't': threshold = strtod(optarg, NULL); break;
+      default: PrintUsage(argv[0]); return (opt == 'h') ? 0 : 2;
+    }
+  }
+  ops = (ops == 0) ? 1 : ops;
+  repeats = (repeats == 0) ? 1 : repeats;
+
+  // Serial never pushes back, every byte a frame produces is counted
+  SimHal::Reset();
+  SimHal::SetSerialWriteSpace(SERIAL_TX_RING_LEN);
+
+  BenchInputs inputs;
+  MakeInputs(inputs, ops);
+  RunSuite(inputs, ops, repeats);
+
+  if (jsonPath != NULL && !WriteJson(jsonPath, ops, repeats))
+  {
+    return 1;
+  }
+  if (baselinePath != NULL)
+  {
+    int regressions = CompareBaseline(baselinePath, threshold);
+    if (regressions < 0)
+    {
+      return 1;
+    }
+    if (regressions > 0)
+    {
+      printf("%d regression(s) against %s\n", regressions, baselinePath);
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,171 @@
+/*!
+ * @file touch_keys_bench.cpp
+ *
+ * \brief Host benchmark of packed-bitmap fret decoding against the old branch chain
+ *
+ * Usage: potv2-touch-bench [updates]
+ *
+ * Checks that TouchHighestPad(TouchPackKeys()) agrees with the original
+ * 19-branch highest-fret chain for every pad combination, then times both
+ * over a stream of sparse, realistic key states. A third line adds the
+ * TouchTracker XOR edge detection and event drain on top of the bitmap
+ * decode, the full per-update cost the FretBoard now pays.
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+
+#include "TouchKeys.hpp"
+
+#define BENCH_DEFAULT_UPDATES  10000000  ///< Key status updates timed per method
+#define BENCH_MAX_HELD_PADS  3  ///< Pads held at once in the synthetic stream
+
+/**************************************************************************/
+/*!
+    @brief  One board's KEY_STATUS bytes as read over I2C
+*/
+/**************************************************************************/
+struct KeyStatus
+{
+  uint8_t ks0;  ///< AT42QT2120 KEY_STATUS_0
+  uint8_t ks1;  ///< AT42QT2120 KEY_STATUS_1
+  uint8_t ks2;  ///< AT42QT1070 KEY_STATUS
+};
+
+/**************************************************************************/
+/*!
+    @brief    Highest fret exactly as SensorState::UpdateFret() used to find it
+*/
+/**************************************************************************/
+static uint8_t LegacyHighestFret(uint8_t ks0, uint8_t ks1, uint8_t ks2)
+{
+  uint8_t fret = 0;
+
+  if (ks2)
+  {
+    if (ks2 & 0x40) fret = 19;
+    else if (ks2 & 0x20) fret = 18;
+    else if (ks2 & 0x10) fret = 17;
+    else if (ks2 & 0x08) fret = 16;
+    else if (ks2 & 0x04) fret = 15;
+    else if (ks2 & 0x02) fret = 14;
+    else if (ks2 & 0x01) fret = 13;
+  }
+  else if (ks1)
+  {
+    if      (ks1 & 0x08) fret = 12;
+    else if (ks1 & 0x04) fret = 11;
+    else if (ks1 & 0x02) fret = 10;
+    else if (ks1 & 0x01) fret = 9;
+  }
+  else if (ks0)
+  {
+    if (ks0 & 0x80) fret = 8;
+    else if (ks0 & 0x40) fret = 7;
+    else if (ks0 & 0x20) fret = 6;
+    else if (ks0 & 0x10) fret = 5;
+    else if (ks0 & 0x08) fret = 4;
+    else if (ks0 & 0x04) fret = 3;
+    else if (ks0 & 0x02) fret = 2;
+    else if (ks0 & 0x01) fret = 1;
+  }
+  return fret;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Split a pad bitmap back into KEY_STATUS bytes
+*/
+/**************************************************************************/
+static KeyStatus Unpack(uint32_t keys)
+{
+  KeyStatus status;
+  status.ks0 = (uint8_t) keys;
+  status.ks1 = (uint8_t) ((keys >> 8) & 0x0F);
+  status.ks2 = (uint8_t) (keys >> TOUCH_QT2120_KEYS);
+  return status;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Print one timing line
+*/
+/**************************************************************************/
+static void PrintLine(const char *name, std::chrono::steady_clock::time_point start, size_t updates, uint32_t checksum)
+{
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / updates;
+  printf("%-14s %8.2f %08lX\n", name, ns, (unsigned long) checksum);
+}
+
+int main(int argc, char **argv)
+{
+  size_t numUpdates = (argc > 1) ? strtoul(argv[1], NULL, 0) : BENCH_DEFAULT_UPDATES;
+  if (numUpdates == 0)
+  {
+    numUpdates = 1;
+  }
+
+  // Every combination of the 19 pads must decode to the same fret
+  uint32_t mismatches = 0;
+  for (uint32_t keys=0; keys<(1UL << TOUCH_NUM_PADS); keys++)
+  {
+    KeyStatus status = Unpack(keys);
+    if (LegacyHighestFret(status.ks0, status.ks1, status.ks2) != TouchHighestPad(TouchPackKeys(status.ks0, status.ks1, status.ks2)))
+    {
+      mismatches++;
+    }
+  }
+  printf("combinations %lu mismatches %lu\n", (unsigned long) (1UL << TOUCH_NUM_PADS), (unsigned long) mismatches);
+
+  // Sparse stream: each update presses or releases one pad, at most BENCH_MAX_HELD_PADS held
+  std::vector<KeyStatus> stream(numUpdates);
+  uint32_t keys = 0;
+  uint32_t lcg = 12345;
+  for (size_t i=0; i<numUpdates; i++)
+  {
+    lcg = lcg * 1664525 + 1013904223;
+    uint32_t pad = 1UL << ((lcg >> 16) % TOUCH_NUM_PADS);
+    if ((keys & pad) || __builtin_popcount(keys) < BENCH_MAX_HELD_PADS)
+    {
+      keys ^= pad;
+    }
+    stream[i] = Unpack(keys);
+  }
+
+  printf("method         ns/update checksum\n");
+  uint32_t checksum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i=0; i<numUpdates; i++)
+  {
+    checksum = checksum * 31 + LegacyHighestFret(stream[i].ks0, stream[i].ks1, stream[i].ks2);
+  }
+  PrintLine("branch_chain", start, numUpdates, checksum);
+
+  checksum = 0;
+  start = std::chrono::steady_clock::now();
+  for (size_t i=0; i<numUpdates; i++)
+  {
+    checksum = checksum * 31 + TouchHighestPad(TouchPackKeys(stream[i].ks0, stream[i].ks1, stream[i].ks2));
+  }
+  PrintLine("bitmap_clz", start, numUpdates, checksum);
+
+  TouchTracker tracker(0);
+  TouchEvent event;
+  checksum = 0;
+  start = std::chrono::steady_clock::now();
+  for (size_t i=0; i<numUpdates; i++)
+  {
+    tracker.Update(TouchPackKeys(stream[i].ks0, stream[i].ks1, stream[i].ks2), (uint32_t) i);
+    checksum = checksum * 31 + tracker.GetHighestPad();
+    while (TouchTracker::PopEvent(event))
+    {
+      checksum += event.pad;
+    }
+  }
+  PrintLine("bitmap_events", start, numUpdates, checksum);
+  return (mismatches == 0) ? 0 : 1;
+}
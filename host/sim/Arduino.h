@@ -0,0 +1,155 @@
+/*!
+ * @file Arduino.h
+ *
+ * \brief Simulated Arduino/Teensy core API for building the sketch on a host
+ *
+ * Only what the PoTv2Debug sources use is provided. Time, pins, interrupts
+ * and the Serial port are all backed by SimHal so a scripted timeline can
+ * drive the sketch faster than real time.
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#ifndef __SIM_ARDUINO_H__
+#define __SIM_ARDUINO_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH  1
+#define LOW   0
+
+#define INPUT         0
+#define OUTPUT        1
+#define INPUT_PULLUP  2
+#define OUTPUT_OPENDRAIN  4
+
+#define CHANGE   4
+#define FALLING  2
+#define RISING   3
+
+#define DEC  10
+#define HEX  16
+#define OCT  8
+#define BIN  2
+
+#define SIM_NUM_PINS  64  ///< Digital pins tracked by the simulator
+
+// Teensy LC/ 4.0 analog pin aliases
+#define A0  14
+#define A1  15
+#define A2  16
+#define A3  17
+
+#define NOT_AN_INTERRUPT  -1
+#define digitalPinToInterrupt(p)  ((p) < SIM_NUM_PINS ? (p) : NOT_AN_INTERRUPT)
+
+#define constrain(amt, low, high)  ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t value);
+int analogRead(uint8_t pin);
+void analogReadResolution(unsigned int bits);
+void analogReadAveraging(unsigned int num);
+uint32_t micros(void);
+uint32_t millis(void);
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void attachInterrupt(uint8_t pin, void (*isr)(void), int mode);
+void detachInterrupt(uint8_t pin);
+void interrupts(void);
+void noInterrupts(void);
+void yield(void);
+
+/**************************************************************************/
+/*!
+    @brief  Arduino Print base class, formats numbers and forwards bytes to write()
+*/
+/**************************************************************************/
+class Print
+{
+  private:
+    size_t _PrintNumber(unsigned long value, uint8_t base);
+
+  public:
+    virtual ~Print() { }
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    size_t write(const char *str) { return (str == NULL) ? 0 : write((const uint8_t *) str, strlen(str)); }
+    size_t write(const char *buffer, size_t size) { return write((const uint8_t *) buffer, size); }
+    virtual int availableForWrite(void) { return 0; }
+
+    size_t print(const char *str) { return write(str); }
+    size_t print(char c) { return write((uint8_t) c); }
+    size_t print(unsigned char value, int base = DEC) { return print((unsigned long) value, base); }
+    size_t print(int value, int base = DEC) { return print((long) value, base); }
+    size_t print(unsigned int value, int base = DEC) { return print((unsigned long) value, base); }
+    size_t print(long value, int base = DEC);
+    size_t print(unsigned long value, int base = DEC);
+    size_t print(double value, int digits = 2);
+
+    size_t println(void) { return write("\r\n"); }
+    template <typename T> size_t println(T value) { size_t n = print(value); return n + println(); }
+    template <typename T> size_t println(T value, int format) { size_t n = print(value, format); return n + println(); }
+};
+
+/**************************************************************************/
+/*!
+    @brief  Arduino Stream base class
+*/
+/**************************************************************************/
+class Stream : public Print
+{
+  public:
+    virtual int available(void) = 0;
+    virtual int read(void) = 0;
+    virtual int peek(void) { return -1; }
+};
+
+/**************************************************************************/
+/*!
+    @brief  Teensy USB serial port, output captured by SimHal, input fed from the timeline
+*/
+/**************************************************************************/
+class usb_serial_class : public Stream
+{
+  public:
+    void begin(long baud) { (void) baud; }
+    size_t write(uint8_t c);
+    size_t write(const uint8_t *buffer, size_t size);
+    using Print::write;
+    int availableForWrite(void);
+    int available(void);
+    int read(void);
+    void flush(void) { }
+    void send_now(void);
+    operator bool() { return true; }
+};
+
+extern usb_serial_class Serial;
+extern volatile uint8_t usb_configuration;  ///< Nonzero once the host has configured the device, always in the sim
+
+#define MIDI_INTERFACE  2  ///< The simulated USB type includes MIDI, see usbMIDI
+
+/**************************************************************************/
+/*!
+    @brief  Teensy USB-MIDI interface, messages are timestamped and logged by SimHal
+*/
+/**************************************************************************/
+class usb_midi_class
+{
+  public:
+    void send(uint8_t type, uint8_t data1, uint8_t data2, uint8_t channel, uint8_t cable);
+    void send_now(void);
+};
+
+extern usb_midi_class usbMIDI;
+
+#endif  // __SIM_ARDUINO_H__
@@ -0,0 +1,307 @@
+/*!
+ * @file FakeI2cBus.cpp
+ *
+ * \brief Host-side I2cBusDriver that simulates register-mapped devices
+ *
+ * Lets the I2cEngine scheduling be exercised on Linux: attach the QT1070,
+ * QT2120 and MMA8452Q addresses, preload their registers, submit
+ * transactions and step the engines, then inspect the log for ordering and overlap.
+ * Injected faults exercise the engine's NACK, retry and timeout handling.
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#include <string.h>
+
+#include "FakeI2cBus.hpp"
+
+/**************************************************************************/
+/*!
+    @brief    Create an empty fake bus
+    @param    ticksPerByte
+              Poll() calls each byte takes, 9 models one tick per SCL cycle
+*/
+/**************************************************************************/
+FakeI2cBus::FakeI2cBus(uint32_t ticksPerByte)
+{
+  memset(_addrs, 0, sizeof(_addrs));
+  memset(_regs, 0, sizeof(_regs));
+  memset(_log, 0, sizeof(_log));
+  _numDevices = 0;
+  _ticksPerByte = (ticksPerByte > 0) ? ticksPerByte : 1;
+  _tick = 0;
+  _busyUntil = 0;
+  _startTick = 0;
+  _txn = NULL;
+  _faultStatus = I2C_STATUS_DONE;
+  _faultCount = 0;
+  _isHung = false;
+  _clockHz = 0;
+  _recoveries = 0;
+  _logCount = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Attach a device that will ACK its address
+    @param    addr
+              7-bit device address
+    @return   Pointer to the device's 256 registers, NULL if the bus is full
+*/
+/**************************************************************************/
+uint8_t *FakeI2cBus::AddDevice(uint8_t addr)
+{
+  int index = _FindDevice(addr);
+  if (index >= 0)
+  {
+    return _regs[index];
+  }
+  if (_numDevices >= FAKE_I2C_MAX_DEVICES)
+  {
+    return NULL;
+  }
+  _addrs[_numDevices] = addr;
+  return _regs[_numDevices++];
+}
+
+/**************************************************************************/
+/*!
+    @brief    Get the register map of an attached device
+    @return   Pointer to the device's 256 registers, NULL if not attached
+*/
+/**************************************************************************/
+uint8_t *FakeI2cBus::Registers(uint8_t addr)
+{
+  int index = _FindDevice(addr);
+  return (index >= 0) ? _regs[index] : NULL;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Make the next transactions fail, whatever device they address
+    @param    status
+              I2C_STATUS_NACK or I2C_STATUS_ERROR to end with that status,
+              I2C_STATUS_TIMEOUT to stay busy until Recover()
+    @param    count
+              Number of transactions to fail
+*/
+/**************************************************************************/
+void FakeI2cBus::InjectFault(uint8_t status, uint8_t count)
+{
+  _faultStatus = status;
+  _faultCount = count;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Begin a transaction, it completes after its bytes' worth of ticks
+    @return   False if a transaction is already active
+*/
+/**************************************************************************/
+bool FakeI2cBus::Start(I2cTransaction *txn)
+{
+  if (_txn != NULL)
+  {
+    return false;
+  }
+  // Address byte per segment plus the data bytes
+  uint32_t bytes = txn->writeLen + txn->readLen;
+  bytes += (txn->writeLen > 0) ? 1 : 0;
+  bytes += (txn->readLen > 0) ? 1 : 0;
+
+  _txn = txn;
+  _startTick = _tick;
+  _busyUntil = _tick + bytes * _ticksPerByte;
+  _isHung = (_faultCount > 0 && _faultStatus == I2C_STATUS_TIMEOUT);
+  if (_isHung)
+  {
+    _faultCount--;
+  }
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Advance the bus by one tick
+    @return   I2C_STATUS_BUSY until the active transaction's time is up
+*/
+/**************************************************************************/
+uint8_t FakeI2cBus::Poll(void)
+{
+  _tick++;
+  if (_txn == NULL)
+  {
+    return I2C_STATUS_ERROR;
+  }
+  if (_isHung || _tick < _busyUntil)
+  {
+    return I2C_STATUS_BUSY;
+  }
+
+  uint8_t status;
+  if (_faultCount > 0)
+  {
+    status = _faultStatus;
+    _faultCount--;
+  }
+  else
+  {
+    status = _Execute();
+  }
+  _Log(status);
+  _txn = NULL;
+  return status;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Remember the SCL rate, the fake bus runs at a fixed tick rate regardless
+    @return   Always True
+*/
+/**************************************************************************/
+bool FakeI2cBus::SetClock(uint32_t hz)
+{
+  _clockHz = hz;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Abandon the active transaction, logged as I2C_STATUS_TIMEOUT
+*/
+/**************************************************************************/
+void FakeI2cBus::Recover(void)
+{
+  _recoveries++;
+  if (_txn != NULL)
+  {
+    _Log(I2C_STATUS_TIMEOUT);
+    _txn = NULL;
+  }
+  _isHung = false;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Number of Poll() calls made so far
+*/
+/**************************************************************************/
+uint32_t FakeI2cBus::GetTick(void) const
+{
+  return _tick;
+}
+
+/**************************************************************************/
+/*!
+    @brief    SCL rate from the last SetClock(), 0 if never set
+*/
+/**************************************************************************/
+uint32_t FakeI2cBus::GetClock(void) const
+{
+  return _clockHz;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Number of Recover() calls made so far
+*/
+/**************************************************************************/
+uint32_t FakeI2cBus::GetRecoveries(void) const
+{
+  return _recoveries;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Total number of transactions completed on this bus
+*/
+/**************************************************************************/
+uint32_t FakeI2cBus::GetLogCount(void) const
+{
+  return _logCount;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Look up a completed transaction, oldest retained first
+    @param    index
+              0 for the first completed transaction
+    @return   Log entry, or NULL if index is out of range or already overwritten
+*/
+/**************************************************************************/
+const FakeI2cLogEntry *FakeI2cBus::GetLogEntry(uint32_t index) const
+{
+  if (index >= _logCount || _logCount - index > FAKE_I2C_LOG_LEN)
+  {
+    return NULL;
+  }
+  return &_log[index % FAKE_I2C_LOG_LEN];
+}
+
+/**************************************************************************/
+/*!
+    @brief    Find an attached device by address
+    @return   Index into _regs, or -1 if not attached
+*/
+/**************************************************************************/
+int FakeI2cBus::_FindDevice(uint8_t addr) const
+{
+  for (uint8_t i=0; i<_numDevices; i++)
+  {
+    if (_addrs[i] == addr)
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Apply the active transaction to the register map
+    @return   Final I2C_STATUS_* value
+*/
+/**************************************************************************/
+uint8_t FakeI2cBus::_Execute(void)
+{
+  int index = _FindDevice(_txn->addr);
+  if (index < 0)
+  {
+    return I2C_STATUS_NACK;
+  }
+
+  uint8_t *regs = _regs[index];
+  uint8_t reg = (_txn->writeLen > 0) ? _txn->writeBuf[0] : 0;
+  for (uint8_t i=1; i<_txn->writeLen; i++)
+  {
+    regs[reg++] = _txn->writeBuf[i];
+  }
+
+  // Reads continue from the address pointer the write left behind
+  for (uint8_t i=0; i<_txn->readLen; i++)
+  {
+    _txn->readBuf[i] = regs[reg++];
+  }
+  _txn->readCount = _txn->readLen;
+  return I2C_STATUS_DONE;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Append the active transaction to the log
+    @param    status
+              Final I2C_STATUS_* value it ended with
+*/
+/**************************************************************************/
+void FakeI2cBus::_Log(uint8_t status)
+{
+  FakeI2cLogEntry &entry = _log[_logCount % FAKE_I2C_LOG_LEN];
+  entry.startTick = _startTick;
+  entry.endTick = _tick;
+  entry.addr = _txn->addr;
+  entry.reg = (_txn->writeLen > 0) ? _txn->writeBuf[0] : 0xFF;
+  entry.writeLen = _txn->writeLen;
+  entry.readLen = _txn->readLen;
+  entry.status = status;
+  _logCount++;
+}
@@ -0,0 +1,82 @@
+/*!
+ * @file FakeI2cBus.hpp
+ *
+ * \brief Header for host-side I2cBusDriver that simulates register-mapped devices
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#ifndef __FAKE_I2C_BUS_HPP__
+#define __FAKE_I2C_BUS_HPP__
+
+#include <stdint.h>
+#include "I2cEngine.hpp"
+
+#define FAKE_I2C_MAX_DEVICES  4  ///< Devices that can be attached to one fake bus
+#define FAKE_I2C_LOG_LEN  64  ///< Completed transactions remembered for inspection
+
+/**************************************************************************/
+/*!
+    @brief  One completed transaction as seen by the fake bus
+*/
+/**************************************************************************/
+struct FakeI2cLogEntry
+{
+  uint32_t startTick;  ///< Bus tick at which the transaction was started
+  uint32_t endTick;  ///< Bus tick at which the transaction completed
+  uint8_t addr;  ///< Device address
+  uint8_t reg;  ///< First register written, 0xFF for a pure read
+  uint8_t writeLen;  ///< Bytes written including the register address
+  uint8_t readLen;  ///< Bytes read
+  uint8_t status;  ///< Final I2C_STATUS_* value
+};
+
+/**************************************************************************/
+/*!
+    @brief  I2cBusDriver with a 256-byte auto-increment register map per device
+    Every Poll() call is one bus tick; a transaction takes ticksPerByte ticks
+    for each address and data byte it puts on the wire, so tests can see
+    whether two engines really overlapped their transfers. InjectFault()
+    makes the next transactions NACK, fail or hang until Recover().
+*/
+/**************************************************************************/
+class FakeI2cBus : public I2cBusDriver
+{
+  private:
+    uint8_t _addrs[FAKE_I2C_MAX_DEVICES];  ///< Addresses of attached devices
+    uint8_t _regs[FAKE_I2C_MAX_DEVICES][256];  ///< Register maps of attached devices
+    uint8_t _numDevices;  ///< Number of attached devices
+    uint32_t _ticksPerByte;  ///< Bus ticks consumed per byte on the wire
+    uint32_t _tick;  ///< Number of Poll() calls so far
+    uint32_t _busyUntil;  ///< Tick at which the active transaction completes
+    uint32_t _startTick;  ///< Tick at which the active transaction started
+    I2cTransaction *_txn;  ///< Active transaction
+    uint8_t _faultStatus;  ///< I2C_STATUS_* the next _faultCount transactions end with
+    uint8_t _faultCount;  ///< Transactions still to fail with _faultStatus
+    bool _isHung;  ///< True while the active transaction never finishes
+    uint32_t _clockHz;  ///< Rate from the last SetClock()
+    uint32_t _recoveries;  ///< Recover() calls so far
+    FakeI2cLogEntry _log[FAKE_I2C_LOG_LEN];  ///< Ring of completed transactions
+    uint32_t _logCount;  ///< Total completed transactions
+
+    int _FindDevice(uint8_t addr) const;
+    uint8_t _Execute(void);
+    void _Log(uint8_t status);
+
+  public:
+    FakeI2cBus(uint32_t ticksPerByte = 9);
+    uint8_t *AddDevice(uint8_t addr);
+    uint8_t *Registers(uint8_t addr);
+    void InjectFault(uint8_t status, uint8_t count);
+    bool Start(I2cTransaction *txn);
+    uint8_t Poll(void);
+    bool SetClock(uint32_t hz);
+    void Recover(void);
+    uint32_t GetTick(void) const;
+    uint32_t GetClock(void) const;
+    uint32_t GetRecoveries(void) const;
+    uint32_t GetLogCount(void) const;
+    const FakeI2cLogEntry *GetLogEntry(uint32_t index) const;
+};
+
+#endif  // __FAKE_I2C_BUS_HPP__
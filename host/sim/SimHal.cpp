@@ -0,0 +1,1140 @@
+/*!
+ * @file SimHal.cpp
+ *
+ * \brief Simulated hardware behind the host Arduino API
+ *
+ * Everything here is plain file-static state so it is valid during the
+ * sketch's global constructors, before main() runs.
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "Arduino.h"
+#include "SimHal.hpp"
+
+#define SIM_MMA8452Q_BUS  1  ///< Bus the "imu" timeline event writes to
+#define SIM_MMA8452Q_ADDR  0x1D  ///< Address the "imu" timeline event writes to
+#define SIM_MMA8452Q_STATUS_ZYXDR  0x08  ///< STATUS bit set by the "imu" event
+#define SIM_MMA8452Q_OUT_Z_MSB  0x05  ///< Reading this clears ZYXDR
+#define SIM_MMA8452Q_OUT_Z_LSB  0x06  ///< Last output register of a 12-bit burst
+#define SIM_MMA8452Q_PL_STATUS  0x10  ///< PL_STATUS, reading it clears NEWLP
+#define SIM_MMA8452Q_PL_NEWLP  0x80  ///< PL_STATUS new orientation bit
+#define SIM_MMA8452Q_WHOAMI  0x0D  ///< WHOAMI register
+#define SIM_MMA8452Q_WHOAMI_VAL  0x2A  ///< WHOAMI value
+#define SIM_MMA8452Q_CTRL1  0x2A  ///< CTRL_REG1, holds F_READ
+#define SIM_MMA8452Q_CTRL1_F_READ  0x02  ///< CTRL_REG1 fast-read bit
+#define SIM_MMA8452Q_CTRL1_ACTIVE  0x01  ///< CTRL_REG1 active bit
+#define SIM_MMA8452Q_CTRL1_DR_SHIFT  3  ///< CTRL_REG1 data rate field position
+
+#define SIM_ULTRA_BURST_US  450  ///< Trigger falling edge to echo rising edge, the HC-SR04 sends its 40kHz burst meanwhile
+#define SIM_ULTRA_NO_ECHO_US  38000  ///< Echo pulse width the HC-SR04 reports when nothing is in range
+#define SIM_I2C_STUCK_CLOCKS  3  ///< SCL falling edges an "i2cstuck" device needs to finish its byte and let go of SDA
+#define SIM_ENCODER_EDGE_US  20000  ///< Time between the quadrature edges of an "encoder" event, a slow turn of 80ms per detent
+
+#define SIM_EVENT_DIGITAL  0
+#define SIM_EVENT_ANALOG   1
+#define SIM_EVENT_REG      2
+#define SIM_EVENT_QTOUCH   3
+#define SIM_EVENT_IMU      4
+#define SIM_EVENT_ENCODER  5
+#define SIM_EVENT_ECHO     6
+#define SIM_EVENT_SERIAL   7
+#define SIM_EVENT_END      8
+#define SIM_EVENT_ORIENT   9
+#define SIM_EVENT_TXSPACE  10
+#define SIM_EVENT_I2CSTUCK  11
+
+/**************************************************************************/
+/*!
+    @brief  One parsed timeline line
+*/
+/**************************************************************************/
+struct SimEvent
+{
+  uint32_t time;  ///< Virtual micros() at which to apply the event
+  uint32_t order;  ///< Line order, keeps same-time events stable
+  uint8_t kind;  ///< SIM_EVENT_*
+  long args[4];  ///< Numeric arguments
+  std::string text;  ///< Payload of serial events
+  bool isGenerated;  ///< Scheduled by simulated hardware rather than read from the timeline
+};
+
+static uint32_t simNow;
+static int digitalLevels[SIM_NUM_PINS];
+static int analogLevels[SIM_NUM_PINS];
+static unsigned int analogBits = SIM_ANALOG_BITS;
+static void (*isrs[SIM_NUM_PINS])(void);
+static int isrModes[SIM_NUM_PINS];
+static bool isInterruptsEnabled = true;
+static uint64_t pendingIsrMask;
+
+static SimI2cDevice devices[SIM_NUM_BUSES][SIM_MAX_DEVICES];
+static uint8_t numDevices[SIM_NUM_BUSES];
+static uint32_t busTransactions[SIM_NUM_BUSES];
+static int busSdaPins[SIM_NUM_BUSES];
+static int busSclPins[SIM_NUM_BUSES];
+static uint8_t busStuckClocks[SIM_NUM_BUSES];
+
+static FILE *serialSink;
+static uint64_t serialBytes;
+static uint64_t serialFlushes;
+static int serialWriteSpace = 4096;
+static std::string serialInput;
+
+static FILE *midiSink;
+static uint64_t midiMessages;
+static uint32_t midiMaxNoteLatency;
+static uint32_t lastInputTime;
+
+static int encoderPinA = SIM_NO_PIN;
+static int encoderPinC = SIM_NO_PIN;
+static uint8_t encoderPhase;
+static uint32_t encoderBusyUntil;
+static uint32_t echoMicros;
+static int ultraTrigPin = SIM_NO_PIN;
+static int ultraEchoPin = SIM_NO_PIN;
+static uint32_t ultraBusyUntil;
+
+static std::vector<SimEvent> timeline;
+static size_t timelineIndex;
+static uint32_t endTime;
+
+usb_serial_class Serial;
+usb_midi_class usbMIDI;
+volatile uint8_t usb_configuration = 1;
+
+static void ApplyDueEvents(void);
+static void ScheduleEvent(SimEvent event);
+static void OnUltrasonicTrigger(void);
+static void TurnEncoder(int32_t edges);
+static void OnI2cPin(uint8_t pin, int old);
+
+/**************************************************************************/
+/*!
+    @brief    Return every piece of simulated hardware to its power-on state
+*/
+/**************************************************************************/
+void SimHal::Reset(void)
+{
+  simNow = 0;
+  memset(digitalLevels, 0, sizeof(digitalLevels));
+  memset(analogLevels, 0, sizeof(analogLevels));
+  analogBits = SIM_ANALOG_BITS;
+  memset(isrs, 0, sizeof(isrs));
+  memset(isrModes, 0, sizeof(isrModes));
+  isInterruptsEnabled = true;
+  pendingIsrMask = 0;
+  memset(devices, 0, sizeof(devices));
+  memset(numDevices, 0, sizeof(numDevices));
+  memset(busTransactions, 0, sizeof(busTransactions));
+  for (uint8_t bus=0; bus<SIM_NUM_BUSES; bus++)
+  {
+    busSdaPins[bus] = SIM_NO_PIN;
+    busSclPins[bus] = SIM_NO_PIN;
+  }
+  memset(busStuckClocks, 0, sizeof(busStuckClocks));
+  serialSink = NULL;
+  serialBytes = 0;
+  serialFlushes = 0;
+  serialWriteSpace = 4096;
+  midiSink = NULL;
+  midiMessages = 0;
+  midiMaxNoteLatency = 0;
+  lastInputTime = 0;
+  serialInput.clear();
+  encoderPinA = SIM_NO_PIN;
+  encoderPinC = SIM_NO_PIN;
+  encoderPhase = 0;
+  encoderBusyUntil = 0;
+  echoMicros = 0;
+  ultraTrigPin = SIM_NO_PIN;
+  ultraEchoPin = SIM_NO_PIN;
+  ultraBusyUntil = 0;
+  timeline.clear();
+  timelineIndex = 0;
+  endTime = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Current virtual time in microseconds
+*/
+/**************************************************************************/
+uint32_t SimHal::Now(void)
+{
+  return simNow;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Move the virtual clock forward, applying timeline events on the way
+    @param    us
+              Microseconds to advance
+*/
+/**************************************************************************/
+void SimHal::Advance(uint32_t us)
+{
+  uint32_t target = simNow + us;
+
+  // Step event by event so interrupts fire at their scripted time
+  while (timelineIndex < timeline.size() && (int32_t) (timeline[timelineIndex].time - target) <= 0)
+  {
+    if ((int32_t) (timeline[timelineIndex].time - simNow) > 0)
+    {
+      simNow = timeline[timelineIndex].time;
+    }
+    ApplyDueEvents();
+  }
+  simNow = target;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Drive an input pin, firing an attached interrupt on a matching edge
+*/
+/**************************************************************************/
+void SimHal::SetDigital(uint8_t pin, int value)
+{
+  if (pin >= SIM_NUM_PINS)
+  {
+    return;
+  }
+  int old = digitalLevels[pin];
+  digitalLevels[pin] = value ? HIGH : LOW;
+  if (pin == ultraTrigPin && old == HIGH && digitalLevels[pin] == LOW)
+  {
+    OnUltrasonicTrigger();
+  }
+  OnI2cPin(pin, old);
+  if (isrs[pin] == NULL || old == digitalLevels[pin])
+  {
+    return;
+  }
+
+  bool isRising = (digitalLevels[pin] == HIGH);
+  int mode = isrModes[pin];
+  if (mode == CHANGE || (mode == RISING && isRising) || (mode == FALLING && !isRising))
+  {
+    if (isInterruptsEnabled)
+    {
+      isrs[pin]();
+    }
+    else
+    {
+      pendingIsrMask |= (uint64_t) 1 << pin;
+    }
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Current level of a pin
+*/
+/**************************************************************************/
+int SimHal::GetDigital(uint8_t pin)
+{
+  return (pin < SIM_NUM_PINS) ? digitalLevels[pin] : LOW;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Set the level of an analog pin, in SIM_ANALOG_BITS counts
+*/
+/**************************************************************************/
+void SimHal::SetAnalog(uint8_t pin, int value)
+{
+  if (pin < SIM_NUM_PINS)
+  {
+    analogLevels[pin] = value;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Value analogRead() returns for a pin at the analogReadResolution() in effect
+*/
+/**************************************************************************/
+int SimHal::GetAnalog(uint8_t pin)
+{
+  int level = (pin < SIM_NUM_PINS) ? analogLevels[pin] : 0;
+  return (analogBits >= SIM_ANALOG_BITS) ? level << (analogBits - SIM_ANALOG_BITS) : level >> (SIM_ANALOG_BITS - analogBits);
+}
+
+/**************************************************************************/
+/*!
+    @brief    Backing for analogReadResolution()
+*/
+/**************************************************************************/
+void SimHal::SetAnalogResolution(unsigned int bits)
+{
+  analogBits = bits;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Backing for attachInterrupt()
+*/
+/**************************************************************************/
+void SimHal::AttachInterrupt(uint8_t pin, void (*isr)(void), int mode)
+{
+  if (pin < SIM_NUM_PINS)
+  {
+    isrs[pin] = isr;
+    isrModes[pin] = mode;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Backing for detachInterrupt()
+*/
+/**************************************************************************/
+void SimHal::DetachInterrupt(uint8_t pin)
+{
+  if (pin < SIM_NUM_PINS)
+  {
+    isrs[pin] = NULL;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Backing for interrupts()/ noInterrupts(), runs edges latched while masked
+*/
+/**************************************************************************/
+void SimHal::SetInterruptsEnabled(bool isEnabled)
+{
+  isInterruptsEnabled = isEnabled;
+  while (isInterruptsEnabled && pendingIsrMask)
+  {
+    uint8_t pin = __builtin_ctzll(pendingIsrMask);
+    pendingIsrMask &= ~((uint64_t) 1 << pin);
+    if (isrs[pin] != NULL)
+    {
+      isrs[pin]();
+    }
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Attach a device to a bus, or return the one already at addr
+    @return   Device, or NULL if the bus is full or invalid
+*/
+/**************************************************************************/
+SimI2cDevice *SimHal::AddDevice(uint8_t bus, uint8_t addr)
+{
+  if (bus >= SIM_NUM_BUSES)
+  {
+    return NULL;
+  }
+  SimI2cDevice *dev = FindDevice(bus, addr);
+  if (dev != NULL || numDevices[bus] >= SIM_MAX_DEVICES)
+  {
+    return dev;
+  }
+  dev = &devices[bus][numDevices[bus]++];
+  memset(dev, 0, sizeof(*dev));
+  dev->addr = addr;
+  dev->changePin = SIM_NO_PIN;
+  dev->maxClockHz = SIM_I2C_MAX_CLOCK_HZ;
+  return dev;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Look up an attached device
+    @return   Device, or NULL if nothing ACKs addr on bus
+*/
+/**************************************************************************/
+SimI2cDevice *SimHal::FindDevice(uint8_t bus, uint8_t addr)
+{
+  if (bus >= SIM_NUM_BUSES)
+  {
+    return NULL;
+  }
+  for (uint8_t i=0; i<numDevices[bus]; i++)
+  {
+    if (devices[bus][i].addr == addr)
+    {
+      return &devices[bus][i];
+    }
+  }
+  return NULL;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Wire a device's active-low CHANGE output to a pin, idle HIGH
+    @param    firstReg
+              First register whose read releases the line
+    @param    lastReg
+              Last register whose read releases the line
+*/
+/**************************************************************************/
+void SimHal::BindChangePin(uint8_t bus, uint8_t addr, int pin, uint8_t firstReg, uint8_t lastReg)
+{
+  SimI2cDevice *dev = AddDevice(bus, addr);
+  if (dev == NULL)
+  {
+    return;
+  }
+  dev->changePin = pin;
+  dev->changeFirst = firstReg;
+  dev->changeLast = lastReg;
+  SetDigital(pin, HIGH);
+}
+
+/**************************************************************************/
+/*!
+    @brief    Read one register, moving the pointer and releasing the CHANGE line if it is a status register
+    @return   Register value
+*/
+/**************************************************************************/
+uint8_t SimHal::ReadDeviceReg(SimI2cDevice *dev)
+{
+  uint8_t reg = dev->pointer;
+  uint8_t value = (dev->readReg != NULL) ? dev->readReg(dev) : dev->regs[dev->pointer++];
+
+  if (dev->changePin != SIM_NO_PIN && reg >= dev->changeFirst && reg <= dev->changeLast)
+  {
+    SetDigital(dev->changePin, HIGH);
+  }
+  return value;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Read one MMA8452Q register
+    While active, the chip converts a new sample every output data period,
+    re-setting ZYXDR on the held x/y/z values. F_READ bursts skip the LSB
+    registers and both modes wrap from the last output register to STATUS.
+*/
+/**************************************************************************/
+static uint8_t Mma8452qReadReg(SimI2cDevice *dev)
+{
+  static const uint32_t periods[] = { 1250, 2500, 5000, 10000, 20000, 80000, 160000, 640000 };
+  uint8_t ctrl1 = dev->regs[SIM_MMA8452Q_CTRL1];
+  bool isFastRead = (ctrl1 & SIM_MMA8452Q_CTRL1_F_READ) != 0;
+  uint8_t reg = dev->pointer++;
+
+  if (reg == 0 && (ctrl1 & SIM_MMA8452Q_CTRL1_ACTIVE))
+  {
+    uint32_t period = periods[(ctrl1 >> SIM_MMA8452Q_CTRL1_DR_SHIFT) & 0x7];
+    uint32_t elapsed = SimHal::Now() - dev->sampleTime;
+    if (elapsed >= period)
+    {
+      dev->sampleTime += elapsed - elapsed % period;
+      dev->regs[0] |= SIM_MMA8452Q_STATUS_ZYXDR;
+    }
+  }
+  uint8_t value = dev->regs[reg];
+
+  if (reg == SIM_MMA8452Q_PL_STATUS)
+  {
+    dev->regs[reg] &= ~SIM_MMA8452Q_PL_NEWLP;
+  }
+  if (reg == SIM_MMA8452Q_OUT_Z_MSB)
+  {
+    dev->regs[0] &= ~SIM_MMA8452Q_STATUS_ZYXDR;
+    dev->pointer = isFastRead ? 0 : SIM_MMA8452Q_OUT_Z_LSB;
+  }
+  else if (reg == SIM_MMA8452Q_OUT_Z_LSB)
+  {
+    dev->pointer = 0;
+  }
+  else if (isFastRead && reg >= 1 && reg < SIM_MMA8452Q_OUT_Z_MSB && (reg % 2))
+  {
+    dev->pointer = reg + 2;
+  }
+  return value;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Attach an MMA8452Q whose active-low INT line releases once a sample is read
+    @param    intPin
+              Pin its data-ready line is wired to, or SIM_NO_PIN
+*/
+/**************************************************************************/
+SimI2cDevice *SimHal::AddMma8452q(uint8_t bus, uint8_t addr, int intPin)
+{
+  SimI2cDevice *dev = AddDevice(bus, addr);
+  if (dev == NULL)
+  {
+    return NULL;
+  }
+  dev->regs[SIM_MMA8452Q_WHOAMI] = SIM_MMA8452Q_WHOAMI_VAL;
+  dev->readReg = Mma8452qReadReg;
+  if (intPin != SIM_NO_PIN)
+  {
+    BindChangePin(bus, addr, intPin, SIM_MMA8452Q_OUT_Z_MSB, SIM_MMA8452Q_OUT_Z_MSB);
+  }
+  return dev;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Number of address-phase transactions seen on a bus
+*/
+/**************************************************************************/
+uint32_t SimHal::GetI2cTransactions(uint8_t bus)
+{
+  return (bus < SIM_NUM_BUSES) ? busTransactions[bus] : 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Count one address-phase transaction on a bus
+*/
+/**************************************************************************/
+void SimHal::CountI2cTransaction(uint8_t bus)
+{
+  if (bus < SIM_NUM_BUSES)
+  {
+    busTransactions[bus]++;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Name the pins a bus's SDA and SCL are on, both idle HIGH
+    Needed for "i2cstuck" events, whose stuck device watches SCL for the
+    clocks that free it and holds SDA LOW until then.
+*/
+/**************************************************************************/
+void SimHal::SetI2cPins(uint8_t bus, int sdaPin, int sclPin)
+{
+  if (bus >= SIM_NUM_BUSES)
+  {
+    return;
+  }
+  busSdaPins[bus] = sdaPin;
+  busSclPins[bus] = sclPin;
+  SetDigital(sdaPin, HIGH);
+  SetDigital(sclPin, HIGH);
+}
+
+/**************************************************************************/
+/*!
+    @brief    Check whether a device is holding a bus's SDA LOW
+    @return   True while every transfer on bus fails
+*/
+/**************************************************************************/
+bool SimHal::IsI2cStuck(uint8_t bus)
+{
+  return (bus < SIM_NUM_BUSES) && busStuckClocks[bus] > 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Where Serial output goes, NULL to only count bytes
+*/
+/**************************************************************************/
+void SimHal::SetSerialSink(FILE *sink)
+{
+  serialSink = sink;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Capture bytes written to Serial
+*/
+/**************************************************************************/
+void SimHal::SerialOut(const uint8_t *data, size_t len)
+{
+  serialBytes += len;
+  if (serialSink != NULL)
+  {
+    fwrite(data, 1, len, serialSink);
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Total bytes written to Serial
+*/
+/**************************************************************************/
+uint64_t SimHal::GetSerialBytes(void)
+{
+  return serialBytes;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Set what Serial.availableForWrite() reports, 0 models a stalled host
+*/
+/**************************************************************************/
+void SimHal::SetSerialWriteSpace(int bytes)
+{
+  serialWriteSpace = bytes;
+}
+
+/**************************************************************************/
+/*!
+    @brief    What Serial.availableForWrite() reports
+*/
+/**************************************************************************/
+int SimHal::GetSerialWriteSpace(void)
+{
+  return serialWriteSpace;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Count one Serial.send_now()
+*/
+/**************************************************************************/
+void SimHal::CountSerialFlush(void)
+{
+  serialFlushes++;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Total Serial.send_now() calls
+*/
+/**************************************************************************/
+uint64_t SimHal::GetSerialFlushes(void)
+{
+  return serialFlushes;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Bytes the host has sent that the sketch has not read yet
+*/
+/**************************************************************************/
+int SimHal::SerialAvailable(void)
+{
+  return (int) serialInput.size();
+}
+
+/**************************************************************************/
+/*!
+    @brief    Take the next byte the host sent, -1 if none
+*/
+/**************************************************************************/
+int SimHal::SerialRead(void)
+{
+  if (serialInput.empty())
+  {
+    return -1;
+  }
+  int c = (uint8_t) serialInput[0];
+  serialInput.erase(0, 1);
+  return c;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Log every usbMIDI message to sink, NULL to only count them
+*/
+/**************************************************************************/
+void SimHal::SetMidiSink(FILE *sink)
+{
+  midiSink = sink;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Record one usbMIDI message with its time and the time since the last input event
+    @param    status
+              Status byte, message type and 0-based channel
+    @param    data1
+              First data byte
+    @param    data2
+              Second data byte
+*/
+/**************************************************************************/
+void SimHal::MidiOut(uint8_t status, uint8_t data1, uint8_t data2)
+{
+  uint32_t latency = simNow - lastInputTime;
+
+  midiMessages++;
+  if ((status & 0xE0) == 0x80 && latency > midiMaxNoteLatency)
+  {
+    midiMaxNoteLatency = latency;
+  }
+  if (midiSink != NULL)
+  {
+    fprintf(midiSink, "%lu %lu %02X %u %u\n", (unsigned long) simNow, (unsigned long) latency, status, data1, data2);
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Total usbMIDI messages sent
+*/
+/**************************************************************************/
+uint64_t SimHal::GetMidiMessages(void)
+{
+  return midiMessages;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Longest time from a timeline input event to a usbMIDI note on or off that followed it
+*/
+/**************************************************************************/
+uint32_t SimHal::GetMaxNoteLatency(void)
+{
+  return midiMaxNoteLatency;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Wire a quadrature encoder whose lines "encoder" events toggle
+    @param    pinA
+              A line of the encoder
+    @param    pinC
+              C line of the encoder
+*/
+/**************************************************************************/
+void SimHal::AddEncoder(int pinA, int pinC)
+{
+  encoderPinA = pinA;
+  encoderPinC = pinC;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Wire an HC-SR04 style rangefinder: a falling edge on trigPin
+              produces a pulse on echoPin as wide as the last "echo" event
+    @param    trigPin
+              Trigger input of the sensor
+    @param    echoPin
+              Echo output of the sensor
+*/
+/**************************************************************************/
+void SimHal::AddUltrasonic(int trigPin, int echoPin)
+{
+  ultraTrigPin = trigPin;
+  ultraEchoPin = echoPin;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Schedule the echo pulse for a trigger, ignored while the last pulse is in flight
+*/
+/**************************************************************************/
+static void OnUltrasonicTrigger(void)
+{
+  if (ultraEchoPin == SIM_NO_PIN || (int32_t) (simNow - ultraBusyUntil) < 0)
+  {
+    return;
+  }
+  SimEvent edge;
+  edge.order = 0;
+  edge.isGenerated = true;
+  edge.kind = SIM_EVENT_DIGITAL;
+  edge.args[0] = ultraEchoPin;
+  edge.args[1] = HIGH;
+  edge.time = simNow + SIM_ULTRA_BURST_US;
+  ScheduleEvent(edge);
+  edge.args[1] = LOW;
+  edge.time += (echoMicros != 0) ? echoMicros : SIM_ULTRA_NO_ECHO_US;
+  ScheduleEvent(edge);
+  ultraBusyUntil = edge.time;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Schedule the line changes of a turn, SIM_ENCODER_EDGE_US apart and after any turn still playing
+    @param    edges
+              Quadrature edges to move, positive goes 00 -> 01 -> 11 -> 10 on A and C
+*/
+/**************************************************************************/
+static void TurnEncoder(int32_t edges)
+{
+  static const uint8_t grayAC[4] = { 0x0, 0x1, 0x3, 0x2 };
+
+  if (encoderPinA == SIM_NO_PIN || edges == 0)
+  {
+    return;
+  }
+  uint32_t time = simNow;
+  if ((int32_t) (simNow - encoderBusyUntil) >= 0)
+  {
+    // Idle lines may have been moved by "digital" events, start from where they are
+    uint8_t ac = (digitalLevels[encoderPinA] == HIGH ? 0x2 : 0) | (digitalLevels[encoderPinC] == HIGH ? 0x1 : 0);
+    for (encoderPhase=0; grayAC[encoderPhase] != ac; encoderPhase++) { }
+  }
+  else
+  {
+    time = encoderBusyUntil;
+  }
+
+  SimEvent edge;
+  edge.order = 0;
+  edge.isGenerated = true;
+  edge.kind = SIM_EVENT_DIGITAL;
+  for (int32_t i=0; i<((edges < 0) ? -edges : edges); i++)
+  {
+    uint8_t prev = grayAC[encoderPhase];
+    encoderPhase = (encoderPhase + ((edges < 0) ? 3 : 1)) & 0x3;
+    uint8_t changed = prev ^ grayAC[encoderPhase];
+    time += SIM_ENCODER_EDGE_US;
+    edge.time = time;
+    edge.args[0] = (changed & 0x2) ? encoderPinA : encoderPinC;
+    edge.args[1] = (changed & 0x2) ? (grayAC[encoderPhase] >> 1) : (grayAC[encoderPhase] & 0x1);
+    ScheduleEvent(edge);
+  }
+  encoderBusyUntil = time;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Insert a model-generated event after every pending event of the same time
+*/
+/**************************************************************************/
+static void ScheduleEvent(SimEvent event)
+{
+  event.order = (uint32_t) timeline.size();
+  std::vector<SimEvent>::iterator pos = std::upper_bound(timeline.begin() + timelineIndex, timeline.end(), event,
+      [](const SimEvent &a, const SimEvent &b) { return (int32_t) (a.time - b.time) < 0; });
+  timeline.insert(pos, event);
+}
+
+/**************************************************************************/
+/*!
+    @brief    Parse a timeline and merge it into the pending events
+    @param    in
+              Open timeline file
+    @param    name
+              File name used in error messages
+    @return   True if every line parsed, else False
+*/
+/**************************************************************************/
+bool SimHal::LoadTimeline(FILE *in, const char *name)
+{
+  static const char *const kinds[] = { "digital", "analog", "reg", "qtouch", "imu", "encoder", "echo", "serial", "end", "orient", "txspace", "i2cstuck" };
+  static const uint8_t argCounts[] = { 2, 2, 4, 4, 3, 1, 1, 0, 0, 1, 1, 1 };
+  char line[512];
+  unsigned lineNum = 0;
+  bool isOk = true;
+
+  while (fgets(line, sizeof(line), in) != NULL)
+  {
+    lineNum++;
+    char *hash = strchr(line, '#');
+    if (hash != NULL) *hash = '\0';
+
+    char *cursor = line;
+    char *end;
+    long time = strtol(cursor, &end, 0);
+    if (end == cursor)
+    {
+      continue;  // blank or comment-only line
+    }
+    cursor = end;
+    while (isspace((unsigned char) *cursor)) cursor++;
+
+    char kind[16];
+    int kindLen = 0;
+    while (*cursor && !isspace((unsigned char) *cursor) && kindLen < (int) sizeof(kind) - 1)
+    {
+      kind[kindLen++] = *cursor++;
+    }
+    kind[kindLen] = '\0';
+
+    SimEvent event;
+    event.time = (uint32_t) time;
+    event.order = (uint32_t) timeline.size();
+    event.isGenerated = false;
+    event.kind = 0xFF;
+    for (uint8_t k=0; k<sizeof(kinds) / sizeof(kinds[0]); k++)
+    {
+      if (strcmp(kind, kinds[k]) == 0)
+      {
+        event.kind = k;
+      }
+    }
+    if (event.kind == 0xFF)
+    {
+      fprintf(stderr, "%s:%u: unknown event '%s'\n", name, lineNum, kind);
+      isOk = false;
+      continue;
+    }
+
+    bool isLineOk = true;
+    for (uint8_t a=0; a<argCounts[event.kind]; a++)
+    {
+      event.args[a] = strtol(cursor, &end, 0);
+      if (end == cursor)
+      {
+        isLineOk = false;
+      }
+      cursor = end;
+    }
+    if (!isLineOk)
+    {
+      fprintf(stderr, "%s:%u: '%s' needs %u numeric arguments\n", name, lineNum, kind, argCounts[event.kind]);
+      isOk = false;
+      continue;
+    }
+    if (event.kind == SIM_EVENT_SERIAL)
+    {
+      while (*cursor == ' ' || *cursor == '\t') cursor++;
+      event.text = cursor;
+      while (!event.text.empty() && (event.text.back() == '\n' || event.text.back() == '\r'))
+      {
+        event.text.pop_back();
+      }
+    }
+    if (event.kind == SIM_EVENT_END || event.time > endTime)
+    {
+      endTime = event.time;
+    }
+    timeline.push_back(event);
+  }
+
+  std::stable_sort(timeline.begin() + timelineIndex, timeline.end(),
+                   [](const SimEvent &a, const SimEvent &b) { return (a.time != b.time) ? a.time < b.time : a.order < b.order; });
+  return isOk;
+}
+
+/**************************************************************************/
+/*!
+    @brief    True while timeline events remain to be applied
+*/
+/**************************************************************************/
+bool SimHal::HasPendingEvents(void)
+{
+  return timelineIndex < timeline.size();
+}
+
+/**************************************************************************/
+/*!
+    @brief    Time of the "end" event, or of the last event if there is none
+*/
+/**************************************************************************/
+uint32_t SimHal::GetEndTime(void)
+{
+  return endTime;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Keep a stuck bus's SDA LOW and count the SCL clocks that free it
+    @param    pin
+              Pin that was just driven
+    @param    old
+              Its level before
+*/
+/**************************************************************************/
+static void OnI2cPin(uint8_t pin, int old)
+{
+  for (uint8_t bus=0; bus<SIM_NUM_BUSES; bus++)
+  {
+    if (busStuckClocks[bus] == 0)
+    {
+      continue;
+    }
+    if (pin == busSdaPins[bus])
+    {
+      digitalLevels[pin] = LOW;
+    }
+    else if (pin == busSclPins[bus] && old == HIGH && digitalLevels[pin] == LOW && --busStuckClocks[bus] == 0)
+    {
+      digitalLevels[busSdaPins[bus]] = HIGH;
+    }
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Apply every timeline event whose time has been reached
+*/
+/**************************************************************************/
+static void ApplyDueEvents(void)
+{
+  while (timelineIndex < timeline.size() && (int32_t) (timeline[timelineIndex].time - simNow) <= 0)
+  {
+    const SimEvent &event = timeline[timelineIndex++];
+    SimI2cDevice *dev;
+    uint8_t bus;
+
+    if (!event.isGenerated && event.kind != SIM_EVENT_SERIAL && event.kind != SIM_EVENT_TXSPACE && event.kind != SIM_EVENT_END)
+    {
+      lastInputTime = event.time;
+    }
+    switch (event.kind)
+    {
+      case SIM_EVENT_DIGITAL:
+        SimHal::SetDigital((uint8_t) event.args[0], (int) event.args[1]);
+        break;
+      case SIM_EVENT_ANALOG:
+        SimHal::SetAnalog((uint8_t) event.args[0], (int) event.args[1]);
+        break;
+      case SIM_EVENT_REG:
+      case SIM_EVENT_QTOUCH:
+        dev = SimHal::AddDevice((uint8_t) event.args[0], (uint8_t) event.args[1]);
+        if (dev != NULL)
+        {
+          dev->regs[(uint8_t) event.args[2]] = (uint8_t) event.args[3];
+          if (event.kind == SIM_EVENT_QTOUCH && dev->changePin != SIM_NO_PIN)
+          {
+            SimHal::SetDigital(dev->changePin, LOW);
+          }
+        }
+        break;
+      case SIM_EVENT_IMU:
+        dev = SimHal::AddDevice(SIM_MMA8452Q_BUS, SIM_MMA8452Q_ADDR);
+        if (dev != NULL)
+        {
+          // OUT_X_MSB..OUT_Z_LSB hold left-justified 12-bit two's complement samples
+          for (uint8_t axis=0; axis<3; axis++)
+          {
+            uint16_t raw = (uint16_t) ((int16_t) event.args[axis] << 4);
+            dev->regs[1 + 2 * axis] = (uint8_t) (raw >> 8);
+            dev->regs[2 + 2 * axis] = (uint8_t) raw;
+          }
+          dev->regs[0] |= SIM_MMA8452Q_STATUS_ZYXDR;
+          if (dev->changePin != SIM_NO_PIN)
+          {
+            SimHal::SetDigital(dev->changePin, LOW);
+          }
+        }
+        break;
+      case SIM_EVENT_ORIENT:
+        dev = SimHal::AddDevice(SIM_MMA8452Q_BUS, SIM_MMA8452Q_ADDR);
+        if (dev != NULL)
+        {
+          dev->regs[SIM_MMA8452Q_PL_STATUS] = SIM_MMA8452Q_PL_NEWLP | (((uint8_t) event.args[0] & 0x3) << 1);
+        }
+        break;
+      case SIM_EVENT_ENCODER:
+        TurnEncoder((int32_t) event.args[0]);
+        break;
+      case SIM_EVENT_ECHO:
+        echoMicros = (uint32_t) event.args[0];
+        break;
+      case SIM_EVENT_SERIAL:
+        serialInput += event.text;
+        break;
+      case SIM_EVENT_TXSPACE:
+        SimHal::SetSerialWriteSpace((int) event.args[0]);
+        break;
+      case SIM_EVENT_I2CSTUCK:
+        bus = (uint8_t) event.args[0];
+        if (bus < SIM_NUM_BUSES && busSdaPins[bus] != SIM_NO_PIN)
+        {
+          busStuckClocks[bus] = SIM_I2C_STUCK_CLOCKS;
+          digitalLevels[busSdaPins[bus]] = LOW;
+        }
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Arduino core functions, backed by SimHal
+*/
+/**************************************************************************/
+void pinMode(uint8_t pin, uint8_t mode) { (void) pin; (void) mode; }
+int digitalRead(uint8_t pin) { return SimHal::GetDigital(pin); }
+void digitalWrite(uint8_t pin, uint8_t value) { SimHal::SetDigital(pin, value); }
+int analogRead(uint8_t pin) { return SimHal::GetAnalog(pin); }
+void analogReadResolution(unsigned int bits) { SimHal::SetAnalogResolution(bits); }
+void analogReadAveraging(unsigned int num) { (void) num; }
+uint32_t micros(void) { return SimHal::Now(); }
+uint32_t millis(void) { return SimHal::Now() / 1000; }
+void delay(uint32_t ms) { SimHal::Advance(ms * 1000); }
+void delayMicroseconds(uint32_t us) { SimHal::Advance(us); }
+void attachInterrupt(uint8_t pin, void (*isr)(void), int mode) { SimHal::AttachInterrupt(pin, isr, mode); }
+void detachInterrupt(uint8_t pin) { SimHal::DetachInterrupt(pin); }
+void interrupts(void) { SimHal::SetInterruptsEnabled(true); }
+void noInterrupts(void) { SimHal::SetInterruptsEnabled(false); }
+void yield(void) { }
+
+/**************************************************************************/
+/*!
+    @brief    Default bulk write, one byte at a time
+*/
+/**************************************************************************/
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+  size_t n = 0;
+  while (size--)
+  {
+    n += write(*buffer++);
+  }
+  return n;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Print an unsigned number in the given base, no prefix
+*/
+/**************************************************************************/
+size_t Print::_PrintNumber(unsigned long value, uint8_t base)
+{
+  char buf[8 * sizeof(long) + 1];
+  char *str = &buf[sizeof(buf) - 1];
+
+  *str = '\0';
+  if (base < 2) base = 10;
+  do
+  {
+    char digit = value % base;
+    value /= base;
+    *--str = (digit < 10) ? digit + '0' : digit + 'A' - 10;
+  } while (value);
+  return write(str);
+}
+
+/**************************************************************************/
+/*!
+    @brief    Print a signed number, negative values are only signed in base 10
+*/
+/**************************************************************************/
+size_t Print::print(long value, int base)
+{
+  if (base == 10 && value < 0)
+  {
+    return print('-') + _PrintNumber((unsigned long) -value, 10);
+  }
+  return _PrintNumber((unsigned long) value, base);
+}
+
+/**************************************************************************/
+/*!
+    @brief    Print an unsigned number in the given base
+*/
+/**************************************************************************/
+size_t Print::print(unsigned long value, int base)
+{
+  return _PrintNumber(value, base);
+}
+
+/**************************************************************************/
+/*!
+    @brief    Print a floating point number with a fixed number of decimals
+*/
+/**************************************************************************/
+size_t Print::print(double value, int digits)
+{
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.*f", digits, value);
+  return write(buf);
+}
+
+size_t usb_serial_class::write(uint8_t c) { SimHal::SerialOut(&c, 1); return 1; }
+size_t usb_serial_class::write(const uint8_t *buffer, size_t size) { SimHal::SerialOut(buffer, size); return size; }
+int usb_serial_class::availableForWrite(void) { return SimHal::GetSerialWriteSpace(); }
+int usb_serial_class::available(void) { return SimHal::SerialAvailable(); }
+int usb_serial_class::read(void) { return SimHal::SerialRead(); }
+void usb_serial_class::send_now(void) { SimHal::CountSerialFlush(); }
+void usb_midi_class::send(uint8_t type, uint8_t data1, uint8_t data2, uint8_t channel, uint8_t cable) { (void) cable; SimHal::MidiOut(type | (channel - 1), data1, data2); }
+void usb_midi_class::send_now(void) { }
@@ -0,0 +1,114 @@
+/*!
+ * @file SimHal.hpp
+ *
+ * \brief Header for the simulated hardware behind the host Arduino API
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#ifndef __SIM_HAL_HPP__
+#define __SIM_HAL_HPP__
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define SIM_NUM_BUSES  2  ///< Wire and Wire1
+#define SIM_MAX_DEVICES  4  ///< Devices per simulated bus
+#define SIM_NO_PIN  -1  ///< SimI2cDevice::changePin value when no CHANGE line is wired
+#define SIM_ANALOG_BITS  10  ///< Resolution of timeline analog levels, the Arduino analogRead() default
+#define SIM_I2C_MAX_CLOCK_HZ  400000  ///< Fastest SCL a device answers at unless changed, fast mode like the AT42QT and MMA8452Q
+
+/**************************************************************************/
+/*!
+    @brief  Register-mapped I2C device with an auto-incrementing address pointer
+    If changePin is set, reading any register in [changeFirst, changeLast]
+    releases (drives HIGH) that pin, like the AT42QT CHANGE or MMA8452Q INT output.
+    Above maxClockHz the device does not ACK its address.
+*/
+/**************************************************************************/
+struct SimI2cDevice
+{
+  uint8_t addr;  ///< 7-bit address the device ACKs
+  uint8_t regs[256];  ///< Register contents
+  uint8_t pointer;  ///< Register address pointer
+  int changePin;  ///< CHANGE line pin, or SIM_NO_PIN
+  uint8_t changeFirst;  ///< First register whose read releases changePin
+  uint8_t changeLast;  ///< Last register whose read releases changePin
+  uint32_t transactions;  ///< Address-phase transactions seen, reads and writes
+  uint32_t maxClockHz;  ///< Fastest SCL the device answers at
+  uint8_t (*readReg)(SimI2cDevice *dev);  ///< Device model: read the register at pointer and move it, NULL to auto-increment
+  uint32_t sampleTime;  ///< Device model: Now() of the last internally generated sample
+};
+
+/**************************************************************************/
+/*!
+    @brief  Virtual clock, pins, interrupts, serial port, I2C devices and scripted timeline
+
+    Timeline files hold one event per line, "<time_us> <kind> <args...>",
+    with '#' starting a comment; numbers may be decimal or 0x-prefixed hex:
+      T digital <pin> <0|1>              set a digital input, firing attached interrupts
+      T analog <pin> <value>             set an analog pin level, 10-bit, scaled to the analogReadResolution()
+      T reg <bus> <addr> <reg> <value>   set a device register
+      T qtouch <bus> <addr> <reg> <value>  set a register and pull the device's CHANGE line LOW
+      T imu <x> <y> <z>                  12-bit counts the MMA8452Q on Wire1 0x1D reports from T on, sets ZYXDR and asserts INT
+      T orient <lapo>                    new MMA8452Q portrait/landscape orientation, 0-3 as in PL_STATUS
+      T encoder <edges>                  turn the encoder AddEncoder() wired, one quadrature edge every 20ms
+      T i2cstuck <bus>                   a device holds SDA LOW, every transfer fails until SCL is clocked a few times
+      T echo <us>                        echo pulse width of later ultrasonic pings, 0 for nothing in range
+      T serial <text>                    bytes the host sends to the sketch
+      T txspace <bytes>                  what Serial.availableForWrite() reports from T on, 0 is a stalled host
+      T end                              stop the run at T
+    Events are applied whenever the clock passes their time, so a trace plays
+    back as fast as the host can execute the sketch.
+*/
+/**************************************************************************/
+class SimHal
+{
+  public:
+    static void Reset(void);
+    static uint32_t Now(void);
+    static void Advance(uint32_t us);
+
+    static void SetDigital(uint8_t pin, int value);
+    static int GetDigital(uint8_t pin);
+    static void SetAnalog(uint8_t pin, int value);
+    static int GetAnalog(uint8_t pin);
+    static void SetAnalogResolution(unsigned int bits);
+    static void AttachInterrupt(uint8_t pin, void (*isr)(void), int mode);
+    static void DetachInterrupt(uint8_t pin);
+    static void SetInterruptsEnabled(bool isEnabled);
+
+    static SimI2cDevice *AddDevice(uint8_t bus, uint8_t addr);
+    static SimI2cDevice *FindDevice(uint8_t bus, uint8_t addr);
+    static void BindChangePin(uint8_t bus, uint8_t addr, int pin, uint8_t firstReg, uint8_t lastReg);
+    static uint8_t ReadDeviceReg(SimI2cDevice *dev);
+    static SimI2cDevice *AddMma8452q(uint8_t bus, uint8_t addr, int intPin);
+    static uint32_t GetI2cTransactions(uint8_t bus);
+    static void CountI2cTransaction(uint8_t bus);
+    static void SetI2cPins(uint8_t bus, int sdaPin, int sclPin);
+    static bool IsI2cStuck(uint8_t bus);
+
+    static void SetSerialSink(FILE *sink);
+    static void SerialOut(const uint8_t *data, size_t len);
+    static uint64_t GetSerialBytes(void);
+    static void SetSerialWriteSpace(int bytes);
+    static int GetSerialWriteSpace(void);
+    static void CountSerialFlush(void);
+    static uint64_t GetSerialFlushes(void);
+    static int SerialAvailable(void);
+    static int SerialRead(void);
+
+    static void SetMidiSink(FILE *sink);
+    static void MidiOut(uint8_t status, uint8_t data1, uint8_t data2);
+    static uint64_t GetMidiMessages(void);
+    static uint32_t GetMaxNoteLatency(void);
+
+    static void AddEncoder(int pinA, int pinC);
+    static void AddUltrasonic(int trigPin, int echoPin);
+
+    static bool LoadTimeline(FILE *in, const char *name);
+    static bool HasPendingEvents(void);
+    static uint32_t GetEndTime(void);
+};
+
+#endif  // __SIM_HAL_HPP__
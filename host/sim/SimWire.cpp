@@ -0,0 +1,180 @@
+/*!
+ * @file SimWire.cpp
+ *
+ * \brief Simulated TwoWire, transfers read and write SimHal register-map devices
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#include "Wire.h"
+#include "SimHal.hpp"
+
+#define SIM_WIRE_DEFAULT_HZ  100000  ///< Wire clock before setClock()
+#define SIM_WIRE_BITS_PER_BYTE  9  ///< Eight data bits plus ACK
+
+TwoWire Wire(0);
+TwoWire Wire1(1);
+
+/**************************************************************************/
+/*!
+    @brief    Create the master for one simulated bus
+    @param    bus
+              SimHal bus index
+*/
+/**************************************************************************/
+TwoWire::TwoWire(uint8_t bus)
+  : _bus(bus), _clockHz(SIM_WIRE_DEFAULT_HZ), _txAddr(0), _txLen(0), _rxLen(0), _rxIndex(0)
+{
+}
+
+void TwoWire::begin(void) { }
+
+/**************************************************************************/
+/*!
+    @brief    Set the SCL rate used to charge bus time
+*/
+/**************************************************************************/
+void TwoWire::setClock(uint32_t hz)
+{
+  _clockHz = (hz > 0) ? hz : SIM_WIRE_DEFAULT_HZ;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Advance the virtual clock by the time bytes take on the wire
+*/
+/**************************************************************************/
+void TwoWire::_BusTime(uint32_t bytes)
+{
+  SimHal::Advance((uint32_t) ((uint64_t) bytes * SIM_WIRE_BITS_PER_BYTE * 1000000 / _clockHz));
+}
+
+/**************************************************************************/
+/*!
+    @brief    Start building a write to addr
+*/
+/**************************************************************************/
+void TwoWire::beginTransmission(uint8_t addr)
+{
+  _txAddr = addr;
+  _txLen = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Queue one byte of the transmission, dropped if the buffer is full
+*/
+/**************************************************************************/
+size_t TwoWire::write(uint8_t c)
+{
+  if (_txLen >= BUFFER_LENGTH)
+  {
+    return 0;
+  }
+  _txBuf[_txLen++] = c;
+  return 1;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Queue several bytes of the transmission
+*/
+/**************************************************************************/
+size_t TwoWire::write(const uint8_t *buffer, size_t size)
+{
+  size_t n = 0;
+  while (n < size && write(buffer[n]))
+  {
+    n++;
+  }
+  return n;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Put the queued write on the bus
+    The first byte sets the device's register pointer, the rest are stored
+    from there with auto-increment.
+    @return   0 on success, 2 if no device ACKed the address, 4 if SDA is stuck LOW
+*/
+/**************************************************************************/
+uint8_t TwoWire::endTransmission(bool sendStop)
+{
+  (void) sendStop;
+  SimHal::CountI2cTransaction(_bus);
+  if (SimHal::IsI2cStuck(_bus))
+  {
+    _BusTime(1);
+    return 4;
+  }
+  SimI2cDevice *dev = SimHal::FindDevice(_bus, _txAddr);
+  if (dev == NULL || _clockHz > dev->maxClockHz)
+  {
+    _BusTime(1);
+    return 2;
+  }
+  _BusTime(1 + _txLen);
+  dev->transactions++;
+  if (_txLen > 0)
+  {
+    dev->pointer = _txBuf[0];
+    for (uint8_t i=1; i<_txLen; i++)
+    {
+      dev->regs[dev->pointer++] = _txBuf[i];
+    }
+  }
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Read count bytes from addr, starting at its register pointer
+    @return   Number of bytes received, 0 if no device ACKed the address or SDA is stuck LOW
+*/
+/**************************************************************************/
+uint8_t TwoWire::requestFrom(uint8_t addr, uint8_t count, bool sendStop)
+{
+  (void) sendStop;
+  _rxLen = 0;
+  _rxIndex = 0;
+  SimHal::CountI2cTransaction(_bus);
+  SimI2cDevice *dev = SimHal::FindDevice(_bus, addr);
+  if (dev == NULL || _clockHz > dev->maxClockHz || SimHal::IsI2cStuck(_bus))
+  {
+    _BusTime(1);
+    return 0;
+  }
+  if (count > BUFFER_LENGTH)
+  {
+    count = BUFFER_LENGTH;
+  }
+  _BusTime(1 + count);
+  dev->transactions++;
+
+  for (uint8_t i=0; i<count; i++)
+  {
+    _rxBuf[i] = SimHal::ReadDeviceReg(dev);
+  }
+  _rxLen = count;
+  return count;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Bytes of the last requestFrom() not yet read
+*/
+/**************************************************************************/
+int TwoWire::available(void)
+{
+  return _rxLen - _rxIndex;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Next byte of the last requestFrom(), -1 if none are left
+*/
+/**************************************************************************/
+int TwoWire::read(void)
+{
+  return (_rxIndex < _rxLen) ? _rxBuf[_rxIndex++] : -1;
+}
@@ -0,0 +1,55 @@
+/*!
+ * @file Wire.h
+ *
+ * \brief Simulated TwoWire API, transfers go to SimHal register-map devices
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#ifndef __SIM_WIRE_H__
+#define __SIM_WIRE_H__
+
+#include "Arduino.h"
+
+#define BUFFER_LENGTH  32  ///< Teensy LC Wire buffer size, transfers are limited to this
+
+/**************************************************************************/
+/*!
+    @brief  I2C master on one simulated bus
+    Every byte on the bus advances the virtual clock by the time it would
+    take at the configured clock rate, so bus cost shows up in task timing.
+*/
+/**************************************************************************/
+class TwoWire : public Stream
+{
+  private:
+    uint8_t _bus;  ///< SimHal bus index, 0 for Wire and 1 for Wire1
+    uint32_t _clockHz;  ///< Configured SCL rate
+    uint8_t _txAddr;  ///< Address of the transmission being built
+    uint8_t _txBuf[BUFFER_LENGTH];  ///< Bytes of the transmission being built
+    uint8_t _txLen;  ///< Number of valid bytes in _txBuf
+    uint8_t _rxBuf[BUFFER_LENGTH];  ///< Bytes returned by the last requestFrom()
+    uint8_t _rxLen;  ///< Number of valid bytes in _rxBuf
+    uint8_t _rxIndex;  ///< Next byte of _rxBuf to read()
+
+    void _BusTime(uint32_t bytes);
+
+  public:
+    TwoWire(uint8_t bus);
+    void begin(void);
+    void setClock(uint32_t hz);
+    void beginTransmission(uint8_t addr);
+    uint8_t endTransmission(bool sendStop = true);
+    uint8_t requestFrom(uint8_t addr, uint8_t count, bool sendStop = true);
+    uint8_t requestFrom(int addr, int count) { return requestFrom((uint8_t) addr, (uint8_t) count, true); }
+    size_t write(uint8_t c);
+    size_t write(const uint8_t *buffer, size_t size);
+    using Print::write;
+    int available(void);
+    int read(void);
+};
+
+extern TwoWire Wire;
+extern TwoWire Wire1;
+
+#endif  // __SIM_WIRE_H__
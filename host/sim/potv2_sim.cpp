@@ -0,0 +1,177 @@
+/*!
+ * @file potv2_sim.cpp
+ *
+ * \brief Run the unmodified PoTv2Debug sketch on Linux against SimHal
+ *
+ * Usage: potv2-sim [-t timeline] [-d duration_us] [-o output] [-m midi_log] [-l loop_us]
+ *
+ * Attaches simulated QTouch boards on Wire and Wire1 and an MMA8452Q on
+ * Wire1, plays back a scripted timeline (see SimHal.hpp for its format)
+ * and runs setup() then loop() on a virtual clock until the timeline's
+ * "end" event or the requested duration. Serial output goes to -o, "-" for
+ * stdout, so a TUI capture or a telemetry stream for potv2-telemetry can be
+ * produced without hardware. usbMIDI messages go to -m, one line each of
+ * "time_us us_since_last_input status data1 data2". A run summary is
+ * printed to stderr.
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "SimHal.hpp"
+
+// The sketch itself, compiled as one C++ translation unit like the Arduino IDE does
+#include "PoTv2Debug.ino"
+
+#define SIM_DEFAULT_DURATION_US  5000000  ///< Run length when the timeline has no "end"
+#define SIM_DEFAULT_LOOP_US  5  ///< Virtual cost of one loop() pass on top of its bus time
+
+/**************************************************************************/
+/*!
+    @brief    Attach one QTouch board's QT1070 and QT2120 to a bus with their CHANGE lines
+*/
+/**************************************************************************/
+static void AddQTouchBoard(uint8_t bus, int pin1070, int pin2120)
+{
+  SimHal::AddDevice(bus, QTOUCH1070_ADDR)->regs[REG_QT1070_CHIP_ID] = VAL_QT1070_CHIP_ID;
+  SimHal::AddDevice(bus, QTOUCH2120_ADDR)->regs[REG_QT2120_CHIP_ID] = VAL_QT2120_CHIP_ID;
+  SimHal::BindChangePin(bus, QTOUCH1070_ADDR, pin1070, REG_QT1070_DETECTION_STATUS, REG_QT1070_KEY_STATUS_0);
+  SimHal::BindChangePin(bus, QTOUCH2120_ADDR, pin2120, REG_QT2120_DETECTION_STATUS, REG_QT2120_KEY_STATUS_1);
+}
+
+/**************************************************************************/
+/*!
+    @brief    Print usage to stderr
+*/
+/**************************************************************************/
+static void PrintUsage(const char *argv0)
+{
+  fprintf(stderr, "Usage: %s [-t timeline] [-d duration_us] [-o output] [-m midi_log] [-l loop_us]\n", argv0);
+  fprintf(stderr, "  -t timeline     scripted input events, see host/sim/SimHal.hpp\n");
+  fprintf(stderr, "  -d duration_us  virtual run time (default: timeline end, else %d)\n", SIM_DEFAULT_DURATION_US);
+  fprintf(stderr, "  -o output       file for the sketch's Serial output, '-' for stdout (default: discard)\n");
+  fprintf(stderr, "  -m midi_log     file for timestamped usbMIDI messages (default: discard)\n");
+  fprintf(stderr, "  -l loop_us      virtual time charged per loop() pass (default %d)\n", SIM_DEFAULT_LOOP_US);
+}
+
+int main(int argc, char **argv)
+{
+  const char *timelinePath = NULL;
+  const char *outputPath = NULL;
+  const char *midiPath = NULL;
+  uint32_t duration = 0;
+  uint32_t loopCost = SIM_DEFAULT_LOOP_US;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "t:d:o:m:l:h")) != -1)
+  {
+    switch (opt)
+    {
+      case 't': timelinePath = optarg; break;
+      case 'd': duration = (uint32_t) strtoul(optarg, NULL, 0); break;
+      case 'o': outputPath = optarg; break;
+      case 'm': midiPath = optarg; break;
+      case 'l': loopCost = (uint32_t) strtoul(optarg, NULL, 0); break;
+      default: PrintUsage(argv[0]); return (opt == 'h') ? 0 : 2;
+    }
+  }
+  if (optind != argc)
+  {
+    PrintUsage(argv[0]);
+    return 2;
+  }
+
+  SimHal::Reset();
+  if (timelinePath != NULL)
+  {
+    FILE *in = fopen(timelinePath, "r");
+    if (in == NULL)
+    {
+      perror(timelinePath);
+      return 1;
+    }
+    bool isOk = SimHal::LoadTimeline(in, timelinePath);
+    fclose(in);
+    if (!isOk)
+    {
+      return 1;
+    }
+  }
+  if (duration == 0)
+  {
+    duration = (SimHal::GetEndTime() > 0) ? SimHal::GetEndTime() : SIM_DEFAULT_DURATION_US;
+  }
+
+  FILE *out = NULL;
+  if (outputPath != NULL)
+  {
+    out = (strcmp(outputPath, "-") == 0) ? stdout : fopen(outputPath, "wb");
+    if (out == NULL)
+    {
+      perror(outputPath);
+      return 1;
+    }
+  }
+  SimHal::SetSerialSink(out);
+
+  FILE *midiOut = NULL;
+  if (midiPath != NULL)
+  {
+    midiOut = fopen(midiPath, "w");
+    if (midiOut == NULL)
+    {
+      perror(midiPath);
+      return 1;
+    }
+  }
+  SimHal::SetMidiSink(midiOut);
+
+  AddQTouchBoard(0, PIN_FRET_1070_INT, PIN_FRET_2120_INT);
+  AddQTouchBoard(1, PIN_STRUM_1070_INT, PIN_STRUM_2120_INT);
+  SimHal::AddMma8452q(1, MMA8452Q_SLAVE_ADDR, PIN_IMU_INT);
+  SimHal::SetI2cPins(0, PIN_WIRE_SDA, PIN_WIRE_SCL);
+  SimHal::SetI2cPins(1, PIN_WIRE1_SDA, PIN_WIRE1_SCL);
+  SimHal::AddUltrasonic(PIN_ULTRA_TRIG, PIN_ULTRA_SENS);
+  SimHal::AddEncoder(PIN_ROT_ENC_A, PIN_ROT_ENC_C);
+  SimHal::SetDigital(PIN_ROT_ENC_SW, HIGH);
+
+  struct timespec wallStart, wallEnd;
+  clock_gettime(CLOCK_MONOTONIC, &wallStart);
+
+  uint64_t loops = 0;
+  setup();
+  while ((int32_t) (SimHal::Now() - duration) < 0)
+  {
+    loop();
+    SimHal::Advance(loopCost);
+    loops++;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &wallEnd);
+  double wallSec = (wallEnd.tv_sec - wallStart.tv_sec) + (wallEnd.tv_nsec - wallStart.tv_nsec) / 1e9;
+
+  if (out != NULL && out != stdout)
+  {
+    fclose(out);
+  }
+  else if (out == stdout)
+  {
+    fflush(stdout);
+  }
+  if (midiOut != NULL)
+  {
+    fclose(midiOut);
+  }
+  fprintf(stderr, "simulated_us=%lu wall_s=%.3f speedup=%.1fx loops=%llu serial_bytes=%llu serial_flushes=%llu midi_msgs=%llu midi_max_note_latency_us=%lu i2c_wire=%lu i2c_wire1=%lu\n",
+          (unsigned long) SimHal::Now(), wallSec, (wallSec > 0) ? SimHal::Now() / 1e6 / wallSec : 0.0,
+          (unsigned long long) loops, (unsigned long long) SimHal::GetSerialBytes(),
+          (unsigned long long) SimHal::GetSerialFlushes(),
+          (unsigned long long) SimHal::GetMidiMessages(), (unsigned long) SimHal::GetMaxNoteLatency(),
+          (unsigned long) SimHal::GetI2cTransactions(0), (unsigned long) SimHal::GetI2cTransactions(1));
+  return 0;
+}
@@ -0,0 +1,118 @@
+/*!
+ * @file TelemetryDecoder.cpp
+ *
+ * \brief Host-side stream decoder of COBS-framed telemetry packets
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#include "TelemetryDecoder.hpp"
+
+/**************************************************************************/
+/*!
+    @brief    Create a decoder waiting for the first frame delimiter
+*/
+/**************************************************************************/
+TelemetryDecoder::TelemetryDecoder(void)
+{
+  _frameLen = 0;
+  _isOverflow = false;
+  _isSynced = false;
+  _frameCount = 0;
+  _crcErrors = 0;
+  _framingErrors = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Feed one received byte
+    @param    byte
+              Next byte from the stream
+    @param    payload
+              Buffer of at least TELEMETRY_MAX_PAYLOAD + TELEMETRY_CRC_LEN bytes,
+              receives the CRC-checked payload when a frame completes
+    @param    payloadLen
+              Receives the payload length, excluding CRC
+    @return   True if byte completed a valid frame, else False
+*/
+/**************************************************************************/
+bool TelemetryDecoder::Push(uint8_t byte, uint8_t *payload, size_t &payloadLen)
+{
+  if (byte != 0x00)
+  {
+    if (_frameLen < sizeof(_frame))
+    {
+      _frame[_frameLen++] = byte;
+    }
+    else
+    {
+      _isOverflow = true;
+    }
+    return false;
+  }
+
+  // Delimiter: validate whatever came before it
+  size_t frameLen = _frameLen;
+  bool isOverflow = _isOverflow;
+  bool isSynced = _isSynced;
+  _frameLen = 0;
+  _isOverflow = false;
+  _isSynced = true;
+
+  if (frameLen == 0 || !isSynced)
+  {
+    return false;  // back-to-back delimiters or the lead-in before the first one, nothing to report
+  }
+  if (isOverflow)
+  {
+    _framingErrors++;
+    return false;
+  }
+
+  size_t rawLen = CobsDecode(_frame, frameLen, payload);
+  if (rawLen <= TELEMETRY_CRC_LEN || rawLen > TELEMETRY_MAX_PAYLOAD + TELEMETRY_CRC_LEN)
+  {
+    _framingErrors++;
+    return false;
+  }
+
+  payloadLen = rawLen - TELEMETRY_CRC_LEN;
+  uint16_t crc = payload[payloadLen] | (payload[payloadLen + 1] << 8);
+  if (crc != TelemetryCrc16(payload, payloadLen))
+  {
+    _crcErrors++;
+    return false;
+  }
+  _frameCount++;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Number of valid frames decoded so far
+*/
+/**************************************************************************/
+uint32_t TelemetryDecoder::GetFrameCount(void) const
+{
+  return _frameCount;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Number of frames dropped for a CRC mismatch
+*/
+/**************************************************************************/
+uint32_t TelemetryDecoder::GetCrcErrors(void) const
+{
+  return _crcErrors;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Number of frames dropped for bad COBS, bad length or overflow
+*/
+/**************************************************************************/
+uint32_t TelemetryDecoder::GetFramingErrors(void) const
+{
+  return _framingErrors;
+}
@@ -0,0 +1,45 @@
+/*!
+ * @file TelemetryDecoder.hpp
+ *
+ * \brief Header for host-side stream decoder of COBS-framed telemetry packets
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#ifndef __TELEMETRY_DECODER_HPP__
+#define __TELEMETRY_DECODER_HPP__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "TelemetryCodec.hpp"
+
+/**************************************************************************/
+/*!
+    @brief  Splits a byte stream on 0x00 delimiters and validates each frame
+    Bytes may be pushed in arbitrarily sized pieces; the decoder resynchronizes
+    on the next delimiter after any corrupt or truncated frame, so it can be
+    attached to a port that is already streaming or to a TUI/telemetry mix.
+    Whatever precedes the first delimiter, such as the boot log and TUI text
+    before a switch to telemetry, is skipped without counting as an error.
+*/
+/**************************************************************************/
+class TelemetryDecoder
+{
+  private:
+    uint8_t _frame[TELEMETRY_MAX_FRAME_LEN - 1];  ///< Encoded bytes of the frame being received, delimiter excluded
+    size_t _frameLen;  ///< Number of valid bytes in _frame
+    bool _isOverflow;  ///< True if the current frame outgrew _frame and must be dropped
+    bool _isSynced;  ///< True once a delimiter has been seen, bytes before it are not a frame
+    uint32_t _frameCount;  ///< Frames that passed COBS and CRC checks
+    uint32_t _crcErrors;  ///< Frames dropped for a CRC mismatch
+    uint32_t _framingErrors;  ///< Frames dropped for bad COBS, bad length or overflow
+
+  public:
+    TelemetryDecoder(void);
+    bool Push(uint8_t byte, uint8_t *payload, size_t &payloadLen);
+    uint32_t GetFrameCount(void) const;
+    uint32_t GetCrcErrors(void) const;
+    uint32_t GetFramingErrors(void) const;
+};
+
+#endif  // __TELEMETRY_DECODER_HPP__
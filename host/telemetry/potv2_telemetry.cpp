@@ -0,0 +1,394 @@
+/*!
+ * @file potv2_telemetry.cpp
+ *
+ * \brief Linux CLI that logs PoTv2Debug binary telemetry as CSV
+ *
+ * Usage: potv2-telemetry [-b baud] [-s] [-c capture.csv] [-r raw.csv] <tty|pty|file>
+ *
+ * Reads COBS-framed packets from a serial port, pseudo-terminal or a file
+ * captured earlier, and prints one CSV line per valid snapshot packet on
+ * stdout. Capture dumps (CMD_CAPTURE_ARM in the sketch) are written one CSV
+ * line per record to the -c file, and raw QTouch samples one CSV line per
+ * key to the -r file. With -s the CMD_OUTPUT_TELEMETRY command, or with -r
+ * CMD_OUTPUT_QTOUCH_RAW, is sent first so the sketch switches out of the
+ * TUI. Frame/CRC statistics go to stderr on exit.
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "TelemetryCodec.hpp"
+#include "TelemetryDecoder.hpp"
+
+#define DEFAULT_BAUD  500000  ///< Baud rate the sketch opens Serial with
+#define CMD_OUTPUT_TELEMETRY  'b'  ///< Must match the sketch's command character
+#define CMD_OUTPUT_QTOUCH_RAW  'r'  ///< Must match the sketch's command character
+#define QTOUCH_RAW_QT2120_KEYS  12  ///< Leading keys of a raw QTouch packet that belong to the AT42QT2120
+#define QTOUCH_RAW_NUM_BOARDS  2  ///< FretBoard and StrumBoard
+
+static volatile sig_atomic_t isStopRequested = 0;
+
+// Capture dump being received, records are only valid after its header
+static FILE *captureFile = NULL;
+static TelemetryCaptureHeader captureHeader;
+static bool hasCaptureHeader = false;
+static uint32_t captureCount = 0;
+static uint32_t captureRecords = 0;
+
+// Raw QTouch samples, sequence gaps are packets the sketch dropped
+static FILE *rawFile = NULL;
+static uint32_t rawCount = 0;
+static uint32_t rawGaps = 0;
+static bool hasRawSequence[QTOUCH_RAW_NUM_BOARDS] = { false, false };
+static uint8_t nextRawSequence[QTOUCH_RAW_NUM_BOARDS];
+
+/**************************************************************************/
+/*!
+    @brief    SIGINT/ SIGTERM handler, lets the read loop print stats and exit
+*/
+/**************************************************************************/
+static void OnSignal(int sig)
+{
+  (void) sig;
+  isStopRequested = 1;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Map a numeric baud rate onto a termios speed constant
+    @return   Speed constant, or B0 if unsupported
+*/
+/**************************************************************************/
+static speed_t BaudToSpeed(long baud)
+{
+  switch (baud)
+  {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 500000: return B500000;
+    case 921600: return B921600;
+    case 1000000: return B1000000;
+    case 2000000: return B2000000;
+    default: return B0;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Put a tty into raw 8N1 mode at the requested speed
+    @return   True on success, else False
+*/
+/**************************************************************************/
+static bool ConfigureTty(int fd, long baud)
+{
+  struct termios tio;
+  speed_t speed = BaudToSpeed(baud);
+
+  if (speed == B0)
+  {
+    fprintf(stderr, "Unsupported baud rate %ld\n", baud);
+    return false;
+  }
+  if (tcgetattr(fd, &tio) != 0)
+  {
+    perror("tcgetattr");
+    return false;
+  }
+  cfmakeraw(&tio);
+  tio.c_cflag |= CLOCAL | CREAD;
+  tio.c_cc[VMIN] = 1;
+  tio.c_cc[VTIME] = 0;
+  cfsetispeed(&tio, speed);
+  cfsetospeed(&tio, speed);
+  if (tcsetattr(fd, TCSANOW, &tio) != 0)
+  {
+    perror("tcsetattr");
+    return false;
+  }
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Write the records of one capture block to the capture CSV
+*/
+/**************************************************************************/
+static bool PrintCaptureBlock(const uint8_t *payload, size_t len)
+{
+  uint32_t firstIndex;
+  uint8_t count;
+  const uint8_t *records;
+  size_t recordLen = TelemetryCaptureRecordLen(captureHeader.channels);
+  uint8_t channels = captureHeader.channels;
+
+  if (!hasCaptureHeader || !TelemetryUnpackCaptureBlock(payload, len, recordLen, firstIndex, count, records))
+  {
+    return false;
+  }
+  captureRecords += count;
+  for (uint8_t i=0; i<count && captureFile != NULL; i++)
+  {
+    CaptureSample sample;
+    uint32_t index = firstIndex + i;
+    TelemetryUnpackCaptureRecord(&records[i * recordLen], channels, sample);
+
+    // Records carry the low 16 bits of micros(), pick the full value nearest the nominal time
+    uint32_t expected = captureHeader.triggerTimestamp + (int32_t) (index - captureHeader.triggerIndex) * (int32_t) captureHeader.periodMicros;
+    uint32_t actual = expected + (int16_t) ((uint16_t) sample.timestamp - (uint16_t) expected);
+
+    fprintf(captureFile, "%lu,%lu,%ld,", (unsigned long) captureCount, (unsigned long) index,
+            (long) (int32_t) (actual - captureHeader.triggerTimestamp));
+    if (channels & CAPTURE_CHANNEL_POT)
+    {
+      fprintf(captureFile, "%u", sample.potRaw);
+    }
+    fprintf(captureFile, ",");
+    if (channels & CAPTURE_CHANNEL_ECHO)
+    {
+      fprintf(captureFile, "%u", sample.echoMicros);
+    }
+    fprintf(captureFile, ",");
+    if (channels & CAPTURE_CHANNEL_IMU)
+    {
+      fprintf(captureFile, "%d,%d,%d", sample.imuX, sample.imuY, sample.imuZ);
+    }
+    else
+    {
+      fprintf(captureFile, ",,");
+    }
+    fprintf(captureFile, ",");
+    if (channels & CAPTURE_CHANNEL_QTOUCH)
+    {
+      fprintf(captureFile, "0x%05lX,0x%05lX", (unsigned long) sample.fretKeys, (unsigned long) sample.strumKeys);
+    }
+    else
+    {
+      fprintf(captureFile, ",");
+    }
+    fprintf(captureFile, "\n");
+  }
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Write one raw QTouch sample to the raw CSV, a line per key
+*/
+/**************************************************************************/
+static void PrintQTouchRaw(const TelemetryQTouchRaw &raw)
+{
+  rawCount++;
+  if (raw.board < QTOUCH_RAW_NUM_BOARDS)
+  {
+    if (hasRawSequence[raw.board] && raw.sequence != nextRawSequence[raw.board])
+    {
+      rawGaps++;
+    }
+    hasRawSequence[raw.board] = true;
+    nextRawSequence[raw.board] = raw.sequence + 1;
+  }
+  for (uint8_t k=0; k<TELEMETRY_QTOUCH_RAW_KEYS && rawFile != NULL; k++)
+  {
+    bool isQt2120 = (k < QTOUCH_RAW_QT2120_KEYS);
+    fprintf(rawFile, "%lu,%u,%u,%s,%u,%u,%u\n", (unsigned long) raw.timestamp, raw.board, raw.sequence,
+            isQt2120 ? "qt2120" : "qt1070", isQt2120 ? k : k - QTOUCH_RAW_QT2120_KEYS, raw.signal[k], raw.reference[k]);
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Print one decoded payload as a CSV line, log a touch edge, or route it to the capture or raw CSV
+*/
+/**************************************************************************/
+static void PrintPayload(const uint8_t *payload, size_t len)
+{
+  TelemetrySnapshot snap;
+  TelemetryQTouchRaw raw;
+  TelemetryTouchEvent touch;
+
+  if (TelemetryUnpackQTouchRaw(payload, len, raw))
+  {
+    PrintQTouchRaw(raw);
+  }
+  else if (TelemetryUnpackTouchEvent(payload, len, touch))
+  {
+    fprintf(stderr, "Touch %lu: board %u pad %u %s\n", (unsigned long) touch.timestamp, touch.board, touch.pad,
+            touch.isPress ? "press" : "release");
+  }
+  else if (TelemetryUnpackCaptureHeader(payload, len, captureHeader))
+  {
+    hasCaptureHeader = true;
+    captureCount++;
+    fprintf(stderr, "Capture %lu: channels 0x%02X trigger %u, %lu records every %lu us, trigger at record %lu\n",
+            (unsigned long) captureCount, captureHeader.channels, captureHeader.trigger,
+            (unsigned long) captureHeader.recordCount, (unsigned long) captureHeader.periodMicros,
+            (unsigned long) captureHeader.triggerIndex);
+  }
+  else if (PrintCaptureBlock(payload, len))
+  {
+    // Records went to the capture CSV
+  }
+  else if (TelemetryUnpackSnapshot(payload, len, snap))
+  {
+    printf("%lu,%u,%u,%u,%u,%u,%u,%u,%d,%d,%d,%u\n",
+           (unsigned long) snap.timestamp, snap.fret, snap.key, snap.rotEnc,
+           (snap.flags & TELEMETRY_FLAG_ROT_ENC_SW) ? 1 : 0, snap.rotPot, snap.ultraDist,
+           (snap.flags & TELEMETRY_FLAG_ULTRA_VALID) ? 1 : 0, snap.imuX, snap.imuY, snap.imuZ, (snap.flags & TELEMETRY_FLAG_LEFTY) ? 1 : 0);
+  }
+  else
+  {
+    fprintf(stderr, "Skipping packet type 0x%02X version %u\n", payload[0], (len > 1) ? payload[1] : 0);
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Print usage to stderr
+*/
+/**************************************************************************/
+static void PrintUsage(const char *argv0)
+{
+  fprintf(stderr, "Usage: %s [-b baud] [-s] [-c capture.csv] [-r raw.csv] <tty|pty|file>\n", argv0);
+  fprintf(stderr, "  -b baud  serial speed when reading a tty (default %d)\n", DEFAULT_BAUD);
+  fprintf(stderr, "  -s       send '%c' to switch the sketch to telemetry output first, '%c' with -r\n",
+          CMD_OUTPUT_TELEMETRY, CMD_OUTPUT_QTOUCH_RAW);
+  fprintf(stderr, "  -c file  write the records of capture dumps to file as CSV\n");
+  fprintf(stderr, "  -r file  write raw QTouch signal and reference samples to file as CSV\n");
+}
+
+int main(int argc, char **argv)
+{
+  long baud = DEFAULT_BAUD;
+  bool isSendStart = false;
+  const char *capturePath = NULL;
+  const char *rawPath = NULL;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "b:sc:r:h")) != -1)
+  {
+    switch (opt)
+    {
+      case 'b': baud = strtol(optarg, NULL, 10); break;
+      case 's': isSendStart = true; break;
+      case 'c': capturePath = optarg; break;
+      case 'r': rawPath = optarg; break;
+      default: PrintUsage(argv[0]); return (opt == 'h') ? 0 : 2;
+    }
+  }
+  if (optind != argc - 1)
+  {
+    PrintUsage(argv[0]);
+    return 2;
+  }
+
+  const char *path = argv[optind];
+  int fd = open(path, isSendStart ? O_RDWR | O_NOCTTY : O_RDONLY | O_NOCTTY);
+  if (fd < 0)
+  {
+    fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+    return 1;
+  }
+  if (isatty(fd) && !ConfigureTty(fd, baud))
+  {
+    close(fd);
+    return 1;
+  }
+  if (isSendStart)
+  {
+    char cmd = (rawPath != NULL) ? CMD_OUTPUT_QTOUCH_RAW : CMD_OUTPUT_TELEMETRY;
+    if (write(fd, &cmd, 1) != 1)
+    {
+      perror("write");
+    }
+  }
+
+  if (capturePath != NULL)
+  {
+    captureFile = fopen(capturePath, "w");
+    if (captureFile == NULL)
+    {
+      fprintf(stderr, "Cannot open %s: %s\n", capturePath, strerror(errno));
+      close(fd);
+      return 1;
+    }
+    fprintf(captureFile, "capture,index,time_from_trigger_us,pot_raw,echo_us,imu_x_mg,imu_y_mg,imu_z_mg,fret_keys,strum_keys\n");
+  }
+  if (rawPath != NULL)
+  {
+    rawFile = fopen(rawPath, "w");
+    if (rawFile == NULL)
+    {
+      fprintf(stderr, "Cannot open %s: %s\n", rawPath, strerror(errno));
+      if (captureFile != NULL)
+      {
+        fclose(captureFile);
+      }
+      close(fd);
+      return 1;
+    }
+    fprintf(rawFile, "timestamp_us,board,sequence,chip,key,signal,reference\n");
+  }
+
+  signal(SIGINT, OnSignal);
+  signal(SIGTERM, OnSignal);
+
+  TelemetryDecoder decoder;
+  uint8_t buf[4096];
+  uint8_t payload[TELEMETRY_MAX_PAYLOAD + TELEMETRY_CRC_LEN];
+  size_t payloadLen = 0;
+
+  printf("timestamp_us,fret,key,rot_enc,rot_enc_sw,rot_pot,ultra_dist,ultra_valid,imu_x_mg,imu_y_mg,imu_z_mg,lefty\n");
+  while (!isStopRequested)
+  {
+    ssize_t count = read(fd, buf, sizeof(buf));
+    if (count == 0)
+    {
+      break;  // end of file
+    }
+    if (count < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      perror("read");
+      break;
+    }
+    for (ssize_t i=0; i<count; i++)
+    {
+      if (decoder.Push(buf[i], payload, payloadLen))
+      {
+        PrintPayload(payload, payloadLen);
+      }
+    }
+  }
+
+  fflush(stdout);
+  if (captureFile != NULL)
+  {
+    fclose(captureFile);
+  }
+  if (rawFile != NULL)
+  {
+    fclose(rawFile);
+  }
+  fprintf(stderr, "frames=%lu crc_errors=%lu framing_errors=%lu captures=%lu capture_records=%lu qtouch_raw=%lu raw_gaps=%lu\n",
+          (unsigned long) decoder.GetFrameCount(), (unsigned long) decoder.GetCrcErrors(),
+          (unsigned long) decoder.GetFramingErrors(), (unsigned long) captureCount, (unsigned long) captureRecords,
+          (unsigned long) rawCount, (unsigned long) rawGaps);
+  close(fd);
+  return 0;
+}
@@ -0,0 +1,398 @@
+/*!
+ * @file i2c_engine_test.cpp
+ *
+ * \brief Host test of I2cEngine scheduling and error handling over FakeI2cBus
+ *
+ * Usage: potv2-i2c-test
+ *
+ * Drives a wireEngine and a wire1Engine the way the sketch does, one
+ * I2cServiceAll() per pass, and checks that the two buses transfer at the
+ * same time, that each bus completes its transactions in submit order with
+ * the right data and callbacks, and that NACKs, retries and timeouts end the
+ * way I2cEngine.hpp documents. Prints each failed check and exits 1 if any.
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "I2cEngine.hpp"
+#include "FakeI2cBus.hpp"
+
+#define TEST_QT2120_ADDR  0x1C  ///< AT42QT2120 address, as in QTouchBoard.hpp
+#define TEST_QT1070_ADDR  0x1B  ///< AT42QT1070 address, as in QTouchBoard.hpp
+#define TEST_MMA8452Q_ADDR  0x1D  ///< MMA8452Q address, as in MMA8452Q.hpp
+#define TEST_ABSENT_ADDR  0x50  ///< Address nothing on the fake buses answers
+#define TEST_TXNS_PER_BUS  4  ///< Transactions queued on each bus by the FIFO test
+#define TEST_MAX_PASSES  100000  ///< Service passes before a test gives up waiting
+
+#define CHECK(cond)  Check((cond), #cond, __LINE__)  ///< Record a failure with its source line if cond is false
+
+static uint32_t fakeMicros;  ///< Test clock, one microsecond per service pass
+static unsigned failures;  ///< Failed checks so far
+
+static int callbackOrder[2 * TEST_TXNS_PER_BUS];  ///< Context ids in the order their callbacks ran
+static uint8_t callbackStatus[2 * TEST_TXNS_PER_BUS];  ///< Status each transaction had when its callback ran
+static uint8_t callbackCount;  ///< Valid entries in callbackOrder
+
+/**************************************************************************/
+/*!
+    @brief    Report a failed check
+    @return   cond, so callers can skip checks that depend on it
+*/
+/**************************************************************************/
+static bool Check(bool cond, const char *text, int line)
+{
+  if (!cond)
+  {
+    printf("FAIL line %d: %s\n", line, text);
+    failures++;
+  }
+  return cond;
+}
+
+/**************************************************************************/
+/*!
+    @brief    I2cClock for the engines, advanced by RunUntilIdle()
+*/
+/**************************************************************************/
+static uint32_t FakeClock(void)
+{
+  return fakeMicros;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Completion callback recording which transaction finished and how
+*/
+/**************************************************************************/
+static void RecordCompletion(I2cTransaction *txn)
+{
+  if (callbackCount < 2 * TEST_TXNS_PER_BUS)
+  {
+    callbackOrder[callbackCount] = *(int *) txn->context;
+    callbackStatus[callbackCount] = txn->status;
+    callbackCount++;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Service both engines like the sketch's main loop until both are idle
+    @return   True if they went idle within TEST_MAX_PASSES
+*/
+/**************************************************************************/
+static bool RunUntilIdle(I2cEngine &wireEngine, I2cEngine &wire1Engine)
+{
+  I2cEngine *engines[] = { &wireEngine, &wire1Engine };
+
+  for (uint32_t pass=0; pass<TEST_MAX_PASSES; pass++)
+  {
+    if (wireEngine.IsIdle() && wire1Engine.IsIdle())
+    {
+      return true;
+    }
+    I2cServiceAll(engines, 2);
+    fakeMicros++;
+  }
+  return false;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Find an engine's counters for one address
+    @return   Counters, or NULL if the engine has not seen addr
+*/
+/**************************************************************************/
+static const I2cDeviceStats *FindStats(const I2cEngine &engine, uint8_t addr)
+{
+  for (uint8_t i=0; i<engine.GetNumDevices(); i++)
+  {
+    if (engine.GetDeviceStats(i).addr == addr)
+    {
+      return &engine.GetDeviceStats(i);
+    }
+  }
+  return NULL;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Both buses busy at once, each completing in FIFO order with its data and callbacks
+*/
+/**************************************************************************/
+static void TestOverlapAndOrder(void)
+{
+  FakeI2cBus wire, wire1;
+  I2cEngine wireEngine(wire, FakeClock);
+  I2cEngine wire1Engine(wire1, FakeClock);
+  I2cTransaction txns[2 * TEST_TXNS_PER_BUS];
+  int ids[2 * TEST_TXNS_PER_BUS];
+  uint8_t reads[2 * TEST_TXNS_PER_BUS][4];
+
+  // Fret QTouch chips on one bus, strum QTouch and the IMU on the other
+  uint8_t *qt2120 = wire.AddDevice(TEST_QT2120_ADDR);
+  uint8_t *qt1070 = wire.AddDevice(TEST_QT1070_ADDR);
+  uint8_t *mma = wire1.AddDevice(TEST_MMA8452Q_ADDR);
+  for (int r=0; r<256; r++)
+  {
+    qt2120[r] = r;
+    qt1070[r] = 0x80 | r;
+    mma[r] = 0xFF - r;
+  }
+
+  callbackCount = 0;
+  for (int i=0; i<2 * TEST_TXNS_PER_BUS; i++)
+  {
+    bool isWire = (i < TEST_TXNS_PER_BUS);
+    uint8_t addr = isWire ? ((i % 2) ? TEST_QT1070_ADDR : TEST_QT2120_ADDR) : TEST_MMA8452Q_ADDR;
+    ids[i] = i;
+    memset(reads[i], 0, sizeof(reads[i]));
+    txns[i].SetupRead(addr, 2 * i, reads[i], sizeof(reads[i]));
+    txns[i].callback = RecordCompletion;
+    txns[i].context = &ids[i];
+    CHECK((isWire ? wireEngine : wire1Engine).Submit(txns[i]));
+  }
+  CHECK(!wireEngine.Submit(txns[0]));  // already pending
+
+  if (!CHECK(RunUntilIdle(wireEngine, wire1Engine)))
+  {
+    return;
+  }
+
+  for (int i=0; i<2 * TEST_TXNS_PER_BUS; i++)
+  {
+    bool isWire = (i < TEST_TXNS_PER_BUS);
+    const uint8_t *regs = isWire ? ((i % 2) ? qt1070 : qt2120) : mma;
+    CHECK(txns[i].status == I2C_STATUS_DONE);
+    CHECK(txns[i].readCount == sizeof(reads[i]));
+    CHECK(memcmp(reads[i], &regs[2 * i], sizeof(reads[i])) == 0);
+  }
+
+  // Each bus ran its transactions back to back in the order they were submitted
+  for (int b=0; b<2; b++)
+  {
+    FakeI2cBus &bus = b ? wire1 : wire;
+    if (!CHECK(bus.GetLogCount() == TEST_TXNS_PER_BUS))
+    {
+      continue;
+    }
+    for (int i=0; i<TEST_TXNS_PER_BUS; i++)
+    {
+      const FakeI2cLogEntry *entry = bus.GetLogEntry(i);
+      CHECK(entry->reg == 2 * (b * TEST_TXNS_PER_BUS + i));
+      CHECK(entry->status == I2C_STATUS_DONE);
+      CHECK(i == 0 || entry->startTick >= bus.GetLogEntry(i - 1)->endTick);
+    }
+  }
+
+  // The buses were busy at the same time, not one after the other
+  if (wire.GetLogCount() == TEST_TXNS_PER_BUS && wire1.GetLogCount() == TEST_TXNS_PER_BUS)
+  {
+    const FakeI2cLogEntry *first = wire.GetLogEntry(0);
+    const FakeI2cLogEntry *first1 = wire1.GetLogEntry(0);
+    CHECK(first->startTick < first1->endTick && first1->startTick < first->endTick);
+    CHECK(wire.GetLogEntry(TEST_TXNS_PER_BUS - 1)->endTick > first1->endTick);
+  }
+
+  // Callbacks ran once each, with the final status set, per bus in submit order
+  CHECK(callbackCount == 2 * TEST_TXNS_PER_BUS);
+  int nextWire = 0;
+  int nextWire1 = TEST_TXNS_PER_BUS;
+  for (int i=0; i<callbackCount; i++)
+  {
+    CHECK(callbackStatus[i] == I2C_STATUS_DONE);
+    if (callbackOrder[i] < TEST_TXNS_PER_BUS)
+    {
+      CHECK(callbackOrder[i] == nextWire++);
+    }
+    else
+    {
+      CHECK(callbackOrder[i] == nextWire1++);
+    }
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    Writes land in the register map, a pure write reads nothing back
+*/
+/**************************************************************************/
+static void TestWrite(void)
+{
+  FakeI2cBus wire;
+  I2cEngine wireEngine(wire, FakeClock);
+  I2cTransaction txn;
+  const uint8_t values[] = { 0x11, 0x22, 0x33 };
+
+  uint8_t *regs = wire.AddDevice(TEST_QT2120_ADDR);
+  CHECK(txn.SetupWrite(TEST_QT2120_ADDR, 0x20, values, sizeof(values)));
+  CHECK(wireEngine.Transfer(txn));
+  CHECK(memcmp(&regs[0x20], values, sizeof(values)) == 0);
+  CHECK(txn.readCount == 0);
+
+  uint8_t tooLong[I2C_TXN_MAX_WRITE];
+  CHECK(!txn.SetupWrite(TEST_QT2120_ADDR, 0, tooLong, sizeof(tooLong)));
+}
+
+/**************************************************************************/
+/*!
+    @brief    An absent device NACKs every attempt and the transaction fails after its retries
+*/
+/**************************************************************************/
+static void TestNackExhaustsRetries(void)
+{
+  FakeI2cBus wire;
+  I2cEngine wireEngine(wire, FakeClock);
+  I2cTransaction txn;
+  uint8_t value;
+
+  txn.SetupRead(TEST_ABSENT_ADDR, 0, &value, 1);
+  CHECK(!wireEngine.Transfer(txn));
+  CHECK(txn.status == I2C_STATUS_NACK);
+  CHECK(wire.GetLogCount() == 1 + I2C_DEFAULT_RETRIES);
+  CHECK(wire.GetRecoveries() == 0);  // a NACK leaves the bus idle
+
+  const I2cDeviceStats *stats = FindStats(wireEngine, TEST_ABSENT_ADDR);
+  if (CHECK(stats != NULL))
+  {
+    CHECK(stats->transactions == 1 + I2C_DEFAULT_RETRIES);
+    CHECK(stats->nacks == 1 + I2C_DEFAULT_RETRIES);
+    CHECK(stats->retries == I2C_DEFAULT_RETRIES);
+    CHECK(stats->bytes == 0);
+  }
+
+  // Without retries the first NACK is final
+  txn.maxRetries = 0;
+  CHECK(!wireEngine.Transfer(txn));
+  CHECK(wire.GetLogCount() == 2 + I2C_DEFAULT_RETRIES);
+}
+
+/**************************************************************************/
+/*!
+    @brief    A NACK and a bus error are retried, the transaction then succeeds
+*/
+/**************************************************************************/
+static void TestRetryRecovers(void)
+{
+  FakeI2cBus wire;
+  I2cEngine wireEngine(wire, FakeClock);
+  I2cTransaction txn;
+  uint8_t value = 0;
+
+  wire.AddDevice(TEST_MMA8452Q_ADDR)[0x0D] = 0x2A;
+
+  wire.InjectFault(I2C_STATUS_NACK, 1);
+  txn.SetupRead(TEST_MMA8452Q_ADDR, 0x0D, &value, 1);
+  CHECK(wireEngine.Transfer(txn));
+  CHECK(value == 0x2A);
+  CHECK(wire.GetLogCount() == 2);
+  CHECK(wire.GetRecoveries() == 0);
+
+  wire.InjectFault(I2C_STATUS_ERROR, I2C_DEFAULT_RETRIES);
+  value = 0;
+  CHECK(wireEngine.Transfer(txn));
+  CHECK(value == 0x2A);
+  CHECK(wire.GetRecoveries() == I2C_DEFAULT_RETRIES);  // an error may leave a device mid-byte
+  CHECK(wireEngine.GetRecoveries() == I2C_DEFAULT_RETRIES);
+
+  const I2cDeviceStats *stats = FindStats(wireEngine, TEST_MMA8452Q_ADDR);
+  if (CHECK(stats != NULL))
+  {
+    CHECK(stats->nacks == 1);
+    CHECK(stats->errors == I2C_DEFAULT_RETRIES);
+    CHECK(stats->retries == 1 + I2C_DEFAULT_RETRIES);
+    CHECK(stats->bytes == 2 * (txn.writeLen + txn.readLen));
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    A hung transfer times out, the bus is recovered and the queue behind it still runs
+*/
+/**************************************************************************/
+static void TestTimeout(void)
+{
+  FakeI2cBus wire, wire1;
+  I2cEngine wireEngine(wire, FakeClock);
+  I2cEngine wire1Engine(wire1, FakeClock);
+  I2cTransaction hung, behind, other;
+  uint8_t hungValue = 0, behindValue = 0, otherValue = 0;
+
+  wire.AddDevice(TEST_QT2120_ADDR)[0] = 0x3E;
+  wire1.AddDevice(TEST_QT1070_ADDR)[0] = 0x2E;
+
+  // Every attempt of the first transaction hangs, the one behind it must not
+  wire.InjectFault(I2C_STATUS_TIMEOUT, 1 + I2C_DEFAULT_RETRIES);
+  hung.SetupRead(TEST_QT2120_ADDR, 0, &hungValue, 1);
+  behind.SetupRead(TEST_QT2120_ADDR, 0, &behindValue, 1);
+  other.SetupRead(TEST_QT1070_ADDR, 0, &otherValue, 1);
+  CHECK(wireEngine.Submit(hung));
+  CHECK(wireEngine.Submit(behind));
+  CHECK(wire1Engine.Submit(other));
+
+  uint32_t startMicros = fakeMicros;
+  if (!CHECK(RunUntilIdle(wireEngine, wire1Engine)))
+  {
+    return;
+  }
+  CHECK(hung.status == I2C_STATUS_TIMEOUT);
+  CHECK(behind.status == I2C_STATUS_DONE && behindValue == 0x3E);
+  CHECK(other.status == I2C_STATUS_DONE && otherValue == 0x2E);
+  CHECK(wire.GetRecoveries() == 1 + I2C_DEFAULT_RETRIES);
+  CHECK(wire1.GetRecoveries() == 0);
+  CHECK(fakeMicros - startMicros >= (1 + I2C_DEFAULT_RETRIES) * I2C_TIMEOUT_BASE_US);
+
+  // The hung bus did not hold up the other one
+  if (CHECK(wire1.GetLogCount() == 1))
+  {
+    CHECK(wire1.GetLogEntry(0)->endTick < I2C_TIMEOUT_BASE_US);
+  }
+
+  const I2cDeviceStats *stats = FindStats(wireEngine, TEST_QT2120_ADDR);
+  if (CHECK(stats != NULL))
+  {
+    CHECK(stats->timeouts == 1 + I2C_DEFAULT_RETRIES);
+    CHECK(stats->retries == I2C_DEFAULT_RETRIES);
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    ProbeClock keeps the first candidate every ID read passes at
+*/
+/**************************************************************************/
+static void TestProbeClock(void)
+{
+  FakeI2cBus wire;
+  I2cEngine wireEngine(wire, FakeClock);
+  const uint32_t clocks[] = { 400000, I2C_CLOCK_DEFAULT_HZ };
+
+  wire.AddDevice(TEST_QT2120_ADDR)[0] = 0x3E;
+
+  // One failed ID read rejects the faster clock
+  wire.InjectFault(I2C_STATUS_NACK, 1);
+  CHECK(wireEngine.ProbeClock(TEST_QT2120_ADDR, 0, 0x3E, clocks, 2) == I2C_CLOCK_DEFAULT_HZ);
+  CHECK(wireEngine.ProbeClock(TEST_QT2120_ADDR, 0, 0x3E, clocks, 2) == 400000);
+  CHECK(wire.GetClock() == 400000);
+  CHECK(wireEngine.ProbeClock(TEST_QT2120_ADDR, 0, 0x00, clocks, 2) == 0);
+}
+
+int main(void)
+{
+  TestOverlapAndOrder();
+  TestWrite();
+  TestNackExhaustsRetries();
+  TestRetryRecovers();
+  TestTimeout();
+  TestProbeClock();
+
+  if (failures > 0)
+  {
+    printf("%u checks failed\n", failures);
+    return 1;
+  }
+  printf("All I2C engine checks passed\n");
+  return 0;
+}
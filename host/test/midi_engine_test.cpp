@@ -0,0 +1,408 @@
+/*!
+ * @file midi_engine_test.cpp
+ *
+ * \brief Host test of MidiEngine queueing against a recording MidiSink
+ *
+ * Usage: potv2-midi-test
+ *
+ * Drives a MidiEngine from a real SensorState the way the sketch does, one
+ * Update() and Service() per pass, into a sink that records every message
+ * and can refuse to send. Built with a short MIDI_QUEUE_LEN so the queue
+ * fills. Checks that messages wait while the sink is busy, that a newer
+ * controller or pitch bend value replaces the queued one, that a note off
+ * cancels a note on that never went out, that a controller which finds the
+ * queue full is sent on the next Update(), and that a note off is never
+ * dropped. Prints each failed check and exits 1 if any.
+ *
+ * Author: Chase E. Stewart for Hidden Layer Design
+ *
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "MidiEngine.hpp"
+#include "ControlCurves.hpp"
+#include "SensorState.hpp"
+#include "SerialTx.hpp"
+
+#define TEST_MAX_MESSAGES  64  ///< Messages the recording sink keeps
+#define TEST_STRUM_PADS_PER_KEY  4  ///< StrumBoard pads per strum key, as in SensorState.cpp
+
+#define CHECK(cond)  Check((cond), #cond, __LINE__)  ///< Record a failure with its source line if cond is false
+
+static_assert(MIDI_QUEUE_LEN == MIDI_NUM_STRINGS + 2, "Build the test with room for a note on every string plus two controllers");
+
+static unsigned failures;  ///< Failed checks so far
+
+/**************************************************************************/
+/*!
+    @brief  MidiSink that keeps every message, sends only while isReady
+*/
+/**************************************************************************/
+class RecordingMidiSink : public MidiSink
+{
+  public:
+    bool isReady;  ///< False makes CanSend() refuse, like a busy USB or UART
+    MidiMessage sent[TEST_MAX_MESSAGES];  ///< Messages in the order they were sent
+    uint8_t numSent;  ///< Valid entries in sent
+    uint8_t numFlushes;  ///< Calls to Flush()
+
+    RecordingMidiSink() : isReady(false), numSent(0), numFlushes(0) { }
+    bool CanSend(void) { return isReady && numSent < TEST_MAX_MESSAGES; }
+    void Send(const MidiMessage &msg) { sent[numSent++] = msg; }
+    void Flush(void) { numFlushes++; }
+};
+
+/**************************************************************************/
+/*!
+    @brief    Report a failed check
+    @return   cond, so callers can skip checks that depend on it
+*/
+/**************************************************************************/
+static bool Check(bool cond, const char *text, int line)
+{
+  if (!cond)
+  {
+    printf("FAIL line %d: %s\n", line, text);
+    failures++;
+  }
+  return cond;
+}
+
+/**************************************************************************/
+/*!
+    @brief    StrumBoard bitmap holding the given strum keys
+    @param    keys
+              One bit per key, as in SensorSnapshot::key
+*/
+/**************************************************************************/
+static uint32_t StrumPads(uint8_t keys)
+{
+  uint32_t pads = 0;
+
+  for (uint8_t key=0; key<MIDI_NUM_STRINGS; key++)
+  {
+    if (keys & (1 << key))
+    {
+      pads |= 1UL << (key * TEST_STRUM_PADS_PER_KEY);
+    }
+  }
+  return pads;
+}
+
+/**************************************************************************/
+/*!
+    @brief    FretBoard bitmap with only the given fret held
+*/
+/**************************************************************************/
+static uint32_t FretPads(uint8_t fret)
+{
+  return 1UL << (fret - 1);
+}
+
+/**************************************************************************/
+/*!
+    @brief    Note a string sounds at a fret
+*/
+/**************************************************************************/
+static uint8_t Note(uint8_t string, uint8_t fret)
+{
+  return MIDI_LOWEST_OPEN_NOTE + string * MIDI_STRING_INTERVAL + fret;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Pitch bend message bytes for an ultrasonic distance, as Update() sends them
+*/
+/**************************************************************************/
+static uint16_t PitchBend(uint8_t rangeCm)
+{
+  return MIDI_PITCH_BEND_CENTER + ULTRA_CM_TO_PITCH_BEND.MapClamped(rangeCm);
+}
+
+/**************************************************************************/
+/*!
+    @brief    Find the first recorded message with these bytes
+    @return   Index into sink.sent, or -1 if none
+*/
+/**************************************************************************/
+static int FindSent(const RecordingMidiSink &sink, uint8_t status, uint8_t data1, uint8_t data2)
+{
+  for (uint8_t i=0; i<sink.numSent; i++)
+  {
+    if (sink.sent[i].status == status && sink.sent[i].data1 == data1 && sink.sent[i].data2 == data2)
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Count recorded messages of one status
+*/
+/**************************************************************************/
+static uint8_t CountSent(const RecordingMidiSink &sink, uint8_t status)
+{
+  uint8_t count = 0;
+
+  for (uint8_t i=0; i<sink.numSent; i++)
+  {
+    count += (sink.sent[i].status == status);
+  }
+  return count;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Let the sink send, drain the queue and forget what went out
+*/
+/**************************************************************************/
+static void Drain(MidiEngine &engine, RecordingMidiSink &sink)
+{
+  sink.isReady = true;
+  engine.Service();
+  sink.numSent = 0;
+  sink.numFlushes = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief    Nothing reaches a busy sink, the queue goes out in order and with one flush once it is ready
+*/
+/**************************************************************************/
+static void TestWaitsWhileBusy(void)
+{
+  SerialTx tx;
+  SensorState state(tx);
+  RecordingMidiSink sink;
+  MidiEngine engine(sink);
+
+  state.UpdateRotEnc(20);
+  engine.SetEnabled(true);
+  for (int pass=0; pass<3; pass++)
+  {
+    engine.Update(state);
+    engine.Service();
+  }
+  CHECK(sink.numSent == 0);
+  CHECK(sink.numFlushes == 0);
+  CHECK(engine.GetSentCount() == 0);
+
+  sink.isReady = true;
+  engine.Service();
+  if (CHECK(sink.numSent == 3))
+  {
+    CHECK(sink.sent[0].status == (MIDI_STATUS_PITCH_BEND | MIDI_CHANNEL));
+    CHECK(sink.sent[1].status == (MIDI_STATUS_CONTROL_CHANGE | MIDI_CHANNEL) && sink.sent[1].data1 == MIDI_CC_ROT_POT);
+    CHECK(sink.sent[2].status == (MIDI_STATUS_CONTROL_CHANGE | MIDI_CHANNEL) && sink.sent[2].data1 == MIDI_CC_ROT_ENC);
+    CHECK(sink.sent[2].data2 == 20);
+  }
+  CHECK(sink.numFlushes == 1);
+  CHECK(engine.GetSentCount() == 3);
+
+  // An empty queue does not flush
+  engine.Service();
+  CHECK(sink.numFlushes == 1);
+}
+
+/**************************************************************************/
+/*!
+    @brief    A newer CC or pitch bend value overwrites the one still queued
+*/
+/**************************************************************************/
+static void TestControllerCoalesced(void)
+{
+  SerialTx tx;
+  SensorState state(tx);
+  RecordingMidiSink sink;
+  MidiEngine engine(sink);
+
+  engine.SetEnabled(true);
+  engine.Update(state);
+  Drain(engine, sink);
+
+  sink.isReady = false;
+  state.UpdateRotEnc(10);
+  state.UpdateUltrasonic(20, true);
+  engine.Update(state);
+  state.UpdateRotEnc(30);
+  state.UpdateUltrasonic(40, true);
+  engine.Update(state);
+  state.UpdateRotEnc(50);
+  engine.Update(state);
+  CHECK(engine.GetCoalescedCount() == 3);
+
+  sink.isReady = true;
+  engine.Service();
+  if (CHECK(sink.numSent == 2))
+  {
+    uint16_t bend = PitchBend(40);
+    CHECK(sink.sent[0].status == (MIDI_STATUS_PITCH_BEND | MIDI_CHANNEL));
+    CHECK(sink.sent[0].data1 == (bend & 0x7F) && sink.sent[0].data2 == (bend >> 7));
+    CHECK(sink.sent[1].data1 == MIDI_CC_ROT_ENC && sink.sent[1].data2 == 50);
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    A note released before its note on went out sends neither, one that went out gets its note off
+*/
+/**************************************************************************/
+static void TestNoteOffCancelsNoteOn(void)
+{
+  SerialTx tx;
+  SensorState state(tx);
+  RecordingMidiSink sink;
+  MidiEngine engine(sink);
+
+  engine.SetEnabled(true);
+  engine.Update(state);
+  Drain(engine, sink);
+
+  sink.isReady = false;
+  state.UpdateFret(FretPads(3));
+  state.UpdateStrumKey(StrumPads(0x1));
+  engine.Update(state);
+  state.UpdateStrumKey(StrumPads(0));
+  engine.Update(state);
+  sink.isReady = true;
+  engine.Service();
+  CHECK(sink.numSent == 0);
+  CHECK(engine.GetCoalescedCount() == 1);
+
+  state.UpdateStrumKey(StrumPads(0x1));
+  engine.Update(state);
+  engine.Service();
+  state.UpdateStrumKey(StrumPads(0));
+  engine.Update(state);
+  engine.Service();
+  if (CHECK(sink.numSent == 2))
+  {
+    CHECK(sink.sent[0].status == (MIDI_STATUS_NOTE_ON | MIDI_CHANNEL));
+    CHECK(sink.sent[0].data1 == Note(0, 3) && sink.sent[0].data2 == MIDI_NOTE_VELOCITY);
+    CHECK(sink.sent[1].data1 == Note(0, 3) && sink.sent[1].data2 == 0);
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief    A controller that finds the queue full, or is evicted by a note, goes out after the next Update()
+*/
+/**************************************************************************/
+static void TestFullQueueResendsController(void)
+{
+  SerialTx tx;
+  SensorState state(tx);
+  RecordingMidiSink sink;
+  MidiEngine engine(sink);
+
+  engine.SetEnabled(true);
+  engine.Update(state);
+  Drain(engine, sink);
+
+  // Three controllers then a note on every string, the last notes evict the oldest controllers
+  sink.isReady = false;
+  state.UpdateUltrasonic(20, true);
+  state.UpdateRotPot(POT_VALUE_MAX);
+  state.UpdateRotEnc(10);
+  state.UpdateFret(FretPads(2));
+  state.UpdateStrumKey(StrumPads(0xF));
+  engine.Update(state);
+
+  // Nowhere to put a new pitch bend value either
+  state.UpdateUltrasonic(30, true);
+  engine.Update(state);
+  CHECK(engine.GetDroppedCount() == 0);
+
+  sink.isReady = true;
+  engine.Service();
+  CHECK(sink.numSent == MIDI_QUEUE_LEN);
+  CHECK(CountSent(sink, MIDI_STATUS_NOTE_ON | MIDI_CHANNEL) == MIDI_NUM_STRINGS);
+  CHECK(CountSent(sink, MIDI_STATUS_PITCH_BEND | MIDI_CHANNEL) == 0);
+  CHECK(FindSent(sink, MIDI_STATUS_CONTROL_CHANGE | MIDI_CHANNEL, MIDI_CC_ROT_ENC, 10) >= 0);
+  sink.numSent = 0;
+
+  // No state change, the pitch bend that did not fit still goes out, with its latest value
+  engine.Update(state);
+  engine.Service();
+  if (CHECK(sink.numSent == 1))
+  {
+    uint16_t bend = PitchBend(30);
+    CHECK(sink.sent[0].status == (MIDI_STATUS_PITCH_BEND | MIDI_CHANNEL));
+    CHECK(sink.sent[0].data1 == (bend & 0x7F) && sink.sent[0].data2 == (bend >> 7));
+  }
+  sink.numSent = 0;
+
+  // Nothing left over
+  engine.Update(state);
+  engine.Service();
+  CHECK(sink.numSent == 0);
+}
+
+/**************************************************************************/
+/*!
+    @brief    With the queue full of notes a note off evicts a note on, so every sounding note is released
+*/
+/**************************************************************************/
+static void TestNoteOffNeverDropped(void)
+{
+  SerialTx tx;
+  SensorState state(tx);
+  RecordingMidiSink sink;
+  MidiEngine engine(sink);
+
+  engine.SetEnabled(true);
+  state.UpdateFret(FretPads(1));
+  state.UpdateStrumKey(StrumPads(0xF));
+  engine.Update(state);
+  Drain(engine, sink);
+
+  // The notes evicted the pitch bend, send it so the queue starts empty
+  engine.Update(state);
+  Drain(engine, sink);
+  CHECK(engine.GetSentCount() == 3 + MIDI_NUM_STRINGS);
+
+  // Moving every string queues a note off and a note on each, more than fit
+  sink.isReady = false;
+  state.UpdateFret(FretPads(5));
+  engine.Update(state);
+  CHECK(engine.GetDroppedCount() == 2 * MIDI_NUM_STRINGS - MIDI_QUEUE_LEN);
+
+  sink.isReady = true;
+  engine.Service();
+  CHECK(sink.numSent == MIDI_QUEUE_LEN);
+  for (uint8_t string=0; string<MIDI_NUM_STRINGS; string++)
+  {
+    CHECK(FindSent(sink, MIDI_STATUS_NOTE_ON | MIDI_CHANNEL, Note(string, 1), 0) >= 0);
+  }
+  sink.numSent = 0;
+
+  // Releasing sends a note off for each string whose new note went out
+  state.UpdateStrumKey(StrumPads(0));
+  engine.Update(state);
+  engine.Service();
+  CHECK(CountSent(sink, MIDI_STATUS_NOTE_ON | MIDI_CHANNEL) == MIDI_NUM_STRINGS);
+  for (uint8_t i=0; i<sink.numSent; i++)
+  {
+    CHECK(sink.sent[i].data2 == 0);
+  }
+}
+
+int main(void)
+{
+  TestWaitsWhileBusy();
+  TestControllerCoalesced();
+  TestNoteOffCancelsNoteOn();
+  TestFullQueueResendsController();
+  TestNoteOffNeverDropped();
+
+  if (failures > 0)
+  {
+    printf("%u checks failed\n", failures);
+    return 1;
+  }
+  printf("All MIDI engine checks passed\n");
+  return 0;
+}